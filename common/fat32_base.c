@@ -241,11 +241,13 @@ finalize_long_name(struct fat_walk_long_name_ctx *ctx,
 }
 
 int
-fat_walk(struct fat_walk_static_params *p, u32 cluster)
+fat_walk_from(struct fat_walk_static_params *p, struct fat_walk_pos *pos)
 {
    struct fat_walk_long_name_ctx *const ctx = p->ctx;
    const u32 entries_per_cluster = fat_get_dir_entries_per_cluster(p->h);
    struct fat_entry *dentries = NULL;
+   u32 cluster = pos->cluster;
+   u32 i = pos->index;
 
    ASSERT(p->ft == fat16_type || p->ft == fat32_type);
 
@@ -259,6 +261,13 @@ fat_walk(struct fat_walk_static_params *p, u32 cluster)
       ctx->is_valid = false;
    }
 
+   /*
+    * `pos` always points to the first slot of the next entry to visit, which
+    * is its first long name entry, if any: that way, resuming the walk from
+    * `pos` doesn't require saving the long name context.
+    */
+   *pos = (struct fat_walk_pos) { cluster, i };
+
    while (true) {
 
       if (cluster != 0) {
@@ -274,24 +283,30 @@ fat_walk(struct fat_walk_static_params *p, u32 cluster)
 
       ASSERT(dentries != NULL);
 
-      for (u32 i = 0; i < entries_per_cluster; i++) {
+      for (; i < entries_per_cluster; i++) {
+
+         if (is_long_name_entry(&dentries[i])) {
+
+            if (ctx)
+               fat_handle_long_dir_entry(ctx, (void *)&dentries[i]);
 
-         if (ctx && is_long_name_entry(&dentries[i])) {
-            fat_handle_long_dir_entry(ctx, (void *)&dentries[i]);
             continue;
          }
 
          // the first "file" is the volume ID. Skip it.
-         if (dentries[i].volume_id)
-            continue;
-
          // the entry was used, but now is free
-         if (dentries[i].DIR_Name[0] == FAT_ENTRY_AVAILABLE)
+         if (dentries[i].volume_id ||
+             dentries[i].DIR_Name[0] == FAT_ENTRY_AVAILABLE)
+         {
+            *pos = (struct fat_walk_pos) { cluster, i + 1 };
             continue;
+         }
 
          // that means all the rest of the entries are free.
-         if (dentries[i].DIR_Name[0] == FAT_ENTRY_LAST)
+         if (dentries[i].DIR_Name[0] == FAT_ENTRY_LAST) {
+            *pos = (struct fat_walk_pos) { cluster, i };
             return 0;
+         }
 
          const char *long_name_ptr = NULL;
 
@@ -306,9 +321,15 @@ fat_walk(struct fat_walk_static_params *p, u32 cluster)
          }
 
          if (ret) {
-            /* the callback returns a value != 0 to request a walk STOP. */
+            /*
+             * The callback returns a value != 0 to request a walk STOP. In
+             * that case, the entry is considered as NOT visited and `pos`
+             * keeps pointing to it.
+             */
             return 0;
          }
+
+         *pos = (struct fat_walk_pos) { cluster, i + 1 };
       }
 
       /*
@@ -333,11 +354,22 @@ fat_walk(struct fat_walk_static_params *p, u32 cluster)
       ASSERT(!fat_is_bad_cluster(p->ft, val));
 
       cluster = val;
+      i = 0;
+
+      if (pos->index == entries_per_cluster)
+         *pos = (struct fat_walk_pos) { cluster, 0 };
    }
 
    return 0;
 }
 
+int
+fat_walk(struct fat_walk_static_params *p, u32 cluster)
+{
+   struct fat_walk_pos pos = { cluster, 0 };
+   return fat_walk_from(p, &pos);
+}
+
 u32 fat_get_cluster_count(struct fat_hdr *hdr)
 {
    const u32 FATSz = fat_get_FATSz(hdr);
@@ -43,8 +43,20 @@
 #define PROCESS_CMDLINE_BUF_SIZE                  256
 #define MAX_MOUNTPOINTS                            16
 #define MAX_NESTED_INTERRUPTS                      32
+#define VFS_DCACHE_ENTRIES                        256  /* must be a power of 2 */
+#define VFS_DCACHE_NAME_LEN                        32
 
 #define WTH_MAX_THREADS                            64
 #define WTH_MAX_PRIO_QUEUE_SIZE                    32
 #define WTH_KB_QUEUE_SIZE                          32
 #define WTH_SERIAL_QUEUE_SIZE                      32
+#define SERIAL_TX_BUF_SIZE                       1024  /* per serial port */
+#define WTH_OVERFLOW_POOL_SIZE                     64
+
+#define AIO_WORKER_THREADS                          2
+#define AIO_WTH_QUEUE_SIZE                         32
+#define AIO_MAX_EVENTS                           4096  /* per context */
+#define AIO_MAX_CTXS                               32  /* per process */
+
+#define TRACE_BUF_SIZE                     (128 * KB)  /* all trace buffers */
+#define TRACE_NR_BUFS                               4  /* traced tasks + 1 */
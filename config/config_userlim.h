@@ -35,6 +35,14 @@
  */
 #define MAX_SCRIPT_REC                                          2
 
+/*
+ * RLIMIT_NOFILE: default soft limit and max value (like `nr_open` on Linux),
+ * also used as default hard limit. The per-process fd table starts with
+ * MAX_HANDLES slots and grows on demand, up to the soft limit.
+ */
+#define NOFILE_DEFAULT_CUR                                   1024
+#define NOFILE_MAX                                           4096
+
 /*
  * Per-task I/O buffer size (pages).
  * Note it is linked with USER_ARGS_PAGE_COUNT.
@@ -36,3 +36,4 @@
 #define TTY_INPUT_BS                                              1024
 #define FAILSAFE_COLS                                              80u
 #define FAILSAFE_ROWS                                              25u
+#define TERM_REFRESH_HZ                                             60u
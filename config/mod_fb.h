@@ -11,6 +11,7 @@
 /* ------ Value-based config variables -------- */
 
 #define FBCON_BIGFONT_THR      @FBCON_BIGFONT_THR@
+#define FBCON_GLYPH_CACHE_KB   @FBCON_GLYPH_CACHE_KB@
 
 /* --------- Boolean config variables --------- */
 
@@ -34,5 +35,5 @@
  */
 
 
-#define FBCON_OPT_FUNCS_MIN_FREE_HEAP                        (16 * MB)
+#define FBCON_PAN_MAX_SCREENS                                        4
 #define FAILSAFE_FB_VADDR          (KERNEL_BASE_VA + (1024 - 64) * MB)
@@ -92,6 +92,8 @@ struct x86_cpu_features {
    } ecx1;
 
    bool avx2;
+   bool invpcid;
+   bool xsaveopt;
    bool invariant_TSC;
    u8 phys_addr_bits;
    u8 virt_addr_bits;
@@ -103,6 +105,7 @@ struct x86_cpu_features {
    bool can_use_sse4_1;
    bool can_use_avx;
    bool can_use_avx2;
+   bool can_use_xsaveopt;
 
 };
 
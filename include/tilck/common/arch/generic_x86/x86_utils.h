@@ -274,6 +274,15 @@ static ALWAYS_INLINE void cpuid(u32 code, u32 *a, u32 *b, u32 *c, u32 *d)
         : "memory");
 }
 
+static ALWAYS_INLINE void
+cpuid_count(u32 code, u32 subcode, u32 *a, u32 *b, u32 *c, u32 *d)
+{
+    asm("cpuid"
+        : "=a"(*a), "=b" (*b), "=c" (*c), "=d"(*d)
+        : "a"(code), "b" (0), "c" (subcode), "d" (0)
+        : "memory");
+}
+
 static ALWAYS_INLINE ulong read_cr0(void)
 {
    ulong res;
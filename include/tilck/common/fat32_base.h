@@ -261,12 +261,27 @@ struct fat_walk_static_params {
    void *arg;
 };
 
+/* Position of a dir entry slot, used to resume a directory walk */
+struct fat_walk_pos {
+
+   u32 cluster;         /* cluster containing the slot (0: root dir) */
+   u32 index;           /* index of the slot in the cluster */
+};
+
 /*
  * Walk the FAT directory having dir entries in the specified cluster.
  * For the root directory, just set cluster = 0.
  */
 int fat_walk(struct fat_walk_static_params *p, u32 cluster);
 
+/*
+ * Like fat_walk(), but start from the entry at `pos` and, before returning,
+ * update `pos` to point to the next entry to visit: the one for which the
+ * callback requested a STOP, if any. Calling again fat_walk_from() with the
+ * same `pos` resumes the walk.
+ */
+int fat_walk_from(struct fat_walk_static_params *p, struct fat_walk_pos *pos);
+
 struct fat_entry *
 fat_search_entry(struct fat_hdr *hdr,
                  enum fat_type ft,
@@ -17,9 +17,26 @@ enum tilck_cmd {
    TILCK_CMD_TRACING_TOOL        = 7,
    TILCK_CMD_PS_TOOL             = 8,
    TILCK_CMD_DEBUGGER_TOOL       = 9,
+   TILCK_CMD_PROFILER            = 10,
 
    /* Number of elements in the enum */
-   TILCK_CMD_COUNT               = 10,
+   TILCK_CMD_COUNT               = 11,
+};
+
+/* Sub-commands of TILCK_CMD_PROFILER (first argument) */
+enum tilck_prof_cmd {
+
+   TILCK_PROF_START              = 0,
+   TILCK_PROF_STOP               = 1,
+   TILCK_PROF_RESET              = 2,
+
+   /*
+    * Write a text report into the user buffer (2nd and 3rd args): the flat
+    * one (self/total samples per function) or the call graph one (the most
+    * common stacks). Returns the length of the report.
+    */
+   TILCK_PROF_REPORT_FLAT        = 3,
+   TILCK_PROF_REPORT_CALLGRAPH   = 4,
 };
 
 #if defined(__x86_64__)
@@ -27,6 +44,7 @@ enum tilck_cmd {
    #define STAT_SYSCALL_N      SYS_stat
    #define LSTAT_SYSCALL_N     SYS_lstat
    #define FSTAT_SYSCALL_N     SYS_fstat
+   #define FSTATAT_SYSCALL_N   SYS_newfstatat
    #define FCNTL_SYSCALL_N     SYS_fcntl
    #define MMAP_SYSCALL_N      SYS_mmap
 
@@ -35,6 +53,7 @@ enum tilck_cmd {
    #define STAT_SYSCALL_N      SYS_stat64
    #define LSTAT_SYSCALL_N     SYS_lstat64
    #define FSTAT_SYSCALL_N     SYS_fstat64
+   #define FSTATAT_SYSCALL_N   SYS_fstatat64
    #define FCNTL_SYSCALL_N     SYS_fcntl64
    #define MMAP_SYSCALL_N      192
 
@@ -114,6 +114,19 @@ get_first_set_bit_index64(u64 num)
    return i;
 }
 
+CONSTEXPR static inline u32
+get_last_set_bit_index64(u64 num)
+{
+   u32 i;
+   ASSERT(num != 0);
+
+   for (i = 63; i > 0; i--)
+      if (num & (1ull << i))
+         break;
+
+   return i;
+}
+
 CONSTEXPR static inline u32
 get_first_zero_bit_index_l(ulong num)
 {
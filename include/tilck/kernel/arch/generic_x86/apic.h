@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+
+#define LAPIC_DEFAULT_PADDR           0xfee00000
+#define IOAPIC_MAX_COUNT                       8
+#define MSI_ADDR_BASE                 0xfee00000
+
+/* Polarity and trigger mode flags for apic_add_irq_override() */
+#define APIC_IRQ_FL_ACTIVE_LOW            (1 << 0)
+#define APIC_IRQ_FL_LEVEL                 (1 << 1)
+
+/*
+ * Functions used by the ACPI module to describe the interrupt controllers
+ * found in the MADT table. They have to be called before init_irq_handling():
+ * when they're not called at all (no ACPI, no MADT), we just keep using the
+ * legacy 8259 PIC.
+ */
+void apic_set_lapic_paddr(ulong paddr);
+void apic_add_ioapic(u8 id, ulong paddr, u32 gsi_base);
+void apic_add_irq_override(u8 isa_irq, u32 gsi, u32 flags);
+
+/*
+ * Switch the IRQ delivery from the 8259 PIC to the I/O APIC + local APIC.
+ * Called by init_irq_handling() only when `-ioapic` is passed in the cmdline:
+ * the APIC mode is EXPERIMENTAL and off by default, because it has not been
+ * validated yet on any machine, virtual or real. The test runners can boot
+ * the kernel in this mode (see TILCK_IOAPIC in tests/runners). Only the ISA
+ * IRQs 0-15 are routed. Returns false (and leaves the PIC in charge) in case
+ * of failure.
+ */
+bool init_apic_irq_routing(void);
+
+static ALWAYS_INLINE bool apic_is_enabled(void)
+{
+   extern bool __apic_enabled;
+   return __apic_enabled;
+}
+
+/* Functions used by the generic IRQ code, valid only if apic_is_enabled() */
+void apic_mask_and_send_eoi(int irq);
+void apic_send_eoi(int irq);
+void apic_end_of_irq(int irq);
+bool apic_is_spur_irq(int irq);
+void apic_set_mask(int irq);
+void apic_clear_mask(int irq);
+bool apic_is_masked(int irq);
+
+/*
+ * Reserve an IRQ line for a message-signaled interrupt (PCI MSI) and get the
+ * address/data pair the device has to write in order to trigger it. Only the
+ * lines not connected to any I/O APIC pin are used, so that the IRQ will never
+ * be shared with a legacy device. The EOI for MSI lines is sent only after
+ * their handlers ran.
+ *
+ * Returns the IRQ number or a negative errno value (-ENODEV when the APIC is
+ * not in use, -ENOSPC when there are no free IRQ lines).
+ */
+int apic_alloc_msi_irq(u32 *addr, u32 *data);
+void apic_free_msi_irq(int irq);
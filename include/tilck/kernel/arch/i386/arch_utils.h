@@ -72,3 +72,8 @@ static ALWAYS_INLINE void *regs_get_ip(regs_t *r)
 {
    return TO_PTR(r->eip);
 }
+
+static ALWAYS_INLINE bool regs_in_user_mode(regs_t *r)
+{
+   return (r->cs & 3) == 3;
+}
@@ -62,3 +62,9 @@ static ALWAYS_INLINE void *regs_get_ip(regs_t *r)
 {
    return TO_PTR(r->rip);
 }
+
+static ALWAYS_INLINE bool regs_in_user_mode(regs_t *r)
+{
+   NOT_IMPLEMENTED();
+   return false;
+}
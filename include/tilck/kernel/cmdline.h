@@ -13,6 +13,7 @@ extern long kopt_ttys;
 extern bool kopt_sercon;
 extern bool kopt_sched_alive_thread;
 extern bool kopt_noacpi;
+extern bool kopt_ioapic;
 extern bool kopt_fb_no_opt;
 extern bool kopt_fb_no_wc;
 extern bool kopt_no_fpu_memcpy;
@@ -9,6 +9,7 @@ extern const ulong init_st_begin;
 extern const ulong init_st_end;
 
 void dump_stacktrace(void *ebp, pdir_t *pdir);
+size_t regs_stackwalk(regs_t *r, ulong *frames, size_t count);
 void dump_regs(regs_t *r);
 
 int debug_qemu_turn_off_machine(void);
@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+
+/*
+ * Directory index: a pair of open-addressing hash tables (linear probing) used
+ * by in-memory file systems to find the entries of a directory in O(1), both
+ * by name and by "cookie".
+ *
+ * Each entry gets a cookie when it's added to the directory: cookies grow
+ * monotonically and never change, therefore they're used as the stable,
+ * opaque, directory positions returned to userspace (d_off), resumable with
+ * seek(), even after other entries have been added or removed. Entries are
+ * expected to be kept in a list ordered by cookie (insertion order), so that
+ * getdents() can simply walk it.
+ *
+ * The tables store pointers to a `struct dir_index_node` embedded in each
+ * entry, like struct bintree_node. The zero-terminated name of the entry must
+ * be at a fixed offset from the node, passed to dir_index_init(). The tables
+ * grow and shrink automatically, keeping the load factor between 1/8 and 1/2.
+ */
+
+struct dir_index_node {
+   u32 hash;                        /* hash of the name */
+   u32 cookie;                      /* stable position in the directory */
+};
+
+struct dir_index {
+   struct dir_index_node **by_name;    /* `size` slots */
+   struct dir_index_node **by_cookie;  /* `size` slots, follows `by_name` */
+   u32 size;                           /* power of 2, or 0 */
+   u32 count;                          /* number of nodes in the index */
+   u32 next_cookie;
+   u32 name_off;                       /* offset of the name from the node */
+};
+
+void dir_index_init(struct dir_index *idx, long name_off);
+void dir_index_destroy(struct dir_index *idx);
+
+/*
+ * Add `n` to the index, assigning it the next cookie. The caller must have
+ * checked that no node with the same name exists. Returns 0 or -ENOMEM.
+ */
+int dir_index_insert(struct dir_index *idx, struct dir_index_node *n);
+void dir_index_remove(struct dir_index *idx, struct dir_index_node *n);
+
+struct dir_index_node *
+dir_index_find(struct dir_index *idx, const char *name, size_t len);
+
+struct dir_index_node *
+dir_index_find_cookie(struct dir_index *idx, u32 cookie);
+
+#define dir_index_init_for(idx, struct_type, node_name, name_field)    \
+   dir_index_init(                                                      \
+      (idx),                                                            \
+      OFFSET_OF(struct_type, name_field)                                \
+         - OFFSET_OF(struct_type, node_name)                            \
+   )
+
+#define dir_index_find_obj(idx, name, len, struct_type, node_name)     \
+   ({                                                                   \
+      struct dir_index_node *__n = dir_index_find((idx), (name), (len)); \
+      __n ? CONTAINER_OF(__n, struct_type, node_name) : NULL;           \
+   })
+
+#define dir_index_find_cookie_obj(idx, cookie, struct_type, node_name) \
+   ({                                                                   \
+      struct dir_index_node *__n = dir_index_find_cookie((idx), (cookie)); \
+      __n ? CONTAINER_OF(__n, struct_type, node_name) : NULL;           \
+   })
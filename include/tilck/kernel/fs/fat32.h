@@ -6,8 +6,57 @@
 #include <tilck/common/fat32_base.h>
 
 #include <tilck/kernel/sync.h>
+#include <tilck/kernel/bintree.h>
 #include <tilck/kernel/datetime.h>
 #include <tilck/kernel/fs/vfs_base.h>
+#include <tilck/kernel/fs/dir_index.h>
+
+/* A run of clusters, contiguous on the disk */
+struct fat_run {
+
+   u32 off;          /* index of the first cluster of the run, in the file */
+   u32 clu;          /* number of the first cluster of the run */
+};
+
+/*
+ * Cluster index of a file: its whole cluster chain, as an array of runs sorted
+ * by `off`. Because the FAT ramdisks are typically compacted, most files have
+ * just one run.
+ */
+struct fat_cindex {
+
+   struct bintree_node node;
+   ulong first_clu;        /* key: the first cluster of the file */
+   u32 clusters_count;     /* total number of clusters in the chain */
+   u32 runs_count;
+   struct fat_run *runs;
+};
+
+/* An entry in a directory index (see below) */
+struct fat_dname {
+
+   struct dir_index_node node;
+   struct fat_entry *e;
+   u32 pos;                /* position of the entry in the directory */
+   u32 name_len;
+   char name[];            /* long name or lowercase short name */
+};
+
+/*
+ * Name index of a directory, mapping names to entries. Long names are case
+ * sensitive, while short names are not (see fat_search_entry_cb()): entries
+ * having just a short name are indexed in `by_short` using the lowercase
+ * name. All the fat_dname objects are stored in the single buffer `buf`.
+ */
+struct fat_dindex {
+
+   struct bintree_node node;
+   ulong first_clu;        /* key: the first cluster of the directory */
+   struct dir_index by_long;
+   struct dir_index by_short;
+   char *buf;
+   size_t buf_size;
+};
 
 struct fat_fs_device_data {
 
@@ -28,6 +77,15 @@ struct fat_fs_device_data {
     * regular fat_entry.
     */
    struct fat_entry *root_dir_entries;
+
+   /* Cluster indexes of the files, built lazily (see fat_get_cindex()) */
+   struct fat_cindex *cindexes;
+
+   /* Name indexes of the directories, built lazily (see fat_get_dindex()) */
+   struct fat_dindex *dindexes;
+
+   /* Protects both `cindexes` and `dindexes` */
+   struct kmutex cache_lock;
 };
 
 struct fatfs_handle {
@@ -37,7 +95,16 @@ struct fatfs_handle {
 
    /* fs-specific members */
    struct fat_entry *e;
-   u32 curr_cluster;
+   struct fat_cindex *ci;     /* files only, NULL until the first read */
+
+   /*
+    * Directories only: position of the next entry to return, used by
+    * getdents() to resume the walk where the previous call stopped. The cursor
+    * is valid only as long as `dir_cur_pos` == dir_pos: otherwise, seek()
+    * has been used and the cursor has to be moved first.
+    */
+   struct fat_walk_pos dir_cur;
+   offt dir_cur_pos;
 };
 
 STATIC_ASSERT(sizeof(struct fatfs_handle) <= MAX_FS_HANDLE_SIZE);
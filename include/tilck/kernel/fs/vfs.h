@@ -22,6 +22,13 @@ struct vfs_dent64 {
    enum vfs_entry_type type;
    u8 name_len;               /* NODE: includes the final '\0' */
    const char *name;
+
+   /*
+    * Opaque dir offset to pass to seek() in order to resume reading the dir
+    * from the entry after this one. File systems not having stable offsets
+    * leave it to 0: in that case, the offsets are the indexes of the entries.
+    */
+   offt next_off;
 };
 
 typedef int (*get_dents_func_cb) (struct vfs_dent64 *, void *);
@@ -49,7 +56,11 @@ typedef int     (*func_2paths)    (struct mnt_fs *,
                                    struct vfs_path *,
                                    struct vfs_path *);
 
-typedef         func_2paths       func_rename;
+typedef int     (*func_rename)    (struct mnt_fs *,
+                                   struct vfs_path *,
+                                   struct vfs_path *,
+                                   u32 flags);
+
 typedef         func_2paths       func_link;
 
 typedef void    (*func_get_entry) (struct mnt_fs *fs,
@@ -114,9 +125,16 @@ typedef void           (*func_syncfs)       (struct mnt_fs *);
  * using a read-write lock under the hood. Yes, that means that for example two
  * creat() operations even in separate directories cannot happen at the same
  * time, on the same FS. But, given that Tilck does NOT support SMP, this
- * approach not only offers a great simplification, but it actually increases
- * the overall throughput of the system (fine-grain per-directory locking is
- * pretty expensive).
+ * approach not only offers a great simplification, but it's good enough for
+ * most of the file systems.
+ *
+ * File systems heavily used by concurrent tasks (ramfs, for /tmp) can opt-in
+ * for fine-grain locking by setting VFS_FS_DIRLOCKS: in that case, the VFS
+ * always grabs just a *shared* fs-lock, also for the operations changing the
+ * namespace (creat, mkdir, unlink, rename etc.), and it's up to the fs to
+ * serialize them using per-directory locks. Because the path is resolved
+ * before the fs-specific func is called, such file systems must re-check the
+ * last component of the path after acquiring the directory lock.
  */
 struct fs_ops {
 
@@ -187,20 +205,88 @@ struct file_ops {
    func_get_rwe_cond get_except_cond;  /* if NULL, return NULL */
 };
 
-int vfs_stat64(const char *path, struct k_stat64 *statbuf, bool res_last_sl);
-int vfs_open(const char *path, fs_handle *out, int flags, mode_t mode);
-int vfs_unlink(const char *path);
-int vfs_mkdir(const char *path, mode_t mode);
-int vfs_rmdir(const char *path);
+/*
+ * Path-based functions. The *at() variants resolve relative paths starting
+ * from the directory referred by `dirfd` (in the current process) instead of
+ * from the current working directory, unless `dirfd` is AT_FDCWD.
+ */
+int vfs_fstatat64(int dirfd, const char *path,
+                  struct k_stat64 *statbuf, bool res_last_sl);
+int vfs_openat(int dirfd, const char *path,
+               fs_handle *out, int flags, mode_t mode);
+int vfs_unlinkat(int dirfd, const char *path);
+int vfs_mkdirat(int dirfd, const char *path, mode_t mode);
+int vfs_rmdirat(int dirfd, const char *path);
 int vfs_truncate(const char *path, offt length);
-int vfs_symlink(const char *target, const char *linkpath);
-int vfs_readlink(const char *path, char *buf);
-int vfs_chown(const char *path, int owner, int group, bool reslink);
-int vfs_chmod(const char *path, mode_t mode);
-int vfs_rename(const char *oldpath, const char *newpath);
-int vfs_link(const char *oldpath, const char *newpath);
+int vfs_symlinkat(const char *target, int dirfd, const char *linkpath);
+int vfs_readlinkat(int dirfd, const char *path, char *buf);
+int vfs_fchownat(int dirfd, const char *path,
+                 int owner, int group, bool reslink);
+int vfs_fchmodat(int dirfd, const char *path, mode_t mode);
+int vfs_renameat(int olddirfd, const char *oldpath,
+                 int newdirfd, const char *newpath, u32 flags);
+int vfs_linkat(int olddirfd, const char *oldpath,
+               int newdirfd, const char *newpath, bool res_last_sl);
 int vfs_utimens(const char *path, const struct k_timespec64 times[2]);
 
+static inline int
+vfs_stat64(const char *path, struct k_stat64 *statbuf, bool res_last_sl)
+{
+   return vfs_fstatat64(AT_FDCWD, path, statbuf, res_last_sl);
+}
+
+static inline int
+vfs_open(const char *path, fs_handle *out, int flags, mode_t mode)
+{
+   return vfs_openat(AT_FDCWD, path, out, flags, mode);
+}
+
+static inline int vfs_unlink(const char *path)
+{
+   return vfs_unlinkat(AT_FDCWD, path);
+}
+
+static inline int vfs_mkdir(const char *path, mode_t mode)
+{
+   return vfs_mkdirat(AT_FDCWD, path, mode);
+}
+
+static inline int vfs_rmdir(const char *path)
+{
+   return vfs_rmdirat(AT_FDCWD, path);
+}
+
+static inline int vfs_symlink(const char *target, const char *linkpath)
+{
+   return vfs_symlinkat(target, AT_FDCWD, linkpath);
+}
+
+static inline int vfs_readlink(const char *path, char *buf)
+{
+   return vfs_readlinkat(AT_FDCWD, path, buf);
+}
+
+static inline int
+vfs_chown(const char *path, int owner, int group, bool reslink)
+{
+   return vfs_fchownat(AT_FDCWD, path, owner, group, reslink);
+}
+
+static inline int vfs_chmod(const char *path, mode_t mode)
+{
+   return vfs_fchmodat(AT_FDCWD, path, mode);
+}
+
+static inline int vfs_rename(const char *oldpath, const char *newpath)
+{
+   return vfs_renameat(AT_FDCWD, oldpath, AT_FDCWD, newpath, 0);
+}
+
+static inline int vfs_link(const char *oldpath, const char *newpath)
+{
+   return vfs_linkat(AT_FDCWD, oldpath, AT_FDCWD, newpath, false);
+}
+
 int vfs_ftruncate(fs_handle h, offt length);
 int vfs_ioctl(fs_handle h, ulong request, void *argp);
 int vfs_fstat64(fs_handle h, struct k_stat64 *statbuf);
@@ -225,6 +311,18 @@ ssize_t vfs_writev(fs_handle h, const struct iovec *iov, int iovcnt);
 ssize_t vfs_pread(fs_handle h, void *buf, size_t buf_size, offt off);
 ssize_t vfs_pwrite(fs_handle h, void *buf, size_t buf_size, offt off);
 
+/* Dentry cache stats, see vfs_dcache.c.h */
+struct vfs_dcache_stats {
+
+   u32 hits;               /* lookups answered by a cached positive entry */
+   u32 neg_hits;           /* lookups answered by a cached negative entry */
+   u32 misses;             /* lookups that had to call fs's get_entry() */
+   u32 invalidations;      /* entries dropped because of namespace changes */
+};
+
+void vfs_dcache_get_stats(struct vfs_dcache_stats *stats);
+void vfs_dcache_invalidate_fs(struct mnt_fs *fs);
+
 int vfs_exlock_noblock(struct mnt_fs *fs, vfs_inode_ptr_t i);
 int vfs_exunlock(struct mnt_fs *fs, vfs_inode_ptr_t i);
 
@@ -302,16 +400,28 @@ void vfs_sync(void);
 
 /*
  * Resolves `path` and returns in `rp` the corresponding VFS path with the
- * struct mnt_fs retained and locked, in case of success (return 0).
+ * struct mnt_fs retained and locked, in case of success (return 0). Relative
+ * paths are resolved starting from the directory referred by `dirfd` or from
+ * the current working directory, when `dirfd` is AT_FDCWD.
  *
  * In case of failure, it returns a value < 0 and the it does *not* require
  * any further clean-up.
  */
 int
+vfs_resolve_at(int dirfd,
+               const char *path,
+               struct vfs_path *rp,
+               bool exlock,
+               bool res_last_sl);
+
+static inline int
 vfs_resolve(const char *path,
             struct vfs_path *rp,
             bool exlock,
-            bool res_last_sl);
+            bool res_last_sl)
+{
+   return vfs_resolve_at(AT_FDCWD, path, rp, exlock, res_last_sl);
+}
 
 int mp_init(struct mnt_fs *root_fs);
 int mp_add(struct mnt_fs *fs, const char *target_path);
@@ -69,7 +69,8 @@ struct vfs_path {
 };
 
 #define VFS_FS_RW             (1 << 0)  /* struct mnt_fs mounted in RW mode */
-#define VFS_FS_RQ_DE_SKIP     (1 << 1)  /* FS requires vfs dents skip */
+#define VFS_FS_DCACHE         (1 << 2)  /* FS lookups can use the dcache */
+#define VFS_FS_DIRLOCKS       (1 << 3)  /* FS uses per-directory locks */
 
 /* This struct is Tilck's analogue of Linux's "superblock" */
 struct mnt_fs {
@@ -54,6 +54,8 @@ void fpu_context_end(void);
 void save_current_fpu_regs(bool in_kernel);
 void restore_fpu_regs(void *task, bool in_kernel);
 void restore_current_fpu_regs(bool in_kernel);
+bool is_fpu_owner(void *task);
+void fpu_reset_owner(void *task);
 int get_irq_num(regs_t *context);
 int get_int_num(regs_t *context);
 void on_first_pdir_update(void);
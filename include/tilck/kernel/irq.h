@@ -11,8 +11,32 @@ struct irq_handler_node {
    struct list_node node;
    irq_handler_t handler;
    void *context;          /* device-specific context, passed to the handler */
+
+   /* Stats, updated by the generic IRQ handling code */
+   u32 calls;              /* number of times the handler has been called */
+   u32 handled;            /* number of times the handler claimed the IRQ */
+   u64 cycles;             /* total TSC cycles spent in the handler */
+};
+
+/*
+ * Log2 histogram of the cycles spent handling an IRQ: bucket 0 counts the IRQs
+ * handled in less than 2^(IRQ_HIST_MIN_SHIFT + 1) cycles, bucket N > 0 counts
+ * the ones handled in [2^(IRQ_HIST_MIN_SHIFT + N), 2^(IRQ_HIST_MIN_SHIFT+N+1))
+ * cycles. The last bucket counts also all the slower IRQs.
+ */
+#define IRQ_HIST_BUCKETS                16
+#define IRQ_HIST_MIN_SHIFT               8
+
+struct irq_stats {
+
+   u32 count;              /* number of (non-spurious) IRQs received */
+   u32 max_cycles;         /* max cycles spent handling a single IRQ */
+   u64 tot_cycles;         /* total cycles spent handling this IRQ */
+   u32 hist[IRQ_HIST_BUCKETS];
 };
 
+extern struct irq_stats irq_stats[16];
+
 #define DEFINE_IRQ_HANDLER_NODE(node_name, func, ctx)        \
    static struct irq_handler_node node_name = {              \
       .node = STATIC_LIST_NODE_INIT(node_name.node),         \
@@ -29,3 +53,4 @@ void irq_uninstall_handler(u8 irq, struct irq_handler_node *n);
 void irq_set_mask(int irq);
 void irq_clear_mask(int irq);
 bool irq_is_masked(int irq);
+void irq_reset_stats(void);
@@ -1,7 +1,8 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
 #pragma once
-#define PIPE_BUF_SIZE   4096
+#define PIPE_BUF_SIZE   4096                 /* default size */
+#define PIPE_MAX_SIZE   (1024 * 1024)        /* as Linux's pipe-max-size */
 
 struct pipe;
 
@@ -9,3 +10,5 @@ struct pipe *create_pipe(void);
 void destroy_pipe(struct pipe *p);
 fs_handle pipe_create_read_handle(struct pipe *p);
 fs_handle pipe_create_write_handle(struct pipe *p);
+int pipe_get_size(fs_handle h);
+int pipe_set_size(fs_handle h, int size);
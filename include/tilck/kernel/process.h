@@ -18,6 +18,7 @@
 #include <tilck/kernel/fs/vfs_base.h>
 #include <tilck/kernel/fs/flock.h>
 #include <tilck/kernel/sys_types.h>
+#include <tilck/kernel/syscall_stats.h>
 
 struct kernel_alloc {
 
@@ -33,6 +34,8 @@ struct mappings_info {
    struct list mappings;
 };
 
+#define FD_BMP_WORDS(n)           (((n) + NBITS - 1) / NBITS)
+
 struct process {
 
    REF_COUNTED_OBJECT;
@@ -48,6 +51,7 @@ struct process {
    struct mappings_info *mi;
 
    struct list children;
+   struct list aio_ctxs;                  /* AIO contexts (see kernel/aio.c) */
 
    void *proc_tty;
    bool did_call_execve;
@@ -58,14 +62,29 @@ struct process {
 
    int *set_child_tid;                    /* NOTE: this is an user pointer */
 
-   struct kmutex fslock;                  /* protects `handles` and `cwd` */
+   struct kmutex fslock;              /* protects the fd table and `cwd` */
    mode_t umask;
 
    struct vfs_path cwd;                   /* CWD as a struct vfs_path */
    char *debug_cmdline;                   /* debug field used by debugpanel */
 
    struct locked_file *elf;
-   fs_handle handles[MAX_HANDLES];        /* just a small fixed-size array */
+   struct proc_sys_stats *sys_stats;      /* see kernel/syscall_stats.c */
+
+   /*
+    * The file descriptors table. It starts as the small `handles_inline`
+    * array and, when that is full, it's moved on the heap and doubled in size
+    * each time it's needed, up to the RLIMIT_NOFILE limit. The `handles_bmp`
+    * bitmap has a bit set for each fd in use. See kernel/fs/fd_table.c.
+    */
+   fs_handle *handles;
+   ulong *handles_bmp;
+   u32 handles_cap;                       /* number of slots in `handles` */
+   u32 nofile_cur;                        /* RLIMIT_NOFILE: soft limit */
+   u32 nofile_max;                        /* RLIMIT_NOFILE: hard limit */
+
+   fs_handle handles_inline[MAX_HANDLES];
+   ulong handles_bmp_inline[FD_BMP_WORDS(MAX_HANDLES)];
 
    /*
     * The purpose of having this opaque `arch_fields` member here is to avoid
@@ -149,6 +168,33 @@ void process_set_cwd2_nolock(struct vfs_path *tp);
 void process_set_cwd2_nolock_raw(struct process *pi, struct vfs_path *tp);
 void terminate_process(int exit_code, int term_sig);
 void close_cloexec_handles(struct process *pi);
+
+void fd_table_init(struct process *pi);
+int fd_table_copy(struct process *pi, struct process *parent_pi);
+void fd_table_destroy(struct process *pi);
+int fd_table_get_free_fd(struct process *pi, int ge);
+int fd_table_ensure(struct process *pi, int fd);
+int fd_table_next_used(struct process *pi, int fd);
+
+static inline void
+fd_table_set(struct process *pi, int fd, fs_handle h)
+{
+   const ulong bit = 1UL << ((u32)fd % NBITS);
+   ASSERT(IN_RANGE(fd, 0, (int)pi->handles_cap));
+
+   pi->handles[fd] = h;
+
+   if (h)
+      pi->handles_bmp[(u32)fd / NBITS] |= bit;
+   else
+      pi->handles_bmp[(u32)fd / NBITS] &= ~bit;
+}
+
+/* Iterate over all the fds in use, in ascending order */
+#define for_each_used_fd(pi, fd)                                   \
+   for (fd = fd_table_next_used(pi, 0);                            \
+        fd >= 0;                                                   \
+        fd = fd_table_next_used(pi, fd + 1))
 int setup_sig_handler(struct task *ti,
                       enum sig_state sig_state,
                       regs_t *r,
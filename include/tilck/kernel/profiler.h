@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+#include <tilck/kernel/hal_types.h>
+
+#define PROF_MAX_FRAMES                         6
+#define PROF_MAX_SAMPLES                     8192
+
+struct prof_sample {
+
+   ulong ip;                        /* interrupted instruction pointer */
+   ulong frames[PROF_MAX_FRAMES];   /* return addresses, innermost first */
+   int pid;
+   u8 nframes;
+   bool user;
+};
+
+struct prof_stats {
+
+   u32 samples;
+   u32 user_samples;
+   u32 dropped;
+   bool running;
+};
+
+/*
+ * Flat report entry. Kernel entries are per-function (`addr` is the start of
+ * the function), while user entries are per-instruction (`addr` is the IP):
+ * they can be symbolized offline with addr2line, on the program of `pid`.
+ */
+struct prof_flat_entry {
+
+   ulong addr;
+   const char *name;             /* kernel symbol or NULL */
+   int pid;                      /* -1 for kernel entries */
+   u32 self;                     /* samples where it was the current func */
+   u32 total;                    /* samples where it was on the stack */
+};
+
+/* Call graph report entry: a unique stack, innermost function first */
+struct prof_cg_entry {
+
+   ulong addrs[1 + PROF_MAX_FRAMES];
+   const char *names[1 + PROF_MAX_FRAMES];
+   int pid;                      /* -1 for kernel entries */
+   u8 n;
+   u32 count;
+};
+
+extern volatile bool __prof_running;
+
+static ALWAYS_INLINE bool prof_is_running(void)
+{
+   return __prof_running;
+}
+
+void prof_sample(regs_t *r);
+int prof_start(void);
+void prof_stop(void);
+void prof_reset(void);
+void prof_get_stats(struct prof_stats *s);
+u32 prof_get_flat(struct prof_flat_entry *arr, u32 max_count);
+u32 prof_get_callgraph(struct prof_cg_entry *arr, u32 max_count);
+int prof_write_report(char *buf, size_t buf_size, bool callgraph);
+int sys_tilck_profiler(int cmd, char *user_buf, size_t buf_size);
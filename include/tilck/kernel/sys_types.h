@@ -97,6 +97,66 @@ struct k_rusage {
    STATIC_ASSERT(sizeof(struct k_rusage) == 136);
 #endif
 
+/*
+ * Classic rlimit struct, with pointer-size values. Used by getrlimit() and
+ * setrlimit().
+ */
+struct k_rlimit {
+
+   ulong rlim_cur;
+   ulong rlim_max;
+};
+
+/*
+ * Modern rlimit struct, used by prlimit64().
+ */
+struct k_rlimit64 {
+
+   u64 rlim_cur;
+   u64 rlim_max;
+};
+
+#define K_RLIM_INFINITY                             (~0UL)
+#define K_RLIM64_INFINITY                           (~0ULL)
+
+/*
+ * Linux AIO's iocb and io_event structs (see <linux/aio_abi.h>).
+ * Note: the layout is the little-endian one.
+ */
+struct k_iocb {
+
+   u64 aio_data;
+   u32 aio_key;
+   u32 aio_rw_flags;
+
+   u16 aio_lio_opcode;
+   s16 aio_reqprio;
+   u32 aio_fildes;
+
+   u64 aio_buf;
+   u64 aio_nbytes;
+   s64 aio_offset;
+
+   u64 aio_reserved2;
+   u32 aio_flags;
+   u32 aio_resfd;
+};
+
+STATIC_ASSERT(sizeof(struct k_iocb) == 64);
+
+struct k_io_event {
+
+   u64 data;         /* the `aio_data` field of the iocb */
+   u64 obj;          /* user pointer to the iocb */
+   s64 res;
+   s64 res2;
+};
+
+#define K_IOCB_CMD_PREAD                                0
+#define K_IOCB_CMD_PWRITE                               1
+#define K_IOCB_CMD_FSYNC                                2
+#define K_IOCB_CMD_FDSYNC                               3
+
 /*
  * Classic (old) timespec. Suffers from the Y2038 bug on ALL systems.
  */
@@ -199,6 +259,75 @@ struct k_stat64 {
    #define O_PATH __O_PATH
 #endif
 
+#ifndef AT_SYMLINK_FOLLOW
+   #define AT_SYMLINK_FOLLOW 0x400
+#endif
+
+#ifndef AT_NO_AUTOMOUNT
+   #define AT_NO_AUTOMOUNT 0x800
+#endif
+
+#ifndef AT_EMPTY_PATH
+   #define AT_EMPTY_PATH 0x1000
+#endif
+
+#ifndef AT_STATX_SYNC_TYPE
+   #define AT_STATX_SYNC_TYPE 0x6000
+#endif
+
+#ifndef RENAME_NOREPLACE
+   #define RENAME_NOREPLACE (1 << 0)
+#endif
+
+#ifndef F_SETPIPE_SZ
+   #define F_SETPIPE_SZ 1031
+#endif
+
+#ifndef F_GETPIPE_SZ
+   #define F_GETPIPE_SZ 1032
+#endif
+
+/*
+ * Linux's struct statx, the only stat struct without the Y2038 bug on 32-bit
+ * systems. Defined here because libc headers expose it only with _GNU_SOURCE.
+ */
+struct k_statx_timestamp {
+
+   s64 tv_sec;
+   u32 tv_nsec;
+   s32 __reserved;
+};
+
+struct k_statx {
+
+   u32 stx_mask;
+   u32 stx_blksize;
+   u64 stx_attributes;
+   u32 stx_nlink;
+   u32 stx_uid;
+   u32 stx_gid;
+   u16 stx_mode;
+   u16 __spare0[1];
+   u64 stx_ino;
+   u64 stx_size;
+   u64 stx_blocks;
+   u64 stx_attributes_mask;
+   struct k_statx_timestamp stx_atime;
+   struct k_statx_timestamp stx_btime;
+   struct k_statx_timestamp stx_ctime;
+   struct k_statx_timestamp stx_mtime;
+   u32 stx_rdev_major;
+   u32 stx_rdev_minor;
+   u32 stx_dev_major;
+   u32 stx_dev_minor;
+   u64 __spare2[14];
+};
+
+STATIC_ASSERT(sizeof(struct k_statx) == 256);
+
+/* The stx_mask bits filled by stat(), see STATX_BASIC_STATS in Linux */
+#define K_STATX_BASIC_STATS                0x7ff
+
 #define FCNTL_CHANGEABLE_FL (         \
    O_APPEND      |                    \
    O_ASYNC       |                    \
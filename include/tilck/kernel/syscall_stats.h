@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+#include <tilck/kernel/sys_types.h>
+
+struct process;
+
+/*
+ * Log2 histogram of the cycles spent in a syscall, with the same layout as
+ * the IRQ one (see irq.h): bucket 0 counts the calls that took less than
+ * 2^(SYS_HIST_MIN_SHIFT + 1) cycles, bucket N > 0 counts the ones that took
+ * [2^(SYS_HIST_MIN_SHIFT + N), 2^(SYS_HIST_MIN_SHIFT + N + 1)) cycles. The
+ * last bucket counts also all the slower calls.
+ */
+#define SYS_HIST_BUCKETS                16
+#define SYS_HIST_MIN_SHIFT               8
+
+/* Max number of different syscalls tracked per process */
+#define PROC_SYS_STATS_SLOTS            32
+
+struct syscall_stats {
+
+   u32 calls;
+   u32 errors;             /* calls that returned -errno */
+   u32 max_cycles;         /* max cycles spent in a single call */
+   u64 tot_cycles;         /* total cycles spent in the syscall */
+   u32 hist[SYS_HIST_BUCKETS];
+};
+
+struct proc_sys_stats {
+
+   u32 gen;                               /* see sys_stats_reset() */
+   u32 untracked;                         /* calls without a free slot */
+   u16 sys_n[PROC_SYS_STATS_SLOTS];       /* syscall number + 1, 0 = free */
+   struct syscall_stats s[PROC_SYS_STATS_SLOTS];
+};
+
+extern struct syscall_stats sys_stats[MAX_SYSCALLS];
+
+void sys_stats_account(u32 sn, ulong ret, u64 cycles);
+void sys_stats_reset(void);
+void sys_stats_free_proc(struct process *pi);
+struct proc_sys_stats *sys_stats_get_proc(struct process *pi);
+const char *sys_stats_get_name(u32 sn);
@@ -132,8 +132,10 @@ CREATE_STUB_SYSCALL_IMPL(sys_setregid16)
 CREATE_STUB_SYSCALL_IMPL(sys_sigsuspend)
 CREATE_STUB_SYSCALL_IMPL(sys_sigpending)
 CREATE_STUB_SYSCALL_IMPL(sys_sethostname)
-CREATE_STUB_SYSCALL_IMPL(sys_setrlimit)
-CREATE_STUB_SYSCALL_IMPL(sys_old_getrlimit)
+
+int sys_setrlimit(int resource, const struct k_rlimit *u_rlim);
+int sys_old_getrlimit(int resource, struct k_rlimit *u_rlim);
+
 CREATE_STUB_SYSCALL_IMPL(sys_getrusage)
 
 int sys_gettimeofday(struct k_timeval *tv, struct timezone *tz);
@@ -296,7 +298,7 @@ CREATE_STUB_SYSCALL_IMPL(sys_sendfile)
 
 int sys_vfork(void);
 
-CREATE_STUB_SYSCALL_IMPL(sys_getrlimit)
+int sys_getrlimit(int resource, struct k_rlimit *u_rlim);
 
 long sys_mmap_pgoff(void *addr, size_t length, int prot,
                     int flags, int fd, size_t pgoffset);
@@ -363,11 +365,22 @@ CREATE_STUB_SYSCALL_IMPL(sys_sched_getaffinity)
 int sys_set_thread_area(void *u_info);
 
 CREATE_STUB_SYSCALL_IMPL(sys_get_thread_area)
-CREATE_STUB_SYSCALL_IMPL(sys_io_setup)
-CREATE_STUB_SYSCALL_IMPL(sys_io_destroy)
-CREATE_STUB_SYSCALL_IMPL(sys_io_getevents_time32)
-CREATE_STUB_SYSCALL_IMPL(sys_io_submit)
-CREATE_STUB_SYSCALL_IMPL(sys_io_cancel)
+
+int sys_io_setup(u32 nr_events, ulong *u_ctxp);
+int sys_io_destroy(ulong ctx_id);
+
+int sys_io_getevents_time32(ulong ctx_id,
+                            long min_nr,
+                            long nr,
+                            struct k_io_event *u_events,
+                            struct k_timespec32 *u_timeout);
+
+int sys_io_submit(ulong ctx_id, long nr, struct k_iocb **u_iocbpp);
+
+int sys_io_cancel(ulong ctx_id,
+                  struct k_iocb *u_iocb,
+                  struct k_io_event *u_result);
+
 CREATE_STUB_SYSCALL_IMPL(sys_ia32_fadvise64)
 
 NORETURN int sys_exit_group(int status);
@@ -419,22 +432,27 @@ CREATE_STUB_SYSCALL_IMPL(sys_inotify_init)
 CREATE_STUB_SYSCALL_IMPL(sys_inotify_add_watch)
 CREATE_STUB_SYSCALL_IMPL(sys_inotify_rm_watch)
 CREATE_STUB_SYSCALL_IMPL(sys_migrate_pages)
-CREATE_STUB_SYSCALL_IMPL(sys_openat)
-CREATE_STUB_SYSCALL_IMPL(sys_mkdirat)
+int sys_openat(int dirfd, const char *u_path, int flags, mode_t mode);
+int sys_mkdirat(int dirfd, const char *u_path, mode_t mode);
 CREATE_STUB_SYSCALL_IMPL(sys_mknodat)
-CREATE_STUB_SYSCALL_IMPL(sys_fchownat)
+int sys_fchownat(int dirfd, const char *u_path,
+                 int owner, int group, int flags);
 
 int sys_futimesat_time32(int dirfd, const char *u_path,
                   const struct k_timeval times[2]);
 
-CREATE_STUB_SYSCALL_IMPL(sys_fstatat64)
-CREATE_STUB_SYSCALL_IMPL(sys_unlinkat)
-CREATE_STUB_SYSCALL_IMPL(sys_renameat)
-CREATE_STUB_SYSCALL_IMPL(sys_linkat)
-CREATE_STUB_SYSCALL_IMPL(sys_symlinkat)
-CREATE_STUB_SYSCALL_IMPL(sys_readlinkat)
-CREATE_STUB_SYSCALL_IMPL(sys_fchmodat)
-CREATE_STUB_SYSCALL_IMPL(sys_faccessat)
+int sys_fstatat64(int dirfd, const char *u_path,
+                  struct k_stat64 *u_statbuf, int flags);
+int sys_unlinkat(int dirfd, const char *u_path, int flags);
+int sys_renameat(int olddirfd, const char *u_oldpath,
+                 int newdirfd, const char *u_newpath);
+int sys_linkat(int olddirfd, const char *u_oldpath,
+               int newdirfd, const char *u_newpath, int flags);
+int sys_symlinkat(const char *u_target, int newdirfd, const char *u_linkpath);
+int sys_readlinkat(int dirfd, const char *u_pathname,
+                   char *u_buf, size_t u_bufsize);
+int sys_fchmodat(int dirfd, const char *u_path, mode_t mode);
+int sys_faccessat(int dirfd, const char *u_path, mode_t mode);
 CREATE_STUB_SYSCALL_IMPL(sys_pselect6)
 CREATE_STUB_SYSCALL_IMPL(sys_ppoll)
 CREATE_STUB_SYSCALL_IMPL(sys_unshare)
@@ -473,7 +491,12 @@ CREATE_STUB_SYSCALL_IMPL(sys_recvmmsg_time32)
 
 CREATE_STUB_SYSCALL_IMPL(sys_fanotify_init)
 CREATE_STUB_SYSCALL_IMPL(sys_fanotify_mark)
-CREATE_STUB_SYSCALL_IMPL(sys_prlimit64)
+
+int sys_prlimit64(int pid,
+                  int resource,
+                  const struct k_rlimit64 *u_new_rlim,
+                  struct k_rlimit64 *u_old_rlim);
+
 CREATE_STUB_SYSCALL_IMPL(sys_name_to_handle_at)
 CREATE_STUB_SYSCALL_IMPL(sys_open_by_handle_at)
 CREATE_STUB_SYSCALL_IMPL(sys_clock_adjtime32)
@@ -488,7 +511,8 @@ CREATE_STUB_SYSCALL_IMPL(sys_kcmp)
 CREATE_STUB_SYSCALL_IMPL(sys_finit_module)
 CREATE_STUB_SYSCALL_IMPL(sys_sched_setattr)
 CREATE_STUB_SYSCALL_IMPL(sys_sched_getattr)
-CREATE_STUB_SYSCALL_IMPL(sys_renameat2)
+int sys_renameat2(int olddirfd, const char *u_oldpath,
+                  int newdirfd, const char *u_newpath, u32 flags);
 CREATE_STUB_SYSCALL_IMPL(sys_seccomp)
 CREATE_STUB_SYSCALL_IMPL(sys_getrandom)
 CREATE_STUB_SYSCALL_IMPL(sys_memfd_create)
@@ -518,7 +542,8 @@ CREATE_STUB_SYSCALL_IMPL(sys_pwritev2)
 CREATE_STUB_SYSCALL_IMPL(sys_pkey_mprotect)
 CREATE_STUB_SYSCALL_IMPL(sys_pkey_alloc)
 CREATE_STUB_SYSCALL_IMPL(sys_pkey_free)
-CREATE_STUB_SYSCALL_IMPL(sys_statx)
+int sys_statx(int dirfd, const char *u_path, int flags,
+              u32 mask, struct k_statx *u_statxbuf);
 CREATE_STUB_SYSCALL_IMPL(sys_arch_prctl)
 CREATE_STUB_SYSCALL_IMPL(sys_io_pgetevents_time32)
 CREATE_STUB_SYSCALL_IMPL(sys_rseq)
@@ -572,7 +597,7 @@ CREATE_STUB_SYSCALL_IMPL(sys_clone3)
 CREATE_STUB_SYSCALL_IMPL(sys_close_range)
 CREATE_STUB_SYSCALL_IMPL(sys_openat2)
 CREATE_STUB_SYSCALL_IMPL(sys_pidfd_getfd)
-CREATE_STUB_SYSCALL_IMPL(sys_faccessat2)
+int sys_faccessat2(int dirfd, const char *u_path, mode_t mode, int flags);
 CREATE_STUB_SYSCALL_IMPL(sys_process_madvise)
 CREATE_STUB_SYSCALL_IMPL(sys_epoll_pwait2)
 CREATE_STUB_SYSCALL_IMPL(sys_mount_setattr)
@@ -44,6 +44,15 @@ struct term_params {
    const struct video_interface *vi;
 };
 
+struct term_refresh_stats {
+
+   u64 frames;                /* flushes of the damaged area */
+   u64 rows;                  /* damaged rows visited by the flushes */
+   u64 cells_drawn;           /* cells actually sent to the video interface */
+   u64 cells_skipped;         /* damaged cells whose entry didn't change */
+   u64 hw_scrolls;            /* calls to vi->scroll_one_line_up() */
+};
+
 enum term_fret {
    TERM_FILTER_WRITE_BLANK,
    TERM_FILTER_WRITE_C,
@@ -54,6 +63,13 @@ typedef enum term_fret (*term_filter)(u8 *c,                 /* in/out */
                                       struct term_action *a, /*  out   */
                                       void *ctx);            /*   in   */
 
+/*
+ * Optional companion of a term_filter: returns the length of the leading run
+ * of `buf` the filter, in its current state, would just write unchanged with
+ * TERM_FILTER_WRITE_C and no action. The term can write such runs in bulk.
+ */
+typedef u32 (*term_filter_scan)(const u8 *buf, u32 len, void *ctx);
+
 struct term_interface {
 
    enum term_type (*get_type)(void);
@@ -67,6 +83,7 @@ struct term_interface {
    void (*pause_output)(term *t);
    void (*restart_output)(term *t);
    void (*set_filter)(term *t, term_filter func, void *ctx);
+   void (*set_filter_scan)(term *t, term_filter_scan func); /* optional */
 
    /*
     * The first term must be pre-allocated but _not_ pre-initialized.
@@ -87,6 +104,9 @@ struct term_interface {
    void (*free)(term *t);
    void (*dispose)(term *t);
 
+   /* Optional: only video terms defer and coalesce their output */
+   void (*get_refresh_stats)(term *t, struct term_refresh_stats *out);
+
    /* --- debug funcs --- */
    void (*debug_dump_font_table)(term *t);
 };
@@ -8,6 +8,14 @@
 
 struct worker_thread;
 
+struct wth_stats {
+   u32 depth;                 /* jobs currently pending */
+   u32 max_depth;             /* max number of pending jobs ever reached */
+   u32 overflows;             /* jobs that didn't fit in the ring buffer */
+   u32 drops;                 /* jobs that could not be enqueued at all */
+   u32 stolen;                /* jobs stolen by other worker threads */
+};
+
 void
 init_worker_threads();
 
@@ -29,9 +37,23 @@ wth_get_runnable_thread(void);
 struct worker_thread *
 wth_create_thread(const char *name, int priority, u16 queue_size);
 
+/*
+ * Allow any idle worker with the same or a higher priority to steal the jobs
+ * queued on `wth`, not just the workers of its pool. Use only when the jobs
+ * don't need to run in order.
+ */
+void
+wth_set_unordered(struct worker_thread *wth);
+
 struct worker_thread *
 wth_find_worker(int lowest_prio);
 
+struct worker_thread *
+wth_get_worker(int index);
+
+void
+wth_get_stats(struct worker_thread *wth, struct wth_stats *stats);
+
 NODISCARD bool
 wth_enqueue_on(struct worker_thread *wth, void (*func)(void *), void *arg);
 
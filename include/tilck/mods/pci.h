@@ -29,6 +29,8 @@
 
 #define PCI_SUBCLASS_PCI_BRIDGE          0x04
 
+#define PCI_CAP_ID_MSI                   0x05
+
 
 struct pci_vendor {
    u16 vendor_id;
@@ -142,3 +144,21 @@ pci_config_write(struct pci_device_loc loc, u32 off, u32 width, u32 val)
 
 struct pci_device *
 pci_get_object(struct pci_device_loc loc);
+
+/*
+ * Find the capability `cap_id` in the device's capability list.
+ * Returns its offset in the config space or 0 if not found.
+ */
+u32
+pci_find_cap(struct pci_device_loc loc, u8 cap_id);
+
+/*
+ * Enable a single message-signaled interrupt for the given device, disabling
+ * its legacy INTx pin. Requires the I/O APIC (and the local APIC) to be in use.
+ * Returns the IRQ number reserved for the device or a negative errno value.
+ */
+int
+pci_enable_msi(struct pci_device *dev);
+
+void
+pci_disable_msi(struct pci_device *dev, int irq);
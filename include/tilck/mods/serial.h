@@ -4,6 +4,8 @@
 #include <tilck_gen_headers/mod_serial.h>
 #include <tilck/common/basic_defs.h>
 
+#define SERIAL_TX_FIFO_SIZE           16   /* 16550's TX FIFO */
+
 void init_serial_port(u16 port);
 
 bool serial_read_ready(u16 port);
@@ -13,6 +15,11 @@ char serial_read(u16 port);
 bool serial_write_ready(u16 port);
 void serial_wait_for_write(u16 port);
 void serial_write(u16 port, char c);
+void serial_write_no_wait(u16 port, char c);
+u32 serial_get_tx_fifo_size(u16 port);
+void serial_set_tx_intr(u16 port, bool enabled);
+
+void serial_tx_write(u16 port, const char *buf, size_t len);
 
 #if MOD_serial
    void early_init_serial_ports(void);
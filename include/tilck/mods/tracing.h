@@ -66,6 +66,57 @@ struct trace_event {
 
 STATIC_ASSERT(sizeof(struct trace_event) <= 256);
 
+/*
+ * /dev/trace stream format. Reading /dev/trace returns, in order:
+ *
+ *    - a struct trace_dev_header
+ *    - `sys_count` struct trace_dev_sys records, with the syscall metadata
+ *    - raw struct trace_event records, as they arrive
+ *
+ * All the fields use the native (little) endianness. The decoder is
+ * scripts/dev/trace_decode: keep it in sync with these structs.
+ */
+
+#define TRACE_DEV_MAGIC               "TILCKTRC"
+#define TRACE_DEV_VERSION                      1
+
+#define TRACE_DEV_PF_REAL_SZ_IN_RET     (1 << 0)
+#define TRACE_DEV_PF_INVISIBLE          (1 << 1)
+
+struct trace_dev_header {
+
+   char magic[8];       /* TRACE_DEV_MAGIC, not NUL-terminated */
+   u32 version;         /* TRACE_DEV_VERSION */
+   u32 header_size;     /* this header + all the syscall records */
+   u32 event_size;      /* sizeof(struct trace_event) */
+   u32 ulong_size;      /* sizeof(ulong), needed to decode the events */
+   u32 sys_count;       /* number of struct trace_dev_sys records */
+   u32 sys_rec_size;    /* sizeof(struct trace_dev_sys) */
+};
+
+struct trace_dev_param {
+
+   char name[16];
+   char type[16];       /* name of the ptype_* object, without the prefix */
+   u16 slot_off;        /* offset of the saved data in the event, if any */
+   u16 slot_size;       /* size of the saved data, 0 if none */
+   s8 helper_idx;       /* index of the helper param, -1 if none */
+   u8 kind;             /* enum sys_param_kind */
+   u8 flags;            /* TRACE_DEV_PF_* */
+   u8 unused;
+};
+
+struct trace_dev_sys {
+
+   u32 sys_n;
+   char name[28];       /* without the "sys_" prefix */
+   char ret_type[16];   /* like trace_dev_param's `type` */
+   s8 n_params;         /* -1 if there is no metadata for the syscall */
+   u8 exp_block;
+   u16 unused;
+   struct trace_dev_param params[6];
+};
+
 enum sys_param_ui_type {
 
    ui_type_other,
@@ -199,6 +250,12 @@ tracing_get_slot(struct trace_event *e,
 int
 tracing_get_param_idx(const struct syscall_info *si, const char *name);
 
+bool
+tracing_get_slot_info(u32 sys, int p_idx, size_t *off, size_t *size);
+
+void
+init_trace_dev(void);
+
 const char *
 get_errno_name(int errno);
 
@@ -220,6 +277,15 @@ set_traced_syscalls(const char *str);
 int
 tracing_get_in_buffer_events_count(void);
 
+u32
+tracing_get_dropped_events_count(void);
+
+int
+tracing_acquire(const void *owner);
+
+void
+tracing_release(const void *owner);
+
 extern const struct syscall_info *tracing_metadata;
 extern const struct sys_param_type ptype_int;
 extern const struct sys_param_type ptype_voidp;
@@ -0,0 +1,715 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+
+#include <tilck/kernel/aio.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/ringbuf.h>
+#include <tilck/kernel/worker_thread.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/syscalls.h>
+#include <tilck/kernel/fs/vfs.h>
+
+/*
+ * Linux AIO (io_setup, io_submit, io_getevents, io_cancel, io_destroy), backed
+ * by a small pool of dedicated worker threads.
+ *
+ * io_submit() copies the iocbs in kernel requests, appends them to the queue
+ * of the context and makes sure that a job for the context is enqueued on its
+ * worker thread: therefore, a whole batch costs a single syscall and at most
+ * a single job. The job runs the requests in FIFO order and moves them to the
+ * completion ring of the context, where io_getevents() reaps them.
+ *
+ * Worker threads cannot access the memory of user processes, so the data goes
+ * through kernel buffers: io_submit() copies the data to write from the user
+ * space, while io_getevents() copies the data read to the user space. For the
+ * same reason, each request uses its own dup of the file handle, closed while
+ * reaping the request, in the context of the process.
+ *
+ * The list of contexts of a process is protected by its `fslock`. Each
+ * syscall using a context holds a reference to it, while the list holds
+ * another one: io_destroy() removes the context from the list and marks it as
+ * dead, but the context is freed only when the last reference is dropped.
+ */
+
+struct aio_req {
+
+   struct list_node node;     /* in aio_ctx->pending */
+   struct k_iocb *u_iocb;     /* user pointer to the iocb */
+   u64 data;                  /* the `aio_data` field of the iocb */
+   ulong u_buf;               /* user buffer */
+   fs_handle h;               /* private dup of the file handle */
+   void *buf;                 /* kernel buffer */
+   size_t len;
+   offt off;
+   u16 opcode;
+   s64 res;
+};
+
+struct aio_ctx {
+
+   struct list_node node;     /* in process->aio_ctxs */
+   ulong id;
+   int refcount;              /* protected by the process' fslock */
+   struct worker_thread *wth;
+   struct kmutex lock;        /* protects all the fields below */
+   struct kcond cond;         /* signaled on each completion and when idle */
+
+   bool dead;                 /* removed by io_destroy() */
+
+   struct list pending;       /* requests not started yet, in FIFO order */
+   struct ringbuf done;       /* completed requests (struct aio_req *) */
+   struct aio_req **done_buf;
+   u32 max_events;
+   u32 inflight;              /* requests submitted and not reaped yet */
+   bool scheduled;            /* a job for this context is queued or running */
+};
+
+static struct worker_thread *aio_workers[AIO_WORKER_THREADS];
+static u32 aio_next_worker;
+static ulong aio_next_ctx_id = 1;
+
+static int aio_init_workers(void)
+{
+   int rc = 0;
+
+   disable_preemption();
+   {
+      for (int i = 0; i < AIO_WORKER_THREADS && !rc; i++) {
+
+         if (aio_workers[i])
+            continue;
+
+         aio_workers[i] = wth_create_thread("aio", 5, AIO_WTH_QUEUE_SIZE);
+
+         if (!aio_workers[i])
+            rc = -ENOMEM;
+      }
+   }
+   enable_preemption();
+   return rc;
+}
+
+static struct aio_ctx *aio_find_ctx(struct process *pi, ulong id)
+{
+   struct aio_ctx *ctx;
+   ASSERT(kmutex_is_curr_task_holding_lock(&pi->fslock));
+
+   list_for_each_ro(ctx, &pi->aio_ctxs, node) {
+      if (ctx->id == id)
+         return ctx;
+   }
+
+   return NULL;
+}
+
+static u32 aio_count_ctxs(struct process *pi)
+{
+   struct aio_ctx *ctx;
+   u32 count = 0;
+   ASSERT(kmutex_is_curr_task_holding_lock(&pi->fslock));
+
+   list_for_each_ro(ctx, &pi->aio_ctxs, node)
+      count++;
+
+   return count;
+}
+
+static struct aio_ctx *aio_get_ctx(struct process *pi, ulong id)
+{
+   struct aio_ctx *ctx;
+
+   kmutex_lock(&pi->fslock);
+   {
+      if ((ctx = aio_find_ctx(pi, id)))
+         ctx->refcount++;
+   }
+   kmutex_unlock(&pi->fslock);
+   return ctx;
+}
+
+static bool aio_is_rw(u16 opcode)
+{
+   return opcode == K_IOCB_CMD_PREAD || opcode == K_IOCB_CMD_PWRITE;
+}
+
+/* NOTE: it must be called in the context of the process */
+static void aio_free_req(struct aio_req *req)
+{
+   if (req->h)
+      vfs_close(req->h);
+
+   if (req->buf)
+      kfree2(req->buf, req->len);
+
+   kfree_obj(req, struct aio_req);
+}
+
+static int aio_prepare_req(struct k_iocb *u_iocb, struct aio_req **out)
+{
+   struct k_iocb iocb;
+   struct k_stat64 st;
+   struct aio_req *req;
+   fs_handle h;
+   int rc;
+
+   if (copy_from_user(&iocb, u_iocb, sizeof(iocb)))
+      return -EFAULT;
+
+   /* Neither eventfd notifications nor RWF_* flags are supported */
+   if (iocb.aio_flags || iocb.aio_rw_flags || iocb.aio_reserved2)
+      return -EINVAL;
+
+   if (iocb.aio_lio_opcode > K_IOCB_CMD_FDSYNC)
+      return -EINVAL;
+
+   if (aio_is_rw(iocb.aio_lio_opcode)) {
+      if (iocb.aio_offset < 0 || iocb.aio_offset > OFFT_MAX)
+         return -EINVAL;
+   }
+
+   if (!(h = get_fs_handle((int)iocb.aio_fildes)))
+      return -EBADF;
+
+   if ((rc = vfs_fstat64(h, &st)))
+      return rc;
+
+   /* Only regular files: jobs must never block for an unbounded time */
+   if ((st.st_mode & S_IFMT) != S_IFREG)
+      return -EINVAL;
+
+   if (!(req = kzalloc_obj(struct aio_req)))
+      return -ENOMEM;
+
+   list_node_init(&req->node);
+   req->u_iocb = u_iocb;
+   req->data = iocb.aio_data;
+   req->u_buf = (ulong)iocb.aio_buf;
+   req->opcode = iocb.aio_lio_opcode;
+   req->off = (offt)iocb.aio_offset;
+
+   if (aio_is_rw(req->opcode)) {
+
+      /* Like write() and read(), transfer at most IO_COPYBUF_SIZE bytes */
+      const size_t len = (size_t)MIN(iocb.aio_nbytes, (u64)IO_COPYBUF_SIZE);
+
+      if (len) {
+
+         if (!(req->buf = kmalloc(len))) {
+            rc = -ENOMEM;
+            goto err;
+         }
+
+         req->len = len;
+      }
+
+      if (req->opcode == K_IOCB_CMD_PWRITE) {
+         if (copy_from_user(req->buf, TO_PTR(req->u_buf), len)) {
+            rc = -EFAULT;
+            goto err;
+         }
+      }
+   }
+
+   if ((rc = vfs_dup(h, &req->h)))
+      goto err;
+
+   *out = req;
+   return 0;
+
+err:
+   aio_free_req(req);
+   return rc;
+}
+
+static void aio_run_req(struct aio_req *req)
+{
+   switch (req->opcode) {
+
+      case K_IOCB_CMD_PREAD:
+         req->res = vfs_pread(req->h, req->buf, req->len, req->off);
+         break;
+
+      case K_IOCB_CMD_PWRITE:
+         req->res = vfs_pwrite(req->h, req->buf, req->len, req->off);
+         break;
+
+      case K_IOCB_CMD_FSYNC:
+         req->res = vfs_fsync(req->h);
+         break;
+
+      case K_IOCB_CMD_FDSYNC:
+         req->res = vfs_fdatasync(req->h);
+         break;
+
+      default:
+         NOT_REACHED();
+   }
+}
+
+static void aio_complete_req(struct aio_ctx *ctx, struct aio_req *req)
+{
+   ASSERT(kmutex_is_curr_task_holding_lock(&ctx->lock));
+
+   /* Cannot fail: there are at most `max_events` requests in flight */
+   VERIFY(ringbuf_write_elem(&ctx->done, &req));
+   kcond_signal_all(&ctx->cond);
+}
+
+static void aio_ctx_job(void *arg)
+{
+   struct aio_ctx *ctx = arg;
+   struct aio_req *req;
+
+   kmutex_lock(&ctx->lock);
+
+   while (!list_is_empty(&ctx->pending)) {
+
+      req = list_first_obj(&ctx->pending, struct aio_req, node);
+      list_remove(&req->node);
+
+      kmutex_unlock(&ctx->lock);
+      {
+         aio_run_req(req);
+      }
+      kmutex_lock(&ctx->lock);
+      aio_complete_req(ctx, req);
+   }
+
+   /* After this, aio_destroy_ctx() can free the context */
+   ctx->scheduled = false;
+   kcond_signal_all(&ctx->cond);
+   kmutex_unlock(&ctx->lock);
+}
+
+/* Reap a completed request, in the context of the process */
+static void aio_reap_req(struct aio_req *req, struct k_io_event *ev)
+{
+   if (req->opcode == K_IOCB_CMD_PREAD && req->res > 0) {
+      if (copy_to_user(TO_PTR(req->u_buf), req->buf, (size_t)req->res))
+         req->res = -EFAULT;
+   }
+
+   *ev = (struct k_io_event) {
+      .data = req->data,
+      .obj = (ulong)req->u_iocb,
+      .res = req->res,
+      .res2 = 0,
+   };
+
+   aio_free_req(req);
+}
+
+static void aio_destroy_ctx(struct aio_ctx *ctx)
+{
+   struct aio_req *req, *tmp;
+   struct list dropped;
+
+   list_init(&dropped);
+   kmutex_lock(&ctx->lock);
+   {
+      /* Drop the requests not started yet */
+      list_for_each(req, tmp, &ctx->pending, node) {
+         list_remove(&req->node);
+         list_add_tail(&dropped, &req->node);
+      }
+
+      /* Wait for the job to complete the current request (if any) */
+      while (ctx->scheduled)
+         kcond_wait(&ctx->cond, &ctx->lock, KCOND_WAIT_FOREVER);
+   }
+   kmutex_unlock(&ctx->lock);
+
+   list_for_each(req, tmp, &dropped, node) {
+      list_remove(&req->node);
+      aio_free_req(req);
+   }
+
+   while (ringbuf_read_elem(&ctx->done, &req))
+      aio_free_req(req);
+
+   kmutex_destroy(&ctx->lock);
+   kcond_destory(&ctx->cond);
+   kfree_array_obj(ctx->done_buf, struct aio_req *, ctx->max_events);
+   kfree_obj(ctx, struct aio_ctx);
+}
+
+static void aio_put_ctx(struct process *pi, struct aio_ctx *ctx)
+{
+   bool last;
+
+   kmutex_lock(&pi->fslock);
+   {
+      ASSERT(ctx->refcount > 0);
+      last = --ctx->refcount == 0;
+   }
+   kmutex_unlock(&pi->fslock);
+
+   if (last)
+      aio_destroy_ctx(ctx);
+}
+
+/* Mark the context as dead and wake up the tasks waiting in io_getevents() */
+static void aio_kill_ctx(struct aio_ctx *ctx)
+{
+   kmutex_lock(&ctx->lock);
+   {
+      ctx->dead = true;
+      kcond_signal_all(&ctx->cond);
+   }
+   kmutex_unlock(&ctx->lock);
+}
+
+/* Remove the context from the list and drop the list's reference */
+static int aio_remove_ctx(struct process *pi, ulong id)
+{
+   struct aio_ctx *ctx;
+
+   kmutex_lock(&pi->fslock);
+   {
+      if ((ctx = aio_find_ctx(pi, id)))
+         list_remove(&ctx->node);
+   }
+   kmutex_unlock(&pi->fslock);
+
+   if (!ctx)
+      return -EINVAL;
+
+   aio_kill_ctx(ctx);
+   aio_put_ctx(pi, ctx);
+   return 0;
+}
+
+void aio_destroy_all_contexts(struct process *pi)
+{
+   struct aio_ctx *ctx;
+
+   while (true) {
+
+      kmutex_lock(&pi->fslock);
+      {
+         ctx = NULL;
+
+         if (!list_is_empty(&pi->aio_ctxs)) {
+            ctx = list_first_obj(&pi->aio_ctxs, struct aio_ctx, node);
+            list_remove(&ctx->node);
+         }
+      }
+      kmutex_unlock(&pi->fslock);
+
+      if (!ctx)
+         break;
+
+      aio_kill_ctx(ctx);
+      aio_put_ctx(pi, ctx);
+   }
+}
+
+int sys_io_setup(u32 nr_events, ulong *u_ctxp)
+{
+   struct process *pi = get_curr_proc();
+   struct aio_ctx *ctx;
+   ulong id;
+   int rc;
+
+   if (copy_from_user(&id, u_ctxp, sizeof(id)))
+      return -EFAULT;
+
+   if (id || !nr_events)
+      return -EINVAL;
+
+   if (nr_events > AIO_MAX_EVENTS)
+      return -EAGAIN;
+
+   if ((rc = aio_init_workers()))
+      return rc;
+
+   if (!(ctx = kzalloc_obj(struct aio_ctx)))
+      return -ENOMEM;
+
+   if (!(ctx->done_buf = kalloc_array_obj(struct aio_req *, nr_events))) {
+      kfree_obj(ctx, struct aio_ctx);
+      return -ENOMEM;
+   }
+
+   list_node_init(&ctx->node);
+   list_init(&ctx->pending);
+   kmutex_init(&ctx->lock, 0);
+   kcond_init(&ctx->cond);
+   ringbuf_init(&ctx->done, nr_events, sizeof(struct aio_req *), ctx->done_buf);
+   ctx->max_events = nr_events;
+
+   disable_preemption();
+   {
+      ctx->id = aio_next_ctx_id++;
+      ctx->wth = aio_workers[aio_next_worker++ % AIO_WORKER_THREADS];
+   }
+   enable_preemption();
+
+   kmutex_lock(&pi->fslock);
+   {
+      if (aio_count_ctxs(pi) < AIO_MAX_CTXS) {
+         ctx->refcount = 1;   /* the list's reference */
+         id = ctx->id;
+         list_add_tail(&pi->aio_ctxs, &ctx->node);
+      } else {
+         id = 0;
+      }
+   }
+   kmutex_unlock(&pi->fslock);
+
+   if (!id) {
+      aio_destroy_ctx(ctx);
+      return -EAGAIN;
+   }
+
+   if (copy_to_user(u_ctxp, &id, sizeof(id))) {
+
+      /* Another thread might have already destroyed it, using its id */
+      aio_remove_ctx(pi, id);
+      return -EFAULT;
+   }
+
+   return 0;
+}
+
+int sys_io_destroy(ulong ctx_id)
+{
+   return aio_remove_ctx(get_curr_proc(), ctx_id);
+}
+
+static int aio_submit(struct aio_ctx *ctx, long nr, struct k_iocb **u_iocbpp)
+{
+   struct aio_req *req = NULL, *tmp;
+   struct k_iocb *u_iocb;
+   struct list batch;
+   bool enqueue = false;
+   long n, i;
+   int rc = 0;
+
+   if (nr < 0)
+      return -EINVAL;
+
+   if (!nr)
+      return 0;
+
+   list_init(&batch);
+
+   /* Reserve the slots in the completion ring */
+   kmutex_lock(&ctx->lock);
+   {
+      n = 0;
+
+      if (!ctx->dead) {
+         n = MIN(nr, (long)(ctx->max_events - ctx->inflight));
+         ctx->inflight += (u32)n;
+      }
+   }
+   kmutex_unlock(&ctx->lock);
+
+   if (!n)
+      return ctx->dead ? -EINVAL : -EAGAIN;
+
+   for (i = 0; i < n; i++) {
+
+      if (copy_from_user(&u_iocb, u_iocbpp + i, sizeof(u_iocb))) {
+         rc = -EFAULT;
+         break;
+      }
+
+      if ((rc = aio_prepare_req(u_iocb, &req)))
+         break;
+
+      list_add_tail(&batch, &req->node);
+   }
+
+   kmutex_lock(&ctx->lock);
+   {
+      /* Release the slots we didn't use */
+      ctx->inflight -= (u32)(n - i);
+
+      list_for_each(req, tmp, &batch, node) {
+         list_remove(&req->node);
+         list_add_tail(&ctx->pending, &req->node);
+      }
+
+      if (i > 0 && !ctx->scheduled)
+         ctx->scheduled = enqueue = true;
+   }
+   kmutex_unlock(&ctx->lock);
+
+   if (enqueue && !wth_enqueue_on(ctx->wth, &aio_ctx_job, ctx)) {
+
+      /*
+       * The queue of the worker thread is full and so is its overflow list:
+       * very unlikely to happen, but still possible. Just run the requests
+       * synchronously, in the context of the current process.
+       */
+      aio_ctx_job(ctx);
+   }
+
+   return i > 0 ? (int)i : rc;
+}
+
+int sys_io_submit(ulong ctx_id, long nr, struct k_iocb **u_iocbpp)
+{
+   struct process *pi = get_curr_proc();
+   struct aio_ctx *ctx = aio_get_ctx(pi, ctx_id);
+   int rc;
+
+   if (!ctx)
+      return -EINVAL;
+
+   rc = aio_submit(ctx, nr, u_iocbpp);
+   aio_put_ctx(pi, ctx);
+   return rc;
+}
+
+static int
+aio_getevents(struct aio_ctx *ctx,
+              long min_nr,
+              long nr,
+              struct k_io_event *u_events,
+              struct k_timespec64 *timeout)
+{
+   struct k_io_event ev;
+   struct aio_req *req;
+   u64 deadline = 0, now;
+   u32 wait_ticks = KCOND_WAIT_FOREVER;
+   long cnt = 0;
+   int rc = 0;
+
+   if (min_nr < 0 || nr < 0 || min_nr > nr)
+      return -EINVAL;
+
+   if (timeout) {
+
+      if (timeout->tv_sec < 0 || !IN_RANGE(timeout->tv_nsec, 0, BILLION))
+         return -EINVAL;
+
+      deadline = get_ticks() + timespec_to_ticks(timeout);
+   }
+
+   kmutex_lock(&ctx->lock);
+
+   while (cnt < nr) {
+
+      if (ringbuf_read_elem(&ctx->done, &req)) {
+
+         ctx->inflight--;
+         kmutex_unlock(&ctx->lock);
+         {
+            aio_reap_req(req, &ev);
+
+            if (copy_to_user(u_events + cnt, &ev, sizeof(ev)))
+               rc = -EFAULT;
+         }
+         kmutex_lock(&ctx->lock);
+
+         if (rc)
+            break;
+
+         cnt++;
+         continue;
+      }
+
+      if (cnt >= min_nr)
+         break;
+
+      if (ctx->dead) {
+         rc = -EINVAL;        /* destroyed by another thread */
+         break;
+      }
+
+      if (timeout) {
+
+         if ((now = get_ticks()) >= deadline)
+            break;
+
+         wait_ticks = (u32)MIN(deadline - now, (u64)UINT32_MAX);
+      }
+
+      kcond_wait(&ctx->cond, &ctx->lock, wait_ticks);
+
+      if (pending_signals()) {
+         rc = -EINTR;
+         break;
+      }
+   }
+
+   kmutex_unlock(&ctx->lock);
+   return cnt > 0 ? (int)cnt : rc;
+}
+
+int sys_io_getevents_time32(ulong ctx_id,
+                            long min_nr,
+                            long nr,
+                            struct k_io_event *u_events,
+                            struct k_timespec32 *u_timeout)
+{
+   struct process *pi = get_curr_proc();
+   struct k_timespec32 ts32;
+   struct k_timespec64 ts;
+   struct aio_ctx *ctx;
+   int rc;
+
+   if (u_timeout) {
+
+      if (copy_from_user(&ts32, u_timeout, sizeof(ts32)))
+         return -EFAULT;
+
+      ts = (struct k_timespec64) {
+         .tv_sec = ts32.tv_sec,
+         .tv_nsec = ts32.tv_nsec,
+      };
+   }
+
+   if (!(ctx = aio_get_ctx(pi, ctx_id)))
+      return -EINVAL;
+
+   rc = aio_getevents(ctx, min_nr, nr, u_events, u_timeout ? &ts : NULL);
+   aio_put_ctx(pi, ctx);
+   return rc;
+}
+
+int sys_io_cancel(ulong ctx_id,
+                  struct k_iocb *u_iocb,
+                  struct k_io_event *u_result)
+{
+   struct process *pi = get_curr_proc();
+   struct aio_ctx *ctx = aio_get_ctx(pi, ctx_id);
+   struct aio_req *req;
+   int rc = -EINVAL;
+
+   if (!ctx)
+      return -EINVAL;
+
+   kmutex_lock(&ctx->lock);
+
+   list_for_each_ro(req, &ctx->pending, node) {
+
+      if (req->u_iocb == u_iocb) {
+
+         /*
+          * Like on Linux, the `u_result` argument is not used anymore: the
+          * event is delivered through the completion ring.
+          */
+         list_remove(&req->node);
+         req->res = -ECANCELED;
+         aio_complete_req(ctx, req);
+         rc = -EINPROGRESS;
+         break;
+      }
+   }
+
+   kmutex_unlock(&ctx->lock);
+   aio_put_ctx(pi, ctx);
+   return rc;
+}
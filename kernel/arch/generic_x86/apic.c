@@ -0,0 +1,454 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck_gen_headers/config_debug.h>
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/irq.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/arch/generic_x86/apic.h>
+
+#include "pic.h"
+
+#define IA32_APIC_BASE_MSR              0x1b
+#define IA32_APIC_BASE_ENABLE      (1 << 11)
+
+/* Local APIC registers (offsets in the MMIO page) */
+#define LAPIC_ID                        0x20
+#define LAPIC_TPR                       0x80
+#define LAPIC_EOI                       0xb0
+#define LAPIC_SVR                       0xf0
+#define LAPIC_ISR                      0x100
+
+#define LAPIC_SVR_ENABLE           (1 << 8)
+
+/*
+ * The spurious vector of the local APIC. On P6 and Pentium processors its
+ * lower 4 bits are hard-wired to 1s, so we use the vector of IRQ 15: spurious
+ * interrupts never set the in-service bit, so apic_is_spur_irq() can still
+ * distinguish them from real IRQs.
+ */
+#define LAPIC_SPURIOUS_VEC         (32 + 15)
+
+/* I/O APIC registers */
+#define IOAPIC_REGSEL                   0x00
+#define IOAPIC_WIN                      0x10
+#define IOAPIC_REG_VER                  0x01
+#define IOAPIC_REG_REDTBL               0x10
+
+/* Redirection table entry flags (low dword) */
+#define IOAPIC_RTE_ACTIVE_LOW     (1 << 13)
+#define IOAPIC_RTE_LEVEL          (1 << 15)
+#define IOAPIC_RTE_MASKED         (1 << 16)
+
+struct ioapic {
+
+   u8 id;
+   u8 max_entry;
+   ulong paddr;
+   u32 gsi_base;
+   volatile u32 *regs;
+};
+
+struct isa_irq_route {
+
+   s8 ioapic;        /* index in ioapics[] or -1 if the IRQ has no pin */
+   u8 pin;
+   u32 flags;        /* APIC_IRQ_FL_* flags */
+   u32 gsi;
+   bool overridden;
+};
+
+bool __apic_enabled;
+
+static ulong lapic_paddr = LAPIC_DEFAULT_PADDR;
+static volatile u32 *lapic;
+static u32 lapic_id;
+
+static struct ioapic ioapics[IOAPIC_MAX_COUNT];
+static u32 ioapics_count;
+
+static struct isa_irq_route isa_routes[16];
+static u16 msi_irqs_mask;       /* IRQ lines reserved for MSI */
+
+static ALWAYS_INLINE u32 lapic_read(u32 reg)
+{
+   return lapic[reg / 4];
+}
+
+static ALWAYS_INLINE void lapic_write(u32 reg, u32 val)
+{
+   lapic[reg / 4] = val;
+}
+
+static u32 ioapic_read(struct ioapic *io, u32 reg)
+{
+   io->regs[IOAPIC_REGSEL / 4] = reg;
+   return io->regs[IOAPIC_WIN / 4];
+}
+
+static void ioapic_write(struct ioapic *io, u32 reg, u32 val)
+{
+   io->regs[IOAPIC_REGSEL / 4] = reg;
+   io->regs[IOAPIC_WIN / 4] = val;
+}
+
+void apic_set_lapic_paddr(ulong paddr)
+{
+   lapic_paddr = paddr;
+}
+
+void apic_add_ioapic(u8 id, ulong paddr, u32 gsi_base)
+{
+   if (ioapics_count == ARRAY_SIZE(ioapics)) {
+      printk("APIC: WARNING: too many I/O APICs, ignoring id %u\n", id);
+      return;
+   }
+
+   ioapics[ioapics_count++] = (struct ioapic) {
+      .id = id,
+      .paddr = paddr,
+      .gsi_base = gsi_base,
+   };
+}
+
+void apic_add_irq_override(u8 isa_irq, u32 gsi, u32 flags)
+{
+   if (isa_irq >= ARRAY_SIZE(isa_routes))
+      return;
+
+   isa_routes[isa_irq].gsi = gsi;
+   isa_routes[isa_irq].flags = flags;
+   isa_routes[isa_irq].overridden = true;
+}
+
+static void *apic_map_mmio(ulong paddr)
+{
+   void *va = hi_vmem_reserve(PAGE_SIZE);
+
+   if (!va)
+      return NULL;
+
+   /*
+    * NOTE: the firmware always marks the APIC's MMIO ranges as uncacheable
+    * in the MTRRs, so we don't need to do anything special here.
+    */
+   if (map_kernel_page(va, paddr & PAGE_MASK, PAGING_FL_RW) < 0) {
+      hi_vmem_release(va, PAGE_SIZE);
+      return NULL;
+   }
+
+   return (char *)va + (paddr & OFFSET_IN_PAGE_MASK);
+}
+
+static int gsi_to_ioapic(u32 gsi)
+{
+   for (u32 i = 0; i < ioapics_count; i++) {
+
+      struct ioapic *io = &ioapics[i];
+
+      if (IN_RANGE_INC(gsi, io->gsi_base, io->gsi_base + io->max_entry))
+         return (int)i;
+   }
+
+   return -1;
+}
+
+static void init_isa_irq_routes(void)
+{
+   struct isa_irq_route *r;
+
+   /* ISA IRQs without an override are identity-mapped, edge/active high */
+   for (u32 i = 0; i < ARRAY_SIZE(isa_routes); i++) {
+      if (!isa_routes[i].overridden)
+         isa_routes[i].gsi = i;
+   }
+
+   for (u32 i = 0; i < ARRAY_SIZE(isa_routes); i++) {
+
+      r = &isa_routes[i];
+      r->ioapic = -1;
+
+      /*
+       * Typically, IRQ 0 (the PIT) is connected to GSI 2, because GSI 0 is
+       * used by the 8259's INTR output. In that case, IRQ 2 (the cascade)
+       * has no pin at all.
+       */
+      if (!r->overridden) {
+
+         bool taken = false;
+
+         for (u32 j = 0; j < ARRAY_SIZE(isa_routes); j++) {
+            if (isa_routes[j].overridden && isa_routes[j].gsi == r->gsi)
+               taken = true;
+         }
+
+         if (taken)
+            continue;
+      }
+
+      r->ioapic = (s8)gsi_to_ioapic(r->gsi);
+
+      if (r->ioapic >= 0)
+         r->pin = (u8)(r->gsi - ioapics[(int)r->ioapic].gsi_base);
+   }
+}
+
+static void ioapic_write_route(int irq, bool masked)
+{
+   struct isa_irq_route *r = &isa_routes[irq];
+   struct ioapic *io;
+   u32 lo;
+
+   if (r->ioapic < 0)
+      return;
+
+   io = &ioapics[(int)r->ioapic];
+   lo = (u32)(32 + irq);   /* fixed delivery mode, physical dest. mode */
+
+   if (r->flags & APIC_IRQ_FL_ACTIVE_LOW)
+      lo |= IOAPIC_RTE_ACTIVE_LOW;
+
+   if (r->flags & APIC_IRQ_FL_LEVEL)
+      lo |= IOAPIC_RTE_LEVEL;
+
+   if (masked)
+      lo |= IOAPIC_RTE_MASKED;
+
+   ioapic_write(io, IOAPIC_REG_REDTBL + 2 * r->pin + 1, lapic_id << 24);
+   ioapic_write(io, IOAPIC_REG_REDTBL + 2 * r->pin, lo);
+}
+
+static bool init_lapic(void)
+{
+   u64 base;
+
+   if (!x86_cpu_features.edx1.apic || !x86_cpu_features.edx1.msr) {
+      printk("APIC: the CPU has no local APIC\n");
+      return false;
+   }
+
+   base = rdmsr(IA32_APIC_BASE_MSR);
+   lapic_paddr = (ulong)(base & PAGE_MASK);
+
+   if (!(lapic = apic_map_mmio(lapic_paddr))) {
+      printk("APIC: unable to map the local APIC\n");
+      return false;
+   }
+
+   wrmsr(IA32_APIC_BASE_MSR, base | IA32_APIC_BASE_ENABLE);
+
+   lapic_id = lapic_read(LAPIC_ID) >> 24;
+   lapic_write(LAPIC_TPR, 0);
+   lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+   return true;
+}
+
+static bool init_ioapics(void)
+{
+   struct ioapic *io;
+
+   for (u32 i = 0; i < ioapics_count; i++) {
+
+      io = &ioapics[i];
+
+      if (!(io->regs = apic_map_mmio(io->paddr))) {
+         printk("APIC: unable to map the I/O APIC %u\n", io->id);
+         return false;
+      }
+
+      io->max_entry = (u8)(ioapic_read(io, IOAPIC_REG_VER) >> 16);
+
+      printk("APIC: I/O APIC id %u at %#lx, GSIs: %u-%u\n",
+             io->id, io->paddr, io->gsi_base, io->gsi_base + io->max_entry);
+
+      /* Mask all the pins: we'll unmask only the ones we actually use */
+      for (u32 pin = 0; pin <= io->max_entry; pin++) {
+         ioapic_write(io, IOAPIC_REG_REDTBL + 2 * pin, IOAPIC_RTE_MASKED);
+         ioapic_write(io, IOAPIC_REG_REDTBL + 2 * pin + 1, 0);
+      }
+   }
+
+   return true;
+}
+
+bool init_apic_irq_routing(void)
+{
+   ASSERT(!are_interrupts_enabled());
+
+   if (!ioapics_count) {
+      printk("APIC: no I/O APIC found (no ACPI MADT?), using the 8259 PIC\n");
+      return false;
+   }
+
+   if (lapic_paddr != LAPIC_DEFAULT_PADDR)
+      printk("APIC: local APIC at non-default paddr %#lx\n", lapic_paddr);
+
+   if (!init_lapic() || !init_ioapics())
+      return false;
+
+   init_isa_irq_routes();
+
+   for (int irq = 0; irq < ARRAY_SIZE(isa_routes); irq++)
+      ioapic_write_route(irq, true);
+
+   /*
+    * From now on, the 8259 must stay completely silent: mask all of its
+    * lines, including the cascade, which irq_set_mask() never masks.
+    */
+   pic_mask_all();
+   __apic_enabled = true;
+
+   printk("APIC: IRQs are now delivered through the I/O APIC\n");
+   return true;
+}
+
+void apic_send_eoi(int irq)
+{
+   lapic_write(LAPIC_EOI, 0);
+}
+
+void apic_mask_and_send_eoi(int irq)
+{
+   /*
+    * MSI lines have no I/O APIC pin that we could mask: if we sent the EOI
+    * here, the same vector could nest inside its own handler. Therefore,
+    * defer their EOI to apic_end_of_irq(). Until then, the local APIC blocks
+    * all the vectors in the same priority class (including the timer).
+    */
+   if (msi_irqs_mask & (1 << irq))
+      return;
+
+   apic_set_mask(irq);
+   apic_send_eoi(irq);
+}
+
+/* Called with interrupts disabled, after all the handlers for `irq` ran */
+void apic_end_of_irq(int irq)
+{
+   ASSERT(!are_interrupts_enabled());
+
+   if (msi_irqs_mask & (1 << irq))
+      apic_send_eoi(irq);
+}
+
+bool apic_is_spur_irq(int irq)
+{
+   const u32 vec = (u32)(32 + irq);
+   ASSERT(!are_interrupts_enabled());
+
+   /*
+    * The local APIC does not set the in-service bit for spurious interrupts
+    * and they MUST NOT be acknowledged with an EOI.
+    */
+   return !(lapic_read(LAPIC_ISR + 0x10 * (vec / 32)) & (1u << (vec % 32)));
+}
+
+void apic_set_mask(int irq)
+{
+   ulong var;
+   ASSERT(IN_RANGE(irq, 0, 16));
+
+   disable_interrupts(&var);
+   {
+      ioapic_write_route(irq, true);
+   }
+   enable_interrupts(&var);
+}
+
+void apic_clear_mask(int irq)
+{
+   ulong var;
+   ASSERT(IN_RANGE(irq, 0, 16));
+
+   if (msi_irqs_mask & (1 << irq))
+      return; /* MSI lines have no I/O APIC pin: keep it masked */
+
+   disable_interrupts(&var);
+   {
+      ioapic_write_route(irq, false);
+   }
+   enable_interrupts(&var);
+}
+
+bool apic_is_masked(int irq)
+{
+   struct isa_irq_route *r = &isa_routes[irq];
+   struct ioapic *io;
+   ulong var;
+   bool res;
+
+   ASSERT(IN_RANGE(irq, 0, 16));
+
+   if (r->ioapic < 0)
+      return true;
+
+   io = &ioapics[(int)r->ioapic];
+
+   disable_interrupts(&var);
+   {
+      res = ioapic_read(io, IOAPIC_REG_REDTBL + 2 * r->pin) & IOAPIC_RTE_MASKED;
+   }
+   enable_interrupts(&var);
+   return res;
+}
+
+int apic_alloc_msi_irq(u32 *addr, u32 *data)
+{
+   int irq = -ENOSPC;
+   ulong var;
+
+   if (!apic_is_enabled())
+      return -ENODEV;
+
+   disable_interrupts(&var);
+   {
+      /*
+       * Use only the IRQ lines not connected to any I/O APIC pin (typically,
+       * just the cascade line 2). Taking an ISA-wired line, even if it has no
+       * handlers now, would silently keep masked the IRQ of any legacy driver
+       * installing its handler later, because apic_clear_mask() ignores the
+       * MSI lines.
+       */
+      for (int i = ARRAY_SIZE(isa_routes) - 1; i > 0; i--) {
+
+         if (msi_irqs_mask & (1 << i))
+            continue;
+
+         if (!list_is_empty(&irq_handlers_lists[i]))
+            continue;
+
+         if (isa_routes[i].ioapic < 0) {
+            irq = i;
+            break;
+         }
+      }
+
+      if (irq > 0)
+         msi_irqs_mask |= (u16)(1 << irq);
+   }
+   enable_interrupts(&var);
+
+   if (irq < 0)
+      return irq;
+
+   /* Fixed delivery mode, edge triggered, physical destination: our LAPIC */
+   *addr = MSI_ADDR_BASE | (lapic_id << 12);
+   *data = (u32)(32 + irq);
+   return irq;
+}
+
+void apic_free_msi_irq(int irq)
+{
+   ulong var;
+   ASSERT(IN_RANGE(irq, 0, 16));
+
+   disable_interrupts(&var);
+   {
+      msi_irqs_mask &= (u16)~(1 << irq);
+   }
+   enable_interrupts(&var);
+}
@@ -22,15 +22,27 @@ static void handle_no_coproc_fault(regs_t *r);
 #define CPU_FXSAVE_AREA_SIZE   512
 
 /*
- * NOTE: calculating the exact area save area for XSAVE is tricky since it
- * depends on the features currently supported by the CPU (it is necessary
- * to iterate with CPUID calls to do the right calculation). For the moment,
- * just using a large buffer is a good-enough solution.
- *
- * TODO (future): calculate the exact size for the XSAVE area.
+ * Upper bound for the XSAVE area, used for the static buffer of the kernel's
+ * FPU context. The buffers for the user tasks are allocated using the exact
+ * size reported by CPUID[0xd] for the features enabled in XCR0.
  */
 #define CPU_XSAVE_AREA_SIZE   8192
 
+/* XSAVE requires the save area to be aligned at 64 bytes */
+#define CPU_XSAVE_AREA_ALIGN  64
+
+/* Default values for the x87 control word and for MXCSR, after FNINIT */
+#define FPU_DEFAULT_FCW       0x037f
+#define FPU_DEFAULT_MXCSR     0x1f80
+
+static u32 xsave_area_size = CPU_XSAVE_AREA_SIZE;
+
+/*
+ * The user task whose FPU context is currently loaded in the registers, if
+ * any. Switching back to it, does not require restoring its FPU context.
+ */
+static void *fpu_owner;
+
 static bool enable_sse(void)
 {
    u32 res = fault_resumable_call(ALL_FAULTS_MASK, &asm_enable_sse, 0);
@@ -88,6 +100,26 @@ static bool enable_osxsave(void)
    return true;
 }
 
+static void init_xsave_area_size(void)
+{
+   u32 a, b, c, d;
+
+   /*
+    * CPUID[0xd].EBX contains the size of the XSAVE area required for all the
+    * features currently enabled in XCR0. Therefore, this must be called after
+    * asm_enable_avx().
+    */
+   cpuid_count(0xd, 0, &a, &b, &c, &d);
+
+   if (!b || b > CPU_XSAVE_AREA_SIZE) {
+      printk("CPU: unexpected XSAVE area size: %u\n", b);
+      return;
+   }
+
+   xsave_area_size = pow2_round_up_at(b, CPU_XSAVE_AREA_ALIGN);
+   printk("CPU: XSAVE area size: %u bytes\n", xsave_area_size);
+}
+
 static bool enable_avx(void)
 {
    u32 res = fault_resumable_call(ALL_FAULTS_MASK, &asm_enable_avx, 0);
@@ -103,6 +135,8 @@ static bool enable_avx(void)
    }
 
    x86_cpu_features.can_use_avx = true;
+   x86_cpu_features.can_use_xsaveopt = x86_cpu_features.xsaveopt;
+   init_xsave_area_size();
 
    if (x86_cpu_features.avx2) {
       x86_cpu_features.can_use_avx2 = true;
@@ -182,6 +216,17 @@ out:
 
 static char fpu_kernel_regs[CPU_XSAVE_AREA_SIZE] ALIGNED_AT(64);
 
+void fpu_reset_owner(void *task)
+{
+   if (fpu_owner == task)
+      fpu_owner = NULL;
+}
+
+bool is_fpu_owner(void *task)
+{
+   return fpu_owner == task;
+}
+
 void save_current_fpu_regs(bool in_kernel)
 {
    if (UNLIKELY(!x86_cpu_features.can_use_sse))
@@ -195,25 +240,37 @@ void save_current_fpu_regs(bool in_kernel)
 
    ASSERT(buf != NULL);
 
-   if (x86_cpu_features.can_use_avx) {
+   if (x86_cpu_features.can_use_xsaveopt) {
 
       /*
        * In eax:edx we're supposed to specific which reg sets to save/restore
        * using a bitmask. Setting all bits to 1 works well to save/restore
-       * "everything".
+       * "everything". Compared to XSAVE, XSAVEOPT skips the components in
+       * their initial state and the ones not modified since the last XRSTOR
+       * from the same buffer.
        */
 
+      asmVolatile("xsaveopt (%0)"
+                  : /* no output */
+                  : "r" (buf), "a" (-1), "d" (-1)
+                  : "memory");
+
+   } else if (x86_cpu_features.can_use_avx) {
+
       asmVolatile("xsave (%0)"
                   : /* no output */
                   : "r" (buf), "a" (-1), "d" (-1)
-                  : /* no clobber */);
+                  : "memory");
    } else {
 
       asmVolatile("fxsave (%0)"
                   : /* no output */
                   : "r" (buf)
-                  : /* no clobber */);
+                  : "memory");
    }
+
+   if (!in_kernel)
+      fpu_owner = get_curr_task();
 }
 
 void restore_fpu_regs(void *task, bool in_kernel)
@@ -229,6 +286,9 @@ void restore_fpu_regs(void *task, bool in_kernel)
 
    ASSERT(buf != NULL);
 
+   if (!in_kernel)
+      fpu_owner = task;
+
    if (x86_cpu_features.can_use_avx) {
 
       asmVolatile("xrstor (%0)"
@@ -257,9 +317,9 @@ bool allocate_fpu_regs(arch_task_members_t *arch_fields)
    if (x86_cpu_features.can_use_avx) {
 
       arch_fields->aligned_fpu_regs =
-         aligned_kmalloc(CPU_XSAVE_AREA_SIZE, 8 * sizeof(void *));
+         aligned_kmalloc(xsave_area_size, CPU_XSAVE_AREA_ALIGN);
 
-      arch_fields->fpu_regs_size = CPU_XSAVE_AREA_SIZE;
+      arch_fields->fpu_regs_size = (u16)xsave_area_size;
 
    } else {
 
@@ -276,6 +336,18 @@ bool allocate_fpu_regs(arch_task_members_t *arch_fields)
    return true;
 }
 
+static void init_fpu_regs_buf(void *buf)
+{
+   /*
+    * Both the FXSAVE area and the legacy region of the XSAVE area start with
+    * the x87 control word and have MXCSR at offset 24. With XSTATE_BV = 0,
+    * XRSTOR puts all the components in their initial state, but it still loads
+    * MXCSR from memory. FXRSTOR, instead, loads everything from memory.
+    */
+   *(u16 *)buf = FPU_DEFAULT_FCW;
+   *(u32 *)((char *)buf + 24) = FPU_DEFAULT_MXCSR;
+}
+
 static void
 handle_no_coproc_fault(regs_t *r)
 {
@@ -335,6 +407,16 @@ handle_no_coproc_fault(regs_t *r)
 
 #endif
 
+   /*
+    * The registers still contain the FPU context of whatever task used the FPU
+    * before: load a clean context instead. That makes this task the owner of
+    * the FPU registers, consistently with its (saved) context.
+    */
+   init_fpu_regs_buf(arch_fields->aligned_fpu_regs);
+   hw_fpu_enable();
+   restore_current_fpu_regs(false);
+   hw_fpu_disable();
+
    r->custom_flags |= REGS_FL_FPU_ENABLED;
 }
 
@@ -11,6 +11,8 @@
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/worker_thread.h>
 #include <tilck/kernel/timer.h>
+#include <tilck/kernel/profiler.h>
+#include <tilck/kernel/arch/generic_x86/apic.h>
 
 #include "pic.h"
 
@@ -35,9 +37,70 @@ struct list irq_handlers_lists[16] = {
 
 u32 unhandled_irq_count[256];
 u32 spur_irq_count;
+struct irq_stats irq_stats[16];
 
 void idt_set_entry(u8 num, void *handler, u16 sel, u8 flags);
 
+/*
+ * The IRQs are delivered either by the legacy 8259 PIC or, when enabled, by
+ * the I/O APIC + local APIC (see apic.c). The functions below just forward
+ * the call to the interrupt controller in use.
+ */
+
+void irq_set_mask(int irq)
+{
+   if (apic_is_enabled())
+      apic_set_mask(irq);
+   else
+      pic_set_mask(irq);
+}
+
+void irq_clear_mask(int irq)
+{
+   if (apic_is_enabled())
+      apic_clear_mask(irq);
+   else
+      pic_clear_mask(irq);
+}
+
+bool irq_is_masked(int irq)
+{
+   if (apic_is_enabled())
+      return apic_is_masked(irq);
+
+   return pic_is_masked(irq);
+}
+
+static inline void irqc_mask_and_send_eoi(int irq)
+{
+   if (apic_is_enabled())
+      apic_mask_and_send_eoi(irq);
+   else
+      pic_mask_and_send_eoi(irq);
+}
+
+static inline void irqc_send_eoi(int irq)
+{
+   if (apic_is_enabled())
+      apic_send_eoi(irq);
+   else
+      pic_send_eoi(irq);
+}
+
+static inline void irqc_end_of_irq(int irq)
+{
+   if (apic_is_enabled())
+      apic_end_of_irq(irq);
+}
+
+static inline bool irqc_is_spur_irq(int irq)
+{
+   if (apic_is_enabled())
+      return apic_is_spur_irq(irq);
+
+   return pic_is_spur_irq(irq);
+}
+
 /* This installs a custom IRQ handler for the given IRQ */
 void irq_install_handler(u8 irq, struct irq_handler_node *n)
 {
@@ -64,6 +127,64 @@ void irq_uninstall_handler(u8 irq, struct irq_handler_node *n)
    enable_interrupts(&var);
 }
 
+void irq_reset_stats(void)
+{
+   struct irq_handler_node *pos;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      bzero(irq_stats, sizeof(irq_stats));
+
+      for (int i = 0; i < ARRAY_SIZE(irq_handlers_lists); i++) {
+
+         unhandled_irq_count[i] = 0;
+
+         list_for_each_ro(pos, &irq_handlers_lists[i], node) {
+            pos->calls = 0;
+            pos->handled = 0;
+            pos->cycles = 0;
+         }
+      }
+
+      spur_irq_count = 0;
+   }
+   enable_interrupts(&var);
+}
+
+static void irq_account_cycles(int irq, u64 cycles)
+{
+   struct irq_stats *s = &irq_stats[irq];
+   const u32 c32 = cycles > 0xffffffff ? 0xffffffff : (u32)cycles;
+   u32 b = 0;
+
+   if (cycles >> IRQ_HIST_MIN_SHIFT)
+      b = get_last_set_bit_index64(cycles) - IRQ_HIST_MIN_SHIFT;
+
+   s->count++;
+   s->tot_cycles += cycles;
+   s->max_cycles = MAX(s->max_cycles, c32);
+   s->hist[MIN(b, (u32)IRQ_HIST_BUCKETS - 1)]++;
+}
+
+/*
+ * Move the handler that claimed the IRQ at the beginning of the list, so that
+ * the next time it will be called first. That's useful only for shared IRQ
+ * lines, where typically only one device raises the IRQ at a time.
+ */
+static inline void
+irq_move_handler_to_front(int irq, struct irq_handler_node *n)
+{
+   struct list *l = &irq_handlers_lists[irq];
+
+   ASSERT(!are_interrupts_enabled());
+
+   if (l->first != &n->node) {
+      list_remove(&n->node);
+      list_add_head(l, &n->node);
+   }
+}
+
 static inline void handle_irq_set_mask_and_eoi(int irq)
 {
    if (KRN_TRACK_NESTED_INTERR) {
@@ -75,12 +196,12 @@ static inline void handle_irq_set_mask_and_eoi(int irq)
        */
 
       if (irq != X86_PC_TIMER_IRQ)
-         pic_mask_and_send_eoi(irq);
+         irqc_mask_and_send_eoi(irq);
       else
-         pic_send_eoi(irq);
+         irqc_send_eoi(irq);
 
    } else {
-      pic_mask_and_send_eoi(irq);
+      irqc_mask_and_send_eoi(irq);
    }
 }
 
@@ -100,33 +221,55 @@ void arch_irq_handling(regs_t *r)
 {
    enum irq_action hret = IRQ_NOT_HANDLED;
    const int irq = r->int_num - 32;
-   struct irq_handler_node *pos;
+   struct irq_handler_node *pos, *claimed = NULL;
+   u64 start, h_start;
 
    ASSERT(!are_interrupts_enabled());
    ASSERT(!is_preemption_enabled());
 
-   if (pic_is_spur_irq(irq)) {
+   if (irqc_is_spur_irq(irq)) {
       spur_irq_count++;
       return;
    }
 
+   if (irq == X86_PC_TIMER_IRQ && prof_is_running())
+      prof_sample(r);
+
+   start = RDTSC();
    push_nested_interrupt(r->int_num);
    handle_irq_set_mask_and_eoi(irq);
    enable_interrupts_forced();
    {
       list_for_each_ro(pos, &irq_handlers_lists[irq], node) {
 
+         h_start = RDTSC();
          hret = pos->handler(pos->context);
+         pos->cycles += RDTSC() - h_start;
+         pos->calls++;
 
-         if (hret != IRQ_NOT_HANDLED)
+         if (hret != IRQ_NOT_HANDLED) {
+            pos->handled++;
+            claimed = pos;
             break;
+         }
       }
 
       if (hret == IRQ_NOT_HANDLED)
          unhandled_irq_count[irq]++;
    }
    disable_interrupts_forced();
+
+   /*
+    * Don't touch the list in the timer IRQ case, as it could be nested (see
+    * handle_irq_set_mask_and_eoi()) and interrupted iterations of the list
+    * in the same IRQ might get confused.
+    */
+   if (claimed && irq != X86_PC_TIMER_IRQ)
+      irq_move_handler_to_front(irq, claimed);
+
    handle_irq_clear_mask(irq);
+   irqc_end_of_irq(irq);
+   irq_account_cycles(irq, RDTSC() - start);
    pop_nested_interrupt();
 }
 
@@ -68,6 +68,7 @@ static void disable_fpu_features(void)
    x86_cpu_features.can_use_sse2 = false;
    x86_cpu_features.can_use_avx = false;
    x86_cpu_features.can_use_avx2 = false;
+   x86_cpu_features.can_use_xsaveopt = false;
 }
 
 static void panic_print_task_info(struct task *curr)
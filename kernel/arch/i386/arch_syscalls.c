@@ -15,6 +15,7 @@
 #include <tilck/kernel/user.h>
 #include <tilck/kernel/elf_utils.h>
 #include <tilck/kernel/signal.h>
+#include <tilck/kernel/syscall_stats.h>
 #include <tilck/mods/tracing.h>
 
 #include "idt_int.h"
@@ -545,6 +546,7 @@ static void do_special_syscall(regs_t *r)
    const bool signals = ~fl & SYSFL_NO_SIG;
    const bool preemptable = ~fl & SYSFL_NO_PREEMPT;
    const bool traceable = ~fl & SYSFL_NO_TRACE;
+   u64 start, cycles;
 
    if (signals)
       process_signals(curr, sig_pre_syscall, r);
@@ -555,7 +557,9 @@ static void do_special_syscall(regs_t *r)
    if (traceable)
       trace_sys_enter(sn,r->ebx,r->ecx,r->edx,r->esi,r->edi,r->ebp);
 
+   start = RDTSC();
    r->eax = (u32) fptr(r->ebx,r->ecx,r->edx,r->esi,r->edi,r->ebp);
+   cycles = RDTSC() - start;
 
    if (traceable)
       trace_sys_exit(sn,r->eax,r->ebx,r->ecx,r->edx,r->esi,r->edi,r->ebp);
@@ -563,6 +567,8 @@ static void do_special_syscall(regs_t *r)
    if (preemptable)
       disable_preemption();
 
+   sys_stats_account(sn, r->eax, cycles);
+
    if (signals)
       process_signals(curr, sig_in_syscall, r);
 }
@@ -572,15 +578,19 @@ static void do_syscall(regs_t *r)
    struct task *curr = get_curr_task();
    const u32 sn = r->eax;
    const syscall_type fptr = syscalls[sn].fptr;
+   u64 start, cycles;
 
    process_signals(curr, sig_pre_syscall, r);
    enable_preemption();
    {
       trace_sys_enter(sn,r->ebx,r->ecx,r->edx,r->esi,r->edi,r->ebp);
+      start = RDTSC();
       r->eax = (u32) fptr(r->ebx,r->ecx,r->edx,r->esi,r->edi,r->ebp);
+      cycles = RDTSC() - start;
       trace_sys_exit(sn,r->eax,r->ebx,r->ecx,r->edx,r->esi,r->edi,r->ebp);
    }
    disable_preemption();
+   sys_stats_account(sn, r->eax, cycles);
    process_signals(curr, sig_in_syscall, r);
 }
 
@@ -62,6 +62,80 @@ stackwalk32(void **frames,
    return i;
 }
 
+/*
+ * Get the bounds of the kernel stack we're running on: the initial one or the
+ * one of the current task. Note: with KERNEL_STACK_ISOLATION, task stacks are
+ * surrounded by unmapped guard pages and they're not aligned at
+ * KERNEL_STACK_SIZE, therefore we cannot just mask the stack pointer.
+ */
+static void get_curr_kernel_stack(ulong *begin, ulong *end)
+{
+   const ulong sp = get_stack_ptr();
+   struct task *ti = get_curr_task();
+
+   if (IN_RANGE(sp, init_st_begin, init_st_end) || !ti->kernel_stack) {
+      *begin = init_st_begin;
+      *end = init_st_end;
+      return;
+   }
+
+   *begin = (ulong)ti->kernel_stack;
+   *end = *begin + KERNEL_STACK_SIZE;
+}
+
+/*
+ * Walk the frame pointers of the context interrupted by `r`. Called by the
+ * sampling profiler in the timer IRQ handler, therefore it must never fault:
+ * kernel frames must be inside the current kernel stack (the one we're using
+ * right now) and all the frames must be mapped. That's essential because the
+ * syscall entry path doesn't clear EBP: the last frame pointer in a kernel
+ * chain can be any value chosen by user space. Also, frames must always move
+ * towards the bottom of the stack, in order to stop on broken chains.
+ */
+size_t regs_stackwalk(regs_t *r, ulong *frames, size_t count)
+{
+   const bool user = regs_in_user_mode(r);
+   pdir_t *pdir = get_curr_pdir();
+   ulong ebp = r->ebp;
+   ulong prev = 0;
+   ulong st_begin, st_end;
+   ulong *fp;
+   size_t i;
+
+   get_curr_kernel_stack(&st_begin, &st_end);
+
+   for (i = 0; i < count; i++) {
+
+      if (ebp <= prev || (ebp & (sizeof(ulong) - 1)))
+         break;
+
+      fp = TO_PTR(ebp);
+
+      if (user) {
+
+         if (ebp + 2 * sizeof(ulong) > KERNEL_BASE_VA)
+            break;
+
+      } else {
+
+         if (ebp < st_begin || ebp + 2 * sizeof(ulong) > st_end)
+            break;
+      }
+
+      if (!is_mapped(pdir, fp) || !is_mapped(pdir, fp + 1))
+         break;
+
+      if (!fp[1])
+         break;
+
+      frames[i] = fp[1];
+      prev = ebp;
+      ebp = fp[0];
+   }
+
+   return i;
+}
+
 void dump_stacktrace(void *ebp, pdir_t *pdir)
 {
    void *frames[32] = {0};
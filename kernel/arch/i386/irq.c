@@ -7,6 +7,8 @@
 
 #include <tilck/kernel/hal.h>
 #include <tilck/kernel/irq.h>
+#include <tilck/kernel/cmdline.h>
+#include <tilck/kernel/arch/generic_x86/apic.h>
 
 #include "idt_int.h"
 #include "../generic_x86/pic.h"
@@ -23,6 +25,14 @@ void init_irq_handling(void)
    ASSERT(!are_interrupts_enabled());
    init_pic_8259(32, 40);
 
+   /*
+    * The 8259 PIC is always initialized (remapped to 32-47) because, even
+    * when we switch to the I/O APIC, it might still raise spurious IRQs.
+    * NOTE: the I/O APIC is experimental and used only with `-ioapic`.
+    */
+   if (kopt_ioapic)
+      init_apic_irq_routing();
+
    for (int i = 0; i < ARRAY_SIZE(irq_handlers_lists); i++) {
 
       idt_set_entry(32 + (u8)i,
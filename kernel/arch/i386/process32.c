@@ -673,6 +673,16 @@ switch_to_task(struct task *ti)
 
    if (!is_kernel_thread(ti)) {
 
+      /*
+       * NOTE: reloading CR3 here flushes only the non-global TLB entries:
+       * kernel mappings have the G bit set and CR4.PGE is enabled in start.S.
+       * Tagging the user entries with a PCID would allow us to keep them as
+       * well, but PCIDs exist only in IA-32e mode (CR4.PCIDE cannot be set
+       * with 32-bit paging). Therefore, on i386 the best we can do is to skip
+       * the reload when the pdir doesn't change: that's always the case when
+       * switching to kernel threads and between threads of the same process.
+       */
+
       if (get_curr_pdir() != ti->pi->pdir) {
 
          arch_proc_members_t *arch = get_proc_arch_fields(ti->pi);
@@ -686,8 +696,13 @@ switch_to_task(struct task *ti)
          process_signals(ti, sig_in_usermode, state);
 
       if (is_fpu_enabled_for_task(ti)) {
+
          hw_fpu_enable();
-         restore_fpu_regs(ti, false);
+
+         /* Skip the restore when the registers already contain ti's context */
+         if (!is_fpu_owner(ti))
+            restore_fpu_regs(ti, false);
+
          /* leave FPU enabled */
       }
    }
@@ -748,6 +763,7 @@ arch_specific_new_task_setup(struct task *ti, struct task *parent)
           * keep it allocated.
           */
          bzero(arch->aligned_fpu_regs, arch->fpu_regs_size);
+         fpu_reset_owner(ti);
 
       } else {
 
@@ -779,6 +795,7 @@ void
 arch_specific_free_task(struct task *ti)
 {
    arch_task_members_t *arch = get_task_arch_fields(ti);
+   fpu_reset_owner(ti);
    aligned_kfree2(arch->aligned_fpu_regs, arch->fpu_regs_size);
    arch->aligned_fpu_regs = NULL;
    arch->fpu_regs_size = 0;
@@ -19,6 +19,12 @@ void dump_stacktrace(void *ebp, pdir_t *pdir)
    NOT_IMPLEMENTED();
 }
 
+size_t regs_stackwalk(regs_t *r, ulong *frames, size_t count)
+{
+   NOT_IMPLEMENTED();
+   return 0;
+}
+
 void dump_regs(regs_t *r)
 {
    NOT_IMPLEMENTED();
@@ -11,6 +11,7 @@
 #include <tilck/kernel/syscalls.h>
 #include <tilck/kernel/debug_utils.h>
 #include <tilck/kernel/interrupts.h>
+#include <tilck/kernel/aio.h>
 
 static const char *const default_env[] =
 {
@@ -357,6 +358,7 @@ do_execve_int(struct execve_ctx *ctx, const char *path, const char *const *argv)
       return rc;                 /* setup_process() failed */
 
    /* From now on, we cannot fail */
+   aio_destroy_all_contexts(ti->pi);
    close_cloexec_handles(ti->pi);
    disable_preemption();
    {
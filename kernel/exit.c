@@ -13,6 +13,7 @@
 #include <tilck/kernel/paging_hw.h>
 #include <tilck/kernel/process_mm.h>
 #include <tilck/kernel/debug_utils.h>
+#include <tilck/kernel/aio.h>
 
 #include <tilck/mods/tracing.h>
 
@@ -100,13 +101,12 @@ static void
 close_all_handles(void)
 {
    struct process *pi = get_curr_proc();
+   int fd;
    ASSERT(is_preemption_enabled());
 
-   for (int i = 0; i < MAX_HANDLES; i++) {
-      if (pi->handles[i]) {
-         vfs_close(pi->handles[i]);
-         pi->handles[i] = NULL;
-      }
+   for_each_used_fd(pi, fd) {
+      vfs_close(pi->handles[fd]);
+      fd_table_set(pi, fd, NULL);
    }
 }
 
@@ -251,10 +251,12 @@ void terminate_process(int exit_code, int term_sig)
    ti->nested_sig_handlers = -1;
 
    /*
-    * Close all the handles, keeping the preemption enabled while doing so.
+    * Destroy the AIO contexts and close all the handles, keeping the
+    * preemption enabled while doing so.
     */
    enable_preemption();
    {
+      aio_destroy_all_contexts(pi);
       close_all_handles();
    }
    disable_preemption();
@@ -13,28 +13,38 @@
 
 STATIC int fork_dup_all_handles(struct process *pi)
 {
+   int fd;
    ASSERT(!is_preemption_enabled());
 
-   for (u32 i = 0; i < MAX_HANDLES; i++) {
+   for_each_used_fd(pi, fd) {
 
       int rc;
       fs_handle dup_h = NULL;
-      fs_handle h = pi->handles[i];
+      fs_handle h = pi->handles[fd];
       struct user_mapping *um;
 
-      if (!h)
-         continue;
-
       rc = vfs_dup(h, &dup_h);
 
       if (rc < 0 || !dup_h) {
 
+         int j;
+
+         /*
+          * Close the handles dup-ed so far and drop the table, still
+          * containing the parent's handles after `fd`.
+          */
          enable_preemption();
          {
-            for (u32 j = 0; j < i; j++)
+            for_each_used_fd(pi, j) {
+
+               if (j == fd)
+                  break;
+
                vfs_close(pi->handles[j]);
+            }
          }
          disable_preemption();
+         fd_table_destroy(pi);
          return -ENOMEM;
       }
 
@@ -42,7 +52,7 @@ STATIC int fork_dup_all_handles(struct process *pi)
       ((struct fs_handle_base *)dup_h)->pi = pi;
 
       /* Replace the older (parent's) handle with the new one */
-      pi->handles[i] = dup_h;
+      pi->handles[fd] = dup_h;
 
       if (!pi->mi)
          continue;
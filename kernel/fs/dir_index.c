@@ -0,0 +1,245 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+
+#include <tilck/kernel/fs/dir_index.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+
+#define DIR_INDEX_MIN_SIZE       4u
+
+/* FNV-1a hash of the name */
+static u32 dir_index_hash(const char *name, size_t len)
+{
+   u32 h = 2166136261u;
+
+   for (size_t i = 0; i < len; i++)
+      h = (h ^ (u8)name[i]) * 16777619u;
+
+   return h;
+}
+
+static ALWAYS_INLINE const char *
+dir_index_name(struct dir_index *idx, struct dir_index_node *n)
+{
+   return (const char *)n + idx->name_off;
+}
+
+/*
+ * Cookies are sequential: using them directly as hash values makes the nodes
+ * of a directory (mostly) fill consecutive slots, which is the best case for
+ * linear probing.
+ */
+static ALWAYS_INLINE u32
+dir_index_slot(struct dir_index *idx, u32 hash)
+{
+   return hash & (idx->size - 1);
+}
+
+static ALWAYS_INLINE u32
+dir_index_key(struct dir_index_node *n, bool by_cookie)
+{
+   return by_cookie ? n->cookie : n->hash;
+}
+
+static ALWAYS_INLINE struct dir_index_node **
+dir_index_table(struct dir_index *idx, bool by_cookie)
+{
+   return by_cookie ? idx->by_cookie : idx->by_name;
+}
+
+static void
+dir_index_table_add(struct dir_index *idx,
+                    struct dir_index_node *n,
+                    bool by_cookie)
+{
+   struct dir_index_node **table = dir_index_table(idx, by_cookie);
+   u32 s = dir_index_slot(idx, dir_index_key(n, by_cookie));
+
+   while (table[s])
+      s = dir_index_slot(idx, s + 1);
+
+   table[s] = n;
+}
+
+/*
+ * Remove `n` using the backward-shift deletion, which doesn't require
+ * tombstones: after emptying a slot, move back any following node in the
+ * same cluster that would become unreachable otherwise.
+ */
+static void
+dir_index_table_del(struct dir_index *idx,
+                    struct dir_index_node *n,
+                    bool by_cookie)
+{
+   struct dir_index_node **table = dir_index_table(idx, by_cookie);
+   u32 s = dir_index_slot(idx, dir_index_key(n, by_cookie));
+   u32 j, home;
+
+   while (table[s] != n) {
+      ASSERT(table[s] != NULL);
+      s = dir_index_slot(idx, s + 1);
+   }
+
+   table[s] = NULL;
+   j = s;
+
+   while (true) {
+
+      j = dir_index_slot(idx, j + 1);
+
+      if (!table[j])
+         break;
+
+      home = dir_index_slot(idx, dir_index_key(table[j], by_cookie));
+
+      /* The node in `j` can be moved to `s` only if `home` is not in (s, j] */
+      if (s <= j ? (s < home && home <= j) : (s < home || home <= j))
+         continue;
+
+      table[s] = table[j];
+      table[j] = NULL;
+      s = j;
+   }
+}
+
+static int dir_index_resize(struct dir_index *idx, u32 new_size)
+{
+   struct dir_index_node **old_name = idx->by_name;
+   struct dir_index_node **old_cookie = idx->by_cookie;
+   const u32 old_size = idx->size;
+   struct dir_index_node **t;
+
+   ASSERT(new_size >= DIR_INDEX_MIN_SIZE);
+   ASSERT(idx->count <= new_size / 2);
+
+   if (!(t = kzalloc_array_obj(struct dir_index_node *, 2 * new_size)))
+      return -ENOMEM;
+
+   idx->by_name = t;
+   idx->by_cookie = t + new_size;
+   idx->size = new_size;
+
+   for (u32 i = 0; i < old_size; i++) {
+
+      if (old_name[i])
+         dir_index_table_add(idx, old_name[i], false);
+
+      if (old_cookie[i])
+         dir_index_table_add(idx, old_cookie[i], true);
+   }
+
+   if (old_name)
+      kfree_array_obj(old_name, struct dir_index_node *, 2 * old_size);
+
+   return 0;
+}
+
+void dir_index_init(struct dir_index *idx, long name_off)
+{
+   *idx = (struct dir_index) {
+      .name_off = (u32)name_off,
+   };
+}
+
+void dir_index_destroy(struct dir_index *idx)
+{
+   ASSERT(idx->count == 0);
+
+   if (idx->by_name)
+      kfree_array_obj(idx->by_name, struct dir_index_node *, 2 * idx->size);
+
+   dir_index_init(idx, idx->name_off);
+}
+
+int dir_index_insert(struct dir_index *idx, struct dir_index_node *n)
+{
+   const char *name = dir_index_name(idx, n);
+   int rc;
+
+   if (2 * (idx->count + 1) > idx->size) {
+
+      rc = dir_index_resize(idx, MAX(2 * idx->size, DIR_INDEX_MIN_SIZE));
+
+      if (rc)
+         return rc;
+   }
+
+   n->hash = dir_index_hash(name, strlen(name));
+   n->cookie = idx->next_cookie++;
+
+   dir_index_table_add(idx, n, false);
+   dir_index_table_add(idx, n, true);
+   idx->count++;
+   return 0;
+}
+
+void dir_index_remove(struct dir_index *idx, struct dir_index_node *n)
+{
+   ASSERT(idx->count > 0);
+
+   dir_index_table_del(idx, n, false);
+   dir_index_table_del(idx, n, true);
+   idx->count--;
+
+   if (idx->size > DIR_INDEX_MIN_SIZE && 8 * idx->count < idx->size) {
+
+      /*
+       * Shrinking the tables is only an optimization: in case of OOM, just
+       * keep the current ones.
+       */
+      dir_index_resize(idx, idx->size / 2);
+   }
+}
+
+struct dir_index_node *
+dir_index_find(struct dir_index *idx, const char *name, size_t len)
+{
+   struct dir_index_node *n;
+   const char *nn;
+   u32 hash, s;
+
+   if (!idx->count)
+      return NULL;
+
+   hash = dir_index_hash(name, len);
+   s = dir_index_slot(idx, hash);
+
+   while ((n = idx->by_name[s])) {
+
+      if (n->hash == hash) {
+
+         nn = dir_index_name(idx, n);
+
+         if (!strncmp(nn, name, len) && !nn[len])
+            return n;
+      }
+
+      s = dir_index_slot(idx, s + 1);
+   }
+
+   return NULL;
+}
+
+struct dir_index_node *
+dir_index_find_cookie(struct dir_index *idx, u32 cookie)
+{
+   struct dir_index_node *n;
+   u32 s;
+
+   if (!idx->count)
+      return NULL;
+
+   s = dir_index_slot(idx, cookie);
+
+   while ((n = idx->by_cookie[s])) {
+
+      if (n->cookie == cookie)
+         return n;
+
+      s = dir_index_slot(idx, s + 1);
+   }
+
+   return NULL;
+}
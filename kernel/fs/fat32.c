@@ -16,6 +16,18 @@ int fat_mmap(struct user_mapping *um, pdir_t *pdir, int flags);
 int fat_munmap(struct user_mapping *um, void *vaddrp, size_t len);
 int fat_ramdisk_prepare_for_mmap(struct fat_fs_device_data *d, size_t rd_size);
 
+struct fat_cindex *
+fat_get_cindex(struct fat_fs_device_data *d, struct fat_entry *e);
+u32 fat_cindex_lookup(struct fat_cindex *ci, u32 n, u32 *contig);
+void fat_destroy_cindexes(struct fat_fs_device_data *d);
+
+int fat_dindex_lookup(struct fat_fs_device_data *d,
+                      struct fat_entry *dir,
+                      const char *name,
+                      size_t len,
+                      struct fat_entry **res);
+void fat_destroy_dindexes(struct fat_fs_device_data *d);
+
 /*
  * Special fat_walk() wrapper handling the special case where `e` is NOT a dir
  * entry but a pointer to the entries in the root directory.
@@ -40,15 +52,6 @@ fat_read(fs_handle handle, char *buf, size_t bufsize, offt *pos)
    offt fsize = (offt)h->e->DIR_FileSize;
    offt written_to_buf = 0;
 
-   if (pos != &h->h_fpos) {
-
-      /*
-       * We don't support pread() for this filesystem, at the moment.
-       * TODO: make fat32 support pread64().
-       */
-      return -EPERM;
-   }
-
    if (h->e->directory)
       return -EISDIR;
 
@@ -61,147 +64,94 @@ fat_read(fs_handle handle, char *buf, size_t bufsize, offt *pos)
       return 0;
    }
 
+   if (!h->ci && !(h->ci = fat_get_cindex(d, h->e)))
+      return -ENOMEM;
+
    do {
 
-      char *data = fat_get_pointer_to_cluster_data(d->hdr, h->curr_cluster);
+      const u32 clu_idx = (u32)(*pos / (offt)d->cluster_size);
+      const offt cluster_off = *pos % (offt)d->cluster_size;
+      u32 contig;
+      const u32 clu = fat_cindex_lookup(h->ci, clu_idx, &contig);
+
+      if (!contig)
+         break; /* The cluster chain is shorter than the file */
 
-      const offt file_rem       = fsize - *pos;
-      const offt buf_rem        = (offt)bufsize - written_to_buf;
-      const offt cluster_off    = *pos % (offt)d->cluster_size;
-      const offt cluster_rem    = (offt)d->cluster_size - cluster_off;
-      const offt to_read        = MIN3(cluster_rem, buf_rem, file_rem);
+      /* Contiguous clusters are contiguous in memory as well */
+      char *data = fat_get_pointer_to_cluster_data(d->hdr, clu);
 
-      ASSERT(to_read >= 0);
+      const u64 run_rem    = (u64)contig * d->cluster_size - (u64)cluster_off;
+      const u64 file_rem   = (u64)(fsize - *pos);
+      const u64 buf_rem    = (u64)bufsize - (u64)written_to_buf;
+      const offt to_read   = (offt)MIN3(run_rem, buf_rem, file_rem);
 
       memcpy(buf + written_to_buf, data + cluster_off, (size_t)to_read);
       written_to_buf += to_read;
       *pos += to_read;
 
-      if (to_read < cluster_rem) {
-
-         /*
-          * We read less than cluster_rem because the buf was not big enough
-          * or because the file was not big enough. In either case, we cannot
-          * continue.
-          */
-         break;
-      }
-
-      // find the next cluster
-      u32 fatval = fat_read_fat_entry(d->hdr, d->type, 0, h->curr_cluster);
-
-      if (fat_is_end_of_clusterchain(d->type, fatval)) {
-         ASSERT(*pos == fsize);
-         break;
-      }
-
-      // we do not expect BAD CLUSTERS
-      ASSERT(!fat_is_bad_cluster(d->type, fatval));
-
-      h->curr_cluster = fatval; // go reading the new cluster in the chain.
-
-   } while (true);
+   } while ((size_t)written_to_buf < bufsize && *pos < fsize);
 
    return (ssize_t)written_to_buf;
 }
 
-
-STATIC int
-fat_rewind(fs_handle handle)
+static void fat_dir_cursor_reset(struct fatfs_handle *fh)
 {
-   struct fatfs_handle *h = (struct fatfs_handle *) handle;
-   h->h_fpos = 0;
-   h->curr_cluster = fat_get_first_cluster(h->e);
-   return 0;
-}
-
-STATIC offt
-fat_seek_forward(fs_handle handle, offt dist)
-{
-   struct fatfs_handle *h = (struct fatfs_handle *) handle;
-   struct fat_fs_device_data *d = h->fs->device_data;
-   offt fsize = (offt)h->e->DIR_FileSize;
-   offt moved_distance = 0;
-
-   if (dist == 0)
-      return h->h_fpos;
-
-   if (h->h_fpos + dist > fsize) {
-      /* Allow, like Linux does, to seek past the end of a file. */
-      h->h_fpos += dist;
-      h->curr_cluster = (u32) -1; /* invalid cluster */
-      return (offt) h->h_fpos;
-   }
-
-   do {
-
-      const offt file_rem       = fsize - h->h_fpos;
-      const offt dist_rem       = dist - moved_distance;
-      const offt cluster_off    = h->h_fpos % (offt)d->cluster_size;
-      const offt cluster_rem    = (offt)d->cluster_size - cluster_off;
-      const offt to_move        = MIN3(cluster_rem, dist_rem, file_rem);
-
-      ASSERT(to_move >= 0);
-
-      moved_distance += to_move;
-      h->h_fpos += to_move;
-
-      if (to_move < cluster_rem)
-         break;
-
-      // find the next cluster
-      u32 fatval = fat_read_fat_entry(d->hdr, d->type, 0, h->curr_cluster);
-
-      if (fat_is_end_of_clusterchain(d->type, fatval)) {
-         ASSERT(h->h_fpos == fsize);
-         break;
-      }
-
-      // we do not expect BAD CLUSTERS
-      ASSERT(!fat_is_bad_cluster(d->type, fatval));
-
-      h->curr_cluster = fatval; // go reading the new cluster in the chain.
+   struct fat_fs_device_data *d = fh->fs->device_data;
 
-   } while (true);
+   fh->dir_cur = (struct fat_walk_pos) {
+      .cluster = fh->e == d->root_dir_entries
+                    ? d->root_cluster
+                    : fat_get_first_cluster(fh->e),
+      .index = 0,
+   };
 
-   return (offt)h->h_fpos;
+   fh->dir_cur_pos = 0;
 }
 
-struct fat_count_dirents_ctx {
+struct fat_skip_dirents_ctx {
    offt count;
 };
 
 static int
-fat_count_dirents_cb(struct fat_hdr *hdr,
-                     enum fat_type ft,
-                     struct fat_entry *entry,
-                     const char *long_name,
-                     void *arg)
+fat_skip_dirents_cb(struct fat_hdr *hdr,
+                    enum fat_type ft,
+                    struct fat_entry *entry,
+                    const char *long_name,
+                    void *arg)
 {
-   struct fat_count_dirents_ctx *ctx = arg;
-   ctx->count++;
+   struct fat_skip_dirents_ctx *ctx = arg;
+
+   if (!ctx->count)
+      return 1; /* stop */
+
+   ctx->count--;
    return 0;
 }
 
 /*
- * Count the number of entries in a given FAT directory.
- * TODO: implement fat_count_dirents() in a more efficient way.
+ * Move the directory cursor to the entry at position `off`, walking forward
+ * from the current position when possible. Returns false if the directory
+ * has less than `off` entries.
  */
-STATIC offt fat_count_dirents(struct fat_fs_device_data *d, struct fat_entry *e)
+static bool fat_dir_cursor_move(struct fatfs_handle *fh, offt off)
 {
-   int rc;
-   struct fat_count_dirents_ctx ctx = { .count = 0 };
+   struct fat_fs_device_data *d = fh->fs->device_data;
+   struct fat_skip_dirents_ctx ctx;
    struct fat_walk_static_params walk_params = {
       .ctx = NULL,      /* no need for long name ctx */
       .h = d->hdr,
       .ft = d->type,
-      .cb = &fat_count_dirents_cb,
+      .cb = &fat_skip_dirents_cb,
       .arg = &ctx,
    };
 
-   ASSERT(e->directory);
-   rc = fat_fs_walk_generic(d, &walk_params, e);
-   return rc ? rc : ctx.count;
+   if (off < fh->dir_cur_pos)
+      fat_dir_cursor_reset(fh);
+
+   ctx.count = off - fh->dir_cur_pos;
+   fat_walk_from(&walk_params, &fh->dir_cur);
+   fh->dir_cur_pos = off - ctx.count;
+   return !ctx.count;
 }
 
 static offt fat_seek_dir(struct fatfs_handle *fh, offt off)
@@ -209,7 +159,7 @@ static offt fat_seek_dir(struct fatfs_handle *fh, offt off)
    if (off < 0)
       return -EINVAL;
 
-   if (off > fat_count_dirents(fh->fs->device_data, fh->e))
+   if (!fat_dir_cursor_move(fh, off))
       return -EINVAL;
 
    fh->dir_pos = off;
@@ -220,6 +170,7 @@ STATIC offt
 fat_seek(fs_handle handle, offt off, int whence)
 {
    struct fatfs_handle *fh = handle;
+   offt new_pos;
 
    if (fh->e->directory) {
 
@@ -229,51 +180,34 @@ fat_seek(fs_handle handle, offt off, int whence)
       return fat_seek_dir(fh, off);
    }
 
-   offt curr_pos = fh->h_fpos;
-
+   /*
+    * Thanks to the cluster index, fat_read() can start from any offset:
+    * seeking is just about updating the file position.
+    */
    switch (whence) {
 
       case SEEK_SET:
-
-         if (off < 0)
-            return -EINVAL; /* invalid negative offset */
-
-         fat_rewind(handle);
-         break;
-
-      case SEEK_END:
-
-         if (off >= 0)
-            break;
-
-         struct fatfs_handle *h = (struct fatfs_handle *) handle;
-         off = (offt) h->e->DIR_FileSize + off;
-
-         if (off < 0)
-            return -EINVAL;
-
-         fat_rewind(handle);
+         new_pos = off;
          break;
 
       case SEEK_CUR:
+         new_pos = fh->h_fpos + off;
+         break;
 
-         if (off < 0) {
-
-            off = curr_pos + off;
-
-            if (off < 0)
-               return -EINVAL;
-
-            fat_rewind(handle);
-         }
-
+      case SEEK_END:
+         new_pos = (offt)fh->e->DIR_FileSize + off;
          break;
 
       default:
          return -EINVAL;
    }
 
-   return fat_seek_forward(handle, off);
+   if (new_pos < 0)
+      return -EINVAL; /* invalid negative offset */
+
+   /* Allow, like Linux does, to seek past the end of a file. */
+   fh->h_fpos = new_pos;
+   return new_pos;
 }
 
 struct datetime
@@ -362,6 +296,8 @@ fat_getdents_cb(struct fat_hdr *hdr,
    char short_name[16];
    const char *entname = long_name ? long_name : short_name;
    struct fat_getdents_ctx *ctx = arg;
+   struct fatfs_handle *fh = ctx->fh;
+   int rc;
 
    if (entname == short_name)
       fat_get_short_name(entry, short_name);
@@ -371,9 +307,16 @@ fat_getdents_cb(struct fat_hdr *hdr,
       .type = entry->directory ? VFS_DIR : VFS_FILE,
       .name_len = (u8) strlen(entname) + 1,
       .name = entname,
+      .next_off = fh->dir_cur_pos + 1,
    };
 
-   return ctx->vfs_cb(&dent, ctx->vfs_ctx);
+   if ((rc = ctx->vfs_cb(&dent, ctx->vfs_ctx))) {
+      ctx->rc = rc;
+      return rc; /* stop the walk: `dir_cur` will point to this entry */
+   }
+
+   fh->dir_cur_pos++;
+   return 0;
 }
 
 static int fat_getdents(fs_handle h, get_dents_func_cb cb, void *arg)
@@ -403,7 +346,14 @@ static int fat_getdents(fs_handle h, get_dents_func_cb cb, void *arg)
       .arg = &ctx,
    };
 
-   rc = fat_fs_walk_generic(d, &walk_params, fh->e);
+   if (fh->dir_cur_pos != fh->dir_pos) {
+
+      /* seek() has been called after the last getdents() */
+      if (!fat_dir_cursor_move(fh, fh->dir_pos))
+         return 0; /* past the end of the directory */
+   }
+
+   rc = fat_walk_from(&walk_params, &fh->dir_cur);
    return rc ? rc : ctx.rc;
 }
 
@@ -498,7 +448,9 @@ fat_open(struct vfs_path *p, fs_handle *out, int fl, mode_t mode)
 
    h->e = e;
    h->h_fpos = 0;
-   h->curr_cluster = fat_get_first_cluster(e);
+
+   if (e->directory || e->volume_id)
+      fat_dir_cursor_reset(h);
 
    if (d->mmap_support)
       h->spec_flags = VFS_SPFL_MMAP_SUPPORTED;
@@ -528,7 +480,8 @@ fat_get_entry(struct mnt_fs *fs,
    struct fat_fs_device_data *d = fs->device_data;
    struct fat_fs_path *fp = (struct fat_fs_path *)fs_path;
    struct fat_walk_static_params walk_params;
-   struct fat_entry *dir_entry;
+   struct fat_entry *dir_entry, *res;
+   enum vfs_entry_type type = VFS_NONE;
    struct fat_search_ctx ctx;
 
    if (!dir_inode && !name)              // both dir_inode and name are NULL:
@@ -540,19 +493,21 @@ fat_get_entry(struct mnt_fs *fs,
       if (is_dot_or_dotdot(name, (int)name_len))
          return fat_get_root_entry(d, fp);
 
-   walk_params = (struct fat_walk_static_params) {
-      .ctx = &ctx.walk_ctx,
-      .h = d->hdr,
-      .ft = d->type,
-      .cb = &fat_search_entry_cb,
-      .arg = &ctx,
-   };
+   if (fat_dindex_lookup(d, dir_entry, name, (size_t)name_len, &res)) {
 
-   fat_init_search_ctx(&ctx, name, true);
-   fat_fs_walk_generic(d, &walk_params, dir_entry);
+      /* No memory for the directory's index: fall back to a linear search */
+      walk_params = (struct fat_walk_static_params) {
+         .ctx = &ctx.walk_ctx,
+         .h = d->hdr,
+         .ft = d->type,
+         .cb = &fat_search_entry_cb,
+         .arg = &ctx,
+      };
 
-   struct fat_entry *res = !ctx.not_dir ? ctx.result : NULL;
-   enum vfs_entry_type type = VFS_NONE;
+      fat_init_search_ctx(&ctx, name, true);
+      fat_fs_walk_generic(d, &walk_params, dir_entry);
+      res = !ctx.not_dir ? ctx.result : NULL;
+   }
 
    if (res) {
 
@@ -634,13 +589,15 @@ struct mnt_fs *fat_mount_ramdisk(void *vaddr, size_t rd_size, u32 flags)
    d->type = fat_get_type(d->hdr);
    d->cluster_size = d->hdr->BPB_SecPerClus * d->hdr->BPB_BytsPerSec;
    d->root_dir_entries = fat_get_rootdir(d->hdr, d->type, &d->root_cluster);
+   kmutex_init(&d->cache_lock, 0);
 
    fs = create_fs_obj("fat",
                       &static_fsops_fat,
                       d,
-                      flags | VFS_FS_RQ_DE_SKIP);
+                      flags | VFS_FS_DCACHE);
 
    if (!fs) {
+      kmutex_destroy(&d->cache_lock);
       kfree_obj(d, struct fat_fs_device_data);
       return NULL;
    }
@@ -653,6 +610,11 @@ struct mnt_fs *fat_mount_ramdisk(void *vaddr, size_t rd_size, u32 flags)
 
 void fat_umount_ramdisk(struct mnt_fs *fs)
 {
-   kfree_obj(fs->device_data, struct fat_fs_device_data);
+   struct fat_fs_device_data *d = fs->device_data;
+
+   fat_destroy_cindexes(d);
+   fat_destroy_dindexes(d);
+   kmutex_destroy(&d->cache_lock);
+   kfree_obj(d, struct fat_fs_device_data);
    destory_fs_obj(fs);
 }
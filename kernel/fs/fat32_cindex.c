@@ -0,0 +1,154 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+
+#include <tilck/kernel/fs/fat32.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+
+/*
+ * Walk the cluster chain starting at `clu`, counting its clusters and its
+ * runs. When `runs` is not NULL, fill it too.
+ */
+static void
+fat_walk_cluster_chain(struct fat_fs_device_data *d,
+                       u32 clu,
+                       u32 *clusters_count,
+                       u32 *runs_count,
+                       struct fat_run *runs)
+{
+   u32 n = 0, r = 0, prev = 0;
+
+   while (true) {
+
+      if (!n || clu != prev + 1) {
+
+         if (runs)
+            runs[r] = (struct fat_run) { .off = n, .clu = clu };
+
+         r++;
+      }
+
+      n++;
+      prev = clu;
+      clu = fat_read_fat_entry(d->hdr, d->type, 0, clu);
+
+      if (fat_is_end_of_clusterchain(d->type, clu))
+         break;
+
+      /* We do not expect BAD CLUSTERS */
+      ASSERT(!fat_is_bad_cluster(d->type, clu));
+   }
+
+   *clusters_count = n;
+   *runs_count = r;
+}
+
+static struct fat_cindex *
+fat_build_cindex(struct fat_fs_device_data *d, u32 first_clu)
+{
+   struct fat_cindex *ci;
+   u32 clusters_count, runs_count;
+
+   if (!(ci = kzalloc_obj(struct fat_cindex)))
+      return NULL;
+
+   /* First pass: just count the runs */
+   fat_walk_cluster_chain(d, first_clu, &clusters_count, &runs_count, NULL);
+
+   if (!(ci->runs = kalloc_array_obj(struct fat_run, runs_count))) {
+      kfree_obj(ci, struct fat_cindex);
+      return NULL;
+   }
+
+   /* Second pass: fill the runs */
+   fat_walk_cluster_chain(d, first_clu, &clusters_count, &runs_count, ci->runs);
+
+   bintree_node_init(&ci->node);
+   ci->first_clu = first_clu;
+   ci->clusters_count = clusters_count;
+   ci->runs_count = runs_count;
+   return ci;
+}
+
+/*
+ * Get the cluster index of the file `e`, building it on the first call.
+ * Returns NULL in case of OOM. The file must have at least one cluster.
+ */
+struct fat_cindex *
+fat_get_cindex(struct fat_fs_device_data *d, struct fat_entry *e)
+{
+   const u32 first_clu = fat_get_first_cluster(e);
+   struct fat_cindex *ci;
+
+   ASSERT(first_clu != 0);
+   kmutex_lock(&d->cache_lock);
+   {
+      ci = bintree_find_ptr(d->cindexes,
+                            first_clu,
+                            struct fat_cindex,
+                            node,
+                            first_clu);
+
+      if (!ci && (ci = fat_build_cindex(d, first_clu))) {
+         bintree_insert_ptr(&d->cindexes,
+                            ci,
+                            struct fat_cindex,
+                            node,
+                            first_clu);
+      }
+   }
+   kmutex_unlock(&d->cache_lock);
+   return ci;
+}
+
+/*
+ * Find the cluster number of the n-th cluster of the file. In `contig`, return
+ * the number of clusters contiguous on the disk, starting from it (0 if the
+ * chain has less than `n + 1` clusters).
+ */
+u32 fat_cindex_lookup(struct fat_cindex *ci, u32 n, u32 *contig)
+{
+   u32 lo = 0, hi = ci->runs_count, end;
+   struct fat_run *r;
+
+   if (n >= ci->clusters_count) {
+      *contig = 0;
+      return 0;
+   }
+
+   /* Binary search for the last run having off <= n */
+   while (hi - lo > 1) {
+
+      const u32 mid = lo + (hi - lo) / 2;
+
+      if (ci->runs[mid].off <= n)
+         lo = mid;
+      else
+         hi = mid;
+   }
+
+   r = &ci->runs[lo];
+   end = lo + 1 < ci->runs_count ? r[1].off : ci->clusters_count;
+
+   *contig = end - n;
+   return r->clu + (n - r->off);
+}
+
+void fat_destroy_cindexes(struct fat_fs_device_data *d)
+{
+   struct fat_cindex *ci;
+
+   while ((ci = d->cindexes)) {
+
+      bintree_remove_ptr(&d->cindexes,
+                         ci,
+                         struct fat_cindex,
+                         node,
+                         first_clu);
+
+      kfree_array_obj(ci->runs, struct fat_run, ci->runs_count);
+      kfree_obj(ci, struct fat_cindex);
+   }
+}
@@ -0,0 +1,263 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/utils.h>
+
+#include <tilck/kernel/fs/fat32.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+
+struct fat_dindex_build_ctx {
+
+   struct fat_dindex *di;
+   size_t buf_off;         /* first pass: total size; second: current offset */
+   u32 pos;
+   char short_name[16];
+};
+
+static ALWAYS_INLINE size_t fat_dname_size(size_t name_len)
+{
+   return pow2_round_up_at(sizeof(struct fat_dname) + name_len + 1,
+                           sizeof(void *));
+}
+
+static const char *
+fat_dindex_entry_name(struct fat_dindex_build_ctx *ctx,
+                      struct fat_entry *entry,
+                      const char *long_name)
+{
+   if (long_name)
+      return long_name;
+
+   fat_get_short_name(entry, ctx->short_name);
+
+   for (char *p = ctx->short_name; *p; p++)
+      *p = (char)tolower(*p);
+
+   return ctx->short_name;
+}
+
+/* First pass: calculate the size of the buffer */
+static int
+fat_dindex_size_cb(struct fat_hdr *hdr,
+                   enum fat_type ft,
+                   struct fat_entry *entry,
+                   const char *long_name,
+                   void *arg)
+{
+   struct fat_dindex_build_ctx *ctx = arg;
+   const char *name = fat_dindex_entry_name(ctx, entry, long_name);
+
+   ctx->buf_off += fat_dname_size(strlen(name));
+   return 0;
+}
+
+/* Second pass: fill the buffer and the indexes */
+static int
+fat_dindex_fill_cb(struct fat_hdr *hdr,
+                   enum fat_type ft,
+                   struct fat_entry *entry,
+                   const char *long_name,
+                   void *arg)
+{
+   struct fat_dindex_build_ctx *ctx = arg;
+   struct fat_dindex *di = ctx->di;
+   const char *name = fat_dindex_entry_name(ctx, entry, long_name);
+   struct dir_index *idx = long_name ? &di->by_long : &di->by_short;
+   const size_t len = strlen(name);
+   struct fat_dname *dn;
+
+   if (ctx->buf_off + fat_dname_size(len) > di->buf_size)
+      return -1; /* Should never happen: stop */
+
+   dn = (void *)(di->buf + ctx->buf_off);
+   ctx->buf_off += fat_dname_size(len);
+
+   dn->e = entry;
+   dn->pos = ctx->pos++;
+   dn->name_len = (u32)len;
+   memcpy(dn->name, name, len + 1);
+
+   /*
+    * In case of duplicates, the lookups must return the first entry, like
+    * a linear search does: skip the others.
+    */
+   if (dir_index_find(idx, name, len))
+      return 0;
+
+   if (dir_index_insert(idx, &dn->node))
+      return -1; /* OOM: stop */
+
+   return 0;
+}
+
+/*
+ * Destroy the index `di`, where only the first `filled` bytes of the buffer
+ * contain valid fat_dname objects.
+ */
+static void fat_destroy_dindex(struct fat_dindex *di, size_t filled)
+{
+   struct fat_dname *dn;
+
+   /* Remove all the nodes from the indexes, as dir_index_destroy() expects */
+   for (size_t off = 0; off < filled; off += fat_dname_size(dn->name_len)) {
+
+      dn = (void *)(di->buf + off);
+
+      if (dir_index_find(&di->by_long, dn->name, dn->name_len) == &dn->node)
+         dir_index_remove(&di->by_long, &dn->node);
+      else if (dir_index_find(&di->by_short, dn->name, dn->name_len)==&dn->node)
+         dir_index_remove(&di->by_short, &dn->node);
+   }
+
+   dir_index_destroy(&di->by_long);
+   dir_index_destroy(&di->by_short);
+
+   if (di->buf)
+      kfree2(di->buf, di->buf_size);
+
+   kfree_obj(di, struct fat_dindex);
+}
+
+static struct fat_dindex *
+fat_build_dindex(struct fat_fs_device_data *d, u32 first_clu)
+{
+   struct fat_dindex *di;
+   struct fat_walk_long_name_ctx walk_ctx;
+   struct fat_dindex_build_ctx ctx = {0};
+   struct fat_walk_static_params walk_params = {
+      .ctx = &walk_ctx,
+      .h = d->hdr,
+      .ft = d->type,
+      .cb = &fat_dindex_size_cb,
+      .arg = &ctx,
+   };
+
+   if (!(di = kzalloc_obj(struct fat_dindex)))
+      return NULL;
+
+   bintree_node_init(&di->node);
+   di->first_clu = first_clu;
+   dir_index_init_for(&di->by_long, struct fat_dname, node, name);
+   dir_index_init_for(&di->by_short, struct fat_dname, node, name);
+
+   /* First pass: calculate the size of the buffer */
+   fat_walk(&walk_params, first_clu);
+
+   if (ctx.buf_off) {
+
+      if (!(di->buf = kmalloc(ctx.buf_off))) {
+         fat_destroy_dindex(di, 0);
+         return NULL;
+      }
+
+      di->buf_size = ctx.buf_off;
+   }
+
+   /* Second pass: fill the buffer and the indexes */
+   ctx = (struct fat_dindex_build_ctx) { .di = di };
+   walk_params.cb = &fat_dindex_fill_cb;
+   fat_walk(&walk_params, first_clu);
+
+   if (ctx.buf_off != di->buf_size) {
+      /* OOM while filling the indexes */
+      fat_destroy_dindex(di, ctx.buf_off);
+      return NULL;
+   }
+
+   return di;
+}
+
+/*
+ * Get the name index of the directory `e`, building it on the first call.
+ * Returns NULL in case of OOM.
+ */
+static struct fat_dindex *
+fat_get_dindex(struct fat_fs_device_data *d, struct fat_entry *e)
+{
+   const u32 first_clu = e == d->root_dir_entries
+                           ? d->root_cluster
+                           : fat_get_first_cluster(e);
+   struct fat_dindex *di;
+
+   kmutex_lock(&d->cache_lock);
+   {
+      di = bintree_find_ptr(d->dindexes,
+                            first_clu,
+                            struct fat_dindex,
+                            node,
+                            first_clu);
+
+      if (!di && (di = fat_build_dindex(d, first_clu))) {
+         bintree_insert_ptr(&d->dindexes,
+                            di,
+                            struct fat_dindex,
+                            node,
+                            first_clu);
+      }
+   }
+   kmutex_unlock(&d->cache_lock);
+   return di;
+}
+
+/*
+ * Look up `name` in the directory `dir`, with the same semantics as
+ * fat_search_entry_cb(): long names are compared in a case sensitive way,
+ * short names in a case insensitive way and the first match wins.
+ *
+ * Returns -ENOMEM if the index could not be built, 0 otherwise. In `res`, it
+ * returns the entry found, or NULL.
+ */
+int fat_dindex_lookup(struct fat_fs_device_data *d,
+                      struct fat_entry *dir,
+                      const char *name,
+                      size_t len,
+                      struct fat_entry **res)
+{
+   struct fat_dindex *di = fat_get_dindex(d, dir);
+   struct fat_dname *a = NULL, *b = NULL;
+   char lc_name[16];
+
+   if (!di)
+      return -ENOMEM;
+
+   a = dir_index_find_obj(&di->by_long, name, len, struct fat_dname, node);
+
+   /* NOTE: short names are at most 12 chars long (8.3) */
+   if (di->by_short.count && len < sizeof(lc_name)) {
+
+      for (size_t i = 0; i < len; i++)
+         lc_name[i] = (char)tolower(name[i]);
+
+      lc_name[len] = 0;
+      b = dir_index_find_obj(&di->by_short,
+                             lc_name,
+                             len,
+                             struct fat_dname,
+                             node);
+   }
+
+   if (a && b)
+      *res = a->pos < b->pos ? a->e : b->e;
+   else
+      *res = a ? a->e : (b ? b->e : NULL);
+
+   return 0;
+}
+
+void fat_destroy_dindexes(struct fat_fs_device_data *d)
+{
+   struct fat_dindex *di;
+
+   while ((di = d->dindexes)) {
+
+      bintree_remove_ptr(&d->dindexes,
+                         di,
+                         struct fat_dindex,
+                         node,
+                         first_clu);
+
+      fat_destroy_dindex(di, di->buf_size);
+   }
+}
@@ -0,0 +1,198 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+
+/*
+ * Heap-allocated tables are a single buffer containing `cap` handle slots,
+ * followed by the bitmap.
+ */
+static ALWAYS_INLINE size_t fd_table_buf_size(u32 cap)
+{
+   return cap * sizeof(fs_handle) + FD_BMP_WORDS(cap) * sizeof(ulong);
+}
+
+static ALWAYS_INLINE bool fd_table_is_inline(struct process *pi)
+{
+   return pi->handles == pi->handles_inline;
+}
+
+static void fd_table_reset(struct process *pi)
+{
+   pi->handles = pi->handles_inline;
+   pi->handles_bmp = pi->handles_bmp_inline;
+   pi->handles_cap = MAX_HANDLES;
+   bzero(pi->handles_inline, sizeof(pi->handles_inline));
+   bzero(pi->handles_bmp_inline, sizeof(pi->handles_bmp_inline));
+}
+
+static int fd_table_grow(struct process *pi, u32 min_cap)
+{
+   const u32 old_cap = pi->handles_cap;
+   u32 cap = old_cap;
+   fs_handle *t;
+
+   ASSERT(min_cap > old_cap);
+
+   while (cap < min_cap)
+      cap *= 2;
+
+   /* Don't go beyond the soft limit, unless strictly necessary */
+   cap = MIN(cap, pi->nofile_cur);
+   cap = MAX(cap, min_cap);
+
+   if (!(t = kzmalloc(fd_table_buf_size(cap))))
+      return -ENOMEM;
+
+   memcpy(t, pi->handles, old_cap * sizeof(fs_handle));
+   memcpy(t + cap, pi->handles_bmp, FD_BMP_WORDS(old_cap) * sizeof(ulong));
+
+   if (!fd_table_is_inline(pi))
+      kfree2(pi->handles, fd_table_buf_size(old_cap));
+
+   pi->handles = t;
+   pi->handles_bmp = (ulong *)(t + cap);
+   pi->handles_cap = cap;
+   return 0;
+}
+
+/* Init an empty fd table with the default RLIMIT_NOFILE limits */
+void fd_table_init(struct process *pi)
+{
+   fd_table_reset(pi);
+   pi->nofile_cur = NOFILE_DEFAULT_CUR;
+   pi->nofile_max = NOFILE_MAX;
+}
+
+/*
+ * Give to `pi`, a memcpy() copy of `parent_pi`, its own fd table having the
+ * same size and contents of the parent's one. The handles still belong to the
+ * parent: fork_dup_all_handles() replaces them later. In case of OOM, `pi` is
+ * left with an empty table.
+ */
+int fd_table_copy(struct process *pi, struct process *parent_pi)
+{
+   const u32 cap = parent_pi->handles_cap;
+   fs_handle *t;
+
+   fd_table_reset(pi);
+
+   if (fd_table_is_inline(parent_pi)) {
+
+      memcpy(pi->handles_inline,
+             parent_pi->handles_inline,
+             sizeof(pi->handles_inline));
+
+      memcpy(pi->handles_bmp_inline,
+             parent_pi->handles_bmp_inline,
+             sizeof(pi->handles_bmp_inline));
+
+      return 0;
+   }
+
+   if (!(t = kmalloc(fd_table_buf_size(cap))))
+      return -ENOMEM;
+
+   memcpy(t, parent_pi->handles, fd_table_buf_size(cap));
+   pi->handles = t;
+   pi->handles_bmp = (ulong *)(t + cap);
+   pi->handles_cap = cap;
+   return 0;
+}
+
+/* Free the memory used by the fd table. It does NOT close the handles. */
+void fd_table_destroy(struct process *pi)
+{
+   if (!fd_table_is_inline(pi))
+      kfree2(pi->handles, fd_table_buf_size(pi->handles_cap));
+
+   fd_table_reset(pi);
+}
+
+/*
+ * Get the lowest free fd >= `ge`, growing the table if necessary. Returns
+ * -EMFILE when there are no free fds below the RLIMIT_NOFILE soft limit and
+ * -ENOMEM when the table could not be grown.
+ */
+int fd_table_get_free_fd(struct process *pi, int ge)
+{
+   const u32 cap = pi->handles_cap;
+   const u32 words = FD_BMP_WORDS(cap);
+   u32 fd = cap, w;
+   ulong bits;
+   int rc;
+
+   ASSERT(ge >= 0);
+   ASSERT(kmutex_is_curr_task_holding_lock(&pi->fslock));
+
+   if ((u32)ge < cap) {
+
+      w = (u32)ge / NBITS;
+      bits = ~pi->handles_bmp[w] & (~0UL << ((u32)ge % NBITS));
+
+      while (!bits && ++w < words)
+         bits = ~pi->handles_bmp[w];
+
+      /* NOTE: the bits beyond `cap` in the last word are always zero */
+      if (bits)
+         fd = MIN(w * NBITS + (u32)__builtin_ctzl(bits), cap);
+
+   } else {
+
+      fd = (u32)ge;
+   }
+
+   if (fd >= pi->nofile_cur)
+      return -EMFILE;
+
+   if (fd >= cap && (rc = fd_table_grow(pi, fd + 1)))
+      return rc;
+
+   return (int)fd;
+}
+
+/*
+ * Make sure that the table contains the slot for `fd`, growing it if
+ * necessary. Returns -EBADF when `fd` is not below the RLIMIT_NOFILE soft
+ * limit (as dup2() does) and -ENOMEM when the table could not be grown.
+ */
+int fd_table_ensure(struct process *pi, int fd)
+{
+   ASSERT(kmutex_is_curr_task_holding_lock(&pi->fslock));
+
+   if (fd < 0 || (u32)fd >= pi->nofile_cur)
+      return -EBADF;
+
+   if ((u32)fd >= pi->handles_cap)
+      return fd_table_grow(pi, (u32)fd + 1);
+
+   return 0;
+}
+
+/* Returns the lowest fd >= `fd` in use, or -1 if there is none */
+int fd_table_next_used(struct process *pi, int fd)
+{
+   const u32 words = FD_BMP_WORDS(pi->handles_cap);
+   u32 w;
+   ulong bits;
+
+   if ((u32)fd >= pi->handles_cap)
+      return -1;
+
+   w = (u32)fd / NBITS;
+   bits = pi->handles_bmp[w] & (~0UL << ((u32)fd % NBITS));
+
+   while (!bits) {
+
+      if (++w == words)
+         return -1;
+
+      bits = pi->handles_bmp[w];
+   }
+
+   return (int)(w * NBITS + (u32)__builtin_ctzl(bits));
+}
@@ -24,7 +24,8 @@ acquire_subsys_flock(struct mnt_fs *fs,
                      enum subsystem subsys,
                      struct locked_file **lock_ref)
 {
-   struct locked_file *lf;
+   struct locked_file *lf, *other;
+   bool same_subsys = false;
    int rc;
 
    disable_preemption();
@@ -87,14 +88,47 @@ acquire_subsys_flock(struct mnt_fs *fs,
 
    disable_preemption();
    {
-      bintree_insert_ptr(&fs->pss_lock_root,
-                         lf,
-                         struct locked_file,
-                         node,
-                         inode);
+      /*
+       * On file systems using per-directory locks (VFS_FS_DIRLOCKS), the same
+       * file can be opened concurrently: another task might have created a
+       * lock object for it while we were allocating ours.
+       */
+      other = bintree_find_ptr(fs->pss_lock_root,
+                               i,
+                               struct locked_file,
+                               node,
+                               inode);
+
+      if (!other) {
+
+         bintree_insert_ptr(&fs->pss_lock_root,
+                            lf,
+                            struct locked_file,
+                            node,
+                            inode);
+
+      } else if (other->owner == subsys) {
+
+         retain_obj(other);
+         same_subsys = true;
+      }
    }
    enable_preemption();
 
+   if (UNLIKELY(other != NULL)) {
+
+      release_obj(lf->fs);
+      kfree_obj(lf, struct locked_file);
+
+      if (rc == 0)
+         vfs_exunlock(fs, i);
+
+      if (!same_subsys)
+         return -ETXTBSY;
+
+      lf = other;
+   }
+
    *lock_ref = lf;
    return 0;
 }
@@ -14,25 +14,9 @@
 
 #include <fcntl.h>      // system header
 
-static inline bool is_fd_in_valid_range(int fd)
-{
-   return IN_RANGE(fd, 0, MAX_HANDLES);
-}
-
-static int get_free_handle_num_ge(struct process *pi, int ge)
-{
-   ASSERT(kmutex_is_curr_task_holding_lock(&pi->fslock));
-
-   for (int free_fd = ge; free_fd < MAX_HANDLES; free_fd++)
-      if (!pi->handles[free_fd])
-         return free_fd;
-
-   return -1;
-}
-
 static int get_free_handle_num(struct process *pi)
 {
-   return get_free_handle_num_ge(pi, 0);
+   return fd_table_get_free_fd(pi, 0);
 }
 
 /*
@@ -50,7 +34,7 @@ fs_handle get_fs_handle(int fd)
 
    kmutex_lock(&curr->pi->fslock);
 
-   if (is_fd_in_valid_range(fd) && curr->pi->handles[fd])
+   if (IN_RANGE(fd, 0, (int)curr->pi->handles_cap))
       handle = curr->pi->handles[fd];
 
    kmutex_unlock(&curr->pi->fslock);
@@ -58,7 +42,7 @@ fs_handle get_fs_handle(int fd)
 }
 
 
-int sys_open(const char *u_path, int flags, mode_t mode)
+int sys_openat(int dirfd, const char *u_path, int flags, mode_t mode)
 {
    int ret, free_fd;
    struct task *curr = get_curr_task();
@@ -87,24 +71,25 @@ int sys_open(const char *u_path, int flags, mode_t mode)
 
    kmutex_lock(&curr->pi->fslock);
 
-   if ((free_fd = get_free_handle_num(curr->pi)) < 0)
-      goto no_fds;
+   if ((ret = free_fd = get_free_handle_num(curr->pi)) < 0)
+      goto end;
 
-   if ((ret = vfs_open(path, &h, flags, mode)) < 0)
+   if ((ret = vfs_openat(dirfd, path, &h, flags, mode)) < 0)
       goto end;
 
    ASSERT(h != NULL);
 
-   curr->pi->handles[free_fd] = h;
+   fd_table_set(curr->pi, free_fd, h);
    ret = free_fd;
 
 end:
    kmutex_unlock(&curr->pi->fslock);
    return ret;
+}
 
-no_fds:
-   ret = -EMFILE;
-   goto end;
+int sys_open(const char *u_path, int flags, mode_t mode)
+{
+   return sys_openat(AT_FDCWD, u_path, flags, mode);
 }
 
 int sys_creat(const char *u_path, mode_t mode)
@@ -112,30 +97,33 @@ int sys_creat(const char *u_path, mode_t mode)
    return sys_open(u_path, O_CREAT | O_WRONLY | O_TRUNC, mode);
 }
 
-int sys_unlink(const char *u_path)
+int sys_unlinkat(int dirfd, const char *u_path, int flags)
 {
    struct task *curr = get_curr_task();
    char *path = curr->args_copybuf;
    size_t written = 0;
    int ret;
 
+   if (flags & ~AT_REMOVEDIR)
+      return -EINVAL;
+
    if ((ret = duplicate_user_path(path, u_path, MAX_PATH, &written)))
       return ret;
 
-   return vfs_unlink(path);
+   if (flags & AT_REMOVEDIR)
+      return vfs_rmdirat(dirfd, path);
+
+   return vfs_unlinkat(dirfd, path);
 }
 
-int sys_rmdir(const char *u_path)
+int sys_unlink(const char *u_path)
 {
-   struct task *curr = get_curr_task();
-   char *path = curr->args_copybuf;
-   size_t written = 0;
-   int ret;
-
-   if ((ret = duplicate_user_path(path, u_path, MAX_PATH, &written)))
-      return ret;
+   return sys_unlinkat(AT_FDCWD, u_path, 0);
+}
 
-   return vfs_rmdir(path);
+int sys_rmdir(const char *u_path)
+{
+   return sys_unlinkat(AT_FDCWD, u_path, AT_REMOVEDIR);
 }
 
 int sys_close(int fd)
@@ -150,13 +138,13 @@ int sys_close(int fd)
    kmutex_lock(&curr->pi->fslock);
    {
       vfs_close(handle);
-      curr->pi->handles[fd] = NULL;
+      fd_table_set(curr->pi, fd, NULL);
    }
    kmutex_unlock(&curr->pi->fslock);
    return ret;
 }
 
-int sys_mkdir(const char *u_path, mode_t mode)
+int sys_mkdirat(int dirfd, const char *u_path, mode_t mode)
 {
    struct task *curr = get_curr_task();
    char *path = curr->args_copybuf;
@@ -169,7 +157,12 @@ int sys_mkdir(const char *u_path, mode_t mode)
    if ((ret = duplicate_user_path(path, u_path, MAX_PATH, &written)))
       return ret;
 
-   return vfs_mkdir(path, mode);
+   return vfs_mkdirat(dirfd, path, mode);
+}
+
+int sys_mkdir(const char *u_path, mode_t mode)
+{
+   return sys_mkdirat(AT_FDCWD, u_path, mode);
 }
 
 int sys_read(int fd, void *u_buf, size_t count)
@@ -384,15 +377,21 @@ int sys_readv(int fd, const struct iovec *u_iov, int u_iovcnt)
    return (int)vfs_readv(handle, iov, u_iovcnt);
 }
 
+/*
+ * Common code for all the stat syscalls: stat `u_path` relative to `dirfd`
+ * or, when `flags` contains AT_EMPTY_PATH and `u_path` is empty, stat the
+ * file referred by `dirfd` itself.
+ */
 static int
-call_vfs_stat64(const char *u_path,
-                struct k_stat64 *u_statbuf,
-                bool res_last_sl)
+do_fstatat(int dirfd, const char *u_path, struct k_stat64 *sb, int flags)
 {
    struct task *curr = get_curr_task();
    char *path = curr->args_copybuf;
-   struct k_stat64 statbuf;
-   int rc = 0;
+   fs_handle h;
+   int rc;
+
+   if (flags & ~(AT_SYMLINK_NOFOLLOW | AT_EMPTY_PATH | AT_NO_AUTOMOUNT))
+      return -EINVAL;
 
    rc = copy_str_from_user(path, u_path, MAX_PATH, NULL);
 
@@ -402,7 +401,27 @@ call_vfs_stat64(const char *u_path,
    if (rc > 0)
       return -ENAMETOOLONG;
 
-   if ((rc = vfs_stat64(path, &statbuf, res_last_sl)))
+   if (!*path && (flags & AT_EMPTY_PATH)) {
+
+      if (dirfd == AT_FDCWD)
+         return vfs_stat64(".", sb, true);
+
+      if (!(h = get_fs_handle(dirfd)))
+         return -EBADF;
+
+      return vfs_fstat64(h, sb);
+   }
+
+   return vfs_fstatat64(dirfd, path, sb, !(flags & AT_SYMLINK_NOFOLLOW));
+}
+
+int sys_fstatat64(int dirfd, const char *u_path,
+                  struct k_stat64 *u_statbuf, int flags)
+{
+   struct k_stat64 statbuf;
+   int rc;
+
+   if ((rc = do_fstatat(dirfd, u_path, &statbuf, flags)))
       return rc;
 
    if (copy_to_user(u_statbuf, &statbuf, sizeof(struct k_stat64)))
@@ -413,12 +432,68 @@ call_vfs_stat64(const char *u_path,
 
 int sys_stat64(const char *u_path, struct k_stat64 *u_statbuf)
 {
-   return call_vfs_stat64(u_path, u_statbuf, true);
+   return sys_fstatat64(AT_FDCWD, u_path, u_statbuf, 0);
 }
 
 int sys_lstat64(const char *u_path, struct k_stat64 *u_statbuf)
 {
-   return call_vfs_stat64(u_path, u_statbuf, false);
+   return sys_fstatat64(AT_FDCWD, u_path, u_statbuf, AT_SYMLINK_NOFOLLOW);
+}
+
+/* Device IDs are encoded as (major << 8 | minor), see devfs_stat() */
+static inline u32 dev_major(u64 dev)
+{
+   return (u32)(dev >> 8) & 0xfff;
+}
+
+static inline u32 dev_minor(u64 dev)
+{
+   return (u32)dev & 0xff;
+}
+
+static inline void
+statx_set_time(struct k_statx_timestamp *t, s64 sec, long nsec)
+{
+   t->tv_sec = sec;
+   t->tv_nsec = (u32)nsec;
+}
+
+int sys_statx(int dirfd, const char *u_path, int flags,
+              u32 mask, struct k_statx *u_statxbuf)
+{
+   struct k_stat64 st;
+   struct k_statx stx;
+   int rc;
+
+   /* The sync type flags don't make sense on Tilck: just ignore them */
+   flags &= ~AT_STATX_SYNC_TYPE;
+
+   if ((rc = do_fstatat(dirfd, u_path, &st, flags)))
+      return rc;
+
+   /* We always return all the basic stats, no matter what's in `mask` */
+   bzero(&stx, sizeof(stx));
+   stx.stx_mask = K_STATX_BASIC_STATS;
+   stx.stx_blksize = (u32)st.st_blksize;
+   stx.stx_nlink = st.st_nlink;
+   stx.stx_uid = (u32)st.st_uid;
+   stx.stx_gid = (u32)st.st_gid;
+   stx.stx_mode = (u16)st.st_mode;
+   stx.stx_ino = st.st_ino;
+   stx.stx_size = (u64)st.st_size;
+   stx.stx_blocks = (u64)st.st_blocks;
+   stx.stx_rdev_major = dev_major(st.st_rdev);
+   stx.stx_rdev_minor = dev_minor(st.st_rdev);
+   stx.stx_dev_major = dev_major(st.st_dev);
+   stx.stx_dev_minor = dev_minor(st.st_dev);
+   statx_set_time(&stx.stx_atime, st.st_atim.tv_sec, st.st_atim.tv_nsec);
+   statx_set_time(&stx.stx_mtime, st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+   statx_set_time(&stx.stx_ctime, st.st_ctim.tv_sec, st.st_ctim.tv_nsec);
+
+   if (copy_to_user(u_statxbuf, &stx, sizeof(stx)))
+      return -EFAULT;
+
+   return 0;
 }
 
 int sys_fstat64(int fd, struct k_stat64 *u_statbuf)
@@ -439,7 +514,7 @@ int sys_fstat64(int fd, struct k_stat64 *u_statbuf)
    return rc;
 }
 
-int sys_symlink(const char *u_target, const char *u_linkpath)
+int sys_symlinkat(const char *u_target, int newdirfd, const char *u_linkpath)
 {
    struct task *curr     = get_curr_task();
    char *target        = curr->args_copybuf + (ARGS_COPYBUF_SIZE / 4) * 0;
@@ -467,10 +542,16 @@ int sys_symlink(const char *u_target, const char *u_linkpath)
    if (!*target || !*linkpath)
       return -ENOENT; /* target or linkpath is an empty string */
 
-   return vfs_symlink(target, linkpath);
+   return vfs_symlinkat(target, newdirfd, linkpath);
 }
 
-int sys_readlink(const char *u_pathname, char *u_buf, size_t u_bufsize)
+int sys_symlink(const char *u_target, const char *u_linkpath)
+{
+   return sys_symlinkat(u_target, AT_FDCWD, u_linkpath);
+}
+
+int sys_readlinkat(int dirfd, const char *u_pathname,
+                   char *u_buf, size_t u_bufsize)
 {
    struct task *curr = get_curr_task();
    char *path = curr->args_copybuf + (ARGS_COPYBUF_SIZE / 4) * 0;
@@ -488,7 +569,7 @@ int sys_readlink(const char *u_pathname, char *u_buf, size_t u_bufsize)
    if (rc > 0)
       return -ENAMETOOLONG;
 
-   rc = vfs_readlink(path, buf);
+   rc = vfs_readlinkat(dirfd, path, buf);
 
    if (rc < 0)
       return rc;
@@ -502,6 +583,11 @@ int sys_readlink(const char *u_pathname, char *u_buf, size_t u_bufsize)
    return (int) ret_bs;
 }
 
+int sys_readlink(const char *u_pathname, char *u_buf, size_t u_bufsize)
+{
+   return sys_readlinkat(AT_FDCWD, u_pathname, u_buf, u_bufsize);
+}
+
 int sys_ia32_truncate64(const char *u_path, s64 len)
 {
    struct task *curr = get_curr_task();
@@ -579,10 +665,28 @@ int sys_getdents64(int fd, struct linux_dirent64 *u_dirp, u32 buf_size)
    return vfs_getdents64(handle, u_dirp, buf_size);
 }
 
+int sys_faccessat2(int dirfd, const char *u_path, mode_t mode, int flags)
+{
+   struct k_stat64 statbuf;
+
+   if (flags & ~(AT_EACCESS | AT_SYMLINK_NOFOLLOW | AT_EMPTY_PATH))
+      return -EINVAL;
+
+   /*
+    * We're always root on Tilck, so just check that the file exists.
+    * TODO: check mode and file r/w flags.
+    */
+   return do_fstatat(dirfd, u_path, &statbuf, flags & ~AT_EACCESS);
+}
+
+int sys_faccessat(int dirfd, const char *u_path, mode_t mode)
+{
+   return sys_faccessat2(dirfd, u_path, mode, 0);
+}
+
 int sys_access(const char *u_path, mode_t mode)
 {
-   // TODO: check mode and file r/w flags.
-   return 0;
+   return sys_faccessat2(AT_FDCWD, u_path, mode, 0);
 }
 
 /*
@@ -595,12 +699,6 @@ int sys_dup2(int oldfd, int newfd)
    fs_handle old_h, new_h;
    struct task *curr = get_curr_task();
 
-   if (!is_fd_in_valid_range(oldfd))
-      return -EBADF;
-
-   if (!is_fd_in_valid_range(newfd))
-      return -EBADF;
-
    if (newfd == oldfd)
       return -EINVAL;
 
@@ -611,6 +709,9 @@ int sys_dup2(int oldfd, int newfd)
       goto out;
    }
 
+   if ((rc = fd_table_ensure(curr->pi, newfd)))
+      goto out;
+
    new_h = get_fs_handle(newfd);
 
    if (new_h) {
@@ -622,6 +723,7 @@ int sys_dup2(int oldfd, int newfd)
        * reusing it.
        */
       vfs_close(new_h);
+      fd_table_set(curr->pi, newfd, NULL);
       new_h = NULL;
    }
 
@@ -647,7 +749,7 @@ int sys_dup2(int oldfd, int newfd)
       goto out;
    }
 
-   curr->pi->handles[newfd] = new_h;
+   fd_table_set(curr->pi, newfd, new_h);
    rc = newfd;
 
 out:
@@ -657,15 +759,13 @@ out:
 
 int sys_dup(int oldfd)
 {
-   int rc = -EMFILE, free_fd;
+   int rc;
    struct process *pi = get_curr_proc();
 
    kmutex_lock(&pi->fslock);
    {
-      free_fd = get_free_handle_num(pi);
-
-      if (is_fd_in_valid_range(free_fd))
-         rc = sys_dup2(oldfd, free_fd);
+      if ((rc = get_free_handle_num(pi)) >= 0)
+         rc = sys_dup2(oldfd, rc);
    }
    kmutex_unlock(&pi->fslock);
    return rc;
@@ -712,15 +812,16 @@ static void debug_print_fcntl_command(int cmd)
 
 void close_cloexec_handles(struct process *pi)
 {
+   int fd;
    kmutex_lock(&pi->fslock);
 
-   for (u32 i = 0; i < MAX_HANDLES; i++) {
+   for_each_used_fd(pi, fd) {
 
-      struct fs_handle_base *h = pi->handles[i];
+      struct fs_handle_base *h = pi->handles[fd];
 
-      if (h && (h->fd_flags & FD_CLOEXEC)) {
+      if (h->fd_flags & FD_CLOEXEC) {
          vfs_close(h);
-         pi->handles[i] = NULL;
+         fd_table_set(pi, fd, NULL);
       }
    }
 
@@ -739,24 +840,23 @@ int sys_fcntl64(int fd, int cmd, int arg)
    switch (cmd) {
 
       case F_DUPFD:
-         {
-            kmutex_lock(&curr->pi->fslock);
-            int new_fd = get_free_handle_num_ge(curr->pi, arg);
-            rc = sys_dup2(fd, new_fd);
-            kmutex_unlock(&curr->pi->fslock);
-            return rc;
-         }
-
       case F_DUPFD_CLOEXEC:
          {
+            if (arg < 0 || (u32)arg >= curr->pi->nofile_cur)
+               return -EINVAL;
+
             kmutex_lock(&curr->pi->fslock);
-            int new_fd = get_free_handle_num_ge(curr->pi, arg);
-            if (!(rc = sys_dup2(fd, new_fd))) {
+
+            if ((rc = fd_table_get_free_fd(curr->pi, arg)) >= 0)
+               rc = sys_dup2(fd, rc);
+
+            if (rc >= 0 && cmd == F_DUPFD_CLOEXEC) {
                /* dup2 succeeded */
-               struct fs_handle_base *h2 = get_fs_handle(new_fd);
+               struct fs_handle_base *h2 = get_fs_handle(rc);
                ASSERT(h2 != NULL);
                h2->fd_flags |= FD_CLOEXEC;
             }
+
             kmutex_unlock(&curr->pi->fslock);
             return rc;
          }
@@ -792,6 +892,12 @@ int sys_fcntl64(int fd, int cmd, int arg)
       case F_GETFL:
          return hb->fl_flags;
 
+      case F_SETPIPE_SZ:
+         return pipe_set_size(hb, arg);
+
+      case F_GETPIPE_SZ:
+         return pipe_get_size(hb);
+
       default:
          printk("fcntl64: Ignored unknown cmd %d\n", cmd);
    }
@@ -799,8 +905,8 @@ int sys_fcntl64(int fd, int cmd, int arg)
    return rc;
 }
 
-static int
-do_chown(const char *u_path, int owner, int group, bool reslink)
+int sys_fchownat(int dirfd, const char *u_path,
+                 int owner, int group, int flags)
 {
    struct task *curr = get_curr_task();
    char *path = curr->args_copybuf;
@@ -814,17 +920,18 @@ do_chown(const char *u_path, int owner, int group, bool reslink)
    if (rc > 0)
       return -ENAMETOOLONG;
 
-   return vfs_chown(path, owner, group, reslink);
+   return vfs_fchownat(dirfd, path, owner, group,
+                       !(flags & AT_SYMLINK_NOFOLLOW));
 }
 
 int sys_chown(const char *u_path, int owner, int group)
 {
-   return do_chown(u_path, owner, group, true);
+   return sys_fchownat(AT_FDCWD, u_path, owner, group, 0);
 }
 
 int sys_lchown(const char *u_path, int owner, int group)
 {
-   return do_chown(u_path, owner, group, false);
+   return sys_fchownat(AT_FDCWD, u_path, owner, group, AT_SYMLINK_NOFOLLOW);
 }
 
 int sys_fchown(int fd, uid_t owner, gid_t group)
@@ -877,7 +984,7 @@ int sys_sync(void)
    return 0;
 }
 
-int sys_chmod(const char *u_path, mode_t mode)
+int sys_fchmodat(int dirfd, const char *u_path, mode_t mode)
 {
    struct task *curr = get_curr_task();
    char *path = curr->args_copybuf;
@@ -891,7 +998,12 @@ int sys_chmod(const char *u_path, mode_t mode)
    if (rc > 0)
       return -ENAMETOOLONG;
 
-   return vfs_chmod(path, mode);
+   return vfs_fchmodat(dirfd, path, mode);
+}
+
+int sys_chmod(const char *u_path, mode_t mode)
+{
+   return sys_fchmodat(AT_FDCWD, u_path, mode);
 }
 
 int sys_fchmod(int fd, mode_t mode)
@@ -909,9 +1021,9 @@ int sys_fchmod(int fd, mode_t mode)
 }
 
 static int
-call_rename_or_link(const char *u_oldpath,
-                    const char *u_newpath,
-                    int (*vfs_func)(const char *, const char *))
+call_rename_or_link(int olddirfd, const char *u_oldpath,
+                    int newdirfd, const char *u_newpath,
+                    u32 flags, bool link)
 {
    struct task *curr = get_curr_task();
    char *oldpath = curr->args_copybuf;
@@ -929,17 +1041,52 @@ call_rename_or_link(const char *u_oldpath,
    if (rc1 > 0 || rc2 > 0)
       return -ENAMETOOLONG;
 
-   return vfs_func(oldpath, newpath);
+   if (link) {
+      return vfs_linkat(olddirfd, oldpath, newdirfd, newpath,
+                        !!(flags & AT_SYMLINK_FOLLOW));
+   }
+
+   return vfs_renameat(olddirfd, oldpath, newdirfd, newpath, flags);
+}
+
+int sys_renameat2(int olddirfd, const char *u_oldpath,
+                  int newdirfd, const char *u_newpath, u32 flags)
+{
+   if (flags & ~RENAME_NOREPLACE)
+      return -EINVAL; /* RENAME_EXCHANGE and RENAME_WHITEOUT not supported */
+
+   return call_rename_or_link(olddirfd, u_oldpath,
+                              newdirfd, u_newpath, flags, false);
+}
+
+int sys_renameat(int olddirfd, const char *u_oldpath,
+                 int newdirfd, const char *u_newpath)
+{
+   return sys_renameat2(olddirfd, u_oldpath, newdirfd, u_newpath, 0);
 }
 
 int sys_rename(const char *u_oldpath, const char *u_newpath)
 {
-   return call_rename_or_link(u_oldpath, u_newpath, &vfs_rename);
+   return sys_renameat2(AT_FDCWD, u_oldpath, AT_FDCWD, u_newpath, 0);
+}
+
+int sys_linkat(int olddirfd, const char *u_oldpath,
+               int newdirfd, const char *u_newpath, int flags)
+{
+   /*
+    * AT_EMPTY_PATH is not supported: on Linux, it requires the
+    * CAP_DAC_READ_SEARCH capability, which has no equivalent in Tilck.
+    */
+   if (flags & ~AT_SYMLINK_FOLLOW)
+      return -EINVAL;
+
+   return call_rename_or_link(olddirfd, u_oldpath,
+                              newdirfd, u_newpath, (u32)flags, true);
 }
 
 int sys_link(const char *u_oldpath, const char *u_newpath)
 {
-   return call_rename_or_link(u_oldpath, u_newpath, &vfs_link);
+   return sys_linkat(AT_FDCWD, u_oldpath, AT_FDCWD, u_newpath, 0);
 }
 
 int sys_pipe(int u_pipefd[2])
@@ -989,21 +1136,22 @@ int sys_pipe2(int u_pipefd[2], int flags)
       goto no_mem;
    }
 
-   if ((fds[0] = get_free_handle_num(curr->pi)) < 0)
-      goto no_fds;
+   if ((ret = fds[0] = get_free_handle_num(curr->pi)) < 0)
+      goto err_end;
 
    if (!(read_h = pipe_create_read_handle(p)))
       goto fault;
 
-   curr->pi->handles[fds[0]] = read_h;
+   fd_table_set(curr->pi, fds[0], read_h);
 
-   if ((fds[1] = get_free_handle_num(curr->pi)) < 0)
-      goto no_fds;
+   if ((ret = fds[1] = get_free_handle_num(curr->pi)) < 0)
+      goto err_end;
 
    if (!(write_h = pipe_create_write_handle(p)))
       goto fault;
 
-   curr->pi->handles[fds[1]] = write_h;
+   fd_table_set(curr->pi, fds[1], write_h);
+   ret = 0;
 
    if (copy_to_user(u_pipefd, fds, sizeof(fds)))
       goto fault;
@@ -1020,12 +1168,12 @@ end:
 err_end:
 
    if (read_h) {
-      curr->pi->handles[fds[0]] = NULL;
+      fd_table_set(curr->pi, fds[0], NULL);
       kfs_destroy_handle((void *)read_h);
    }
 
    if (write_h) {
-      curr->pi->handles[fds[1]] = NULL;
+      fd_table_set(curr->pi, fds[1], NULL);
       kfs_destroy_handle((void *)write_h);
    }
 
@@ -1042,8 +1190,4 @@ fault:
 no_mem:
    ret = -ENOMEM;
    goto err_end;
-
-no_fds:
-   ret = -EMFILE;
-   goto err_end;
 }
@@ -1,52 +1,243 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
-static struct ramfs_block *ramfs_new_block(offt page)
+/* Number of pages needed to store `len` bytes */
+static ALWAYS_INLINE ulong
+ramfs_pages_count(offt len)
 {
-   struct ramfs_block *b;
+   return (ulong)((len + (offt)PAGE_SIZE - 1) >> PAGE_SHIFT);
+}
+
+/* Returns true if a block map of the given height can contain page `idx` */
+static ALWAYS_INLINE bool
+ramfs_bmap_covers(u32 height, ulong idx)
+{
+   const u32 bits = height * RAMFS_BMAP_SHIFT;
+   return height && (bits >= NBITS || idx < (1ul << bits));
+}
+
+static ALWAYS_INLINE ulong
+ramfs_bmap_slot(u32 height, ulong idx)
+{
+   return (idx >> ((height - 1) * RAMFS_BMAP_SHIFT)) & RAMFS_BMAP_MASK;
+}
+
+/* Returns the leaf node containing the page `idx`, or NULL */
+static struct ramfs_bmap_node *
+ramfs_bmap_get_leaf(struct ramfs_bmap *bm, ulong idx)
+{
+   struct ramfs_bmap_node *n = bm->root;
 
-   /* Allocate memory for the block object */
-   if (!(b = kalloc_obj(struct ramfs_block)))
+   if (!ramfs_bmap_covers(bm->height, idx))
       return NULL;
 
-   /* Allocate block's data */
-   if (!(b->vaddr = kzmalloc(PAGE_SIZE))) {
-      kfree_obj(b, struct ramfs_block);
+   for (u32 h = bm->height; n && h > 1; h--)
+      n = n->slots[ramfs_bmap_slot(h, idx)];
+
+   return n;
+}
+
+/* Like ramfs_bmap_get_leaf(), but grows the tree when necessary */
+static struct ramfs_bmap_node *
+ramfs_bmap_get_leaf_alloc(struct ramfs_bmap *bm, ulong idx)
+{
+   struct ramfs_bmap_node *n = NULL;
+   void **pp = (void **)&bm->root;
+
+   while (!ramfs_bmap_covers(bm->height, idx)) {
+
+      if (bm->root) {
+
+         if (!(n = kzalloc_obj(struct ramfs_bmap_node)))
+            return NULL;
+
+         n->slots[0] = bm->root;
+         bm->root = n;
+      }
+
+      bm->height++;
+   }
+
+   for (u32 h = bm->height; h > 0; h--) {
+
+      if (!*pp) {
+         if (!(*pp = kzalloc_obj(struct ramfs_bmap_node)))
+            return NULL;
+      }
+
+      n = *pp;
+
+      if (h > 1)
+         pp = &n->slots[ramfs_bmap_slot(h, idx)];
+   }
+
+   return n;
+}
+
+/*
+ * Look up the page `idx` of the file. Returns its vaddr or NULL in case of a
+ * hole. In `run`, it returns how many pages, starting from `idx`, (up to `max`)
+ * are contiguous in memory or, in case of a hole, are all holes. The run never
+ * crosses the boundary of a leaf node.
+ */
+static char *
+ramfs_bmap_lookup(struct ramfs_inode *i, ulong idx, ulong max, ulong *run)
+{
+   struct ramfs_bmap_node *leaf = ramfs_bmap_get_leaf(&i->bmap, idx);
+   const ulong s = idx & RAMFS_BMAP_MASK;
+   const ulong lim = MIN(max, RAMFS_BMAP_SLOTS - s);
+   ulong n = 1;
+   char *va;
+
+   ASSERT(max > 0);
+
+   if (!leaf) {
+      *run = lim;
       return NULL;
    }
 
-   /* Retain the pageframe used by this block */
-   retain_pageframes_mapped_at(get_kernel_pdir(), b->vaddr, PAGE_SIZE);
+   va = leaf->slots[s];
+
+   if (va) {
+
+      while (n < lim && leaf->slots[s + n] == va + (n << PAGE_SHIFT))
+         n++;
+
+   } else {
+
+      while (n < lim && !leaf->slots[s + n])
+         n++;
+   }
+
+   *run = n;
+   return va;
+}
+
+/*
+ * Allocate a physically contiguous extent for the hole starting at the page
+ * `idx`. The extent will be at most `max` pages long (and never longer than
+ * RAMFS_MAX_EXTENT_PAGES): smaller extents are tried when the kernel heap is
+ * too fragmented. Returns the number of pages allocated (0 in case of OOM).
+ *
+ * NOTE: the memory is NOT zeroed.
+ */
+static ulong
+ramfs_alloc_extent(struct ramfs_inode *i, ulong idx, ulong max, char **vaddr)
+{
+   const ulong s = idx & RAMFS_BMAP_MASK;
+   struct ramfs_bmap_node *leaf;
+   size_t size = 0;
+   char *va = NULL;
+   ulong n = 1;
+
+   max = MIN3(max, RAMFS_BMAP_SLOTS - s, (ulong)RAMFS_MAX_EXTENT_PAGES);
+
+   if (!(leaf = ramfs_bmap_get_leaf_alloc(&i->bmap, idx)))
+      return 0;
+
+   ASSERT(!leaf->slots[s]);
+
+   while (n < max && !leaf->slots[s + n])
+      n++;
+
+   for (; n > 0; n /= 2) {
+
+      size = n << PAGE_SHIFT;
+      va = general_kmalloc(&size, KMALLOC_FL_MULTI_STEP | PAGE_SIZE);
+
+      if (va)
+         break;
+   }
+
+   if (!va)
+      return 0;
+
+   ASSERT(size == n << PAGE_SHIFT);
+
+   /* Retain the pageframes used by this extent */
+   retain_pageframes_mapped_at(get_kernel_pdir(), va, size);
+
+   for (ulong k = 0; k < n; k++)
+      leaf->slots[s + k] = va + (k << PAGE_SHIFT);
 
-   /* Init the block object */
-   bintree_node_init(&b->node);
-   b->offset = page;
-   return b;
+   i->blocks_count += n;
+   *vaddr = va;
+   return n;
 }
 
-static void ramfs_destroy_block(struct ramfs_block *b)
+static void ramfs_free_page(void *va)
 {
-   /* Release the pageframe used by this block */
-   release_pageframes_mapped_at(get_kernel_pdir(), b->vaddr, PAGE_SIZE);
+   size_t size = PAGE_SIZE;
 
-   /* Free the memory pointed by this block */
-   kfree2(b->vaddr, PAGE_SIZE);
+   /* Release the pageframe used by this page */
+   release_pageframes_mapped_at(get_kernel_pdir(), va, PAGE_SIZE);
 
-   /* Free the memory used by the block object itself */
-   kfree_obj(b, struct ramfs_block);
+   /*
+    * Free the page alone, splitting the extent it belongs to. Pages are freed
+    * one by one because a run of pages contiguous in memory might come from
+    * different allocations.
+    */
+   general_kfree(va, &size, KFREE_FL_ALLOW_SPLIT | KFREE_FL_MULTI_STEP);
 }
 
-static void
-ramfs_append_new_block(struct ramfs_inode *inode, struct ramfs_block *block)
+/*
+ * Free the pages >= `first` in the sub-tree `n` of height `h`, where `first`
+ * is relative to the first page covered by `n`. Returns true if `n` became
+ * empty.
+ */
+static bool
+ramfs_bmap_trunc_node(struct ramfs_inode *i,
+                      struct ramfs_bmap_node *n,
+                      u32 h,
+                      ulong first)
 {
-   DEBUG_ONLY_UNSAFE(bool success =)
-      bintree_insert_ptr(&inode->blocks_tree_root,
-                         block,
-                         struct ramfs_block,
-                         node,
-                         offset);
+   const u32 shift = (h - 1) * RAMFS_BMAP_SHIFT;
+   const ulong s = first >> shift;
+   struct ramfs_bmap_node *child;
 
-   ASSERT(success);
-   inode->blocks_count++;
+   for (ulong k = s; k < RAMFS_BMAP_SLOTS; k++) {
+
+      if (!n->slots[k])
+         continue;
+
+      if (h == 1) {
+
+         ramfs_free_page(n->slots[k]);
+         i->blocks_count--;
+
+      } else {
+
+         const ulong sub = k == s ? first & ((1ul << shift) - 1) : 0;
+         child = n->slots[k];
+
+         if (!ramfs_bmap_trunc_node(i, child, h - 1, sub))
+            continue;
+
+         kfree_obj(child, struct ramfs_bmap_node);
+      }
+
+      n->slots[k] = NULL;
+   }
+
+   for (ulong k = 0; k < RAMFS_BMAP_SLOTS; k++)
+      if (n->slots[k])
+         return false;
+
+   return true;
+}
+
+/* Free all the pages of the file >= `first`, along with the empty nodes */
+static void ramfs_bmap_truncate(struct ramfs_inode *i, ulong first)
+{
+   struct ramfs_bmap *bm = &i->bmap;
+
+   if (!bm->root || !ramfs_bmap_covers(bm->height, first))
+      return;
+
+   if (ramfs_bmap_trunc_node(i, bm->root, bm->height, first)) {
+      kfree_obj(bm->root, struct ramfs_bmap_node);
+      bm->root = NULL;
+      bm->height = 0;
+   }
 }
 
 static int ramfs_inode_extend(struct ramfs_inode *i, offt new_len)
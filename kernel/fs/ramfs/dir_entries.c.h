@@ -1,17 +1,40 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
-static long ramfs_insert_remove_entry_cmp(const void *a, const void *b)
+/*
+ * The link count of an inode can be changed concurrently by operations on
+ * different directories (e.g. link() in a dir and unlink() in another one),
+ * holding different locks: therefore, it has to be updated atomically.
+ */
+static ALWAYS_INLINE void ramfs_nlink_inc(struct ramfs_inode *i)
 {
-   const struct ramfs_entry *e1 = a;
-   const struct ramfs_entry *e2 = b;
-   return strcmp(e1->name, e2->name);
+   ATOMIC(nlink_t) *atomic = (ATOMIC(nlink_t) *)&i->nlink;
+   atomic_fetch_add_explicit(atomic, 1, mo_relaxed);
 }
 
-static long ramfs_find_entry_cmp(const void *obj, const void *valptr)
+/* Take a link only if the inode has still at least one: see link() */
+static ALWAYS_INLINE bool ramfs_nlink_inc_not_zero(struct ramfs_inode *i)
 {
-   const struct ramfs_entry *e = obj;
-   const char *searched_str = valptr;
-   return strcmp(e->name, searched_str);
+   ATOMIC(nlink_t) *atomic = (ATOMIC(nlink_t) *)&i->nlink;
+   nlink_t old = atomic_load_explicit(atomic, mo_relaxed);
+
+   do {
+
+      if (!old)
+         return false;
+
+   } while (!atomic_cas_weak(atomic, &old, old + 1, mo_relaxed, mo_relaxed));
+
+   return true;
+}
+
+/* Returns the new link count */
+static ALWAYS_INLINE nlink_t ramfs_nlink_dec(struct ramfs_inode *i)
+{
+   ATOMIC(nlink_t) *atomic = (ATOMIC(nlink_t) *)&i->nlink;
+   nlink_t old = atomic_fetch_sub_explicit(atomic, 1, mo_relaxed);
+
+   ASSERT(old > 0);
+   return old - 1;
 }
 
 static int
@@ -34,7 +57,6 @@ ramfs_dir_add_entry(struct ramfs_inode *idir,
 
    ASSERT(ie->parent_dir != NULL);
 
-   bintree_node_init(&e->node);
    list_node_init(&e->lnode);
 
    e->inode = ie;
@@ -47,24 +69,30 @@ ramfs_dir_add_entry(struct ramfs_inode *idir,
 
    e->name_len = (u8) enl;
 
-   bintree_insert(&idir->entries_tree_root,
-                  e,
-                  ramfs_insert_remove_entry_cmp,
-                  struct ramfs_entry,
-                  node);
+   if (dir_index_insert(&idir->index, &e->node)) {
+      kfree_obj(e, struct ramfs_entry);
+      return -ENOSPC;
+   }
 
+   /* New entries get the highest cookie: the list stays ordered by cookie */
    list_add_tail(&idir->entries_list, &e->lnode);
 
-   ie->nlink++;
+   ramfs_nlink_inc(ie);
    idir->num_entries++;
    return 0;
 }
 
-static void
+/*
+ * Remove the entry `e` from `idir`. Returns true if that was the last link to
+ * the inode pointed by the entry: in that case, the caller is expected to
+ * call ramfs_add_zombie() on it, unless the inode was never reachable.
+ */
+static bool
 ramfs_dir_remove_entry(struct ramfs_inode *idir, struct ramfs_entry *e)
 {
    struct ramfs_handle *pos;
    struct ramfs_inode *ie = e->inode;
+   nlink_t nlink;
    ASSERT(idir->type == VFS_DIR);
 
    /*
@@ -79,18 +107,13 @@ ramfs_dir_remove_entry(struct ramfs_inode *idir, struct ramfs_entry *e)
          pos->dpos = list_next_obj(pos->dpos, lnode);
    }
 
-   bintree_remove(&idir->entries_tree_root,
-                  e,
-                  ramfs_insert_remove_entry_cmp,
-                  struct ramfs_entry,
-                  node);
-
+   dir_index_remove(&idir->index, &e->node);
    list_remove(&e->lnode);
 
-   ASSERT(ie->nlink > 0);
-   ie->nlink--;
+   nlink = ramfs_nlink_dec(ie);
    idir->num_entries--;
    kfree_obj(e, struct ramfs_entry);
+   return nlink == 0;
 }
 
 static struct ramfs_entry *
@@ -98,13 +121,68 @@ ramfs_dir_get_entry_by_name(struct ramfs_inode *idir,
                             const char *name,
                             ssize_t len)
 {
-   char buf[RAMFS_ENTRY_MAX_LEN];
-   memcpy(buf, name, (size_t) len);
-   buf[len] = 0;
-
-   return bintree_find(idir->entries_tree_root,
-                       buf,
-                       ramfs_find_entry_cmp,
-                       struct ramfs_entry,
-                       node);
+   return dir_index_find_obj(&idir->index,
+                             name,
+                             (size_t) len,
+                             struct ramfs_entry,
+                             node);
+}
+
+/*
+ * Return the first entry of `idir` having a cookie >= `cookie`, or the list
+ * head (end of the directory) if there's no such entry. Used to resume
+ * reading a directory from an offset (d_off) returned by getdents().
+ */
+static struct ramfs_entry *
+ramfs_dir_get_entry_by_cookie(struct ramfs_inode *idir, u32 cookie)
+{
+   struct ramfs_entry *e;
+
+   /*
+    * Typical case: `cookie - 1` is the cookie of the last entry returned by
+    * getdents() and that entry still exists: just return the next one.
+    */
+   if (cookie > 0) {
+
+      e = dir_index_find_cookie_obj(&idir->index,
+                                    cookie - 1,
+                                    struct ramfs_entry,
+                                    node);
+      if (e)
+         return list_next_obj(e, lnode);
+   }
+
+   e = dir_index_find_cookie_obj(&idir->index,
+                                 cookie,
+                                 struct ramfs_entry,
+                                 node);
+   if (e)
+      return e;
+
+   /* Slow path: the entries around the cookie have been removed */
+   list_for_each_ro(e, &idir->entries_list, lnode) {
+      if (e->node.cookie >= cookie)
+         break;
+   }
+
+   return e;
+}
+
+/*
+ * Look up the last component of a path (which might have trailing slashes)
+ * in `idir`. Used by the functions changing the namespace to check again the
+ * result of the path resolution after having locked `idir`.
+ */
+static struct ramfs_entry *
+ramfs_dir_lookup_last_comp(struct ramfs_inode *idir, const char *name)
+{
+   size_t len = 0;
+
+   while (name[len] && name[len] != '/')
+      len++;
+
+   if (!len || len >= RAMFS_ENTRY_MAX_LEN)
+      return NULL;
+
+   return ramfs_dir_get_entry_by_name(idir, name, (ssize_t)len);
 }
@@ -12,18 +12,22 @@ static int ramfs_getdents(fs_handle h, get_dents_func_cb cb, void *arg)
    if ((inode->mode & 0400) != 0400) /* read permission */
       return -EACCES;
 
-   list_for_each_ro_kp(rh->dpos, &inode->entries_list, lnode) {
+   rwlock_wp_shlock(&inode->rwlock);
+   {
+      list_for_each_ro_kp(rh->dpos, &inode->entries_list, lnode) {
 
-      struct vfs_dent64 dent = {
-         .ino        = rh->dpos->inode->ino,
-         .type       = rh->dpos->inode->type,
-         .name_len   = rh->dpos->name_len,
-         .name       = rh->dpos->name,
-      };
+         struct vfs_dent64 dent = {
+            .ino        = rh->dpos->inode->ino,
+            .type       = rh->dpos->inode->type,
+            .name_len   = rh->dpos->name_len,
+            .name       = rh->dpos->name,
+            .next_off   = (offt)rh->dpos->node.cookie + 1,
+         };
 
-      if ((rc = cb(&dent, arg)))
-         break;
+         if ((rc = cb(&dent, arg)))
+            break;
+      }
    }
-
+   rwlock_wp_shunlock(&inode->rwlock);
    return rc;
 }
@@ -11,9 +11,15 @@ static struct ramfs_inode *ramfs_new_inode(struct ramfs_data *d)
 
    rwlock_wp_init(&i->rwlock, true);
    list_init(&i->mappings_list);
+   list_node_init(&i->zombie_node);
 
    i->type = VFS_NONE;
-   i->ino = d->next_inode_num++;
+
+   disable_preemption();
+   {
+      i->ino = d->next_inode_num++;
+   }
+   enable_preemption();
 
    if (DEBUG_RAMFS_CREATE_INODE_PRINTK) {
       printk("ramfs: Create inode with ref_count at %p\n", &i->ref_count);
@@ -34,6 +40,7 @@ ramfs_create_inode_dir(struct ramfs_data *d,
 
    i->type = VFS_DIR;
    i->mode = (mode & 0777) | S_IFDIR;
+   dir_index_init_for(&i->index, struct ramfs_entry, node, name);
    list_init(&i->entries_list);
    list_init(&i->handles_list);
 
@@ -45,15 +52,18 @@ ramfs_create_inode_dir(struct ramfs_data *d,
    i->parent_dir = parent;
 
    if (ramfs_dir_add_entry(i, ".", i) < 0) {
+      dir_index_destroy(&i->index);
       kfree_obj(i, struct ramfs_inode);
       return NULL;
    }
 
    if (ramfs_dir_add_entry(i, "..", parent) < 0) {
 
-      struct ramfs_entry *e = i->entries_tree_root;
-      ramfs_dir_remove_entry(i, e);
+      struct ramfs_entry *e =
+         list_first_obj(&i->entries_list, struct ramfs_entry, lnode);
 
+      ramfs_dir_remove_entry(i, e);
+      dir_index_destroy(&i->index);
       kfree_obj(i, struct ramfs_inode);
       return NULL;
    }
@@ -99,11 +109,13 @@ static int ramfs_destroy_inode(struct ramfs_data *d, struct ramfs_inode *i)
          break;
 
       case VFS_FILE:
-         ASSERT(i->blocks_tree_root == NULL);
+         ASSERT(i->blocks_count == 0);
+         ramfs_bmap_truncate(i, 0); /* free the empty nodes, if any */
          break;
 
       case VFS_DIR:
-         ASSERT(i->entries_tree_root == NULL);
+         ASSERT(i->num_entries == 0);
+         dir_index_destroy(&i->index);
          break;
 
       case VFS_SYMLINK:
@@ -119,6 +131,48 @@ static int ramfs_destroy_inode(struct ramfs_data *d, struct ramfs_inode *i)
    return 0;
 }
 
+/*
+ * Drop the `.` and `..` entries of an empty directory, which is expected to be
+ * locked by the caller, unless it's not reachable.
+ */
+static void ramfs_dir_drop_dot_entries(struct ramfs_inode *i)
+{
+   ASSERT(i->num_entries == 2);
+
+   for (int k = 0; k < 2; k++) {
+
+      struct ramfs_entry *e =
+         list_first_obj(&i->entries_list, struct ramfs_entry, lnode);
+
+      ramfs_dir_remove_entry(i, e);   // drop . or ..
+   }
+
+   ASSERT(i->num_entries == 0);
+   ASSERT(list_is_empty(&i->entries_list));
+}
+
+/*
+ * Add an inode with no more links to the list of the zombies. It's safe to
+ * call this function more than once for the same inode.
+ *
+ * Zombie inodes cannot be destroyed right away because, while holding the
+ * shared fs-lock, other tasks might have got a pointer to them by resolving a
+ * path just before the last link was removed. They'll be destroyed by
+ * ramfs_reap_zombies(), unless still in use: in that case, they'll be added
+ * back to the list by ramfs_release_inode() when their ref-count drops to 0.
+ */
+static void ramfs_add_zombie(struct ramfs_data *d, struct ramfs_inode *i)
+{
+   disable_preemption();
+   {
+      if (list_node_is_empty(&i->zombie_node)) {
+         list_add_tail(&d->zombies, &i->zombie_node);
+         d->zombies_count++;
+      }
+   }
+   enable_preemption();
+}
+
 static struct ramfs_inode *
 ramfs_create_inode_symlink(struct ramfs_data *d,
                            struct ramfs_inode *parent,
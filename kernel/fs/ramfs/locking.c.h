@@ -1,5 +1,46 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
+/*
+ * Locking in ramfs
+ * -------------------
+ *
+ * ramfs sets VFS_FS_DIRLOCKS: the VFS always calls it holding just a *shared*
+ * fs-lock (ramfs_data.rwlock), also for the operations changing the namespace.
+ * Those are serialized using the rwlock of the parent directory inode(s),
+ * while lookups take a shared lock on one directory at a time. The order in
+ * which the locks have to be acquired is:
+ *
+ *    1. The fs-lock (shared, as explained above)
+ *
+ *    2. The `rename_lock` mutex, only for rename() and link() operations
+ *       involving two different directories
+ *
+ *    3. The parent directories: if one of them is an ancestor of the other,
+ *       it's locked first; otherwise, the one with the lowest inode number
+ *       is locked first. See ramfs_lock_dirs().
+ *
+ *    4. The inodes of the entries being changed: the dir removed by rmdir(),
+ *       the dir moved by rename(), the file being truncated etc.
+ *
+ * Because the path is resolved before the directory locks are acquired, the
+ * inode pointers in a struct vfs_path might refer to entries removed in the
+ * meanwhile. Therefore:
+ *
+ *    - every function changing the namespace looks up again the last component
+ *      of the path, after having locked the parent directory. The only
+ *      exception is the old path of link(): see ramfs_link_locked()
+ *
+ *    - inodes with no links are never destroyed right away: they're added to
+ *      the `zombies` list and destroyed later by ramfs_reap_zombies(), while
+ *      holding the fs-lock in exclusive mode. At that point, no other task
+ *      can be holding a pointer to them, except through a retained reference.
+ *
+ * Besides the reaping of zombies, the exclusive fs-lock is left only for the
+ * operations on the whole file system.
+ */
+
+static void ramfs_reap_zombies(struct mnt_fs *fs); /* see ramfs.c */
+
 static void ramfs_file_exlock(fs_handle h)
 {
    struct ramfs_handle *rh = h;
@@ -46,5 +87,89 @@ static void ramfs_shlock(struct mnt_fs *fs)
 static void ramfs_shunlock(struct mnt_fs *fs)
 {
    struct ramfs_data *d = fs->device_data;
+   bool reap;
+
+   disable_preemption();
+   {
+      /*
+       * Destroy the zombies only when the last task using the fs is leaving
+       * it: that way, grabbing the exclusive lock won't (typically) wait for
+       * anybody and, above all, we can be sure that we're not going to wait
+       * on a task that's waiting for a fs-lock held by us, on another fs.
+       */
+      reap = d->zombies_count > 0 && d->rwlock.r == 1;
+   }
+   enable_preemption();
+
    rwlock_wp_shunlock(&d->rwlock);
+
+   if (reap)
+      ramfs_reap_zombies(fs);
+}
+
+/* Returns true if `a` is an ancestor of the directory `i` */
+static bool
+ramfs_dir_is_ancestor(struct ramfs_inode *a, struct ramfs_inode *i)
+{
+   /* NOTE: the root dir is the parent of itself, like removed dirs */
+   while (i->parent_dir != i) {
+
+      i = i->parent_dir;
+
+      if (i == a)
+         return true;
+   }
+
+   return false;
+}
+
+/*
+ * Lock the parent directories of a rename() or link() operation. When they're
+ * different, `rename_lock` is acquired first: that guarantees that the result
+ * of ramfs_dir_is_ancestor() will stay valid, as only cross-directory renames
+ * can change the `parent_dir` of an inode and that no other task can follow
+ * the "lowest inode number first" rule at the same time, in a way that could
+ * conflict with the ancestor rule.
+ */
+static void
+ramfs_lock_dirs(struct ramfs_data *d,
+                struct ramfs_inode *d1,
+                struct ramfs_inode *d2)
+{
+   bool d1_first;
+
+   if (d1 == d2) {
+      rwlock_wp_exlock(&d1->rwlock);
+      return;
+   }
+
+   kmutex_lock(&d->rename_lock);
+
+   if (ramfs_dir_is_ancestor(d1, d2))
+      d1_first = true;
+   else if (ramfs_dir_is_ancestor(d2, d1))
+      d1_first = false;
+   else
+      d1_first = d1->ino < d2->ino;
+
+   if (d1_first) {
+      rwlock_wp_exlock(&d1->rwlock);
+      rwlock_wp_exlock(&d2->rwlock);
+   } else {
+      rwlock_wp_exlock(&d2->rwlock);
+      rwlock_wp_exlock(&d1->rwlock);
+   }
+}
+
+static void
+ramfs_unlock_dirs(struct ramfs_data *d,
+                  struct ramfs_inode *d1,
+                  struct ramfs_inode *d2)
+{
+   rwlock_wp_exunlock(&d1->rwlock);
+
+   if (d1 != d2) {
+      rwlock_wp_exunlock(&d2->rwlock);
+      kmutex_unlock(&d->rename_lock);
+   }
 }
@@ -1,22 +1,29 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
-static int ramfs_mkdir(struct vfs_path *p, mode_t mode)
+static int
+ramfs_mkdir_locked(struct vfs_path *p, mode_t mode)
 {
-   struct ramfs_path *rp = (struct ramfs_path *) &p->fs_path;
    struct ramfs_data *d = p->fs->device_data;
+   struct ramfs_inode *idir = p->fs_path.dir_inode;
    struct ramfs_inode *new_dir;
    int rc;
 
-   if (rp->inode)
+   ASSERT(rwlock_wp_holding_exlock(&idir->rwlock));
+
+   if (!idir->nlink)
+      return -ENOENT; /* the parent dir has been removed in the meanwhile */
+
+   if (ramfs_dir_lookup_last_comp(idir, p->last_comp))
       return -EEXIST;
 
-   if ((rp->dir_inode->mode & 0300) != 0300) /* write + execute */
+   if ((idir->mode & 0300) != 0300) /* write + execute */
       return -EACCES;
 
-   if (!(new_dir = ramfs_create_inode_dir(d, mode, rp->dir_inode)))
+   if (!(new_dir = ramfs_create_inode_dir(d, mode, idir)))
       return -ENOSPC;
 
-   if ((rc = ramfs_dir_add_entry(rp->dir_inode, p->last_comp, new_dir))) {
+   if ((rc = ramfs_dir_add_entry(idir, p->last_comp, new_dir))) {
+      ramfs_dir_drop_dot_entries(new_dir);
       ramfs_destroy_inode(d, new_dir);
       return rc;
    }
@@ -24,53 +31,103 @@ static int ramfs_mkdir(struct vfs_path *p, mode_t mode)
    return rc;
 }
 
-static int ramfs_rmdir(struct vfs_path *p)
+static int ramfs_mkdir(struct vfs_path *p, mode_t mode)
 {
-   struct ramfs_path *rp = (struct ramfs_path *) &p->fs_path;
-   struct ramfs_data *d = p->fs->device_data;
-   struct ramfs_inode *i = rp->inode;
+   struct ramfs_inode *idir = p->fs_path.dir_inode;
+   int rc;
+
+   if (p->fs_path.inode)
+      return -EEXIST;
 
-   ASSERT(rwlock_wp_holding_exlock(&d->rwlock));
+   rwlock_wp_exlock(&idir->rwlock);
+   {
+      rc = ramfs_mkdir_locked(p, mode);
+   }
+   rwlock_wp_exunlock(&idir->rwlock);
+   return rc;
+}
 
-   if (rp->type != VFS_DIR)
+/*
+ * Remove the directory pointed by the entry `e` from `idir`, which must be
+ * locked by the caller. Used by rmdir() and rename().
+ */
+static int
+ramfs_rmdir_entry(struct ramfs_data *d,
+                  struct ramfs_inode *idir,
+                  struct ramfs_entry *e)
+{
+   struct ramfs_inode *i = e->inode;
+   int rc = 0;
+
+   ASSERT(rwlock_wp_holding_exlock(&idir->rwlock));
+
+   if (i->type != VFS_DIR)
       return -ENOTDIR;
 
-   if ((rp->dir_inode->mode & 0200) != 0200) /* write permission */
+   if ((idir->mode & 0200) != 0200) /* write permission */
       return -EACCES;
 
-   if (!rp->dir_entry)
-      return -EINVAL; /* root dir case */
+   rwlock_wp_exlock(&i->rwlock);
+   {
+      if (i->num_entries > 2) {
 
-   if (p->last_comp[0] == '.' && !p->last_comp[1])
-      return -EINVAL; /* trying to delete /a/b/c/. */
+         rc = -ENOTEMPTY; /* empty dirs have two entries: '.' and '..' */
+
+      } else if (get_ref_count(i) > 0) {
+
+         /*
+          * For the moment, we won't support deleting a directory opened
+          * somewhere as this is allowed by POSIX. Linux typically allowed
+          * that, both for files and for directories. On Tilck let's try to
+          * keep that allowed only for files. TODO: consider supporting removal
+          * of in-use directories.
+          */
+         rc = -EBUSY;
+
+      } else {
 
-   if (i->num_entries > 2)
-      return -ENOTEMPTY; /* empty dirs have two entries: '.' and '..' */
+         /*
+          * Drop the '.' and '..' entries and the entry in the parent dir while
+          * holding the lock on `i`, so that nobody can add entries to it in
+          * the meanwhile: after this point, i->nlink is 0.
+          */
+         ramfs_dir_drop_dot_entries(i);
 
-   if (get_ref_count(i) > 0) {
+         if (ramfs_dir_remove_entry(idir, e))
+            ramfs_add_zombie(d, i);
 
-      /*
-       * For the moment, we won't support deleting a directory opened somewhere
-       * as this is allowed by POSIX. Linux typically allowed that, both for
-       * files and for directories. On Tilck let's try to keep that allowed only
-       * for files. TODO: consider supporting removal of in-use directories.
-       */
-      return -EBUSY;
+         /* See ramfs_dir_is_ancestor() */
+         i->parent_dir = i;
+      }
    }
+   rwlock_wp_exunlock(&i->rwlock);
+   return rc;
+}
 
-   ASSERT(i->entries_tree_root != NULL);
-   ramfs_dir_remove_entry(i, i->entries_tree_root);   // drop .
+static int ramfs_rmdir(struct vfs_path *p)
+{
+   struct ramfs_path *rp = (struct ramfs_path *) &p->fs_path;
+   struct ramfs_data *d = p->fs->device_data;
+   struct ramfs_inode *idir = rp->dir_inode;
+   struct ramfs_entry *e;
+   int rc;
 
-   ASSERT(i->entries_tree_root != NULL);
-   ramfs_dir_remove_entry(i, i->entries_tree_root);   // drop ..
+   if (rp->type != VFS_DIR)
+      return -ENOTDIR;
 
-   ASSERT(i->num_entries == 0);
-   ASSERT(i->entries_tree_root == NULL);
+   if (!rp->dir_entry)
+      return -EINVAL; /* root dir case */
 
-   /* Remove the dir entry */
-   ramfs_dir_remove_entry(rp->dir_inode, rp->dir_entry);
+   if (p->last_comp[0] == '.' && !p->last_comp[1])
+      return -EINVAL; /* trying to delete /a/b/c/. */
 
-   /* Destroy the inode */
-   ramfs_destroy_inode(d, i);
-   return 0;
+   rwlock_wp_exlock(&idir->rwlock);
+   {
+      if ((e = ramfs_dir_lookup_last_comp(idir, p->last_comp)))
+         rc = ramfs_rmdir_entry(d, idir, e);
+      else
+         rc = -ENOENT;
+   }
+   rwlock_wp_exunlock(&idir->rwlock);
+   return rc;
 }
@@ -11,9 +11,10 @@ ramfs_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
    struct ramfs_handle *rh = um->h;
    struct ramfs_inode *i = rh->inode;
    ulong vaddr = um->vaddr;
-   struct bintree_walk_ctx ctx;
-   struct ramfs_block *b;
    u32 pg_flags;
+   size_t off;
+   ulong run;
+   char *va;
    int rc;
 
    const size_t off_begin = um->off;
@@ -27,43 +28,29 @@ ramfs_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
    if (flags & VFS_MM_DONT_MMAP)
       goto register_mapping;
 
-   bintree_in_order_visit_start(&ctx,
-                                i->blocks_tree_root,
-                                struct ramfs_block,
-                                node,
-                                false);
-
    pg_flags = PAGING_FL_US | PAGING_FL_SHARED;
 
    if ((rh->fl_flags & O_RDWR) == O_RDWR)
       pg_flags |= PAGING_FL_RW;
 
-   while ((b = bintree_in_order_visit_next(&ctx))) {
+   for (off = off_begin; off < off_end; off += PAGE_SIZE, vaddr += PAGE_SIZE) {
 
-      if ((size_t)b->offset < off_begin)
-         continue; /* skip this block */
+      va = ramfs_bmap_lookup(i, off >> PAGE_SHIFT, 1, &run);
 
-      if ((size_t)b->offset >= off_end)
-         break;
+      if (!va)
+         continue; /* holes are handled by ramfs_handle_fault() */
 
-      rc = map_page(pdir,
-                    (void *)vaddr,
-                    KERNEL_VA_TO_PA(b->vaddr),
-                    pg_flags);
+      rc = map_page(pdir, (void *)vaddr, KERNEL_VA_TO_PA(va), pg_flags);
 
       if (rc) {
 
          /* mmap failed, we have to unmap the pages already mapped */
-         vaddr -= PAGE_SIZE;
-
-         for (; vaddr >= um->vaddr; vaddr -= PAGE_SIZE) {
+         for (vaddr -= PAGE_SIZE; vaddr >= um->vaddr; vaddr -= PAGE_SIZE) {
             unmap_page_permissive(pdir, (void *)vaddr, false);
          }
 
          return rc;
       }
-
-      vaddr += PAGE_SIZE;
    }
 
 register_mapping:
@@ -83,8 +70,8 @@ ramfs_handle_fault_int(struct process *pi,
 {
    struct ramfs_handle *rh = um->h;
    ulong vaddr = (ulong) vaddrp;
-   ulong abs_off;
-   struct ramfs_block *block;
+   ulong abs_off, run;
+   char *va;
    int rc;
 
    ASSERT(um != NULL);
@@ -107,21 +94,25 @@ ramfs_handle_fault_int(struct process *pi,
    if (abs_off >= (ulong)rh->inode->fsize)
       return false; /* Read/write past EOF */
 
-   if (rw) {
-      /* Create and map on-the-fly a struct ramfs_block */
-      if (!(block = ramfs_new_block((offt)(abs_off & PAGE_MASK))))
-         panic("Out-of-memory: unable to alloc a ramfs_block. No OOM killer");
+   /* The page might have been allocated by a fault in another process */
+   va = ramfs_bmap_lookup(rh->inode, abs_off >> PAGE_SHIFT, 1, &run);
+
+   if (!va && rw) {
+
+      /* Create and map on-the-fly a page for the hole */
+      if (!ramfs_alloc_extent(rh->inode, abs_off >> PAGE_SHIFT, 1, &va))
+         panic("Out-of-memory: unable to alloc a ramfs page. No OOM killer");
 
-      ramfs_append_new_block(rh->inode, block);
+      bzero(va, PAGE_SIZE);
    }
 
    rc = map_page(pi->pdir,
                  (void *)(vaddr & PAGE_MASK),
-                 KERNEL_VA_TO_PA(rw ? block->vaddr : &zero_page),
+                 KERNEL_VA_TO_PA(va ? va : zero_page),
                  PAGING_FL_US | PAGING_FL_RW | PAGING_FL_SHARED);
 
    if (rc)
-      panic("Out-of-memory: unable to map a ramfs_block. No OOM killer");
+      panic("Out-of-memory: unable to map a ramfs page. No OOM killer");
 
    invalidate_page(vaddr);
    return true;
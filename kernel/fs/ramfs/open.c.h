@@ -37,8 +37,14 @@ ramfs_open_int(struct mnt_fs *fs,
        * forward. This is a VERY CORNER CASE, but it *MUST BE* handled.
        */
       list_node_init(&h->node);
-      list_add_tail(&inode->handles_list, &h->node);
-      h->dpos = list_first_obj(&inode->entries_list, struct ramfs_entry, lnode);
+
+      rwlock_wp_exlock(&inode->rwlock);
+      {
+         list_add_tail(&inode->handles_list, &h->node);
+         h->dpos =
+            list_first_obj(&inode->entries_list, struct ramfs_entry, lnode);
+      }
+      rwlock_wp_exunlock(&inode->rwlock);
 
    } else {
 
@@ -86,11 +92,66 @@ static int ramfs_open_existing_checks(int fl, struct ramfs_inode *i)
    return 0;
 }
 
+/*
+ * Create the file pointed by `p`, with the parent dir locked. Because the path
+ * has been resolved before acquiring the lock, the entry might have been
+ * created in the meanwhile: in that case, just return it in `*out_i` and let
+ * the caller open it as an existing file.
+ */
+static int
+ramfs_open_creat(struct vfs_path *p,
+                 mode_t mod,
+                 struct ramfs_inode **out_i,
+                 struct locked_file **out_lf)
+{
+   struct ramfs_data *d = p->fs->device_data;
+   struct ramfs_inode *idir = p->fs_path.dir_inode;
+   struct ramfs_entry *re;
+   struct ramfs_inode *i;
+   int rc;
+
+   ASSERT(rwlock_wp_holding_exlock(&idir->rwlock));
+
+   if (!idir->nlink)
+      return -ENOENT; /* the parent dir has been removed in the meanwhile */
+
+   if ((re = ramfs_dir_lookup_last_comp(idir, p->last_comp))) {
+
+      if (re->inode->type == VFS_SYMLINK)
+         return -EEXIST; /* too late to follow it: pretend it wasn't there */
+
+      *out_i = re->inode;
+      return 0;
+   }
+
+   if ((idir->mode & 0300) != 0300) /* write + execute */
+      return -EACCES;
+
+   if (!(i = ramfs_create_inode_file(d, mod, idir)))
+      return -ENOSPC;
+
+   rc = acquire_subsys_flock(p->fs, i, SUBSYS_VFS, out_lf);
+
+   if (rc) {
+      ramfs_destroy_inode(d, i);
+      return rc;
+   }
+
+   if ((rc = ramfs_dir_add_entry(idir, p->last_comp, i))) {
+      release_subsys_flock(*out_lf);
+      *out_lf = NULL;
+      ramfs_destroy_inode(d, i);
+      return rc;
+   }
+
+   *out_i = i;
+   return 0;
+}
+
 static int
 ramfs_open(struct vfs_path *p, fs_handle *out, int fl, mode_t mod)
 {
    struct ramfs_path *rp = (struct ramfs_path *) &p->fs_path;
-   struct ramfs_data *d = p->fs->device_data;
    struct ramfs_inode *i = rp->inode;
    struct ramfs_inode *idir = rp->dir_inode;
    struct locked_file *lf = NULL;
@@ -101,25 +162,19 @@ ramfs_open(struct vfs_path *p, fs_handle *out, int fl, mode_t mod)
       if (!(fl & O_CREAT))
          return -ENOENT;
 
-      if ((idir->mode & 0300) != 0300) /* write + execute */
-         return -EACCES;
-
-      if (!(i = ramfs_create_inode_file(d, mod, idir)))
-         return -ENOSPC;
-
-      rc = acquire_subsys_flock(p->fs, i, SUBSYS_VFS, &lf);
-
-      if (rc) {
-         ramfs_destroy_inode(d, i);
-         return rc;
+      rwlock_wp_exlock(&idir->rwlock);
+      {
+         rc = ramfs_open_creat(p, mod, &i, &lf);
       }
+      rwlock_wp_exunlock(&idir->rwlock);
 
-      if ((rc = ramfs_dir_add_entry(idir, p->last_comp, i))) {
-         ramfs_destroy_inode(d, i);
+      if (rc)
          return rc;
-      }
+   }
 
-   } else {
+   if (!lf) {
+
+      /* Opening an existing file */
 
       if ((idir->mode & 0500) != 0500) /* read + execute */
          return -EACCES;
@@ -15,22 +15,26 @@
 #include "getdents.c.h"
 #include "locking.c.h"
 #include "dir_entries.c.h"
+#include "blocks.c.h"
 #include "inodes.c.h"
 #include "stat.c.h"
-#include "blocks.c.h"
 #include "mmap.c.h"
 #include "rw_ops.c.h"
 #include "open.c.h"
 #include "mkdir.c.h"
 
-static int ramfs_unlink(struct vfs_path *p)
+/*
+ * Remove the entry `e` of a non-directory inode from `idir`, which must be
+ * locked by the caller. Used by unlink() and rename().
+ */
+static int
+ramfs_unlink_entry(struct ramfs_data *d,
+                   struct ramfs_inode *idir,
+                   struct ramfs_entry *e)
 {
-   struct ramfs_path *rp = (struct ramfs_path *) &p->fs_path;
-   struct ramfs_data *d = p->fs->device_data;
-   struct ramfs_inode *i = rp->inode;
-   struct ramfs_inode *idir = rp->dir_inode;
+   struct ramfs_inode *i = e->inode;
 
-   ASSERT(rwlock_wp_holding_exlock(&d->rwlock));
+   ASSERT(rwlock_wp_holding_exlock(&idir->rwlock));
 
    if (i->type == VFS_DIR)
       return -EISDIR;
@@ -38,29 +42,92 @@ static int ramfs_unlink(struct vfs_path *p)
    if ((idir->mode & 0200) != 0200) /* write permission */
       return -EACCES;
 
+   /* Remove the dir entry: the inode will be destroyed later, if not used */
+   if (ramfs_dir_remove_entry(idir, e))
+      ramfs_add_zombie(d, i);
+
+   return 0;
+}
+
+static int ramfs_unlink(struct vfs_path *p)
+{
+   struct ramfs_path *rp = (struct ramfs_path *) &p->fs_path;
+   struct ramfs_data *d = p->fs->device_data;
+   struct ramfs_inode *idir = rp->dir_inode;
+   struct ramfs_entry *e;
+   int rc;
+
    /*
-    * The only case when `rp->e` is NULL is when path == "/", but we have just
-    * checked the directory case. Therefore, `rp->e` must be valid.
+    * The only case when `rp->dir_entry` is NULL is when path == "/".
     */
-   ASSERT(rp->dir_entry != NULL);
+   if (!rp->dir_entry)
+      return -EISDIR;
 
-   /* Remove the dir entry */
-   ramfs_dir_remove_entry(idir, rp->dir_entry);
+   rwlock_wp_exlock(&idir->rwlock);
+   {
+      if ((e = ramfs_dir_lookup_last_comp(idir, p->last_comp)))
+         rc = ramfs_unlink_entry(d, idir, e);
+      else
+         rc = -ENOENT;
+   }
+   rwlock_wp_exunlock(&idir->rwlock);
+   return rc;
+}
 
-   /* Trucate and delete the inode, if it's not used */
-   if (!i->nlink && !get_ref_count(i)) {
+/*
+ * Destroy all the zombie inodes (see ramfs_add_zombie()) not in use anymore.
+ * The ones still in use are just removed from the list: they'll be added back
+ * by ramfs_release_inode() when their ref-count drops to 0.
+ */
+static void ramfs_reap_zombies(struct mnt_fs *fs)
+{
+   struct ramfs_data *d = fs->device_data;
+   struct ramfs_inode *pos, *temp;
+   struct list dead;
+   bool dirs = false;
 
-      if (i->type == VFS_FILE) {
-         DEBUG_ONLY_UNSAFE(int rc =)
-            ramfs_inode_truncate_safe(i, 0, true /* no_perm_check */);
+   list_init(&dead);
+   ramfs_exlock(fs);
 
-         ASSERT(rc == 0);
+   disable_preemption();
+   {
+      list_for_each(pos, temp, &d->zombies, zombie_node) {
+
+         ASSERT(pos->nlink == 0);
+         list_remove(&pos->zombie_node);
+         list_node_init(&pos->zombie_node);
+         d->zombies_count--;
+
+         if (!get_ref_count(pos))
+            list_add_tail(&dead, &pos->zombie_node);
       }
+   }
+   enable_preemption();
 
-      ramfs_destroy_inode(d, i);
+   /*
+    * Nobody can get a new reference to the inodes in `dead` now: that would
+    * require a lookup, which in turn would require the fs-lock.
+    */
+   list_for_each(pos, temp, &dead, zombie_node) {
+
+      if (pos->type == VFS_DIR)
+         dirs = true;
+
+      if (pos->type == VFS_FILE)
+         ramfs_inode_truncate_safe(pos, 0, true /* no_perm_check */);
    }
 
-   return 0;
+   /* The dcache might have entries keyed by the dirs we're going to destroy */
+   if (dirs)
+      vfs_dcache_invalidate_fs(fs);
+
+   list_for_each(pos, temp, &dead, zombie_node) {
+      list_remove(&pos->zombie_node);
+      list_node_init(&pos->zombie_node);
+      ramfs_destroy_inode(d, pos);
+   }
+
+   ramfs_exunlock(fs);
 }
 
 static void ramfs_on_close(fs_handle h)
@@ -69,36 +136,32 @@ static void ramfs_on_close(fs_handle h)
    struct ramfs_inode *i = rh->inode;
 
    if (i->type == VFS_DIR) {
+
       /* Remove this handle from h->inode->handles_list */
-      list_remove(&rh->node);
+      rwlock_wp_exlock(&i->rwlock);
+      {
+         list_remove(&rh->node);
+      }
+      rwlock_wp_exunlock(&i->rwlock);
    }
 }
 
 static void ramfs_on_close_last_handle(fs_handle h)
 {
    struct ramfs_handle *rh = h;
-   struct ramfs_inode *i = rh->inode;
-
-   if (!i->nlink) {
-
-      /*
-       * !get_ref_count(i) => no handle referring to this inode
-       * !i->nlink         => no dir entry referring to this inode
-       *
-       * It means the last link (dir entry) pointing to this inode has been
-       * removed while the current task was keeping opened a handle to this
-       * inode. Now, nobody can get to this inode anymore. We have to destroy
-       * it.
-       */
+   struct ramfs_data *d = rh->fs->device_data;
 
-      if (i->type == VFS_FILE)
-         ramfs_inode_truncate_safe(i, 0, true);
+   /*
+    * NOTE: we cannot touch rh->inode here: if the last link to it has been
+    * removed while the current task was keeping a handle to it, it's already
+    * a zombie (see ramfs_release_inode()) and it might have been destroyed.
+    * Just destroy the zombies now, without waiting for a ramfs_shunlock().
+    */
 
-      ramfs_destroy_inode(rh->fs->device_data, i);
-   }
+   if (d->zombies_count > 0)
+      ramfs_reap_zombies(rh->fs);
 }
 
-
 /*
  * This function is supposed to be called ONLY by ramfs_create() in its error
  * path, as a clean-up. It is *not* a proper way to destroy a whole ramfs
@@ -114,6 +177,7 @@ static void ramfs_err_case_destroy(struct mnt_fs *fs)
          ramfs_destroy_inode(d, d->root);
       }
 
+      kmutex_destroy(&d->rename_lock);
       rwlock_wp_destroy(&d->rwlock);
       kfree_obj(d, struct ramfs_data);
    }
@@ -144,14 +208,18 @@ ramfs_get_entry(struct mnt_fs *fs,
       return;
    }
 
-   re = ramfs_dir_get_entry_by_name(idir, name, name_len);
+   rwlock_wp_shlock(&idir->rwlock);
+   {
+      re = ramfs_dir_get_entry_by_name(idir, name, name_len);
 
-   *fs_path = (struct fs_path) {
-      .inode      = re ? re->inode : NULL,
-      .dir_inode  = idir,
-      .dir_entry  = re,
-      .type       = re ? re->inode->type : VFS_NONE,
-   };
+      *fs_path = (struct fs_path) {
+         .inode      = re ? re->inode : NULL,
+         .dir_inode  = idir,
+         .dir_entry  = re,
+         .type       = re ? re->inode->type : VFS_NONE,
+      };
+   }
+   rwlock_wp_shunlock(&idir->rwlock);
 }
 
 static vfs_inode_ptr_t ramfs_getinode(fs_handle h)
@@ -159,17 +227,40 @@ static vfs_inode_ptr_t ramfs_getinode(fs_handle h)
    return ((struct ramfs_handle *)h)->inode;
 }
 
-static int ramfs_symlink(const char *target, struct vfs_path *lp)
+static int
+ramfs_symlink_locked(const char *target, struct vfs_path *lp)
 {
    struct ramfs_data *d = lp->fs->device_data;
+   struct ramfs_inode *idir = lp->fs_path.dir_inode;
    struct ramfs_inode *n;
+   int rc;
 
-   n = ramfs_create_inode_symlink(d, lp->fs_path.dir_inode, target);
+   if (!idir->nlink)
+      return -ENOENT; /* the parent dir has been removed in the meanwhile */
 
-   if (!n)
+   if (ramfs_dir_lookup_last_comp(idir, lp->last_comp))
+      return -EEXIST;
+
+   if (!(n = ramfs_create_inode_symlink(d, idir, target)))
       return -ENOSPC;
 
-   return ramfs_dir_add_entry(lp->fs_path.dir_inode, lp->last_comp, n);
+   if ((rc = ramfs_dir_add_entry(idir, lp->last_comp, n)))
+      ramfs_destroy_inode(d, n);
+
+   return rc;
+}
+
+static int ramfs_symlink(const char *target, struct vfs_path *lp)
+{
+   struct ramfs_inode *idir = lp->fs_path.dir_inode;
+   int rc;
+
+   rwlock_wp_exlock(&idir->rwlock);
+   {
+      rc = ramfs_symlink_locked(target, lp);
+   }
+   rwlock_wp_exunlock(&idir->rwlock);
+   return rc;
 }
 
 /* NOTE: `buf` is guaranteed to have room for at least MAX_PATH chars */
@@ -196,12 +287,28 @@ static int ramfs_retain_inode(struct mnt_fs *fs, vfs_inode_ptr_t inode)
 
 static int ramfs_release_inode(struct mnt_fs *fs, vfs_inode_ptr_t inode)
 {
+   struct ramfs_inode *i = inode;
+   int rc;
+
    ASSERT(inode != NULL);
 
    if (!(fs->flags & VFS_FS_RW))
       return 1;
 
-   return release_obj((struct ramfs_inode *)inode);
+   /*
+    * Disable the preemption in order to prevent ramfs_reap_zombies() from
+    * running between the release and ramfs_add_zombie(): it could destroy the
+    * inode, if it was already in the list.
+    */
+   disable_preemption();
+   {
+      rc = release_obj(i);
+
+      if (!rc && !i->nlink)
+         ramfs_add_zombie(fs->device_data, i);
+   }
+   enable_preemption();
+   return rc;
 }
 
 static int ramfs_chmod(struct mnt_fs *fs, vfs_inode_ptr_t inode, mode_t mode)
@@ -229,37 +336,92 @@ static int ramfs_chmod(struct mnt_fs *fs, vfs_inode_ptr_t inode, mode_t mode)
    return rc;
 }
 
+/*
+ * Make the `..` entry of the directory `i` point to `new_parent`. Called by
+ * rename() when moving a directory somewhere else.
+ */
+static void
+ramfs_dir_reparent(struct ramfs_inode *i, struct ramfs_inode *new_parent)
+{
+   struct ramfs_inode *old_parent = i->parent_dir;
+   struct ramfs_entry *e;
+
+   rwlock_wp_exlock(&i->rwlock);
+   {
+      e = ramfs_dir_get_entry_by_name(i, "..", 2);
+      ASSERT(e != NULL && e->inode == old_parent);
+
+      e->inode = new_parent;
+      ramfs_nlink_inc(new_parent);
+      ramfs_nlink_dec(old_parent);
+      i->parent_dir = new_parent;
+   }
+   rwlock_wp_exunlock(&i->rwlock);
+}
+
+static inline bool ramfs_is_dot_or_dotdot(struct ramfs_entry *e)
+{
+   return !strcmp(e->name, ".") || !strcmp(e->name, "..");
+}
+
 static int
-ramfs_rename(struct mnt_fs *fs, struct vfs_path *voldp, struct vfs_path *vnewp)
+ramfs_rename_locked(struct ramfs_data *d,
+                    struct vfs_path *voldp,
+                    struct vfs_path *vnewp,
+                    u32 flags)
 {
-   struct ramfs_path *oldp = (void *)&voldp->fs_path;
-   struct ramfs_path *newp = (void *)&vnewp->fs_path;
+   struct ramfs_inode *odir = voldp->fs_path.dir_inode;
+   struct ramfs_inode *ndir = vnewp->fs_path.dir_inode;
+   struct ramfs_entry *oe, *ne;
+   struct ramfs_inode *i;
    int rc;
 
-   DEBUG_ONLY_UNSAFE(struct ramfs_data *d = fs->device_data);
-   ASSERT(rwlock_wp_holding_exlock(&d->rwlock));
+   if (!(oe = ramfs_dir_lookup_last_comp(odir, voldp->last_comp)))
+      return -ENOENT;
 
-   if (newp->inode != NULL) {
+   if (!ndir->nlink)
+      return -ENOENT; /* the new parent dir has been removed */
 
-      if (newp->type == VFS_DIR) {
+   ne = ramfs_dir_lookup_last_comp(ndir, vnewp->last_comp);
+   i = oe->inode;
 
-         if (oldp->type != VFS_DIR)
-            return -EISDIR;
+   if (ramfs_is_dot_or_dotdot(oe) || (ne && ramfs_is_dot_or_dotdot(ne)))
+      return -EINVAL;
+
+   if (ne && ne->inode == i)
+      return 0; /* Both the paths refer to the same file: nothing to do */
+
+   if (ne && (flags & RENAME_NOREPLACE))
+      return -EEXIST;
+
+   if (i->type == VFS_DIR && odir != ndir) {
+
+      /* Cannot move a directory inside itself */
+      if (ndir == i || ramfs_dir_is_ancestor(i, ndir))
+         return -EINVAL;
+   }
+
+   if (ne) {
 
-         if (newp->inode->num_entries > 2)
-            return -ENOTEMPTY;
+      if (ne->inode->type == VFS_DIR) {
 
-         if ((rc = ramfs_rmdir(vnewp)))
+         if (i->type != VFS_DIR)
+            return -EISDIR;
+
+         if ((rc = ramfs_rmdir_entry(d, ndir, ne)))
             return rc;
 
       } else {
 
-         if ((rc = ramfs_unlink(vnewp)))
+         if (i->type == VFS_DIR)
+            return -ENOTDIR;
+
+         if ((rc = ramfs_unlink_entry(d, ndir, ne)))
             return rc;
       }
    }
 
-   rc = ramfs_dir_add_entry(newp->dir_inode, vnewp->last_comp, oldp->inode);
+   rc = ramfs_dir_add_entry(ndir, vnewp->last_comp, i);
 
    if (rc) {
 
@@ -278,24 +440,90 @@ ramfs_rename(struct mnt_fs *fs, struct vfs_path *voldp, struct vfs_path *vnewp)
       return rc;
    }
 
-   /* Finally, this operation cannot fail. */
-   ramfs_dir_remove_entry(oldp->dir_inode, oldp->dir_entry);
+   if (i->type == VFS_DIR && odir != ndir)
+      ramfs_dir_reparent(i, ndir);
+
+   /* Finally, this operation cannot fail. The inode has at least one link. */
+   ramfs_dir_remove_entry(odir, oe);
    return 0;
 }
 
 static int
-ramfs_link(struct mnt_fs *fs, struct vfs_path *voldp, struct vfs_path *vnewp)
+ramfs_rename(struct mnt_fs *fs,
+             struct vfs_path *voldp,
+             struct vfs_path *vnewp,
+             u32 flags)
 {
-   struct ramfs_path *oldp = (void *)&voldp->fs_path;
-   struct ramfs_path *newp = (void *)&vnewp->fs_path;
+   struct ramfs_data *d = fs->device_data;
+   struct ramfs_inode *odir = voldp->fs_path.dir_inode;
+   struct ramfs_inode *ndir = vnewp->fs_path.dir_inode;
+   int rc;
+
+   if (flags & ~RENAME_NOREPLACE)
+      return -EINVAL;
 
-   if (oldp->type != VFS_FILE)
+   ramfs_lock_dirs(d, odir, ndir);
+   {
+      rc = ramfs_rename_locked(d, voldp, vnewp, flags);
+   }
+   ramfs_unlock_dirs(d, odir, ndir);
+   return rc;
+}
+
+static int
+ramfs_link_locked(struct ramfs_data *d,
+                  struct vfs_path *voldp,
+                  struct vfs_path *vnewp)
+{
+   struct ramfs_inode *i = voldp->fs_path.inode;
+   struct ramfs_inode *ndir = vnewp->fs_path.dir_inode;
+   int rc;
+
+   if (i->type != VFS_FILE)
       return -EPERM;
 
-   if (newp->inode != NULL)
+   if (!ndir->nlink)
+      return -ENOENT; /* the new parent dir has been removed */
+
+   if (ramfs_dir_lookup_last_comp(ndir, vnewp->last_comp))
       return -EEXIST;
 
-   return ramfs_dir_add_entry(newp->dir_inode, vnewp->last_comp, oldp->inode);
+   /*
+    * Unlike the other operations, don't look up again the old entry by name:
+    * when the last symlink has been followed (AT_SYMLINK_FOLLOW), `last_comp`
+    * is the symlink's name, while we have to link its target. Instead, hold a
+    * link on the inode while adding the new entry, unless all of its links
+    * have already been removed in the meanwhile. The inode itself cannot be
+    * destroyed, as zombies are reaped only holding the fs-lock exclusively.
+    */
+   if (!ramfs_nlink_inc_not_zero(i))
+      return -ENOENT;
+
+   rc = ramfs_dir_add_entry(ndir, vnewp->last_comp, i);
+
+   if (!ramfs_nlink_dec(i))
+      ramfs_add_zombie(d, i); /* add failed and the other links are gone */
+
+   return rc;
+}
+
+static int
+ramfs_link(struct mnt_fs *fs, struct vfs_path *voldp, struct vfs_path *vnewp)
+{
+   struct ramfs_data *d = fs->device_data;
+   struct ramfs_inode *odir = voldp->fs_path.dir_inode;
+   struct ramfs_inode *ndir = vnewp->fs_path.dir_inode;
+   int rc;
+
+   if (vnewp->fs_path.inode != NULL)
+      return -EEXIST;
+
+   ramfs_lock_dirs(d, odir, ndir);
+   {
+      rc = ramfs_link_locked(d, voldp, vnewp);
+   }
+   ramfs_unlock_dirs(d, odir, ndir);
+   return rc;
 }
 
 int ramfs_futimens(struct mnt_fs *fs,
@@ -303,12 +531,17 @@ int ramfs_futimens(struct mnt_fs *fs,
                    const struct k_timespec64 times[2])
 {
    struct ramfs_inode *i = inode;
+   int rc = 0;
 
-   if ((i->mode & 0200) != 0200)
-      return -EACCES;
-
-   i->mtime = times[1];
-   return 0;
+   rwlock_wp_exlock(&i->rwlock);
+   {
+      if ((i->mode & 0200) == 0200)
+         i->mtime = times[1];
+      else
+         rc = -EACCES;
+   }
+   rwlock_wp_exunlock(&i->rwlock);
+   return rc;
 }
 
 static const struct fs_ops static_fsops_ramfs =
@@ -347,7 +580,10 @@ struct mnt_fs *ramfs_create(void)
    if (!(d = kzalloc_obj(struct ramfs_data)))
       return NULL;
 
-   fs = create_fs_obj("ramfs", &static_fsops_ramfs, d, VFS_FS_RW);
+   fs = create_fs_obj("ramfs",
+                      &static_fsops_ramfs,
+                      d,
+                      VFS_FS_RW | VFS_FS_DCACHE | VFS_FS_DIRLOCKS);
 
    if (!fs) {
       kfree_obj(d, struct ramfs_data);
@@ -355,6 +591,8 @@ struct mnt_fs *ramfs_create(void)
    }
 
    rwlock_wp_init(&d->rwlock, false);
+   kmutex_init(&d->rename_lock, 0);
+   list_init(&d->zombies);
    d->next_inode_num = 1;
    d->root = ramfs_create_inode_dir(d, 0777, NULL);
 
@@ -4,6 +4,7 @@
 #include <tilck/common/basic_defs.h>
 
 #include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/fs/dir_index.h>
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/kmalloc.h>
 #include <tilck/kernel/errno.h>
@@ -20,11 +21,30 @@
 
 struct ramfs_inode;
 
-struct ramfs_block {
+/*
+ * The data of ramfs files is kept in pages indexed by a radix tree (block map)
+ * whose leaves point directly to the pages. Pages are allocated in physically
+ * contiguous extents of up to RAMFS_MAX_EXTENT_PAGES, when possible: that way,
+ * sequential reads and writes require a single lookup per extent instead of a
+ * lookup per page. See blocks.c.h.
+ */
+#define RAMFS_BMAP_SHIFT                      6
+#define RAMFS_BMAP_SLOTS      (1ul << RAMFS_BMAP_SHIFT)
+#define RAMFS_BMAP_MASK        (RAMFS_BMAP_SLOTS - 1)
+#define RAMFS_MAX_EXTENT_PAGES               16
+
+STATIC_ASSERT(RAMFS_MAX_EXTENT_PAGES <= RAMFS_BMAP_SLOTS);
 
-   struct bintree_node node;
-   offt offset;                  /* MUST BE divisible by PAGE_SIZE */
-   void *vaddr;
+struct ramfs_bmap_node {
+
+   /* child nodes or, in leaf nodes, the vaddr of the pages */
+   void *slots[RAMFS_BMAP_SLOTS];
+};
+
+struct ramfs_bmap {
+
+   struct ramfs_bmap_node *root;
+   u32 height;                   /* 0 means empty, leaf nodes have height 1 */
 };
 
 /*
@@ -36,7 +56,7 @@ struct ramfs_block {
 #define RAMFS_ENTRY_SIZE 256
 #define RAMFS_ENTRY_MAX_LEN (                   \
    RAMFS_ENTRY_SIZE                             \
-   - sizeof(struct bintree_node)                \
+   - sizeof(struct dir_index_node)              \
    - sizeof(struct list_node)                   \
    - sizeof(struct ramfs_inode *)               \
    - sizeof(u8)                                 \
@@ -44,7 +64,7 @@ struct ramfs_block {
 
 struct ramfs_entry {
 
-   struct bintree_node node;
+   struct dir_index_node node;
    struct list_node lnode;
    struct ramfs_inode *inode;
    u8 name_len;                     /* NOTE: includes the final \0 */
@@ -64,25 +84,26 @@ struct ramfs_inode {
    tilck_ino_t ino;
    enum vfs_entry_type type;
    struct rwlock_wp rwlock;
-   nlink_t nlink;
+   nlink_t nlink;                      /* see ramfs_nlink_inc() */
    mode_t mode;
-   size_t blocks_count;                /* count of page-size blocks */
+   size_t blocks_count;                /* count of pages in `bmap` */
    struct ramfs_inode *parent_dir;
    struct list mappings_list;          /* see ramfs_unmap_past_eof_mappings() */
+   struct list_node zombie_node;       /* see ramfs_add_zombie() */
 
    union {
 
       /* valid when type == VFS_FILE */
       struct {
          offt fsize;
-         struct ramfs_block *blocks_tree_root;
+         struct ramfs_bmap bmap;
       };
 
       /* valid when type == VFS_DIR */
       struct {
          offt num_entries;
-         struct ramfs_entry *entries_tree_root;
-         struct list entries_list;
+         struct dir_index index;             /* see dir_index.h */
+         struct list entries_list;           /* ordered by cookie */
          struct list handles_list;
       };
 
@@ -117,10 +138,14 @@ STATIC_ASSERT(sizeof(struct ramfs_handle) <= MAX_FS_HANDLE_SIZE);
 
 struct ramfs_data {
 
-   struct rwlock_wp rwlock;
+   struct rwlock_wp rwlock;            /* fs-lock, see locking.c.h */
+   struct kmutex rename_lock;          /* see ramfs_lock_dirs() */
 
    tilck_ino_t next_inode_num;
    struct ramfs_inode *root;
+
+   struct list zombies;                /* inodes to destroy */
+   u32 zombies_count;
 };
 
 CREATE_FS_PATH_STRUCT(ramfs_path, struct ramfs_inode *, struct ramfs_entry *);
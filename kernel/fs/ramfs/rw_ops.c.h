@@ -5,23 +5,17 @@ static int ramfs_ioctl(fs_handle h, ulong cmd, void *argp)
    return -EINVAL;
 }
 
+/*
+ * Dir offsets are the cookies of the entries (see dir_index.h) + 1, as
+ * returned by getdents() in d_off: seeking to them is O(1).
+ */
 static offt ramfs_dir_seek(struct ramfs_handle *rh, offt target_off)
 {
-   struct ramfs_inode *i = rh->inode;
-   struct ramfs_entry *dpos;
-   offt off = 0;
-
-   list_for_each_ro(dpos, &i->entries_list, lnode) {
-
-      if (off == target_off) {
-         rh->dir_pos = off;
-         rh->dpos = dpos;
-         break;
-      }
-
-      off++;
-   }
+   if ((u64)target_off > UINT32_MAX)
+      return -EINVAL;
 
+   rh->dpos = ramfs_dir_get_entry_by_cookie(rh->inode, (u32)target_off);
+   rh->dir_pos = target_off;
    return rh->dir_pos;
 }
 
@@ -197,26 +191,23 @@ static int ramfs_inode_truncate(struct ramfs_inode *i, offt len)
    }
    enable_preemption();
 
-   while (true) {
+   ramfs_bmap_truncate(i, ramfs_pages_count(len));
 
-      struct ramfs_block *b =
-         bintree_get_last_obj(i->blocks_tree_root, struct ramfs_block, node);
+   if (len & (offt)OFFSET_IN_PAGE_MASK) {
 
-      if (!b || b->offset < len)
-         break;
+      /*
+       * Zero the part of the last page past the new EOF: otherwise, the old
+       * data would re-appear in case the file gets extended again.
+       */
+      const size_t page_off = (size_t)(len & (offt)OFFSET_IN_PAGE_MASK);
+      ulong run;
+      char *va = ramfs_bmap_lookup(i, (ulong)(len >> PAGE_SHIFT), 1, &run);
 
-      /* Remove the block object from the tree */
-      bintree_remove_ptr(&i->blocks_tree_root,
-                         b,
-                         struct ramfs_block,
-                         node,
-                         offset);
-
-      ramfs_destroy_block(b);
+      if (va)
+         bzero(va + page_off, PAGE_SIZE - page_off);
    }
 
    i->fsize = len;
-   i->blocks_count = pow2_round_up_at((ulong) len, PAGE_SIZE);
    return 0;
 }
 
@@ -260,39 +251,31 @@ ramfs_read_nolock(struct ramfs_handle *rh, char *buf, size_t len, offt *pos)
 
    ASSERT(inode->type == VFS_FILE);
 
-   while (buf_rem > 0) {
+   while (buf_rem > 0 && *pos < inode->fsize) {
 
-      struct ramfs_block *block;
-      const offt page     = *pos & (offt)PAGE_MASK;
+      const ulong page    = (ulong)(*pos >> PAGE_SHIFT);
       const offt page_off = *pos & (offt)OFFSET_IN_PAGE_MASK;
-      const offt page_rem = (offt)PAGE_SIZE - page_off;
       const offt file_rem = inode->fsize - *pos;
-      const offt to_read  = MIN3(page_rem, buf_rem, file_rem);
-
-      if (*pos >= inode->fsize)
-         break;
-
-      ASSERT(to_read >= 0);
-
-      if (!to_read)
-         break;
-
-      block = bintree_find_ptr(inode->blocks_tree_root,
-                               page,
-                               struct ramfs_block,
-                               node,
-                               offset);
-
-      if (block) {
-         /* reading a regular block */
-         memcpy(buf + tot_read, block->vaddr + page_off, (size_t)to_read);
+      const offt rem      = MIN(buf_rem, file_rem);
+      const ulong max     = ramfs_pages_count(page_off + rem);
+      offt to_read;
+      ulong run;
+      char *va;
+
+      va = ramfs_bmap_lookup(inode, page, max, &run);
+      to_read = MIN(((offt)run << PAGE_SHIFT) - page_off, rem);
+      ASSERT(to_read > 0);
+
+      if (va) {
+         /* reading a run of regular pages */
+         memcpy(buf + tot_read, va + page_off, (size_t)to_read);
       } else {
          /* reading a hole */
          memset(buf + tot_read, 0, (size_t)to_read);
       }
 
       tot_read += to_read;
-      *pos  += to_read;
+      *pos     += to_read;
       buf_rem  -= to_read;
    }
 
@@ -327,35 +310,35 @@ ramfs_write_nolock(struct ramfs_handle *rh, char *buf, size_t len, offt *pos)
 
    while (buf_rem > 0) {
 
-      struct ramfs_block *block;
-      const offt page     = *pos & (offt)PAGE_MASK;
+      const ulong page    = (ulong)(*pos >> PAGE_SHIFT);
       const offt page_off = *pos & (offt)OFFSET_IN_PAGE_MASK;
-      const offt page_rem = (offt)PAGE_SIZE - page_off;
-      const offt to_write = MIN(page_rem, buf_rem);
+      const ulong max     = ramfs_pages_count(page_off + buf_rem);
+      offt to_write;
+      bool new_ext;
+      ulong run;
+      char *va;
 
-      ASSERT(to_write > 0);
+      va = ramfs_bmap_lookup(inode, page, max, &run);
 
-      block = bintree_find_ptr(inode->blocks_tree_root,
-                               page,
-                               struct ramfs_block,
-                               node,
-                               offset);
-
-      /* Assert that if page_off > 0, the block is present */
-      ASSERT(!page_off || block);
-
-      if (!block) {
-
-         if (!(block = ramfs_new_block(page)))
+      if ((new_ext = !va)) {
+         if (!(run = ramfs_alloc_extent(inode, page, run, &va)))
             break;
+      }
+
+      to_write = MIN(((offt)run << PAGE_SHIFT) - page_off, buf_rem);
+      ASSERT(to_write > 0);
 
-         ramfs_append_new_block(inode, block);
+      if (new_ext) {
+         /* Zero only the parts of the new extent we're not going to write */
+         const size_t end = (size_t)(page_off + to_write);
+         bzero(va, (size_t)page_off);
+         bzero(va + end, (run << PAGE_SHIFT) - end);
       }
 
-      memcpy(block->vaddr + page_off, buf + tot_written, (size_t)to_write);
+      memcpy(va + page_off, buf + tot_written, (size_t)to_write);
       tot_written += to_write;
       buf_rem     -= to_write;
-      *pos     += to_write;
+      *pos        += to_write;
 
       if (*pos > inode->fsize)
          inode->fsize = *pos;
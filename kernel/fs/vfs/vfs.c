@@ -14,6 +14,7 @@
 #include <dirent.h> // system header
 
 #include "../fs_int.h"
+#include "vfs_dcache.c.h"
 #include "vfs_mp.c.h"
 #include "vfs_locking.c.h"
 #include "vfs_resolve.c.h"
@@ -264,7 +265,8 @@ typedef int (*vfs_func_impl)(struct mnt_fs *,
                              ulong, ulong, ulong);
 
 static ALWAYS_INLINE int
-__vfs_path_funcs_wrapper(const char *path,
+__vfs_path_funcs_wrapper(int dirfd,
+                         const char *path,
                          bool exlock,
                          bool res_last_sl,
                          vfs_func_impl func,
@@ -275,7 +277,7 @@ __vfs_path_funcs_wrapper(const char *path,
 
    NO_TEST_ASSERT(is_preemption_enabled());
 
-   if ((rc = vfs_resolve(path, &p, exlock, res_last_sl)) < 0)
+   if ((rc = vfs_resolve_at(dirfd, path, &p, exlock, res_last_sl)) < 0)
       return rc;
 
    ASSERT(p.fs != NULL);
@@ -286,8 +288,9 @@ __vfs_path_funcs_wrapper(const char *path,
    return rc;
 }
 
-#define vfs_path_funcs_wrapper(path, exlock, rsl, func, a1, a2, a3)           \
-   __vfs_path_funcs_wrapper(path,                                             \
+#define vfs_path_funcs_wrapper(dirfd, path, exlock, rsl, func, a1, a2, a3)    \
+   __vfs_path_funcs_wrapper(dirfd,                                            \
+                            path,                                             \
                             exlock,                                           \
                             rsl,                                              \
                             (vfs_func_impl)(void *)func,                      \
@@ -305,7 +308,12 @@ vfs_open_impl(struct mnt_fs *fs, struct vfs_path *p,
          return -ENOTDIR;
    }
 
-   if ((rc = fs->fsops->open(p, out, flags, mode)))
+   rc = fs->fsops->open(p, out, flags, mode);
+
+   if (!p->fs_path.inode && (flags & O_CREAT))
+      vfs_dcache_invalidate_at(p);
+
+   if (rc)
       return rc;
 
    {
@@ -330,9 +338,11 @@ vfs_open_impl(struct mnt_fs *fs, struct vfs_path *p,
    return 0;
 }
 
-int vfs_open(const char *path, fs_handle *out, int flags, mode_t mode)
+int vfs_openat(int dirfd, const char *path,
+               fs_handle *out, int flags, mode_t mode)
 {
    return vfs_path_funcs_wrapper(
+      dirfd,
       path,
       true,             /* exlock */
       true,             /* res_last_sl */
@@ -356,9 +366,11 @@ vfs_stat64_impl(struct mnt_fs *fs,
    return fs->fsops->stat(fs, p->fs_path.inode, statbuf);
 }
 
-int vfs_stat64(const char *path, struct k_stat64 *statbuf, bool res_last_sl)
+int vfs_fstatat64(int dirfd, const char *path,
+                  struct k_stat64 *statbuf, bool res_last_sl)
 {
    return vfs_path_funcs_wrapper(
+      dirfd,
       path,
       false,               /* exlock */
       res_last_sl,         /* res_last_sl */
@@ -375,6 +387,8 @@ vfs_mkdir_impl(struct mnt_fs *fs,
                mode_t mode,
                ulong x, ulong y)
 {
+   int rc;
+
    if (!fs->fsops->mkdir)
       return -EPERM;
 
@@ -384,12 +398,15 @@ vfs_mkdir_impl(struct mnt_fs *fs,
    if (p->fs_path.inode)
       return -EEXIST;
 
-   return fs->fsops->mkdir(p, mode);
+   rc = fs->fsops->mkdir(p, mode);
+   vfs_dcache_invalidate_at(p);
+   return rc;
 }
 
-int vfs_mkdir(const char *path, mode_t mode)
+int vfs_mkdirat(int dirfd, const char *path, mode_t mode)
 {
    return vfs_path_funcs_wrapper(
+      dirfd,
       path,
       true,             /* exlock */
       false,            /* res_last_sl */
@@ -405,6 +422,8 @@ vfs_rmdir_impl(struct mnt_fs *fs,
                struct vfs_path *p,
                ulong u1, ulong u2, ulong u3)
 {
+   int rc;
+
    if (!fs->fsops->rmdir)
       return -EPERM;
 
@@ -414,12 +433,17 @@ vfs_rmdir_impl(struct mnt_fs *fs,
    if (!p->fs_path.inode)
       return -ENOENT;
 
-   return fs->fsops->rmdir(p);
+   rc = fs->fsops->rmdir(p);
+
+   /* Entries in the removed dir might be cached as well: drop them all */
+   vfs_dcache_invalidate_fs(fs);
+   return rc;
 }
 
-int vfs_rmdir(const char *path)
+int vfs_rmdirat(int dirfd, const char *path)
 {
    return vfs_path_funcs_wrapper(
+      dirfd,
       path,
       true,             /* exlock */
       false,            /* res_last_sl */
@@ -433,6 +457,8 @@ vfs_unlink_impl(struct mnt_fs *fs,
                 struct vfs_path *p,
                 ulong u1, ulong u2, ulong u3)
 {
+   int rc;
+
    if (!fs->fsops->unlink)
       return -EPERM;
 
@@ -442,12 +468,15 @@ vfs_unlink_impl(struct mnt_fs *fs,
    if (!p->fs_path.inode)
       return -ENOENT;
 
-   return fs->fsops->unlink(p);
+   rc = fs->fsops->unlink(p);
+   vfs_dcache_invalidate_at(p);
+   return rc;
 }
 
-int vfs_unlink(const char *path)
+int vfs_unlinkat(int dirfd, const char *path)
 {
    return vfs_path_funcs_wrapper(
+      dirfd,
       path,
       true,             /* exlock */
       false,            /* res_last_sl */
@@ -492,6 +521,7 @@ vfs_truncate_impl(struct mnt_fs *fs,
 int vfs_truncate(const char *path, offt len)
 {
    return vfs_path_funcs_wrapper(
+      AT_FDCWD,
       path,
       false,               /* exlock */
       true,                /* res_last_sl */
@@ -505,6 +535,8 @@ static ALWAYS_INLINE int
 vfs_symlink_impl(struct mnt_fs *fs,
                  struct vfs_path *p, const char *target, ulong u1, ulong u2)
 {
+   int rc;
+
    if (!fs->fsops->symlink)
       return -EPERM;
 
@@ -514,12 +546,15 @@ vfs_symlink_impl(struct mnt_fs *fs,
    if (p->fs_path.inode)
       return -EEXIST; /* the linkpath already exists! */
 
-   return fs->fsops->symlink(target, p);
+   rc = fs->fsops->symlink(target, p);
+   vfs_dcache_invalidate_at(p);
+   return rc;
 }
 
-int vfs_symlink(const char *target, const char *linkpath)
+int vfs_symlinkat(const char *target, int dirfd, const char *linkpath)
 {
    return vfs_path_funcs_wrapper(
+      dirfd,
       linkpath,
       true,             /* exlock */
       false,            /* res_last_sl */
@@ -551,9 +586,10 @@ vfs_readlink_impl(struct mnt_fs *fs,
 }
 
 /* NOTE: `buf` is guaranteed to have room for at least MAX_PATH chars */
-int vfs_readlink(const char *path, char *buf)
+int vfs_readlinkat(int dirfd, const char *path, char *buf)
 {
    return vfs_path_funcs_wrapper(
+      dirfd,
       path,
       false,               /* exlock */
       false,               /* res_last_sl */
@@ -573,9 +609,11 @@ vfs_chown_impl(struct mnt_fs *fs,
    return (owner == 0 && group == 0) ? 0 : -EPERM;
 }
 
-int vfs_chown(const char *path, int owner, int group, bool reslink)
+int vfs_fchownat(int dirfd, const char *path,
+                 int owner, int group, bool reslink)
 {
    return vfs_path_funcs_wrapper(
+      dirfd,
       path,
       false,            /* exlock */
       reslink,          /* res_last_sl */
@@ -601,9 +639,10 @@ vfs_chmod_impl(struct mnt_fs *fs, struct vfs_path *p, mode_t mode)
    return fs->fsops->chmod(fs, p->fs_path.inode, mode);
 }
 
-int vfs_chmod(const char *path, mode_t mode)
+int vfs_fchmodat(int dirfd, const char *path, mode_t mode)
 {
    return vfs_path_funcs_wrapper(
+      dirfd,
       path,
       false,            /* exlock */
       true,             /* res_last_sl */
@@ -630,6 +669,7 @@ vfs_utimens_impl(struct mnt_fs *fs,
 int vfs_utimens(const char *path, const struct k_timespec64 times[2])
 {
    return vfs_path_funcs_wrapper(
+      AT_FDCWD,
       path,
       true,            /* exlock */
       true,            /* res_last_sl */
@@ -640,19 +680,26 @@ int vfs_utimens(const char *path, const struct k_timespec64 times[2])
 }
 
 static int
-vfs_rename_or_link(const char *oldpath,
+vfs_rename_or_link(int olddirfd,
+                   const char *oldpath,
+                   int newdirfd,
                    const char *newpath,
-                   func_2paths (*get_func_ptr)(struct mnt_fs *))
+                   u32 flags,
+                   bool link,
+                   bool res_last_sl)
 {
+   const struct fs_ops *fsops;
    struct mnt_fs *fs;
-   func_2paths func;
    struct vfs_path oldp, newp;
+   bool supported;
    int rc;
 
    NO_TEST_ASSERT(is_preemption_enabled());
 
    /* First, just resolve the old path using a shared lock */
-   if ((rc = vfs_resolve(oldpath, &oldp, false, false)) < 0)
+   rc = vfs_resolve_at(olddirfd, oldpath, &oldp, false, res_last_sl);
+
+   if (rc < 0)
       return rc;
 
    ASSERT(oldp.fs != NULL);
@@ -666,18 +713,24 @@ vfs_rename_or_link(const char *oldpath,
       return -ENOENT;
    }
 
-   /* Everything was fine: now retain the file and release the lock */
+   /*
+    * Everything was fine: now retain the file and its parent directory and
+    * release the lock. Retaining the directory too matters for file systems
+    * using per-directory locks, as they will look up again the old entry.
+    */
    vfs_retain_inode_at(&oldp);
+   vfs_retain_inode(fs, oldp.fs_path.dir_inode);
    vfs_smart_fs_unlock(fs, false);
 
    /* Now, resolve the new path grabbing an exclusive lock */
-   if ((rc = vfs_resolve(newpath, &newp, true, false)) < 0) {
+   if ((rc = vfs_resolve_at(newdirfd, newpath, &newp, true, false)) < 0) {
 
       /*
        * Oops, something when wrong: release the oldpath's inode and fs.
        * Note: no need for release anything about the new path since the func
        * already does that in the error cases.
        */
+      vfs_release_inode(fs, oldp.fs_path.dir_inode);
       vfs_release_inode_at(&oldp);
       release_obj(fs);
       return rc;
@@ -701,6 +754,7 @@ vfs_rename_or_link(const char *oldpath,
       vfs_smart_fs_unlock(newp.fs, true);
       release_obj(newp.fs);
 
+      vfs_release_inode(fs, oldp.fs_path.dir_inode);
       vfs_release_inode_at(&oldp);
       release_obj(fs);
       return -EXDEV;
@@ -712,41 +766,52 @@ vfs_rename_or_link(const char *oldpath,
     */
 
    release_obj(fs);
-   vfs_release_inode_at(&oldp); /* note: we're still holding an exlock on fs */
+   vfs_release_inode(fs, oldp.fs_path.dir_inode);
+   vfs_release_inode_at(&oldp); /* note: we're still holding a lock on fs */
 
    /* Finally, we can call struct mnt_fs's func (if any) */
-   func = get_func_ptr(fs);
+   fsops = fs->fsops;
+   supported = link ? fsops->link != NULL : fsops->rename != NULL;
+
+   if (!supported)
+      rc = -EPERM; /* not supported */
+   else if (!(fs->flags & VFS_FS_RW))
+      rc = -EROFS; /* read-only struct mnt_fs */
+   else if (link)
+      rc = fsops->link(fs, &oldp, &newp);
+   else
+      rc = fsops->rename(fs, &oldp, &newp, flags);
 
-   rc = func
-      ? fs->flags & VFS_FS_RW
-         ? func(fs, &oldp, &newp)
-         : -EROFS /* read-only struct mnt_fs */
-      : -EPERM; /* not supported */
+   /*
+    * Rename might move a whole sub-tree (changing its `..` entry) and replace
+    * an existing directory: just drop all the cached entries of the fs.
+    */
+   vfs_dcache_invalidate_fs(fs);
 
-   /* We're done, release fs's exlock and its retain count */
+   /* We're done, release fs's lock and its retain count */
    vfs_smart_fs_unlock(fs, true);
    release_obj(fs);
    return rc;
 }
 
-static ALWAYS_INLINE func_2paths vfs_get_rename_func(struct mnt_fs *fs)
-{
-   return fs->fsops->rename;
-}
-
-static ALWAYS_INLINE func_2paths vfs_get_link_func(struct mnt_fs *fs)
-{
-   return fs->fsops->link;
-}
-
-int vfs_rename(const char *oldpath, const char *newpath)
+int vfs_renameat(int olddirfd, const char *oldpath,
+                 int newdirfd, const char *newpath, u32 flags)
 {
-   return vfs_rename_or_link(oldpath, newpath, &vfs_get_rename_func);
+   return vfs_rename_or_link(olddirfd, oldpath,
+                             newdirfd, newpath,
+                             flags,
+                             false,
+                             false);
 }
 
-int vfs_link(const char *oldpath, const char *newpath)
+int vfs_linkat(int olddirfd, const char *oldpath,
+               int newdirfd, const char *newpath, bool res_last_sl)
 {
-   return vfs_rename_or_link(oldpath, newpath, &vfs_get_link_func);
+   return vfs_rename_or_link(olddirfd, oldpath,
+                             newdirfd, newpath,
+                             0,
+                             true,
+                             res_last_sl);
 }
 
 int vfs_fchmod(fs_handle h, mode_t mode)
@@ -926,6 +991,7 @@ create_fs_obj(const char *type,
 void destory_fs_obj(struct mnt_fs *fs)
 {
    ASSERT(!fs->pss_lock_root);
+   vfs_dcache_invalidate_fs(fs);
    kfree_obj(fs, struct mnt_fs);
 }
 
@@ -0,0 +1,232 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+/*
+ * Dentry cache (dcache): a small direct-mapped cache of the results of the
+ * fs-level get_entry() calls made by the path resolver, keyed by the tuple
+ * (mnt_fs, parent dir inode, name). Negative results (no such entry) are
+ * cached as well, because looking up non-existing paths (e.g. searching a
+ * command in $PATH) is as common as looking up existing ones.
+ *
+ * Only file systems whose namespace changes exclusively through the VFS can
+ * opt-in, by setting VFS_FS_DCACHE: that's because the cached entries are
+ * invalidated by the VFS functions changing the namespace (creat, mkdir,
+ * unlink, rmdir, rename etc.), *after* the change has been made. Because
+ * with VFS_FS_DIRLOCKS a lookup can run concurrently with a namespace change,
+ * every invalidation bumps a generation counter and the result of a lookup is
+ * inserted in the cache only if no invalidation happened while get_entry()
+ * was running. All the accesses to the cache run with preemption disabled.
+ */
+
+struct vfs_dcache_entry {
+
+   struct mnt_fs *fs;                  /* NULL means free slot */
+   vfs_inode_ptr_t idir;               /* parent dir inode */
+   u32 hash;                           /* hash of the name */
+   u32 len;                            /* length of the name */
+   char name[VFS_DCACHE_NAME_LEN];     /* NOT zero-terminated */
+   struct fs_path fs_path;             /* result of get_entry() */
+};
+
+static struct vfs_dcache_entry dcache[VFS_DCACHE_ENTRIES];
+static struct vfs_dcache_stats dcache_stats;
+static u32 dcache_gen;
+
+STATIC_ASSERT((VFS_DCACHE_ENTRIES & (VFS_DCACHE_ENTRIES - 1)) == 0);
+
+/* FNV-1a hash of the path component */
+static ALWAYS_INLINE u32
+vfs_dcache_hash(const char *name, size_t len)
+{
+   u32 h = 2166136261u;
+
+   for (size_t i = 0; i < len; i++)
+      h = (h ^ (u8)name[i]) * 16777619u;
+
+   return h;
+}
+
+static ALWAYS_INLINE struct vfs_dcache_entry *
+vfs_dcache_slot(struct mnt_fs *fs, vfs_inode_ptr_t idir, u32 hash)
+{
+   ulong k = hash ^ ((ulong)idir >> 4) ^ ((ulong)fs >> 6);
+   k ^= k >> 16;
+   return &dcache[k & (VFS_DCACHE_ENTRIES - 1)];
+}
+
+static ALWAYS_INLINE bool
+vfs_dcache_match(struct vfs_dcache_entry *e,
+                 struct mnt_fs *fs,
+                 vfs_inode_ptr_t idir,
+                 const char *name,
+                 size_t len,
+                 u32 hash)
+{
+   return e->fs == fs &&
+          e->idir == idir &&
+          e->hash == hash &&
+          e->len == len &&
+          !memcmp(e->name, name, len);
+}
+
+static bool
+vfs_dcache_lookup(struct mnt_fs *fs,
+                  vfs_inode_ptr_t idir,
+                  const char *name,
+                  size_t len,
+                  u32 hash,
+                  struct fs_path *fs_path)
+{
+   struct vfs_dcache_entry *e = vfs_dcache_slot(fs, idir, hash);
+   bool found = false;
+
+   disable_preemption();
+   {
+      if (vfs_dcache_match(e, fs, idir, name, len, hash)) {
+
+         *fs_path = e->fs_path;
+         found = true;
+
+         if (fs_path->inode)
+            dcache_stats.hits++;
+         else
+            dcache_stats.neg_hits++;
+
+      } else {
+
+         dcache_stats.misses++;
+      }
+   }
+   enable_preemption();
+   return found;
+}
+
+static void
+vfs_dcache_insert(struct mnt_fs *fs,
+                  vfs_inode_ptr_t idir,
+                  const char *name,
+                  size_t len,
+                  u32 hash,
+                  u32 gen,
+                  struct fs_path *fs_path)
+{
+   struct vfs_dcache_entry *e = vfs_dcache_slot(fs, idir, hash);
+
+   disable_preemption();
+   {
+      /*
+       * If anything got invalidated while get_entry() was running, `fs_path`
+       * might be already out-of-date: just don't cache it.
+       */
+      if (gen == dcache_gen) {
+         e->fs = fs;
+         e->idir = idir;
+         e->hash = hash;
+         e->len = (u32)len;
+         e->fs_path = *fs_path;
+         memcpy(e->name, name, len);
+      }
+   }
+   enable_preemption();
+}
+
+/*
+ * Wrapper of vfs_get_entry() used by the path resolver. It's expected to be
+ * called only for path components in the middle of directories (not for the
+ * root entry).
+ */
+static void
+vfs_dcache_get_entry(struct mnt_fs *fs,
+                     vfs_inode_ptr_t idir,
+                     const char *name,
+                     ssize_t name_len,
+                     struct fs_path *fs_path)
+{
+   const size_t len = (size_t)name_len;
+   u32 hash, gen;
+
+   if (!(fs->flags & VFS_FS_DCACHE) || len > VFS_DCACHE_NAME_LEN) {
+      vfs_get_entry(fs, idir, name, name_len, fs_path);
+      return;
+   }
+
+   hash = vfs_dcache_hash(name, len);
+   gen = dcache_gen;
+
+   if (vfs_dcache_lookup(fs, idir, name, len, hash, fs_path))
+      return;
+
+   vfs_get_entry(fs, idir, name, name_len, fs_path);
+   vfs_dcache_insert(fs, idir, name, len, hash, gen, fs_path);
+}
+
+/*
+ * Drop the entry for the last component of `p`, if cached. Called after
+ * creating or removing an entry in p->fs_path.dir_inode.
+ */
+static void
+vfs_dcache_invalidate_at(struct vfs_path *p)
+{
+   struct mnt_fs *fs = p->fs;
+   const char *name = p->last_comp;
+   struct vfs_dcache_entry *e;
+   size_t len = 0;
+   u32 hash;
+
+   if (!(fs->flags & VFS_FS_DCACHE))
+      return;
+
+   while (name[len] && name[len] != '/')
+      len++;
+
+   hash = vfs_dcache_hash(name, len);
+   e = vfs_dcache_slot(fs, p->fs_path.dir_inode, hash);
+
+   disable_preemption();
+   {
+      dcache_gen++;
+
+      if (vfs_dcache_match(e, fs, p->fs_path.dir_inode, name, len, hash)) {
+         e->fs = NULL;
+         dcache_stats.invalidations++;
+      }
+   }
+   enable_preemption();
+}
+
+/*
+ * Drop all the entries of `fs` (or all the entries at all, when `fs` is NULL).
+ * Used when a whole sub-tree is affected (rmdir, rename), when a struct
+ * mnt_fs is mounted or destroyed and when a fs frees directory inodes, as
+ * their address might be reused later.
+ */
+void vfs_dcache_invalidate_fs(struct mnt_fs *fs)
+{
+   if (fs && !(fs->flags & VFS_FS_DCACHE))
+      return;
+
+   disable_preemption();
+   {
+      dcache_gen++;
+
+      for (int i = 0; i < ARRAY_SIZE(dcache); i++) {
+
+         if (!dcache[i].fs)
+            continue;
+
+         if (!fs || dcache[i].fs == fs) {
+            dcache[i].fs = NULL;
+            dcache_stats.invalidations++;
+         }
+      }
+   }
+   enable_preemption();
+}
+
+void vfs_dcache_get_stats(struct vfs_dcache_stats *stats)
+{
+   disable_preemption();
+   {
+      *stats = dcache_stats;
+   }
+   enable_preemption();
+}
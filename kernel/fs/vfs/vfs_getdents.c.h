@@ -6,7 +6,6 @@ struct vfs_getdents_ctx {
    struct linux_dirent64 *user_dirp;
    u32 buf_size;
    u32 offset;
-   u32 fs_flags;
    offt off;
    struct linux_dirent64 ent;
 };
@@ -36,26 +35,6 @@ static int vfs_getdents_cb(struct vfs_dent64 *vde, void *arg)
    struct vfs_getdents_ctx *ctx = arg;
    char *user_ent_dname;
 
-   if (ctx->fs_flags & VFS_FS_RQ_DE_SKIP) {
-
-      /*
-       * Pseudo-hack used fortunately *only* by the FAT32 struct mnt_fs: it
-       * implements here in the VFS layer a trivial mechanism to skip the first
-       * `pos` entries of a directory in case the struct mnt_fs does not have a
-       * way to just "save" the current position and resume from there in each
-       * call of the mnt_fs-op getdents().
-       *
-       * TODO: implement in FAT32 a way to walk a directory step-by-step,
-       * instead of having to walk all the entries every time and skipping the
-       * already "returned" entries. This way we could drop VFS_FS_RQ_DE_SKIP.
-       */
-
-      if (ctx->off < ctx->h->dir_pos) {
-         ctx->off++;
-         return 0; /* skip the dentry */
-      }
-   }
-
    if (ctx->offset + entry_size > ctx->buf_size) {
 
       if (!ctx->offset) {
@@ -72,8 +51,11 @@ static int vfs_getdents_cb(struct vfs_dent64 *vde, void *arg)
       return (int) ctx->offset;
    }
 
+   if (!vde->next_off)
+      vde->next_off = ctx->off + 1; /* "offset" (=ID) of the next dent */
+
    ctx->ent.d_ino    = vde->ino;
-   ctx->ent.d_off    = (u64) ctx->off + 1; /* "offset" (=ID) of the next dent */
+   ctx->ent.d_off    = (u64) vde->next_off;
    ctx->ent.d_reclen = entry_size;
    ctx->ent.d_type   = vfs_type_to_linux_dirent_type(vde->type);
 
@@ -88,7 +70,7 @@ static int vfs_getdents_cb(struct vfs_dent64 *vde, void *arg)
 
    ctx->offset += entry_size;
    ctx->off++;
-   ctx->h->dir_pos++;
+   ctx->h->dir_pos = vde->next_off;
    return 0;
 }
 
@@ -106,8 +88,7 @@ int vfs_getdents64(fs_handle h, struct linux_dirent64 *user_dirp, u32 buf_size)
       .user_dirp     = user_dirp,
       .buf_size      = buf_size,
       .offset        = 0,
-      .fs_flags      = hb->fs->flags,
-      .off           = hb->fs->flags & VFS_FS_RQ_DE_SKIP ? 0 : ctx.h->dir_pos,
+      .off           = hb->dir_pos,
       .ent           = { 0 },
    };
 
@@ -11,6 +11,7 @@ int mp_init(struct mnt_fs *root_fs)
 
 #ifdef UNIT_TEST_ENVIRONMENT
    bzero(mps2, sizeof(mps2));
+   vfs_dcache_invalidate_fs(NULL);
 #endif
 
    mp_root = root_fs;
@@ -133,6 +134,9 @@ int mp_add(struct mnt_fs *target_fs, const char *target_path)
       /* Now that we've succeeded, we must retain the target_fs as well */
       retain_obj(target_fs);
 
+      /* Make sure no stale entries exist for the newly mounted fs */
+      vfs_dcache_invalidate_fs(target_fs);
+
    } else {
 
       /* no free slot, sorry */
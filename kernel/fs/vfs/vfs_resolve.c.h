@@ -1,15 +1,30 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
+/*
+ * File systems with per-directory locks serialize the changes of their
+ * namespace by themselves: for them, a shared fs-lock is always enough.
+ */
+static inline bool vfs_fs_needs_exlock(struct mnt_fs *fs, bool exlock)
+{
+   return exlock && !(fs->flags & VFS_FS_DIRLOCKS);
+}
+
 static inline void vfs_smart_fs_lock(struct mnt_fs *fs, bool exlock)
 {
    /* See the comment in vfs.h about the "fs-lock" funcs */
-   exlock ? vfs_fs_exlock(fs) : vfs_fs_shlock(fs);
+   if (vfs_fs_needs_exlock(fs, exlock))
+      vfs_fs_exlock(fs);
+   else
+      vfs_fs_shlock(fs);
 }
 
 static inline void vfs_smart_fs_unlock(struct mnt_fs *fs, bool exlock)
 {
    /* See the comment in vfs.h about the "fs-lock" funcs */
-   exlock ? vfs_fs_exunlock(fs) : vfs_fs_shunlock(fs);
+   if (vfs_fs_needs_exlock(fs, exlock))
+      vfs_fs_exunlock(fs);
+   else
+      vfs_fs_shunlock(fs);
 }
 
 static inline void
@@ -68,7 +83,16 @@ __vfs_resolve_get_entry(vfs_inode_ptr_t idir,
                         struct vfs_path *rp,
                         bool exlock)
 {
-   vfs_get_entry(rp->fs, idir, pc, path - pc, &rp->fs_path);
+   /*
+    * Use the dcache only for lookups in actual directories: negative entries
+    * keyed by a file inode would become stale if the inode got freed and its
+    * memory reused for a directory.
+    */
+   if (rp->fs_path.type == VFS_DIR)
+      vfs_dcache_get_entry(rp->fs, idir, pc, path - pc, &rp->fs_path);
+   else
+      vfs_get_entry(rp->fs, idir, pc, path - pc, &rp->fs_path);
+
    rp->last_comp = pc;
 
    struct mnt_fs *target_fs = mp_get_retained_at(rp->fs, rp->fs_path.inode);
@@ -356,6 +380,57 @@ get_locked_retained_cwd(struct vfs_path *rp, bool exlock)
    vfs_smart_fs_lock(rp->fs, exlock);
 }
 
+static int
+get_locked_retained_dirfd(int dirfd, struct vfs_path *rp, bool exlock)
+{
+   struct process *pi = get_curr_proc();
+   struct fs_handle_base *hb;
+   struct k_stat64 statbuf;
+   int rc;
+
+   kmutex_lock(&pi->fslock);
+   {
+      if (!(hb = get_fs_handle(dirfd))) {
+         kmutex_unlock(&pi->fslock);
+         return -EBADF;
+      }
+
+      /*
+       * Like in the `cwd` case, make `rp` point to the directory referred by
+       * the handle. The handle retains its inode, but another thread might
+       * close it as soon as we release `fslock`: therefore, retain the inode
+       * here as well. The caller will release it after the stack push in
+       * vfs_resolve_at(), which retains it for the whole resolve.
+       */
+      *rp = (struct vfs_path) {
+         .fs = hb->fs,
+         .fs_path = {
+            .inode = hb->fs->fsops->get_inode(hb),
+            .type = VFS_DIR,
+         },
+      };
+
+      retain_obj(rp->fs);
+      vfs_retain_inode_at(rp);
+   }
+   kmutex_unlock(&pi->fslock);
+   vfs_smart_fs_lock(rp->fs, exlock);
+
+   rc = rp->fs->fsops->stat(rp->fs, rp->fs_path.inode, &statbuf);
+
+   if (!rc && !S_ISDIR(statbuf.st_mode))
+      rc = -ENOTDIR;
+
+   if (rc) {
+      vfs_release_inode_at(rp);
+      vfs_smart_fs_unlock(rp->fs, exlock);
+      release_obj(rp->fs);
+      bzero(rp, sizeof(*rp));
+   }
+
+   return rc;
+}
+
 /*
  * Resolves the path, locking the last struct mnt_fs with an exclusive or a
  * shared lock depending on `exlock`. The last component of the path, if a
@@ -367,10 +442,11 @@ get_locked_retained_cwd(struct vfs_path *rp, bool exlock)
  * to release the FS with release_obj().
  */
 int
-vfs_resolve(const char *path,
-            struct vfs_path *rp,
-            bool exlock,
-            bool res_last_sl)
+vfs_resolve_at(int dirfd,
+               const char *path,
+               struct vfs_path *rp,
+               bool exlock,
+               bool res_last_sl)
 {
    int rc;
 
@@ -394,12 +470,19 @@ vfs_resolve(const char *path,
 
    if (*path == '/')
       get_locked_retained_root(rp, exlock);
-   else
+   else if (dirfd == AT_FDCWD)
       get_locked_retained_cwd(rp, exlock);
+   else if ((rc = get_locked_retained_dirfd(dirfd, rp, exlock)))
+      return rc;
 
    rc = vfs_resolve_stack_push(ctx, path, rp);
    ASSERT(rc == 0);
 
+   if (*path != '/' && dirfd != AT_FDCWD) {
+      /* Drop the ref taken by get_locked_retained_dirfd(): the stack has one */
+      vfs_release_inode_at(rp);
+   }
+
    rc = __vfs_resolve(ctx, res_last_sl);
 
    /* At the end, resolve() must use exactly 1 stack frame */
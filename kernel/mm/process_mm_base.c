@@ -139,15 +139,10 @@ void full_remove_user_mapping(struct process *pi, struct user_mapping *um)
 
 void remove_all_file_mappings(struct process *pi)
 {
-   fs_handle *h;
+   int fd;
 
-   for (u32 i = 0; i < MAX_HANDLES; i++) {
-
-      if (!(h = pi->handles[i]))
-         continue;
-
-      remove_all_mappings_of_handle(pi, h);
-   }
+   for_each_used_fd(pi, fd)
+      remove_all_mappings_of_handle(pi, pi->handles[fd]);
 }
 
 struct mappings_info *
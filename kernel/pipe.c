@@ -2,22 +2,34 @@
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/atomics.h>
+#include <tilck/common/string_util.h>
 
 #include <tilck/kernel/kmalloc.h>
 #include <tilck/kernel/fs/vfs.h>
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/pipe.h>
 #include <tilck/kernel/fs/kernelfs.h>
-#include <tilck/kernel/ringbuf.h>
 #include <tilck/kernel/sync.h>
 #include <tilck/kernel/sched.h>
 
+/*
+ * The pipe's buffer: a ring of `npages` page-size buffers, allocated one by
+ * one in order to never require large contiguous allocations. Its capacity
+ * can be changed with fcntl(F_SETPIPE_SZ).
+ */
+struct pipe_ring {
+
+   void **pages;
+   u32 npages;                /* always a power of 2 */
+   u32 rpos;                  /* read offset in the ring, in bytes */
+   u32 used;                  /* bytes in the ring */
+};
+
 struct pipe {
 
    KOBJ_BASE_FIELDS
 
-   char *buf;
-   struct ringbuf rb;
+   struct pipe_ring ring;
    struct kmutex mutex;
    struct kcond not_full_cond;
    struct kcond not_empty_cond;
@@ -27,6 +39,85 @@ struct pipe {
    ATOMIC(int) write_handles;
 };
 
+static ALWAYS_INLINE u32 ring_cap(struct pipe_ring *r)
+{
+   return r->npages << PAGE_SHIFT;
+}
+
+static ALWAYS_INLINE bool ring_is_empty(struct pipe_ring *r)
+{
+   return r->used == 0;
+}
+
+static ALWAYS_INLINE bool ring_is_full(struct pipe_ring *r)
+{
+   return r->used == ring_cap(r);
+}
+
+static void ring_destroy(struct pipe_ring *r)
+{
+   for (u32 i = 0; i < r->npages; i++) {
+      if (r->pages[i])
+         kfree2(r->pages[i], PAGE_SIZE);
+   }
+
+   kfree_array_obj(r->pages, void *, r->npages);
+   bzero(r, sizeof(*r));
+}
+
+static int ring_init(struct pipe_ring *r, u32 npages)
+{
+   ASSERT(npages > 0 && !(npages & (npages - 1)));
+   bzero(r, sizeof(*r));
+
+   if (!(r->pages = kzalloc_array_obj(void *, npages)))
+      return -ENOMEM;
+
+   r->npages = npages;
+
+   for (u32 i = 0; i < npages; i++) {
+      if (!(r->pages[i] = kmalloc(PAGE_SIZE))) {
+         ring_destroy(r);
+         return -ENOMEM;
+      }
+   }
+
+   return 0;
+}
+
+static size_t ring_read(struct pipe_ring *r, char *buf, size_t size)
+{
+   const u32 n = (u32)MIN(size, (size_t)r->used);
+   u32 off, chunk;
+
+   for (u32 done = 0; done < n; done += chunk) {
+      off = r->rpos & (PAGE_SIZE - 1);
+      chunk = MIN(n - done, (u32)PAGE_SIZE - off);
+      memcpy(buf + done, (char *)r->pages[r->rpos >> PAGE_SHIFT] + off, chunk);
+      r->rpos = (r->rpos + chunk) & (ring_cap(r) - 1);
+   }
+
+   r->used -= n;
+   return n;
+}
+
+static size_t ring_write(struct pipe_ring *r, const char *buf, size_t size)
+{
+   const u32 n = (u32)MIN(size, (size_t)(ring_cap(r) - r->used));
+   u32 wpos = (r->rpos + r->used) & (ring_cap(r) - 1);
+   u32 off, chunk;
+
+   for (u32 done = 0; done < n; done += chunk) {
+      off = wpos & (PAGE_SIZE - 1);
+      chunk = MIN(n - done, (u32)PAGE_SIZE - off);
+      memcpy((char *)r->pages[wpos >> PAGE_SHIFT] + off, buf + done, chunk);
+      wpos = (wpos + chunk) & (ring_cap(r) - 1);
+   }
+
+   r->used += n;
+   return n;
+}
+
 static ssize_t pipe_read(fs_handle h, char *buf, size_t size, offt *pos)
 {
    struct kfs_handle *kh = h;
@@ -42,7 +133,7 @@ static ssize_t pipe_read(fs_handle h, char *buf, size_t size, offt *pos)
 
    while (true) {
 
-      rc = (ssize_t)ringbuf_read_bytes(&p->rb, (u8 *)buf, size);
+      rc = (ssize_t)ring_read(&p->ring, buf, size);
 
       if (rc)
          break; /* Everything is alright, we read something */
@@ -81,7 +172,7 @@ static ssize_t pipe_read(fs_handle h, char *buf, size_t size, offt *pos)
     */
    kcond_signal_one(&p->not_full_cond);
 
-   if (!ringbuf_is_empty(&p->rb)) {
+   if (!ring_is_empty(&p->ring)) {
       /* The buffer is not empty: wake up one more reader, if any */
       kcond_signal_one(&p->not_empty_cond);
    }
@@ -114,7 +205,7 @@ static ssize_t pipe_write(fs_handle h, char *buf, size_t size, offt *pos)
          break;
       }
 
-      rc = (ssize_t)ringbuf_write_bytes(&p->rb, (u8 *)buf, size);
+      rc = (ssize_t)ring_write(&p->ring, buf, size);
 
       if (rc)
          break; /* Everything is alright, we wrote something */
@@ -140,7 +231,7 @@ static ssize_t pipe_write(fs_handle h, char *buf, size_t size, offt *pos)
     */
    kcond_signal_one(&p->not_empty_cond);
 
-   if (!ringbuf_is_full(&p->rb)) {
+   if (!ring_is_full(&p->ring)) {
       /* The buffer is not full: wake up one more writer, if any */
       kcond_signal_one(&p->not_full_cond);
    }
@@ -158,7 +249,7 @@ static int pipe_read_ready(fs_handle h)
 
    kmutex_lock(&p->mutex);
    {
-      ret = !ringbuf_is_empty(&p->rb) ||
+      ret = !ring_is_empty(&p->ring) ||
             atomic_load_explicit(&p->write_handles, mo_relaxed) == 0;
    }
    kmutex_unlock(&p->mutex);
@@ -180,7 +271,7 @@ static int pipe_write_ready(fs_handle h)
 
    kmutex_lock(&p->mutex);
    {
-      ret = !ringbuf_is_full(&p->rb) ||
+      ret = !ring_is_full(&p->ring) ||
             atomic_load_explicit(&p->read_handles, mo_relaxed) == 0;
    }
    kmutex_unlock(&p->mutex);
@@ -243,8 +334,7 @@ void destroy_pipe(struct pipe *p)
    kcond_destory(&p->not_empty_cond);
    kcond_destory(&p->not_full_cond);
    kmutex_destroy(&p->mutex);
-   ringbuf_destory(&p->rb);
-   kfree2(p->buf, PIPE_BUF_SIZE);
+   ring_destroy(&p->ring);
    kfree_obj(p, struct pipe);
 }
 
@@ -288,7 +378,7 @@ struct pipe *create_pipe(void)
    if (!(p = (void *)kzalloc_obj(struct pipe)))
       return NULL;
 
-   if (!(p->buf = kmalloc(PIPE_BUF_SIZE))) {
+   if (ring_init(&p->ring, PIPE_BUF_SIZE / PAGE_SIZE)) {
       kfree_obj(p, struct pipe);
       return NULL;
    }
@@ -296,7 +386,6 @@ struct pipe *create_pipe(void)
    p->on_handle_close = &pipe_on_handle_close;
    p->on_handle_dup = &pipe_on_handle_dup;
    p->destory_obj = (void *)&destroy_pipe;
-   ringbuf_init(&p->rb, PIPE_BUF_SIZE, 1, p->buf);
    kmutex_init(&p->mutex, 0);
    kcond_init(&p->not_full_cond);
    kcond_init(&p->not_empty_cond);
@@ -304,6 +393,91 @@ struct pipe *create_pipe(void)
    return p;
 }
 
+static struct pipe *get_pipe(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+
+   if (kh->fops != &static_ops_pipe_read_end &&
+       kh->fops != &static_ops_pipe_write_end)
+   {
+      return NULL;
+   }
+
+   return (void *)kh->kobj;
+}
+
+/* fcntl(F_GETPIPE_SZ) */
+int pipe_get_size(fs_handle h)
+{
+   struct pipe *p = get_pipe(h);
+   int ret;
+
+   if (!p)
+      return -EBADF;
+
+   kmutex_lock(&p->mutex);
+   {
+      ret = (int)ring_cap(&p->ring);
+   }
+   kmutex_unlock(&p->mutex);
+   return ret;
+}
+
+/*
+ * fcntl(F_SETPIPE_SZ): like on Linux, the size is rounded up to a power-of-2
+ * number of pages and it cannot be smaller than the data currently in the
+ * pipe. Returns the new size.
+ */
+int pipe_set_size(fs_handle h, int size)
+{
+   struct pipe *p = get_pipe(h);
+   struct pipe_ring new_ring;
+   u32 npages = 1;
+   int rc = 0;
+
+   if (!p)
+      return -EBADF;
+
+   if (size < 0)
+      return -EINVAL;
+
+   if (size > PIPE_MAX_SIZE)
+      return -EPERM;
+
+   while ((npages << PAGE_SHIFT) < (u32)size)
+      npages *= 2;
+
+   kmutex_lock(&p->mutex);
+
+   if (npages == p->ring.npages)
+      goto out;
+
+   if (p->ring.used > (npages << PAGE_SHIFT)) {
+      rc = -EBUSY;
+      goto out;
+   }
+
+   if ((rc = ring_init(&new_ring, npages)))
+      goto out;
+
+   /* Move the data at the beginning of the new ring */
+   for (u32 i = 0; !ring_is_empty(&p->ring); i++)
+      new_ring.used += ring_read(&p->ring, new_ring.pages[i], PAGE_SIZE);
+
+   ring_destroy(&p->ring);
+   p->ring = new_ring;
+
+   /* There might be more room now: wake up the writers */
+   kcond_signal_all(&p->not_full_cond);
+
+out:
+   if (!rc)
+      rc = (int)ring_cap(&p->ring);
+
+   kmutex_unlock(&p->mutex);
+   return rc;
+}
+
 fs_handle pipe_create_read_handle(struct pipe *p)
 {
    fs_handle res = NULL;
@@ -191,6 +191,7 @@ void init_task_lists(struct task *ti)
 void init_process_lists(struct process *pi)
 {
    list_init(&pi->children);
+   list_init(&pi->aio_ctxs);
    kmutex_init(&pi->fslock, KMUTEX_FL_RECURSIVE);
 }
 
@@ -213,6 +214,12 @@ allocate_new_process(struct task *parent, int pid, pdir_t *new_pdir)
    memcpy(ti, parent, sizeof(struct task));
    memcpy(pi, parent_pi, sizeof(struct process));
 
+   /* NOTE: nothing else has been allocated yet */
+   if (UNLIKELY(fd_table_copy(pi, parent_pi) < 0)) {
+      kfree2(ti, TOT_PROC_AND_TASK_SIZE);
+      return NULL;
+   }
+
    if (MOD_debugpanel) {
 
       if (UNLIKELY(!(pi->debug_cmdline = kzmalloc(PROCESS_CMDLINE_BUF_SIZE))))
@@ -233,6 +240,7 @@ allocate_new_process(struct task *parent, int pid, pdir_t *new_pdir)
    pi->automatic_reaping = false;
    pi->cwd.fs = NULL;
    pi->vforked = false;
+   pi->sys_stats = NULL;
 
    if (new_pdir != parent_pi->pdir) {
 
@@ -300,6 +308,7 @@ oom_case:
       }
 
       process_free_mappings_info(ti->pi);
+      fd_table_destroy(pi);
 
       if (MOD_debugpanel && pi->debug_cmdline)
          kfree2(pi->debug_cmdline, PROCESS_CMDLINE_BUF_SIZE);
@@ -353,6 +362,8 @@ static void free_process_int(struct process *pi)
    if (release_obj(pi) == 0) {
 
       arch_specific_free_proc(pi);
+      fd_table_destroy(pi);
+      sys_stats_free_proc(pi);
       kfree2(get_process_task(pi), TOT_PROC_AND_TASK_SIZE);
 
       if (MOD_debugpanel)
@@ -0,0 +1,500 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+#include <tilck/common/syscalls.h>
+
+#include <tilck/kernel/profiler.h>
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/elf_utils.h>
+#include <tilck/kernel/debug_utils.h>
+#include <tilck/kernel/sort.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/errno.h>
+
+/*
+ * Sampling profiler. While it's running, on each timer tick the IRQ handler
+ * records the interrupted IP, the mode (kernel/user) and a few return
+ * addresses, obtained by walking the frame pointers. Samples are appended to
+ * a fixed-size array, allocated on the first start: once it's full, further
+ * samples are just counted as dropped, until the next reset.
+ *
+ * The reports aggregate the samples at the moment they're requested and
+ * symbolize the kernel addresses with find_sym_at_addr(). Because that does
+ * a linear search in the symbol table, its results are cached.
+ */
+
+#define PROF_FLAT_MAX_ENTRIES                  512
+#define PROF_CG_MAX_ENTRIES                    128
+#define PROF_REPORT_MAX_FUNCS                   64
+#define PROF_REPORT_MAX_STACKS                  32
+#define PROF_REPORT_MAX_SIZE             (64 * KB)
+#define PROF_SYM_CACHE_SIZE                    256
+
+struct prof_sym {
+
+   ulong va;
+   ulong start;
+   const char *name;
+};
+
+struct prof_report {
+
+   char *buf;
+   size_t size;
+   size_t used;
+};
+
+volatile bool __prof_running;
+
+static struct prof_sample *samples;
+static u32 samples_count;
+static u32 user_samples_count;
+static u32 dropped_samples;
+static struct prof_sym sym_cache[PROF_SYM_CACHE_SIZE];
+static struct kmutex prof_lock = STATIC_KMUTEX_INIT(prof_lock, 0);
+
+void prof_sample(regs_t *r)
+{
+   struct prof_sample *s;
+   ASSERT(!are_interrupts_enabled());
+
+   if (samples_count == PROF_MAX_SAMPLES) {
+      dropped_samples++;
+      return;
+   }
+
+   s = &samples[samples_count];
+   s->ip = (ulong)regs_get_ip(r);
+   s->user = regs_in_user_mode(r);
+   s->pid = get_curr_pid();
+   s->nframes = (u8)regs_stackwalk(r, s->frames, PROF_MAX_FRAMES);
+
+   /* Publish the sample only once it's complete */
+   user_samples_count += s->user;
+   samples_count++;
+}
+
+int prof_start(void)
+{
+   int rc = 0;
+
+   kmutex_lock(&prof_lock);
+   {
+      if (!samples)
+         samples = vmalloc(PROF_MAX_SAMPLES * sizeof(struct prof_sample));
+
+      if (samples)
+         __prof_running = true;
+      else
+         rc = -ENOMEM;
+   }
+   kmutex_unlock(&prof_lock);
+   return rc;
+}
+
+void prof_stop(void)
+{
+   __prof_running = false;
+}
+
+void prof_reset(void)
+{
+   ulong var;
+   kmutex_lock(&prof_lock);
+   {
+      disable_interrupts(&var);
+      {
+         samples_count = 0;
+         user_samples_count = 0;
+         dropped_samples = 0;
+      }
+      enable_interrupts(&var);
+   }
+   kmutex_unlock(&prof_lock);
+}
+
+void prof_get_stats(struct prof_stats *s)
+{
+   ulong var;
+   disable_interrupts(&var);
+   {
+      *s = (struct prof_stats) {
+         .samples = samples_count,
+         .user_samples = user_samples_count,
+         .dropped = dropped_samples,
+         .running = __prof_running,
+      };
+   }
+   enable_interrupts(&var);
+}
+
+static const char *
+prof_resolve(ulong va, ulong *start)
+{
+   struct prof_sym *e = &sym_cache[(va >> 2) % PROF_SYM_CACHE_SIZE];
+   const char *name;
+   long off;
+
+   if (e->va != va) {
+
+      name = find_sym_at_addr(va, &off, NULL);
+
+      *e = (struct prof_sym) {
+         .va = va,
+         .start = name ? va - (ulong)off : va,
+         .name = name,
+      };
+   }
+
+   *start = e->start;
+   return e->name;
+}
+
+/*
+ * Symbolize the stack of a kernel sample, innermost function first. User
+ * addresses are kept as they are. Returns the number of functions.
+ */
+static u8
+prof_resolve_sample(struct prof_sample *s, ulong *addrs, const char **names)
+{
+   for (u8 i = 0; i <= s->nframes; i++) {
+
+      /*
+       * Return addresses point to the instruction after the call, which
+       * might belong to the next function when the callee is NORETURN:
+       * resolve the address of the call itself instead.
+       */
+      const ulong va = i ? s->frames[i - 1] - 1 : s->ip;
+
+      addrs[i] = va;
+      names[i] = s->user ? NULL : prof_resolve(va, &addrs[i]);
+   }
+
+   return 1 + s->nframes;
+}
+
+static struct prof_flat_entry *
+prof_flat_get_entry(struct prof_flat_entry *arr,
+                    u32 *count,
+                    u32 max_count,
+                    ulong addr,
+                    const char *name,
+                    int pid)
+{
+   for (u32 i = 0; i < *count; i++)
+      if (arr[i].addr == addr && arr[i].pid == pid)
+         return &arr[i];
+
+   if (*count == max_count)
+      return NULL;
+
+   arr[*count] = (struct prof_flat_entry) {
+      .addr = addr,
+      .name = name,
+      .pid = pid,
+   };
+
+   return &arr[(*count)++];
+}
+
+static long prof_flat_cmp(const void *a, const void *b)
+{
+   const struct prof_flat_entry *x = a;
+   const struct prof_flat_entry *y = b;
+
+   if (x->self != y->self)
+      return (long)y->self - (long)x->self;
+
+   return (long)y->total - (long)x->total;
+}
+
+static long prof_cg_cmp(const void *a, const void *b)
+{
+   const struct prof_cg_entry *x = a;
+   const struct prof_cg_entry *y = b;
+   return (long)y->count - (long)x->count;
+}
+
+static bool
+prof_addr_seen(const ulong *addrs, u8 n, ulong addr)
+{
+   for (u8 i = 0; i < n; i++)
+      if (addrs[i] == addr)
+         return true;
+
+   return false;
+}
+
+/*
+ * Per-function self and total samples. The inclusive (total) count makes
+ * sense only for kernel functions: user return addresses cannot be mapped
+ * to the functions they belong to, so for user entries total == self.
+ */
+u32 prof_get_flat(struct prof_flat_entry *arr, u32 max_count)
+{
+   ulong addrs[1 + PROF_MAX_FRAMES];
+   const char *names[1 + PROF_MAX_FRAMES];
+   struct prof_flat_entry *e;
+   u32 count = 0;
+   u8 n;
+
+   kmutex_lock(&prof_lock);
+   {
+      const u32 tot = samples_count;
+
+      for (u32 i = 0; i < tot; i++) {
+
+         struct prof_sample *s = &samples[i];
+         const int pid = s->user ? s->pid : -1;
+
+         n = prof_resolve_sample(s, addrs, names);
+         n = s->user ? 1 : n;
+
+         for (u8 j = 0; j < n; j++) {
+
+            /* Count recursive functions only once per sample */
+            if (prof_addr_seen(addrs, j, addrs[j]))
+               continue;
+
+            e = prof_flat_get_entry(arr, &count, max_count,
+                                    addrs[j], names[j], pid);
+
+            if (!e)
+               continue;
+
+            e->self += !j;
+            e->total++;
+         }
+      }
+   }
+   kmutex_unlock(&prof_lock);
+
+   insertion_sort_generic(arr, sizeof(arr[0]), count, prof_flat_cmp);
+   return count;
+}
+
+static struct prof_cg_entry *
+prof_cg_get_entry(struct prof_cg_entry *arr,
+                  u32 *count,
+                  u32 max_count,
+                  const ulong *addrs,
+                  const char **names,
+                  u8 n,
+                  int pid)
+{
+   const size_t sz = n * sizeof(addrs[0]);
+
+   for (u32 i = 0; i < *count; i++) {
+
+      if (arr[i].pid != pid || arr[i].n != n)
+         continue;
+
+      if (!memcmp(arr[i].addrs, addrs, sz))
+         return &arr[i];
+   }
+
+   if (*count == max_count)
+      return NULL;
+
+   arr[*count] = (struct prof_cg_entry) {
+      .pid = pid,
+      .n = n,
+   };
+
+   memcpy(arr[*count].addrs, addrs, sz);
+   memcpy(arr[*count].names, names, n * sizeof(names[0]));
+   return &arr[(*count)++];
+}
+
+/* The most common stacks, each one counted once per sample */
+u32 prof_get_callgraph(struct prof_cg_entry *arr, u32 max_count)
+{
+   ulong addrs[1 + PROF_MAX_FRAMES];
+   const char *names[1 + PROF_MAX_FRAMES];
+   struct prof_cg_entry *e;
+   u32 count = 0;
+   u8 n;
+
+   kmutex_lock(&prof_lock);
+   {
+      const u32 tot = samples_count;
+
+      for (u32 i = 0; i < tot; i++) {
+
+         struct prof_sample *s = &samples[i];
+
+         n = prof_resolve_sample(s, addrs, names);
+         e = prof_cg_get_entry(arr, &count, max_count,
+                               addrs, names, n, s->user ? s->pid : -1);
+
+         if (e)
+            e->count++;
+      }
+   }
+   kmutex_unlock(&prof_lock);
+
+   insertion_sort_generic(arr, sizeof(arr[0]), count, prof_cg_cmp);
+   return count;
+}
+
+static void ATTR_PRINTF_LIKE(2)
+prof_rep(struct prof_report *r, const char *fmt, ...)
+{
+   va_list args;
+
+   if (r->used + 1 >= r->size)
+      return;
+
+   va_start(args, fmt);
+   r->used += (size_t)vsnprintk(r->buf + r->used, r->size - r->used, fmt, args);
+   va_end(args);
+}
+
+static void
+prof_rep_func(struct prof_report *r, ulong addr, const char *name, int pid)
+{
+   if (name)
+      prof_rep(r, "%s\n", name);
+   else if (pid >= 0)
+      prof_rep(r, "[pid %d] %p\n", pid, TO_PTR(addr));
+   else
+      prof_rep(r, "%p\n", TO_PTR(addr));
+}
+
+static void
+prof_rep_percent(struct prof_report *r, u32 val, u32 tot)
+{
+   const u32 pm = tot ? (u32)((u64)val * 1000 / tot) : 0;
+   prof_rep(r, "%3u.%u%%  ", pm / 10, pm % 10);
+}
+
+static void
+prof_rep_flat(struct prof_report *r, u32 tot)
+{
+   struct prof_flat_entry *arr;
+   u32 count;
+
+   arr = kalloc_array_obj(struct prof_flat_entry, PROF_FLAT_MAX_ENTRIES);
+
+   if (!arr) {
+      prof_rep(r, "ERROR: out of memory\n");
+      return;
+   }
+
+   count = prof_get_flat(arr, PROF_FLAT_MAX_ENTRIES);
+   prof_rep(r, "  Self     Total    Function\n");
+
+   for (u32 i = 0; i < MIN(count, (u32)PROF_REPORT_MAX_FUNCS); i++) {
+      prof_rep_percent(r, arr[i].self, tot);
+      prof_rep_percent(r, arr[i].total, tot);
+      prof_rep_func(r, arr[i].addr, arr[i].name, arr[i].pid);
+   }
+
+   kfree_array_obj(arr, struct prof_flat_entry, PROF_FLAT_MAX_ENTRIES);
+}
+
+static void
+prof_rep_callgraph(struct prof_report *r, u32 tot)
+{
+   struct prof_cg_entry *arr;
+   u32 count;
+
+   arr = kalloc_array_obj(struct prof_cg_entry, PROF_CG_MAX_ENTRIES);
+
+   if (!arr) {
+      prof_rep(r, "ERROR: out of memory\n");
+      return;
+   }
+
+   count = prof_get_callgraph(arr, PROF_CG_MAX_ENTRIES);
+   prof_rep(r, "  Samples          Stack\n");
+
+   for (u32 i = 0; i < MIN(count, (u32)PROF_REPORT_MAX_STACKS); i++) {
+
+      struct prof_cg_entry *e = &arr[i];
+
+      prof_rep(r, "%7u  ", e->count);
+      prof_rep_percent(r, e->count, tot);
+      prof_rep_func(r, e->addrs[0], e->names[0], e->pid);
+
+      for (u8 j = 1; j < e->n; j++) {
+         prof_rep(r, "%18s<- ", "");
+         prof_rep_func(r, e->addrs[j], e->names[j], -1);
+      }
+   }
+
+   kfree_array_obj(arr, struct prof_cg_entry, PROF_CG_MAX_ENTRIES);
+}
+
+/*
+ * Write a text report in `buf`, always NUL-terminated. Returns the length of
+ * the report (truncated if `buf` is too small).
+ */
+int prof_write_report(char *buf, size_t buf_size, bool callgraph)
+{
+   struct prof_report r = { .buf = buf, .size = buf_size };
+   struct prof_stats s;
+
+   ASSERT(buf_size > 0);
+   buf[0] = 0;
+   prof_get_stats(&s);
+
+   prof_rep(&r, "Profiler: %s, samples: %u (user: %u), dropped: %u\n\n",
+            s.running ? "running" : "stopped",
+            s.samples, s.user_samples, s.dropped);
+
+   if (callgraph)
+      prof_rep_callgraph(&r, s.samples);
+   else
+      prof_rep_flat(&r, s.samples);
+
+   return (int)MIN(r.used, buf_size - 1);
+}
+
+int sys_tilck_profiler(int cmd, char *user_buf, size_t buf_size)
+{
+   char *buf;
+   int rc;
+
+   switch (cmd) {
+
+      case TILCK_PROF_START:
+         return prof_start();
+
+      case TILCK_PROF_STOP:
+         prof_stop();
+         return 0;
+
+      case TILCK_PROF_RESET:
+         prof_reset();
+         return 0;
+
+      case TILCK_PROF_REPORT_FLAT:
+      case TILCK_PROF_REPORT_CALLGRAPH:
+         break;
+
+      default:
+         return -EINVAL;
+   }
+
+   if (!buf_size)
+      return -EINVAL;
+
+   buf_size = MIN(buf_size, PROF_REPORT_MAX_SIZE);
+
+   if (!(buf = kmalloc(buf_size)))
+      return -ENOMEM;
+
+   rc = prof_write_report(buf, buf_size, cmd == TILCK_PROF_REPORT_CALLGRAPH);
+
+   if (copy_to_user(user_buf, buf, (size_t)rc + 1))
+      rc = -EFAULT;
+
+   kfree2(buf, buf_size);
+   return rc;
+}
@@ -0,0 +1,161 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/syscalls.h>
+
+#include <sys/resource.h>     // system header
+
+/*
+ * Tilck enforces only RLIMIT_NOFILE: all the other limits are reported as
+ * RLIM_INFINITY and the attempts to change them are silently ignored.
+ */
+
+static void
+get_rlimit(struct process *pi, int res, struct k_rlimit64 *rl)
+{
+   if (res == RLIMIT_NOFILE) {
+      rl->rlim_cur = pi->nofile_cur;
+      rl->rlim_max = pi->nofile_max;
+   } else {
+      rl->rlim_cur = K_RLIM64_INFINITY;
+      rl->rlim_max = K_RLIM64_INFINITY;
+   }
+}
+
+static int
+set_rlimit(struct process *pi, int res, const struct k_rlimit64 *rl)
+{
+   if (rl->rlim_cur > rl->rlim_max)
+      return -EINVAL;
+
+   if (res != RLIMIT_NOFILE)
+      return 0;
+
+   /*
+    * Like on Linux, the RLIMIT_NOFILE limit cannot exceed `nr_open`, even for
+    * privileged processes. Lowering it below the highest fd in use is fine:
+    * the open fds just stay open.
+    */
+   if (rl->rlim_max > NOFILE_MAX)
+      return -EPERM;
+
+   pi->nofile_cur = (u32)rl->rlim_cur;
+   pi->nofile_max = (u32)rl->rlim_max;
+   return 0;
+}
+
+static ulong rlim64_to_ulong(u64 val, ulong inf)
+{
+   return val > (u64)inf ? inf : (ulong)val;
+}
+
+static u64 ulong_to_rlim64(ulong val)
+{
+   return val == K_RLIM_INFINITY ? K_RLIM64_INFINITY : val;
+}
+
+/*
+ * Get and/or set the `resource` limit of the process `pid` (0 means the current
+ * process). Both `new_rl` and `old_rl` are kernel pointers and can be NULL.
+ */
+static int
+do_prlimit(int pid,
+           int resource,
+           const struct k_rlimit64 *new_rl,
+           struct k_rlimit64 *old_rl)
+{
+   struct task *ti;
+   int rc = 0;
+
+   if (!IN_RANGE(resource, 0, RLIM_NLIMITS))
+      return -EINVAL;
+
+   disable_preemption();
+   {
+      ti = pid ? get_task(pid) : get_curr_task();
+
+      if (ti) {
+
+         if (old_rl)
+            get_rlimit(ti->pi, resource, old_rl);
+
+         if (new_rl)
+            rc = set_rlimit(ti->pi, resource, new_rl);
+
+      } else {
+
+         rc = -ESRCH;
+      }
+   }
+   enable_preemption();
+   return rc;
+}
+
+int sys_prlimit64(int pid,
+                  int resource,
+                  const struct k_rlimit64 *u_new_rlim,
+                  struct k_rlimit64 *u_old_rlim)
+{
+   struct k_rlimit64 new_rl, old_rl;
+   int rc;
+
+   if (u_new_rlim && copy_from_user(&new_rl, u_new_rlim, sizeof(new_rl)))
+      return -EFAULT;
+
+   rc = do_prlimit(pid,
+                   resource,
+                   u_new_rlim ? &new_rl : NULL,
+                   u_old_rlim ? &old_rl : NULL);
+
+   if (!rc && u_old_rlim && copy_to_user(u_old_rlim, &old_rl, sizeof(old_rl)))
+      rc = -EFAULT;
+
+   return rc;
+}
+
+static int do_getrlimit(int resource, struct k_rlimit *u_rlim, ulong inf)
+{
+   struct k_rlimit64 rl64;
+   struct k_rlimit rl;
+   int rc;
+
+   if ((rc = do_prlimit(0, resource, NULL, &rl64)))
+      return rc;
+
+   rl.rlim_cur = rlim64_to_ulong(rl64.rlim_cur, inf);
+   rl.rlim_max = rlim64_to_ulong(rl64.rlim_max, inf);
+
+   if (copy_to_user(u_rlim, &rl, sizeof(rl)))
+      return -EFAULT;
+
+   return 0;
+}
+
+int sys_getrlimit(int resource, struct k_rlimit *u_rlim)
+{
+   return do_getrlimit(resource, u_rlim, K_RLIM_INFINITY);
+}
+
+/* The old interface, where RLIM_INFINITY was 0x7fffffff */
+int sys_old_getrlimit(int resource, struct k_rlimit *u_rlim)
+{
+   return do_getrlimit(resource, u_rlim, 0x7fffffff);
+}
+
+int sys_setrlimit(int resource, const struct k_rlimit *u_rlim)
+{
+   struct k_rlimit64 rl64;
+   struct k_rlimit rl;
+
+   if (copy_from_user(&rl, u_rlim, sizeof(rl)))
+      return -EFAULT;
+
+   rl64.rlim_cur = ulong_to_rlim64(rl.rlim_cur);
+   rl64.rlim_max = ulong_to_rlim64(rl.rlim_max);
+   return do_prlimit(0, resource, &rl64, NULL);
+}
@@ -409,6 +409,7 @@ static void create_kernel_process(void)
    s_kernel_ti->pi = s_kernel_pi;
    init_task_lists(s_kernel_ti);
    init_process_lists(s_kernel_pi);
+   fd_table_init(s_kernel_pi);
 
    s_kernel_ti->is_main_thread = true;
    s_kernel_ti->running_in_kernel = true;
@@ -0,0 +1,139 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/utils.h>
+
+#include <tilck/kernel/syscall_stats.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/elf_utils.h>
+#include <tilck/kernel/debug_utils.h>
+
+/*
+ * Always-on per-syscall counters, updated by the arch syscall dispatcher right
+ * after each syscall returns, with preemption disabled. Each process has also
+ * a small table, allocated on its first syscall, with slots for up to
+ * PROC_SYS_STATS_SLOTS different syscalls: calls to other syscalls are just
+ * counted as `untracked` there, but they're still part of the system-wide
+ * stats.
+ *
+ * Resetting the stats zeroes the system-wide table and bumps a generation
+ * counter: the per-process tables with an older generation are considered
+ * empty and get zeroed lazily, on the next syscall of their process.
+ */
+
+#define SYS_MAX_ERRNO                     4095
+
+struct syscall_stats sys_stats[MAX_SYSCALLS];
+static u32 sys_stats_gen;
+
+static void
+sys_stats_add(struct syscall_stats *s, bool err, u64 cycles)
+{
+   const u32 c32 = cycles > 0xffffffff ? 0xffffffff : (u32)cycles;
+   u32 b = 0;
+
+   if (cycles >> SYS_HIST_MIN_SHIFT)
+      b = get_last_set_bit_index64(cycles) - SYS_HIST_MIN_SHIFT;
+
+   s->calls++;
+   s->errors += err;
+   s->tot_cycles += cycles;
+   s->max_cycles = MAX(s->max_cycles, c32);
+   s->hist[MIN(b, (u32)SYS_HIST_BUCKETS - 1)]++;
+}
+
+static struct syscall_stats *
+proc_sys_stats_get_slot(struct proc_sys_stats *ps, u32 sn)
+{
+   const u16 key = (u16)(sn + 1);
+   u32 i = sn % PROC_SYS_STATS_SLOTS;
+
+   for (u32 n = 0; n < PROC_SYS_STATS_SLOTS; n++) {
+
+      if (!ps->sys_n[i])
+         ps->sys_n[i] = key;
+
+      if (ps->sys_n[i] == key)
+         return &ps->s[i];
+
+      i = (i + 1) % PROC_SYS_STATS_SLOTS;
+   }
+
+   return NULL;
+}
+
+void sys_stats_account(u32 sn, ulong ret, u64 cycles)
+{
+   struct process *pi = get_curr_proc();
+   struct proc_sys_stats *ps = pi->sys_stats;
+   const bool err = ret >= (ulong)-SYS_MAX_ERRNO;
+   struct syscall_stats *s;
+
+   ASSERT(!is_preemption_enabled());
+   ASSERT(sn < MAX_SYSCALLS);
+
+   sys_stats_add(&sys_stats[sn], err, cycles);
+
+   if (!ps && !(ps = pi->sys_stats = kzalloc_obj(struct proc_sys_stats)))
+      return; /* Out of memory: just skip the per-process stats */
+
+   if (ps->gen != sys_stats_gen) {
+      bzero(ps, sizeof(*ps));
+      ps->gen = sys_stats_gen;
+   }
+
+   if ((s = proc_sys_stats_get_slot(ps, sn)))
+      sys_stats_add(s, err, cycles);
+   else
+      ps->untracked++;
+}
+
+void sys_stats_reset(void)
+{
+   disable_preemption();
+   {
+      bzero(sys_stats, sizeof(sys_stats));
+      sys_stats_gen++;
+   }
+   enable_preemption();
+}
+
+/*
+ * Returns the stats of the given process, or NULL if it didn't do any syscall
+ * since the last reset. Must be called with preemption disabled.
+ */
+struct proc_sys_stats *sys_stats_get_proc(struct process *pi)
+{
+   struct proc_sys_stats *ps = pi->sys_stats;
+
+   ASSERT(!is_preemption_enabled());
+   return ps && ps->gen == sys_stats_gen ? ps : NULL;
+}
+
+void sys_stats_free_proc(struct process *pi)
+{
+   if (pi->sys_stats) {
+      kfree_obj(pi->sys_stats, struct proc_sys_stats);
+      pi->sys_stats = NULL;
+   }
+}
+
+/* Name of the syscall, without the "sys_" prefix, or NULL if unknown */
+const char *sys_stats_get_name(u32 sn)
+{
+   void *func = get_syscall_func_ptr(sn);
+   const char *name;
+
+   if (!func)
+      return NULL;
+
+   name = find_sym_at_addr((ulong)func, NULL, NULL);
+
+   if (name && !strncmp(name, "sys_", 4))
+      name += 4;
+
+   return name;
+}
@@ -10,6 +10,7 @@
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/gcov.h>
 #include <tilck/kernel/debug_utils.h>
+#include <tilck/kernel/profiler.h>
 
 typedef int (*tilck_cmd_func)();
 static int sys_tilck_run_selftest(const char *user_selftest);
@@ -26,6 +27,7 @@ static void *tilck_cmds[TILCK_CMD_COUNT] = {
    [TILCK_CMD_TRACING_TOOL] = NULL,
    [TILCK_CMD_PS_TOOL] = NULL,
    [TILCK_CMD_DEBUGGER_TOOL] = NULL,
+   [TILCK_CMD_PROFILER] = sys_tilck_profiler,
 };
 
 void register_tilck_cmd(int cmd_n, void *func)
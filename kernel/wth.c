@@ -2,6 +2,7 @@
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/atomics.h>
+#include <tilck/common/string_util.h>
 
 #include <tilck/kernel/worker_thread.h>
 #include <tilck/kernel/kmalloc.h>
@@ -19,6 +20,9 @@
 int worker_threads_cnt;
 struct worker_thread *worker_threads[WTH_MAX_THREADS];
 
+static struct wjob_ovf_node wth_ovf_pool[WTH_OVERFLOW_POOL_SIZE];
+static struct wjob_ovf_node *wth_ovf_free_list;
+
 u32 wth_get_queue_size(struct worker_thread *wth)
 {
    return wth->rb.max_elems;
@@ -40,6 +44,134 @@ wth_get_name(struct worker_thread *wth)
    return wth->name;
 }
 
+struct worker_thread *wth_get_worker(int index)
+{
+   if (index < 0 || index >= worker_threads_cnt)
+      return NULL;
+
+   return worker_threads[index];
+}
+
+static u32 wth_get_depth(struct worker_thread *t)
+{
+   return safe_ringbuf_get_elems(&t->rb) + t->ovf_count;
+}
+
+void wth_get_stats(struct worker_thread *t, struct wth_stats *stats)
+{
+   *stats = (struct wth_stats) {
+      .depth = wth_get_depth(t),
+      .max_depth = t->max_depth,
+      .overflows = t->overflows,
+      .drops = t->drops,
+      .stolen = t->stolen,
+   };
+}
+
+static void wth_init_ovf_pool(void)
+{
+   wth_ovf_free_list = NULL;
+
+   for (int i = 0; i < ARRAY_SIZE(wth_ovf_pool); i++) {
+      wth_ovf_pool[i].next = wth_ovf_free_list;
+      wth_ovf_free_list = &wth_ovf_pool[i];
+   }
+}
+
+static bool
+wth_enqueue_ovf(struct worker_thread *t, struct wjob *job)
+{
+   struct wjob_ovf_node *n;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      if ((n = wth_ovf_free_list)) {
+
+         wth_ovf_free_list = n->next;
+         n->job = *job;
+         n->next = NULL;
+
+         if (t->ovf_tail)
+            t->ovf_tail->next = n;
+         else
+            t->ovf_head = n;
+
+         t->ovf_tail = n;
+         t->ovf_count++;
+         t->overflows++;
+      }
+   }
+   enable_interrupts(&var);
+   return n != NULL;
+}
+
+static bool
+wth_dequeue_ovf(struct worker_thread *t, struct wjob *job)
+{
+   struct wjob_ovf_node *n;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      if ((n = t->ovf_head)) {
+
+         t->ovf_head = n->next;
+
+         if (!t->ovf_head)
+            t->ovf_tail = NULL;
+
+         t->ovf_count--;
+         *job = n->job;
+         n->next = wth_ovf_free_list;
+         wth_ovf_free_list = n;
+      }
+   }
+   enable_interrupts(&var);
+   return n != NULL;
+}
+
+/*
+ * The jobs in the ring buffer are always older than the ones in the overflow
+ * list because, while the list is not empty, wth_enqueue_on() appends there
+ * all the new jobs, even if in the meanwhile some space in the ring buffer
+ * has been freed.
+ */
+static bool
+wth_dequeue_job(struct worker_thread *t, struct wjob *job)
+{
+   if (safe_ringbuf_read_elem(&t->rb, job))
+      return true;
+
+   if (!t->ovf_head)
+      return false;
+
+   return wth_dequeue_ovf(t, job);
+}
+
+static bool
+wth_can_steal_from(struct worker_thread *t, struct worker_thread *v);
+
+/*
+ * `t` is busy and it just got a new job: wake up one idle worker that could
+ * steal it, otherwise the job would wait for `t` even if some worker of the
+ * same pool is sleeping.
+ */
+static void wth_wakeup_thief(struct worker_thread *t)
+{
+   struct worker_thread *w;
+
+   for (int i = 0; i < worker_threads_cnt; i++) {
+
+      w = worker_threads[i];
+
+      if (w->waiting_for_jobs && wth_can_steal_from(w, t)) {
+         wth_wakeup(w);
+         break;
+      }
+   }
+}
+
 static long wth_cmp_func(const void *a, const void *b)
 {
    const struct worker_thread *const *wa = a;
@@ -79,10 +211,43 @@ wth_enqueue_on(struct worker_thread *t, void (*func)(void *), void *arg)
 
 #endif
 
-   success = safe_ringbuf_write_elem(&t->rb, &new_job, &was_empty);
+   if (LIKELY(!t->ovf_head)) {
+      success = safe_ringbuf_write_elem(&t->rb, &new_job, &was_empty);
+   } else {
+      success = false;
+      was_empty = false;
+   }
+
+   if (UNLIKELY(!success)) {
+
+      /*
+       * The ring buffer is full (or we're already using the overflow list):
+       * instead of failing, append the job to the overflow list, as long as
+       * there are free nodes in the shared pool.
+       */
+      success = wth_enqueue_ovf(t, &new_job);
+   }
+
+   if (success) {
+
+      const u32 depth = wth_get_depth(t);
+
+      if (depth > t->max_depth)
+         t->max_depth = depth;
+
+      if (t->waiting_for_jobs) {
+
+         if (was_empty || t->ovf_head)
+            wth_wakeup(t);
+
+      } else {
+
+         wth_wakeup_thief(t);
+      }
+
+   } else {
 
-   if (success && was_empty && t->waiting_for_jobs) {
-      wth_wakeup(t);
+      t->drops++;
    }
 
    enable_preemption();
@@ -141,7 +306,7 @@ bool wth_process_single_job(struct worker_thread *t)
    bool success;
    struct wjob job_to_run;
 
-   success = safe_ringbuf_read_elem(&t->rb, &job_to_run);
+   success = wth_dequeue_job(t, &job_to_run);
 
    if (success) {
       /* Run the job with preemption enabled */
@@ -151,6 +316,94 @@ bool wth_process_single_job(struct worker_thread *t)
    return success;
 }
 
+void wth_set_unordered(struct worker_thread *wth)
+{
+   wth->unordered = true;
+}
+
+/* Workers with the same name (or with no name at all) form a pool */
+static bool
+wth_same_pool(struct worker_thread *a, struct worker_thread *b)
+{
+   if (!a->name || !b->name)
+      return a->name == b->name;
+
+   return !strcmp(a->name, b->name);
+}
+
+static bool
+wth_can_steal_from(struct worker_thread *t, struct worker_thread *v)
+{
+   if (v == t || v->priority < t->priority)
+      return false;
+
+   return wth_same_pool(t, v) || v->unordered;
+}
+
+/*
+ * Called by an idle worker thread, before going to sleep: steal and run a
+ * single job from the queue of another worker thread having the same or a
+ * lower priority, which is busy (e.g. its current job is blocked on a mutex).
+ * That way, a long-blocking job won't delay all the other ones queued after
+ * it. Jobs never run with a priority lower than the one of the worker they
+ * were queued on.
+ *
+ * Jobs can be stolen only by workers of the same pool (see wth_same_pool())
+ * or, from any worker, when their worker has been marked as unordered with
+ * wth_set_unordered(). All the other dedicated workers (e.g. kb, serial)
+ * never get their jobs stolen, because their users rely on jobs being
+ * serialized.
+ */
+bool wth_steal_job(struct worker_thread *t)
+{
+   struct worker_thread *v;
+   struct wjob job;
+   bool stolen;
+
+   for (int i = 0; i < worker_threads_cnt; i++) {
+
+      v = worker_threads[i];
+
+      if (!wth_can_steal_from(t, v))
+         continue;
+
+      if (v->waiting_for_jobs)
+         continue;
+
+      /*
+       * Account the job as running *before* dequeueing it: otherwise, in the
+       * meanwhile `v` might look idle, with an empty queue and no stolen jobs
+       * running, and wth_wait_for_completion() would return too early.
+       */
+      disable_preemption();
+      {
+         v->stolen_running++;
+         stolen = wth_dequeue_job(v, &job);
+
+         if (stolen)
+            v->stolen++;
+         else
+            v->stolen_running--;
+      }
+      enable_preemption();
+
+      if (!stolen)
+         continue;
+
+      job.func(job.arg);
+
+      disable_preemption();
+      {
+         if (!--v->stolen_running && v->waiting_for_jobs)
+            kcond_signal_all(&v->completion);
+      }
+      enable_preemption();
+      return true;
+   }
+
+   return false;
+}
+
 void wth_run(void *arg)
 {
    struct worker_thread *t = arg;
@@ -170,9 +423,12 @@ void wth_run(void *arg)
 
       } while (job_run);
 
+      if (wth_steal_job(t))
+         continue;
+
       disable_interrupts_forced();
       {
-         if (safe_ringbuf_is_empty(&t->rb)) {
+         if (safe_ringbuf_is_empty(&t->rb) && !t->ovf_head) {
             t->task->state = TASK_STATE_SLEEPING;
             t->waiting_for_jobs = true;
          }
@@ -257,7 +513,8 @@ wth_create_thread(const char *name, int priority, u16 queue_size)
 void
 wth_wait_for_completion(struct worker_thread *wth)
 {
-   while (!wth->waiting_for_jobs)
+   /* Jobs stolen from `wth` might still be running on other workers */
+   while (!wth->waiting_for_jobs || wth->stolen_running)
       kcond_wait(&wth->completion, NULL, TIMER_HZ / 10);
 }
 
@@ -271,5 +528,6 @@ init_wth_create_worker_or_die(int prio, u16 queue_size)
 void init_worker_threads(void)
 {
    worker_threads_cnt = 0;
+   wth_init_ovf_pool();
    init_wth_create_worker_or_die(0, WTH_MAX_PRIO_QUEUE_SIZE);
 }
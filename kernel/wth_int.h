@@ -9,6 +9,16 @@ struct wjob {
    void *arg;
 };
 
+/*
+ * Node of the overflow list of a worker thread. Nodes are taken from a static
+ * pool shared by all the worker threads, because jobs are often enqueued by
+ * IRQ handlers, where we cannot allocate memory.
+ */
+struct wjob_ovf_node {
+   struct wjob job;
+   struct wjob_ovf_node *next;
+};
+
 struct worker_thread {
 
    const char *name;
@@ -18,6 +28,19 @@ struct worker_thread {
    struct kcond completion;
    int priority;              /* 0 is the max priority */
    volatile bool waiting_for_jobs;
+   bool unordered;            /* see wth_set_unordered() */
+   u32 stolen_running;        /* stolen jobs still running elsewhere */
+
+   /* Jobs enqueued while `rb` was full, in FIFO order */
+   struct wjob_ovf_node *ovf_head;
+   struct wjob_ovf_node *ovf_tail;
+   u32 ovf_count;
+
+   /* Stats */
+   u32 max_depth;             /* max number of pending jobs ever reached */
+   u32 overflows;             /* jobs that ended up in the overflow list */
+   u32 drops;                 /* jobs that could not be enqueued at all */
+   u32 stolen;                /* jobs stolen by other worker threads */
 };
 
 extern struct worker_thread *worker_threads[WTH_MAX_THREADS];
@@ -26,4 +49,5 @@ extern int worker_threads_cnt;
 void wth_run(void *arg);
 void wth_wakeup(struct worker_thread *t);
 bool wth_process_single_job(struct worker_thread *t);
+bool wth_steal_job(struct worker_thread *t);
 int wth_create_thread_for(struct worker_thread *t);
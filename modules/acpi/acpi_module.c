@@ -10,6 +10,7 @@
 #include <tilck/kernel/hal.h>
 #include <tilck/kernel/debug_utils.h>
 #include <tilck/kernel/cmdline.h>
+#include <tilck/kernel/arch/generic_x86/apic.h>
 
 #include <tilck/mods/pci.h>
 #include <tilck/mods/acpi.h>
@@ -150,6 +151,83 @@ acpi_read_acpi_hw_flags(void)
    AcpiPutTable((struct acpi_table_header *)fadt);
 }
 
+static void
+acpi_read_madt_irq_override(struct acpi_madt_interrupt_override *ovr)
+{
+   u32 flags = 0;
+
+   if (ovr->Bus != 0)
+      return; /* Only ISA is supported */
+
+   if ((ovr->IntiFlags & ACPI_MADT_POLARITY_MASK) ==
+       ACPI_MADT_POLARITY_ACTIVE_LOW)
+   {
+      flags |= APIC_IRQ_FL_ACTIVE_LOW;
+   }
+
+   if ((ovr->IntiFlags & ACPI_MADT_TRIGGER_MASK) == ACPI_MADT_TRIGGER_LEVEL)
+      flags |= APIC_IRQ_FL_LEVEL;
+
+   printk("ACPI: MADT: ISA IRQ %u -> GSI %u%s%s\n",
+          ovr->SourceIrq, ovr->GlobalIrq,
+          flags & APIC_IRQ_FL_LEVEL ? ", level" : "",
+          flags & APIC_IRQ_FL_ACTIVE_LOW ? ", active low" : "");
+
+   apic_add_irq_override(ovr->SourceIrq, ovr->GlobalIrq, flags);
+}
+
+static void
+acpi_read_madt(void)
+{
+   ACPI_STATUS rc;
+   struct acpi_table_madt *madt;
+   struct acpi_subtable_header *it;
+   struct acpi_madt_io_apic *io;
+   struct acpi_madt_local_apic_override *lovr;
+   char *end;
+
+   rc = AcpiGetTable(ACPI_SIG_MADT, 1, (struct acpi_table_header **)&madt);
+
+   if (rc == AE_NOT_FOUND)
+      return;
+
+   if (ACPI_FAILURE(rc)) {
+      print_acpi_failure("AcpiGetTable", "MADT", rc);
+      return;
+   }
+
+   apic_set_lapic_paddr(madt->Address);
+   it = (void *)((char *)madt + sizeof(*madt));
+   end = (char *)madt + madt->Header.Length;
+
+   while ((char *)it + sizeof(*it) <= end && it->Length > 0) {
+
+      switch (it->Type) {
+
+         case ACPI_MADT_TYPE_IO_APIC:
+            io = (void *)it;
+            apic_add_ioapic(io->Id, io->Address, io->GlobalIrqBase);
+            break;
+
+         case ACPI_MADT_TYPE_INTERRUPT_OVERRIDE:
+            acpi_read_madt_irq_override((void *)it);
+            break;
+
+         case ACPI_MADT_TYPE_LOCAL_APIC_OVERRIDE:
+            lovr = (void *)it;
+            apic_set_lapic_paddr((ulong)lovr->Address);
+            break;
+
+         default:
+            break;
+      }
+
+      it = (void *)((char *)it + it->Length);
+   }
+
+   AcpiPutTable((struct acpi_table_header *)madt);
+}
+
 void
 acpi_reboot(void)
 {
@@ -254,6 +332,7 @@ acpi_mod_init_tables(void)
 
    acpi_init_status = ais_tables_initialized;
    acpi_read_acpi_hw_flags();
+   acpi_read_madt();
 }
 
 void
@@ -15,6 +15,7 @@
 ACPI_MODULE_NAME("osl_tasks")
 
 static struct worker_thread *wth_events;
+static struct worker_thread *wth_notify;
 static struct worker_thread *wth_main;
 static struct worker_thread *wth_debug;
 
@@ -33,6 +34,9 @@ AcpiOsExecute(
    switch (Type) {
 
       case OSL_NOTIFY_HANDLER:
+         wth = wth_notify;
+         break;
+
       case OSL_GPE_HANDLER:
          wth = wth_events;
          break;
@@ -62,6 +66,7 @@ AcpiOsWaitEventsComplete(void)
    ACPI_FUNCTION_TRACE(__FUNC__);
 
    wth_wait_for_completion(wth_events);
+   wth_wait_for_completion(wth_notify);
    wth_wait_for_completion(wth_main);
    wth_wait_for_completion(wth_debug);
 }
@@ -81,10 +86,16 @@ ACPI_STATUS
 osl_init_tasks(void)
 {
    wth_events = osl_create_worker_or_die("acevents", 1, 64);
+   wth_notify = osl_create_worker_or_die("acnotify", 1, 64);
    wth_main = osl_create_worker_or_die("acmain", 2, 64);
 
    if (ACPI_DEBUGGER_ENABLED)
       wth_debug = osl_create_worker_or_die("acdebug", 3, 64);
 
+   /*
+    * Notify handlers are independent from each other (Linux runs them on an
+    * unordered workqueue as well): let idle workers help during bursts.
+    */
+   wth_set_unordered(wth_notify);
    return AE_OK;
 }
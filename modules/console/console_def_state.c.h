@@ -124,6 +124,42 @@ tty_def_state_raw_lf(u8 *c, u8 *color, struct term_action *a, void *ctx_arg)
    return TERM_FILTER_WRITE_C;
 }
 
+/* Bytes < 0x20 or > 0x7e: the SWAR "hasless" and "hasmore" tricks */
+#define HAS_NON_PLAIN_BYTE(w)                                           \
+   (((((w) - 0x20202020u) & ~(w)) | ((w) + 0x01010101u) | (w)) & 0x80808080u)
+
+/*
+ * The term_filter_scan companion of tty_state_default(): with the default
+ * translation table, the chars in [0x20, 0x7e] are written unchanged. Check
+ * 4 bytes at a time, then the tail one byte at a time.
+ */
+static u32
+tty_def_state_scan(const u8 *buf, u32 len, void *ctx_arg)
+{
+   struct twfilter_ctx *const ctx = ctx_arg;
+   struct console_data *const cd = ctx->cd;
+   u32 i = 0, w;
+
+   if (ctx->non_default_state)
+      return 0;
+
+   if (cd->c_sets_tables[cd->c_set] != tty_default_trans_table)
+      return 0;
+
+   for (; i + 4 <= len; i += 4) {
+
+      memcpy(&w, buf + i, 4);
+
+      if (HAS_NON_PLAIN_BYTE(w))
+         break;
+   }
+
+   while (i < len && IN_RANGE_INC(buf[i], 0x20, 0x7e))
+      i++;
+
+   return i;
+}
+
 void tty_update_default_state_tables(struct tty *t)
 {
    const struct termios *const c_term = &t->c_term;
@@ -150,6 +186,9 @@ void tty_update_default_state_tables(struct tty *t)
    cd->def_state_funcs[c_term->c_cc[VERASE]]  = tty_def_state_verase;
    cd->def_state_funcs[c_term->c_cc[VWERASE]] = tty_def_state_vwerase;
    cd->def_state_funcs[c_term->c_cc[VKILL]]   = tty_def_state_vkill;
+
+   if (t->tintf->set_filter_scan)
+      t->tintf->set_filter_scan(t->tstate, tty_def_state_scan);
 }
 
 static enum term_fret
@@ -31,6 +31,7 @@ static const struct actions_table_item actions_table[] = {
    [a_insert_blank_chars]   = ENTRY(ins_blank_chars, 1),
    [a_simple_del_chars]     = ENTRY(del_chars_in_line, 1),
    [a_simple_erase_chars]   = ENTRY(erase_chars_in_line, 1),
+   [a_flush]                = ENTRY(flush, 0),
 };
 
 #undef ENTRY
@@ -147,6 +148,13 @@ vterm_set_filter(term *_t, term_filter func, void *ctx)
    t->filter_ctx = ctx;
 }
 
+static void
+vterm_set_filter_scan(term *_t, term_filter_scan func)
+{
+   struct vterm *const t = _t;
+   t->filter_scan = func;
+}
+
 static bool
 vterm_is_initialized(term *_t)
 {
@@ -110,6 +110,21 @@ term_action_write(struct vterm *const t, const char *buf, u32 len, u8 color)
          continue;
       }
 
+      if (t->filter_scan) {
+
+         /* Fast path: the run of chars the filter would write unchanged */
+         const u32 n = t->filter_scan((const u8 *)buf + i, len - i,
+                                      t->filter_ctx);
+
+         if (n) {
+
+            term_internal_write_plain(t, buf + i, n, color);
+
+            if ((i += n) == len)
+               break;
+         }
+      }
+
       /*
        * NOTE: We MUST store buf[i] in a local variable because the filter
        * function is absolutely allowed to modify its contents!!
@@ -127,7 +142,7 @@ term_action_write(struct vterm *const t, const char *buf, u32 len, u8 color)
    }
 
    if (t->cursor_enabled)
-      vi->move_cursor(t->r, t->c, get_curr_cell_fg_color(t));
+      term_update_cursor(t);
 }
 
 DEFINE_TERM_ACTION_3(write, const char *, u32, u8)
@@ -160,7 +175,7 @@ term_action_move_cur_rel(struct vterm *const t, s16 dr, s16 dc)
    t->c = (u16) CLAMP((int)t->c + dc, 0, t->cols - 1);
 
    if (t->cursor_enabled)
-      t->vi->move_cursor(t->r, t->c, get_curr_cell_fg_color(t));
+      term_update_cursor(t);
 }
 
 DEFINE_TERM_ACTION_2(move_cur_rel, s16, s16)
@@ -193,7 +208,7 @@ term_action_erase_in_display(struct vterm *const t, int mode)
 
          for (u16 col = t->c; col < t->cols; col++) {
             buf_set_entry(t, t->r, col, entry);
-            t->vi->set_char_at(t->r, col, entry);
+            term_set_char_at(t, t->r, col, entry);
          }
 
          for (u16 i = t->r + 1; i < t->rows; i++)
@@ -210,7 +225,7 @@ term_action_erase_in_display(struct vterm *const t, int mode)
 
          for (u16 col = 0; col < t->c; col++) {
             buf_set_entry(t, t->r, col, entry);
-            t->vi->set_char_at(t->r, col, entry);
+            term_set_char_at(t, t->r, col, entry);
          }
 
          break;
@@ -253,14 +268,14 @@ term_action_erase_in_line(struct vterm *const t, int mode)
       case 0:
          for (u16 col = t->c; col < t->cols; col++) {
             buf_set_entry(t, t->r, col, entry);
-            t->vi->set_char_at(t->r, col, entry);
+            term_set_char_at(t, t->r, col, entry);
          }
          break;
 
       case 1:
          for (u16 col = 0; col < t->c; col++) {
             buf_set_entry(t, t->r, col, entry);
-            t->vi->set_char_at(t->r, col, entry);
+            term_set_char_at(t, t->r, col, entry);
          }
          break;
 
@@ -318,7 +333,7 @@ term_action_ins_blank_chars(struct vterm *const t, u16 n)
       buf_row[c] = make_vgaentry(' ', vgaentry_get_color(buf_row[c]));
 
    for (u16 c = t->c; c < t->cols; c++)
-      t->vi->set_char_at(row, c, buf_row[c]);
+      term_set_char_at(t, row, c, buf_row[c]);
 }
 
 DEFINE_TERM_ACTION_1(ins_blank_chars, u16)
@@ -337,7 +352,7 @@ term_action_del_chars_in_line(struct vterm *const t, u16 n)
       buf_row[c] = make_vgaentry(' ', vgaentry_get_color(buf_row[c]));
 
    for (u16 c = t->c; c < t->cols; c++)
-      t->vi->set_char_at(row, c, buf_row[c]);
+      term_set_char_at(t, row, c, buf_row[c]);
 }
 
 DEFINE_TERM_ACTION_1(del_chars_in_line, u16)
@@ -352,7 +367,7 @@ term_action_erase_chars_in_line(struct vterm *const t, u16 n)
       buf_row[c] = make_vgaentry(' ', vgaentry_get_color(buf_row[c]));
 
    for (u16 c = t->c; c < t->cols; c++)
-      t->vi->set_char_at(row, c, buf_row[c]);
+      term_set_char_at(t, row, c, buf_row[c]);
 }
 
 DEFINE_TERM_ACTION_1(erase_chars_in_line, u16)
@@ -374,6 +389,7 @@ static void
 term_action_restart_output(struct vterm *const t)
 {
    t->vi = t->saved_vi;
+   term_invalidate_screen(t);
    term_redraw(t);
 
    if (t->scroll == t->max_scroll)
@@ -497,3 +513,11 @@ term_action_set_scroll_region(struct vterm *const t, u16 start, u16 end)
 }
 
 DEFINE_TERM_ACTION_2(set_scroll_region, u16, u16)
+
+static void
+term_action_flush(struct vterm *const t)
+{
+   term_dmg_flush(t);
+}
+
+DEFINE_TERM_ACTION_0(flush)
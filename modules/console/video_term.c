@@ -15,6 +15,7 @@
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/cmdline.h>
+#include <tilck/kernel/timer.h>
 
 #include "video_term_int.h"
 
@@ -61,13 +62,29 @@ struct vterm {
    bool *main_tabs_buf;
    bool *alt_tabs_buf;
 
+   /*
+    * Damage tracking. When `screen` != NULL, the output is not sent to the
+    * video interface immediately: the touched cells are just marked as damaged
+    * and the refresh thread flushes them at most TERM_REFRESH_HZ times per
+    * second, skipping the cells whose entry didn't change.
+    */
+   u16 *screen;               /* the entries currently shown on the screen */
+   u16 *dmg_start;            /* per-row first damaged col */
+   u16 *dmg_end;              /* per-row last damaged col + 1 */
+   u16 dmg_scroll;            /* pending vi->scroll_one_line_up() calls */
+   bool dmg_pending;          /* there is something to flush */
+   bool screen_invalid;       /* `screen` does not match the real screen */
+   struct term_refresh_stats stats;
+
    struct term_action actions_buf[32];
 
    term_filter filter;
+   term_filter_scan filter_scan;
    void *filter_ctx;
 };
 
 static struct vterm first_instance;
+static bool refresh_thread_created;
 static u16 failsafe_buffer[FAILSAFE_COLS * FAILSAFE_ROWS];
 
 /* ------------ No-output video-interface ------------------ */
@@ -168,6 +185,191 @@ static ALWAYS_INLINE u8 get_curr_cell_fg_color(struct vterm *t)
    return vgaentry_get_fg(buf_get_entry(t, t->r, t->c));
 }
 
+static ALWAYS_INLINE bool term_defer_output(struct vterm *t)
+{
+   return t->screen != NULL && !in_panic();
+}
+
+static ALWAYS_INLINE void
+term_mark_damage(struct vterm *t, u16 row, u16 s, u16 e)
+{
+   t->dmg_start[row] = MIN(t->dmg_start[row], s);
+   t->dmg_end[row] = MAX(t->dmg_end[row], e);
+   t->dmg_pending = true;
+}
+
+static void term_mark_all_damaged(struct vterm *t)
+{
+   memset16(t->dmg_start, 0, t->rows);
+   memset16(t->dmg_end, t->cols, t->rows);
+
+   /*
+    * Every row will be compared with the `screen` copy anyway: the pending
+    * hardware scrolls can be just dropped, as `screen` does not include them.
+    */
+   t->dmg_scroll = 0;
+   t->dmg_pending = true;
+}
+
+static void term_invalidate_screen(struct vterm *t)
+{
+   if (!t->screen)
+      return;
+
+   t->screen_invalid = true;
+   term_mark_all_damaged(t);
+}
+
+static void
+term_flush_row(struct vterm *t, u16 row, bool force, bool fpu_allowed)
+{
+   u16 *const data = get_buf_row(t, row);
+   u16 *const scr = &t->screen[row * t->cols];
+   const u16 s = force ? 0 : t->dmg_start[row];
+   const u16 e = force ? t->cols : t->dmg_end[row];
+   u32 changed = 0;
+
+   t->dmg_start[row] = t->cols;
+   t->dmg_end[row] = 0;
+
+   if (s >= e)
+      return;
+
+   t->stats.rows++;
+
+   if (!force) {
+
+      for (u16 c = s; c < e; c++)
+         changed += data[c] != scr[c];
+
+      t->stats.cells_skipped += e - s - changed;
+
+      if (!changed)
+         return;
+   }
+
+   if (force || changed > t->cols / 2) {
+
+      /* Drawing the whole row at once is cheaper than many set_char_at() */
+      t->vi->set_row(row, data, fpu_allowed);
+      memcpy(scr, data, t->cols * 2);
+      t->stats.cells_drawn += t->cols;
+      return;
+   }
+
+   for (u16 c = s; c < e; c++) {
+      if (data[c] != scr[c]) {
+         t->vi->set_char_at(row, c, data[c]);
+         scr[c] = data[c];
+      }
+   }
+
+   t->stats.cells_drawn += changed;
+}
+
+static void term_dmg_flush(struct vterm *t)
+{
+   const bool fpu_allowed = !in_irq() && !in_panic();
+   const bool cursor = t->cursor_enabled && t->scroll == t->max_scroll;
+   const u16 n = t->dmg_scroll;
+   const u16 rows_cnt = t->rows;
+
+   if (!t->dmg_pending)
+      return;
+
+   t->dmg_pending = false;
+   t->stats.frames++;
+
+   if (cursor)
+      t->vi->disable_cursor();
+
+   if (n) {
+
+      for (u16 i = 0; i < n; i++)
+         t->vi->scroll_one_line_up();
+
+      memmove(t->screen,
+              &t->screen[n * t->cols],
+              (u32)(rows_cnt - n) * t->cols * 2);
+
+      t->stats.hw_scrolls += n;
+      t->dmg_scroll = 0;
+   }
+
+   if (fpu_allowed)
+      fpu_context_begin();
+
+   for (u16 row = 0; row < rows_cnt; row++) {
+
+      /* The last `n` rows have been left dirty by the hardware scroll */
+      const bool force = t->screen_invalid || row >= rows_cnt - n;
+      term_flush_row(t, row, force, fpu_allowed);
+   }
+
+   if (fpu_allowed)
+      fpu_context_end();
+
+   t->screen_invalid = false;
+
+   if (cursor) {
+      t->vi->enable_cursor();
+      t->vi->move_cursor(t->r, t->c, get_curr_cell_fg_color(t));
+   }
+}
+
+/*
+ * The direct calls to the video interface below are used only when the output
+ * is not deferred: in panic or when the damage tracking buffers could not be
+ * allocated. In panic, the damage accumulated so far has to be flushed first.
+ */
+
+static void term_set_char_at(struct vterm *t, u16 row, u16 col, u16 entry)
+{
+   if (term_defer_output(t)) {
+      term_mark_damage(t, row, col, col + 1);
+      return;
+   }
+
+   term_dmg_flush(t);
+   t->vi->set_char_at(row, col, entry);
+}
+
+static void term_update_cursor(struct vterm *t)
+{
+   if (term_defer_output(t)) {
+      t->dmg_pending = true;    /* the cursor is moved by term_dmg_flush() */
+      return;
+   }
+
+   term_dmg_flush(t);
+   t->vi->move_cursor(t->r, t->c, get_curr_cell_fg_color(t));
+}
+
+static void term_vi_scroll_one_line_up(struct vterm *t)
+{
+   if (!term_defer_output(t)) {
+      term_dmg_flush(t);
+      t->vi->scroll_one_line_up();
+      return;
+   }
+
+   /*
+    * Shifting the whole screen is not cheap: after too many lines, it's better
+    * to compare every row with the `screen` copy and redraw what changed.
+    */
+   if (t->dmg_scroll >= t->rows / 4) {
+      term_mark_all_damaged(t);
+      return;
+   }
+
+   memmove(t->dmg_start, t->dmg_start + 1, (t->rows - 1u) * 2);
+   memmove(t->dmg_end, t->dmg_end + 1, (t->rows - 1u) * 2);
+   t->dmg_start[t->rows - 1] = t->cols;
+   t->dmg_end[t->rows - 1] = 0;
+   t->dmg_scroll++;
+   t->dmg_pending = true;
+}
+
 static void term_int_enable_cursor(struct vterm *t, bool val)
 {
    if (val == 0) {
@@ -191,6 +393,21 @@ static void term_redraw2(struct vterm *t, u16 s, u16 e)
    if (!t->buffer)
       return;
 
+   if (term_defer_output(t)) {
+
+      if (s == 0 && e == t->rows) {
+         term_mark_all_damaged(t);
+         return;
+      }
+
+      for (u16 row = s; row < e; row++)
+         term_mark_damage(t, row, 0, t->cols);
+
+      return;
+   }
+
+   term_dmg_flush(t);
+
    if (fpu_allowed)
       fpu_context_begin();
 
@@ -267,6 +484,13 @@ static void ts_buf_clear_row(struct vterm *t, u16 row, u8 color)
 static void ts_clear_row(struct vterm *t, u16 row, u8 color)
 {
    ts_buf_clear_row(t, row, color);
+
+   if (term_defer_output(t)) {
+      term_mark_damage(t, row, 0, t->cols);
+      return;
+   }
+
+   term_dmg_flush(t);
    t->vi->clear_row(row, color);
 }
 
@@ -347,7 +571,7 @@ static void term_int_move_cur(struct vterm *t, int row, int col)
    t->c = (u16) CLAMP(col, 0, t->cols - 1);
 
    if (t->cursor_enabled)
-      t->vi->move_cursor(t->r, t->c, get_curr_cell_fg_color(t));
+      term_update_cursor(t);
 }
 
 static void term_internal_incr_row(struct vterm *t)
@@ -378,7 +602,7 @@ static void term_internal_incr_row(struct vterm *t)
 
    if (t->vi->scroll_one_line_up) {
       t->scroll++;
-      t->vi->scroll_one_line_up();
+      term_vi_scroll_one_line_up(t);
    } else {
       ts_set_scroll(t, t->max_scroll);
    }
@@ -390,7 +614,7 @@ static void term_internal_write_printable_char(struct vterm *t, u8 c, u8 color)
 {
    const u16 entry = make_vgaentry(c, color);
    buf_set_entry(t, t->r, t->c, entry);
-   t->vi->set_char_at(t->r, t->c, entry);
+   term_set_char_at(t, t->r, t->c, entry);
    t->c++;
 }
 
@@ -421,7 +645,7 @@ static void term_internal_write_backspace(struct vterm *t, u8 color)
 
    if (!t->tabs_buf || !t->tabs_buf[t->r * t->cols + t->c]) {
       buf_set_entry(t, t->r, t->c, space_entry);
-      t->vi->set_char_at(t->r, t->c, space_entry);
+      term_set_char_at(t, t->r, t->c, space_entry);
       return;
    }
 
@@ -468,6 +692,43 @@ static void term_internal_delete_last_word(struct vterm *t, u8 color)
    }
 }
 
+/*
+ * Write a run of printable chars as term_internal_write_char2() would do, one
+ * row chunk at a time: each chunk is damaged with a single call.
+ */
+static void
+term_internal_write_plain(struct vterm *t, const char *buf, u32 len, u8 color)
+{
+   while (len > 0) {
+
+      if (t->c == t->cols) {
+         t->c = 0;
+         term_internal_incr_row(t);
+      }
+
+      const u16 col = t->c;
+      const u16 n = (u16)MIN(len, (u32)(t->cols - col));
+      u16 *const row = get_buf_row(t, t->r);
+
+      for (u16 i = 0; i < n; i++)
+         row[col + i] = make_vgaentry((u8)buf[i], color);
+
+      t->c = (u16)(col + n);
+      buf += n;
+      len -= n;
+
+      if (term_defer_output(t)) {
+         term_mark_damage(t, t->r, col, t->c);
+         continue;
+      }
+
+      term_dmg_flush(t);
+
+      for (u16 i = col; i < t->c; i++)
+         t->vi->set_char_at(t->r, i, row[i]);
+   }
+}
+
 static void term_internal_write_char2(struct vterm *t, char c, u8 color)
 {
    switch (c) {
@@ -518,6 +779,33 @@ term_allocate_alt_buffers(struct vterm *t)
    return 0;
 }
 
+static int
+term_allocate_dmg_buffers(struct vterm *t)
+{
+   const u32 sz = t->rows * t->cols + 2u * t->rows;
+
+   t->screen = kalloc_array_obj(u16, sz);
+
+   if (!t->screen)
+      return -ENOMEM;
+
+   t->dmg_start = t->screen + t->rows * t->cols;
+   t->dmg_end = t->dmg_start + t->rows;
+   t->dmg_scroll = 0;
+   term_invalidate_screen(t);
+   return 0;
+}
+
+static void
+term_free_dmg_buffers(struct vterm *t)
+{
+   if (!t->screen)
+      return;
+
+   kfree_array_obj(t->screen, u16, t->rows * t->cols + 2u * t->rows);
+   t->screen = t->dmg_start = t->dmg_end = NULL;
+}
+
 static void term_execute_action(struct vterm *t, struct term_action *a);
 
 #include "term_actions.c.h"
@@ -614,6 +902,15 @@ dispose_term(term *_t)
       kfree_array_obj(t->screen_buf_copy, u16, t->rows * t->cols);
       t->screen_buf_copy = NULL;
    }
+
+   term_free_dmg_buffers(t);
+}
+
+static void
+vterm_get_refresh_stats(term *_t, struct term_refresh_stats *out)
+{
+   struct vterm *const t = _t;
+   *out = t->stats;
 }
 
 static void
@@ -653,6 +950,42 @@ static u32 term_calc_extra_buf_rows(u16 rows, u16 cols)
    return (buf_size / 2) / cols - rows;
 }
 
+static void vterm_refresh_thread()
+{
+   const u32 ticks = MAX(TIMER_HZ / TERM_REFRESH_HZ, 1u);
+   struct vterm *t;
+   struct term_action a;
+
+   while (true) {
+
+      kernel_sleep(ticks);
+
+      if (get_curr_term_intf() != video_term_intf)
+         continue;
+
+      t = get_curr_term();
+
+      if (!t->dmg_pending)
+         continue;
+
+      term_make_action_flush(&a);
+      term_execute_or_enqueue_action(t, &a);
+   }
+}
+
+static void vterm_create_refresh_thread(void)
+{
+   if (refresh_thread_created)
+      return;
+
+   if (kthread_create(vterm_refresh_thread, 0, NULL) < 0) {
+      printk("WARNING: unable to create the vterm_refresh_thread\n");
+      return;
+   }
+
+   refresh_thread_created = true;
+}
+
 static int
 init_vterm(term *_t,
            const struct video_interface *intf,
@@ -740,6 +1073,16 @@ init_vterm(term *_t,
          printk("ERROR: unable to allocate the term buffer.\n");
    }
 
+   if (t->buffer != failsafe_buffer && !t->screen) {
+
+      if (t == &first_instance)
+         vterm_create_refresh_thread();
+
+      /* Without the refresh thread, nobody would flush the damaged cells */
+      if (refresh_thread_created && term_allocate_dmg_buffers(t) < 0)
+         printk("WARNING: video_term: unable to alloc the damage buffers\n");
+   }
+
    for (u16 i = 0; i < t->rows; i++)
       ts_clear_row(t, i, DEFAULT_COLOR16);
 
@@ -775,6 +1118,7 @@ static const struct term_interface intf = {
    .pause_output = vterm_pause_output,
    .restart_output = vterm_restart_output,
    .set_filter = vterm_set_filter,
+   .set_filter_scan = vterm_set_filter_scan,
 
    .get_first_term = vterm_get_first_inst,
    .video_term_init = init_vterm,
@@ -782,6 +1126,7 @@ static const struct term_interface intf = {
    .alloc = alloc_term_struct,
    .free = free_term_struct,
    .dispose = dispose_term,
+   .get_refresh_stats = vterm_get_refresh_stats,
 
 #if DEBUG_CHECKS
    .debug_dump_font_table = debug_term_dump_font_table,
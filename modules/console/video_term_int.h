@@ -32,6 +32,7 @@ enum term_action_type {
    a_insert_blank_chars,
    a_simple_del_chars,
    a_simple_erase_chars,
+   a_flush,                      // [4]
 };
 
 /*
@@ -50,6 +51,9 @@ enum term_action_type {
  *          REASON: because the `CSI n S` sequence is called SU (Scroll Up) and
  *             the `CSI n T` sequence is called SD (Scroll Down), despite what
  *             traditionally up and down mean when it's about scrolling.
+ *
+ *    [4] draw the damaged cells on the screen. Enqueued by the refresh
+ *        thread at most TERM_REFRESH_HZ times per second.
  */
 
 enum term_del_type {
@@ -318,3 +322,11 @@ term_make_action_simple_erase_chars(struct term_action *a, u16 num)
       .arg = num,
    };
 }
+
+static ALWAYS_INLINE void
+term_make_action_flush(struct term_action *a)
+{
+   *a = (struct term_action) {
+      .type1 = a_flush,
+   };
+}
@@ -141,13 +141,16 @@ static void redraw_screen(void)
       dp_write_header(pos->index+1, pos->label, pos == dp_ctx);
    }
 
-   dp_write_raw("q[Quit]" RESET_ATTRS " ");
    dp_ctx->draw_func();
 
    dp_draw_rect_raw(dp_start_row, dp_start_col, DP_H, DP_W);
    dp_move_cursor(dp_start_row, dp_start_col + 2);
    dp_write_raw(E_COLOR_YELLOW "[ TilckDebugPanel ]" RESET_ATTRS);
 
+   /* On the bottom border, to leave the whole first row to the tabs */
+   dp_move_cursor(dp_end_row - 1, dp_start_col + 2);
+   dp_write_raw("q[Quit]" RESET_ATTRS);
+
    rc = snprintk(buf, sizeof(buf),
                  "[rows %02d - %02d of %02d]",
                  dp_ctx->row_off + 1,
@@ -4,7 +4,9 @@
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
 #include <tilck/kernel/debug_utils.h>
+#include <tilck/kernel/elf_utils.h>
 #include <tilck/kernel/irq.h>
 #include <tilck/kernel/timer.h>
 #include <tilck/kernel/kb.h>
@@ -72,6 +74,79 @@ static void debug_dump_masked_irqs(void)
    dp_writeln("");
 }
 
+static void debug_dump_irq_stats(void)
+{
+   struct irq_stats *s;
+
+   dp_writeln("");
+   dp_writeln("IRQ      Count     Avg cycles     Max cycles");
+
+   for (int i = 0; i < ARRAY_SIZE(irq_stats); i++) {
+
+      s = &irq_stats[i];
+
+      if (!s->count)
+         continue;
+
+      dp_writeln("#%2d %10u %14llu %14u",
+                 i, s->count, s->tot_cycles / s->count, s->max_cycles);
+   }
+}
+
+static void debug_dump_irq_handlers(void)
+{
+   extern struct list irq_handlers_lists[16];
+   struct irq_handler_node *pos;
+   const char *sym;
+   long off;
+   u32 sz;
+
+   dp_writeln("");
+   dp_writeln("IRQ handlers (in call order)");
+
+   for (int i = 0; i < ARRAY_SIZE(irq_handlers_lists); i++) {
+
+      list_for_each_ro(pos, &irq_handlers_lists[i], node) {
+
+         sym = find_sym_at_addr((ulong)pos->handler, &off, &sz);
+
+         dp_writeln("   #%2d %-24s calls: %7u handled: %7u avg: %6llu",
+                    i, sym ? sym : "???", pos->calls, pos->handled,
+                    pos->calls ? pos->cycles / pos->calls : 0);
+      }
+   }
+}
+
+static void debug_dump_irq_hist(void)
+{
+   char buf[DP_W + 1];
+   int buf_len;
+
+   dp_writeln("");
+   dp_writeln("IRQ latency histogram (bucket N: < 2^(%d+N) cycles)",
+              IRQ_HIST_MIN_SHIFT + 1);
+
+   for (int i = 0; i < ARRAY_SIZE(irq_stats); i++) {
+
+      if (!irq_stats[i].count)
+         continue;
+
+      buf_len = snprintk(buf, sizeof(buf), "   #%2d:", i);
+
+      /* snprintk() returns `size` on truncation: stop once the row is full */
+      for (int j = 0; j < IRQ_HIST_BUCKETS; j++) {
+
+         if (buf_len >= (int)sizeof(buf) - 1)
+            break;
+
+         buf_len += snprintk(buf + buf_len, sizeof(buf) - (size_t)buf_len,
+                             " %u", irq_stats[i].hist[j]);
+      }
+
+      dp_writeln("%s", buf);
+   }
+}
+
 static void dp_show_irq_stats(void)
 {
    row = dp_screen_start_row;
@@ -81,6 +156,9 @@ static void dp_show_irq_stats(void)
    debug_dump_spur_irq_count();
    debug_dump_unhandled_irq_count();
    debug_dump_masked_irqs();
+   debug_dump_irq_stats();
+   debug_dump_irq_handlers();
+   debug_dump_irq_hist();
 }
 
 static struct dp_screen dp_irqs_screen =
@@ -0,0 +1,130 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/profiler.h>
+
+#include "termutil.h"
+#include "dp_int.h"
+
+#define PROF_REPORT_BUF_SIZE                     (16 * KB)
+
+static char *report_buf;
+static bool report_callgraph;
+static bool report_dirty;
+
+static void dp_prof_enter(void)
+{
+   report_dirty = true;
+}
+
+static void dp_prof_exit(void)
+{
+   if (report_buf) {
+      kfree2(report_buf, PROF_REPORT_BUF_SIZE);
+      report_buf = NULL;
+   }
+}
+
+static void dp_prof_update_report(void)
+{
+   if (!report_buf && !(report_buf = kmalloc(PROF_REPORT_BUF_SIZE)))
+      return;
+
+   prof_write_report(report_buf, PROF_REPORT_BUF_SIZE, report_callgraph);
+
+   /* The report might have become shorter */
+   dp_ctx->row_off = 0;
+   dp_ctx->row_max = 0;
+   report_dirty = false;
+}
+
+static int dp_prof_keypress(struct key_event ke)
+{
+   switch (ke.print_char) {
+
+      case 's':
+         if (prof_is_running())
+            prof_stop();
+         else if (prof_start() < 0)
+            modal_msg = "Unable to allocate the samples buffer";
+         break;
+
+      case 'r':
+         prof_reset();
+         break;
+
+      case 'c':
+         report_callgraph = !report_callgraph;
+         break;
+
+      case 'u':
+         break;
+
+      default:
+         return kb_handler_nak;
+   }
+
+   report_dirty = true;
+   ui_need_update = true;
+   return kb_handler_ok_and_continue;
+}
+
+static void dp_show_profiler(void)
+{
+   int row = dp_screen_start_row;
+   char line[DP_W - 3];
+   const char *p, *end;
+   size_t len;
+
+   if (report_dirty)
+      dp_prof_update_report();
+
+   dp_writeln(
+      E_COLOR_BR_WHITE "s" RESET_ATTRS "tart/stop, "
+      E_COLOR_BR_WHITE "r" RESET_ATTRS "eset, "
+      E_COLOR_BR_WHITE "u" RESET_ATTRS "pdate, "
+      E_COLOR_BR_WHITE "c" RESET_ATTRS "all graph/flat [showing: %s]",
+      report_callgraph ? "call graph" : "flat"
+   );
+
+   dp_writeln("");
+
+   if (!report_buf) {
+      dp_writeln("Out of memory");
+      return;
+   }
+
+   for (p = report_buf; *p; p = *end ? end + 1 : end) {
+
+      end = p;
+
+      while (*end && *end != '\n')
+         end++;
+
+      /* Truncate the lines longer than the panel's width */
+      len = MIN((size_t)(end - p), sizeof(line) - 1);
+      memcpy(line, p, len);
+      line[len] = 0;
+      dp_writeln("%s", line);
+   }
+}
+
+static struct dp_screen dp_profiler_screen =
+{
+   .index = 6,
+   .label = "Prof",
+   .draw_func = dp_show_profiler,
+   .on_dp_enter = dp_prof_enter,
+   .on_dp_exit = dp_prof_exit,
+   .on_keypress_func = dp_prof_keypress,
+};
+
+__attribute__((constructor))
+static void dp_profiler_init(void)
+{
+   dp_register_screen(&dp_profiler_screen);
+}
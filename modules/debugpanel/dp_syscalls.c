@@ -0,0 +1,311 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/syscall_stats.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/sort.h>
+
+#include "termutil.h"
+#include "dp_int.h"
+
+struct sys_entry {
+
+   u32 sn;
+   struct syscall_stats s;
+};
+
+static struct sys_entry *entries;
+static u32 entries_count;
+static u64 entries_tot_cycles;
+static u32 untracked;
+static int sel_pid;           /* 0 means all the processes */
+static char order_by;
+
+static long dp_sys_cmpf_calls(const void *a, const void *b)
+{
+   const struct sys_entry *x = a;
+   const struct sys_entry *y = b;
+   return (long)y->s.calls - (long)x->s.calls;
+}
+
+static long dp_sys_cmpf_errors(const void *a, const void *b)
+{
+   const struct sys_entry *x = a;
+   const struct sys_entry *y = b;
+   return (long)y->s.errors - (long)x->s.errors;
+}
+
+static long dp_sys_cmpf_tot(const void *a, const void *b)
+{
+   const struct sys_entry *x = a;
+   const struct sys_entry *y = b;
+
+   if (x->s.tot_cycles == y->s.tot_cycles)
+      return 0;
+
+   return x->s.tot_cycles < y->s.tot_cycles ? 1 : -1;
+}
+
+static long dp_sys_cmpf_max(const void *a, const void *b)
+{
+   const struct sys_entry *x = a;
+   const struct sys_entry *y = b;
+
+   if (x->s.max_cycles == y->s.max_cycles)
+      return 0;
+
+   return x->s.max_cycles < y->s.max_cycles ? 1 : -1;
+}
+
+static void
+dp_sys_add_entry(u32 sn, struct syscall_stats *s)
+{
+   entries[entries_count++] = (struct sys_entry) { .sn = sn, .s = *s };
+   entries_tot_cycles += s->tot_cycles;
+}
+
+static int
+dp_sys_next_proc_cb(void *obj, void *arg)
+{
+   struct task *ti = obj;
+   int *next_pid = arg;
+
+   if (!ti->is_main_thread || !sys_stats_get_proc(ti->pi))
+      return 0;
+
+   if (ti->pi->pid > sel_pid && (!*next_pid || ti->pi->pid < *next_pid))
+      *next_pid = ti->pi->pid;
+
+   return 0;
+}
+
+/* Select the next process with stats, in pid order, or all of them */
+static void dp_sys_select_next_proc(void)
+{
+   int next_pid = 0;
+
+   disable_preemption();
+   {
+      iterate_over_tasks(dp_sys_next_proc_cb, &next_pid);
+   }
+   enable_preemption();
+   sel_pid = next_pid;
+}
+
+static void dp_sys_load_proc_stats(void)
+{
+   struct process *pi = get_process(sel_pid);
+   struct proc_sys_stats *ps;
+
+   if (!pi || !(ps = sys_stats_get_proc(pi)))
+      return;
+
+   for (int i = 0; i < PROC_SYS_STATS_SLOTS; i++)
+      if (ps->sys_n[i])
+         dp_sys_add_entry(ps->sys_n[i] - 1u, &ps->s[i]);
+
+   untracked = ps->untracked;
+}
+
+static void dp_sys_load_stats(void)
+{
+   entries_count = 0;
+   entries_tot_cycles = 0;
+   untracked = 0;
+
+   disable_preemption();
+   {
+      if (sel_pid) {
+
+         dp_sys_load_proc_stats();
+
+      } else {
+
+         for (u32 i = 0; i < MAX_SYSCALLS; i++)
+            if (sys_stats[i].calls)
+               dp_sys_add_entry(i, &sys_stats[i]);
+      }
+   }
+   enable_preemption();
+
+   insertion_sort_generic(entries,
+                          sizeof(entries[0]),
+                          entries_count,
+                          order_by == 'e' ? dp_sys_cmpf_errors :
+                          order_by == 't' ? dp_sys_cmpf_tot :
+                          order_by == 'm' ? dp_sys_cmpf_max :
+                                            dp_sys_cmpf_calls);
+}
+
+static void dp_sys_enter(void)
+{
+   if (!entries)
+      entries = kalloc_array_obj(struct sys_entry, MAX_SYSCALLS);
+
+   sel_pid = 0;
+   order_by = 'c';
+}
+
+static void dp_sys_exit(void)
+{
+   if (entries) {
+      kfree_array_obj(entries, struct sys_entry, MAX_SYSCALLS);
+      entries = NULL;
+   }
+}
+
+static int dp_sys_keypress(struct key_event ke)
+{
+   const char c = ke.print_char;
+
+   switch (c) {
+
+      case 'c':
+      case 'e':
+      case 't':
+      case 'm':
+         order_by = c;
+         break;
+
+      case 'p':
+         dp_sys_select_next_proc();
+         break;
+
+      case 'a':
+         sel_pid = 0;
+         break;
+
+      case 'r':
+         sys_stats_reset();
+         break;
+
+      default:
+         return kb_handler_nak;
+   }
+
+   ui_need_update = true;
+   return kb_handler_ok_and_continue;
+}
+
+/*
+ * Upper bound of the log2 bucket containing the 99th percentile of the
+ * latency, as a power of 2 (see syscall_stats.h).
+ */
+static u32 dp_sys_p99_shift(struct syscall_stats *s)
+{
+   const u32 target = s->calls - s->calls / 100;
+   u32 cum = 0;
+   int b;
+
+   for (b = 0; b < SYS_HIST_BUCKETS - 1; b++) {
+
+      cum += s->hist[b];
+
+      if (cum >= target)
+         break;
+   }
+
+   return SYS_HIST_MIN_SHIFT + (u32)b + 1;
+}
+
+static void dp_show_syscalls(void)
+{
+   int row = dp_screen_start_row;
+   char pid_buf[16];
+
+   if (!entries) {
+      dp_writeln("Out of memory");
+      return;
+   }
+
+   dp_sys_load_stats();
+   snprintk(pid_buf, sizeof(pid_buf), "%d", sel_pid);
+
+   dp_writeln(
+      "Order by: "
+      E_COLOR_BR_WHITE "c" RESET_ATTRS "alls, "
+      E_COLOR_BR_WHITE "e" RESET_ATTRS "rrors, "
+      E_COLOR_BR_WHITE "t" RESET_ATTRS "ot cycles, "
+      E_COLOR_BR_WHITE "m" RESET_ATTRS "ax cycles. "
+      E_COLOR_BR_WHITE "r" RESET_ATTRS "eset"
+   );
+
+   dp_writeln(
+      "Show: "
+      E_COLOR_BR_WHITE "a" RESET_ATTRS "ll, next "
+      E_COLOR_BR_WHITE "p" RESET_ATTRS "rocess "
+      "[showing: %s%s] %s",
+      sel_pid ? "pid " : "all",
+      sel_pid ? pid_buf : "",
+      untracked ? "[+ untracked calls]" : ""
+   );
+
+   dp_writeln("");
+
+   dp_writeln(
+                 "    Syscall     "            RESET_ATTRS
+      TERM_VLINE "%s" "  Calls  "             RESET_ATTRS
+      TERM_VLINE "%s" " Errs "                RESET_ATTRS
+      TERM_VLINE " Avg cyc  "
+      TERM_VLINE "%s" "  Max cyc  "           RESET_ATTRS
+      TERM_VLINE "%s" " Tot%% "               RESET_ATTRS
+      TERM_VLINE " p99 ",
+      order_by == 'c' ? E_COLOR_BR_WHITE REVERSE_VIDEO : "",
+      order_by == 'e' ? E_COLOR_BR_WHITE REVERSE_VIDEO : "",
+      order_by == 'm' ? E_COLOR_BR_WHITE REVERSE_VIDEO : "",
+      order_by == 't' ? E_COLOR_BR_WHITE REVERSE_VIDEO : ""
+   );
+
+   dp_writeln(
+      GFX_ON
+      "qqqqqqqqqqqqqqqqnqqqqqqqqqnqqqqqqnqqqqqqqqqqnqqqqqqqqqqqnqqqqqqnqqqqq"
+      GFX_OFF
+   );
+
+   for (u32 i = 0; i < entries_count; i++) {
+
+      struct syscall_stats *s = &entries[i].s;
+      const char *name = sys_stats_get_name(entries[i].sn);
+      const u32 tot_pm = entries_tot_cycles
+         ? (u32)(s->tot_cycles * 1000 / entries_tot_cycles)
+         : 0;
+
+      dp_writeln("%3u %-12.12s"
+                 TERM_VLINE " %7u "
+                 TERM_VLINE " %4u "
+                 TERM_VLINE " %8llu "
+                 TERM_VLINE " %9u "
+                 TERM_VLINE " %2u.%u "
+                 TERM_VLINE " 2^%u",
+                 entries[i].sn, name ? name : "?",
+                 s->calls,
+                 s->errors,
+                 s->tot_cycles / s->calls,
+                 s->max_cycles,
+                 tot_pm / 10, tot_pm % 10,
+                 dp_sys_p99_shift(s));
+   }
+
+   dp_writeln("");
+}
+
+static struct dp_screen dp_syscalls_screen =
+{
+   .index = 7,
+   .label = "Sys",
+   .draw_func = dp_show_syscalls,
+   .on_dp_enter = dp_sys_enter,
+   .on_dp_exit = dp_sys_exit,
+   .on_keypress_func = dp_sys_keypress,
+};
+
+__attribute__((constructor))
+static void dp_syscalls_init(void)
+{
+   dp_register_screen(&dp_syscalls_screen);
+}
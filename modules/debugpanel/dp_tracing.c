@@ -138,7 +138,8 @@ tracing_ui_msg(void)
       TERM_VLINE " #Sys traced: " E_COLOR_BR_BLUE "%d" RESET_ATTRS " "
       TERM_VLINE " #Tasks traced: " E_COLOR_BR_BLUE "%d" RESET_ATTRS " "
       TERM_VLINE "\r\n"
-      TERM_VLINE " Printk lvl: " E_COLOR_BR_BLUE "%d" RESET_ATTRS
+      TERM_VLINE " Printk lvl: " E_COLOR_BR_BLUE "%d" RESET_ATTRS " "
+      TERM_VLINE " Dropped events: " E_COLOR_BR_BLUE "%u" RESET_ATTRS
       "\r\n",
 
       tracing_is_force_exp_block_enabled()
@@ -151,7 +152,8 @@ tracing_ui_msg(void)
 
       get_traced_syscalls_count(),
       get_traced_tasks_count(),
-      tracing_get_printk_lvl()
+      tracing_get_printk_lvl(),
+      tracing_get_dropped_events_count()
    );
 
    get_traced_syscalls_str(line_buf, TRACED_SYSCALLS_STR_LEN);
@@ -492,15 +494,22 @@ dp_tracing_screen(void)
       if (c == DP_KEY_ENTER) {
 
          dp_write_raw("\r\n");
+
+         if (tracing_acquire(&dp_tracing_screen) < 0) {
+            dp_write_raw(
+               E_COLOR_RED "-- Tracing busy: /dev/trace is open --"
+               RESET_ATTRS "\r\n\r\n"
+            );
+            tracing_ui_msg();
+            continue;
+         }
+
          dp_write_raw(
             E_COLOR_GREEN "-- Tracing active --" RESET_ATTRS "\r\n\r\n"
          );
 
-         tracing_set_enabled(true);
-         {
-            should_continue = dp_tracing_screen_main_loop();
-         }
-         tracing_set_enabled(false);
+         should_continue = dp_tracing_screen_main_loop();
+         tracing_release(&dp_tracing_screen);
 
          if (!should_continue)
             break;
@@ -206,11 +206,13 @@ void fb_draw_banner(void);
 static void fb_disable_banner_refresh(void)
 {
    banner_refresh_disabled = true;
+   fb_pan_reset();
 }
 
 static void fb_enable_banner_refresh(void)
 {
    banner_refresh_disabled = false;
+   fb_pan_reset();
    fb_draw_banner();
 }
 
@@ -224,7 +226,7 @@ static struct video_interface framebuffer_vi =
    fb_move_cursor,
    fb_enable_cursor,
    fb_disable_cursor,
-   NULL,  /* scroll_one_line_up: used only when running in a VM */
+   NULL,  /* scroll_one_line_up: used only in a VM or with hw panning */
    fb_draw_banner,
    fb_disable_banner_refresh,
    fb_enable_banner_refresh,
@@ -454,33 +456,32 @@ static void fb_scroll_one_line_up(void)
    if (enabled)
      fb_disable_cursor();
 
-   fb_lines_shift_up(fb_offset_y + font_h,  /* source: row 1 (+ following) */
-                     fb_offset_y,           /* destination: row 0 */
-                     fb_get_height() - fb_offset_y - font_h);
+   if (fb_can_pan()) {
 
-   if (enabled)
-      fb_enable_cursor();
-}
+      const u32 used_lines = fb_offset_y + font_h * fb_term_rows;
 
-static void async_pre_render_scanlines()
-{
-   if (!fb_pre_render_char_scanlines()) {
-      printk("fb_console: WARNING: fb_pre_render_char_scanlines failed.\n");
-      return;
-   }
+      /* Keep the banner in place and clear the lines below the last row */
+      fb_pan_lines_up(fb_offset_y, font_h);
+      fb_raw_color_lines(used_lines,
+                         fb_get_height() - used_lines,
+                         vga_rgb_colors[COLOR_BLACK]);
 
-   disable_interrupts_forced();
-   {
-      use_optimized = true;
-      framebuffer_vi.set_char_at = fb_set_char_at_optimized;
-      framebuffer_vi.set_row = fb_set_row_optimized;
+   } else {
+
+      fb_lines_shift_up(fb_offset_y + font_h, /* source: row 1 (+ following) */
+                        fb_offset_y,          /* destination: row 0 */
+                        fb_get_height() - fb_offset_y - font_h);
    }
-   enable_interrupts_forced();
+
+   if (enabled)
+      fb_enable_cursor();
 }
 
 static void fb_use_optimized_funcs_if_possible(void)
 {
-   if (in_hypervisor())
+   ulong var;
+
+   if (in_hypervisor() || fb_can_pan())
       framebuffer_vi.scroll_one_line_up = fb_scroll_one_line_up;
 
    if (in_panic())
@@ -505,14 +506,21 @@ static void fb_use_optimized_funcs_if_possible(void)
       return;
    }
 
-   if (kmalloc_get_max_tot_heap_free() < FBCON_OPT_FUNCS_MIN_FREE_HEAP) {
-      printk("fb_console: Not using fast funcs in order to save memory\n");
+   if (!fb_init_glyph_cache()) {
+      printk("fb_console: WARNING: unable to alloc the glyph cache\n");
       return;
    }
 
-   if (kthread_create(async_pre_render_scanlines, 0, NULL) < 0)
-      printk("fb_console: WARNING: unable to create a kthread for "
-             "async_pre_render_scanlines\n");
+   printk("fb_console: glyph cache: up to %u color pairs\n",
+          fb_get_glyph_cache_slots());
+
+   disable_interrupts(&var);
+   {
+      use_optimized = true;
+      framebuffer_vi.set_char_at = fb_set_char_at_optimized;
+      framebuffer_vi.set_row = fb_set_row_optimized;
+   }
+   enable_interrupts(&var);
 }
 
 bool fb_is_using_opt_funcs(void)
@@ -20,7 +20,12 @@ void fb_draw_row_optimized(u32 y, u16 *entries, u32 count, bool fpu);
 void fb_copy_from_screen(u32 ix, u32 iy, u32 w, u32 h, u32 *buf);
 void fb_copy_to_screen(u32 ix, u32 iy, u32 w, u32 h, u32 *buf);
 void fb_lines_shift_up(u32 src_y, u32 dst_y, u32 lines_count);
-bool fb_pre_render_char_scanlines(void);
+bool fb_can_pan(void);
+void fb_pan_lines_up(u32 keep, u32 lines);
+void fb_pan_reset(void);
+int fb_pan_display(u32 xoffset, u32 yoffset);
+bool fb_init_glyph_cache(void);
+u32 fb_get_glyph_cache_slots(void);
 bool fb_alloc_shadow_buffer(void);
 void fb_raw_perf_screen_redraw(u32 color, bool use_fpu);
 void fb_set_font(void *font);
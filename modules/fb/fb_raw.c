@@ -21,6 +21,8 @@
 #include <tilck/kernel/paging.h>
 #include <tilck/kernel/kmalloc.h>
 #include <tilck/kernel/hal.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/interrupts.h>
 #include <tilck/kernel/system_mmap.h>
 #include <tilck/kernel/system_mmap_int.h>
 #include <tilck/kernel/errno.h>
@@ -49,8 +51,17 @@ u32 fb_size;
 static u32 fb_bytes_per_pixel;
 static u32 fb_line_length;
 
-ulong fb_vaddr;
-static u32 *fb_w8_char_scanlines;
+ulong fb_vaddr;                  /* start of the whole (virtual) framebuffer */
+static ulong fb_screen_vaddr;    /* first line shown on the screen */
+
+/*
+ * Hardware panning: when the video card supports it, the framebuffer is taller
+ * than the screen (fb_virt_height > fb_height) and the console scrolls by
+ * moving the display start line (fb_pan_y) instead of moving pixel data.
+ */
+static u32 fb_virt_height;
+static u32 fb_pan_y;             /* console's display start line */
+static u32 fb_hw_pan_y;          /* display start line set in hardware */
 
 u32 font_w;
 u32 font_h;
@@ -186,10 +197,163 @@ void set_framebuffer_info_from_mbi(multiboot_info_t *mbi)
    });
 }
 
+/* Bochs VBE extensions (DISPI), supported by QEMU's stdvga and bochs-display */
+#define VBE_DISPI_IOPORT_INDEX            0x01CE
+#define VBE_DISPI_IOPORT_DATA             0x01CF
+
+#define VBE_DISPI_INDEX_ID                0x0
+#define VBE_DISPI_INDEX_XRES              0x1
+#define VBE_DISPI_INDEX_YRES              0x2
+#define VBE_DISPI_INDEX_BPP               0x3
+#define VBE_DISPI_INDEX_ENABLE            0x4
+#define VBE_DISPI_INDEX_VIRT_WIDTH        0x6
+#define VBE_DISPI_INDEX_VIRT_HEIGHT       0x7
+#define VBE_DISPI_INDEX_X_OFFSET          0x8
+#define VBE_DISPI_INDEX_Y_OFFSET          0x9
+
+#define VBE_DISPI_ID2                     0xB0C2
+#define VBE_DISPI_ID5                     0xB0C5
+#define VBE_DISPI_ENABLED                 0x01
+
+static u16 bga_read(u16 index)
+{
+   outw(VBE_DISPI_IOPORT_INDEX, index);
+   return inw(VBE_DISPI_IOPORT_DATA);
+}
+
+static void bga_write(u16 index, u16 val)
+{
+   outw(VBE_DISPI_IOPORT_INDEX, index);
+   outw(VBE_DISPI_IOPORT_DATA, val);
+}
+
+static void fb_set_hw_pan(u32 y)
+{
+   bga_write(VBE_DISPI_INDEX_Y_OFFSET, (u16)y);
+   fb_hw_pan_y = y;
+}
+
+static void fb_pan_init(void)
+{
+   const u32 max_h = MIN(fb_height * FBCON_PAN_MAX_SCREENS, 0xffffu);
+   u16 id;
+   u32 h;
+
+   fb_virt_height = fb_height;
+
+   /* Real hardware does not have the Bochs VBE extensions */
+   if (!in_hypervisor())
+      return;
+
+   id = bga_read(VBE_DISPI_INDEX_ID);
+
+   if (id < VBE_DISPI_ID2 || id > VBE_DISPI_ID5)
+      return;
+
+   /* Make sure that the bootloader's framebuffer is the current DISPI mode */
+   if (!(bga_read(VBE_DISPI_INDEX_ENABLE) & VBE_DISPI_ENABLED)      ||
+       bga_read(VBE_DISPI_INDEX_XRES) != fb_width                   ||
+       bga_read(VBE_DISPI_INDEX_YRES) != fb_height                  ||
+       bga_read(VBE_DISPI_INDEX_BPP) != fb_bpp                      ||
+       bga_read(VBE_DISPI_INDEX_X_OFFSET) != 0                      ||
+       bga_read(VBE_DISPI_INDEX_VIRT_WIDTH) * fb_bytes_per_pixel != fb_pitch)
+   {
+      return;
+   }
+
+   /* The card clamps the virtual height to its amount of video memory */
+   bga_write(VBE_DISPI_INDEX_VIRT_HEIGHT, (u16)max_h);
+   h = MIN(bga_read(VBE_DISPI_INDEX_VIRT_HEIGHT), max_h);
+
+   /* Panning is worth only if it saves many copies of the whole screen */
+   if (h < fb_height + fb_height / 2)
+      return;
+
+   fb_virt_height = h;
+   fb_size = fb_pitch * fb_virt_height;
+   fb_set_hw_pan(0);
+}
+
+bool fb_can_pan(void)
+{
+   return fb_virt_height > fb_height;
+}
+
+static void fb_set_pan(u32 y)
+{
+   fb_pan_y = y;
+   fb_screen_vaddr = fb_vaddr + fb_pitch * fb_pan_y;
+   fb_set_hw_pan(fb_pan_y);
+}
+
+/*
+ * Scroll the screen up by `lines` pixel lines using the hardware panning,
+ * except for its first `keep` lines which stay in place. The content of the
+ * last `lines` lines of the screen is undefined after the call.
+ */
+void fb_pan_lines_up(u32 keep, u32 lines)
+{
+   const ulong old_vaddr = fb_screen_vaddr;
+   const u32 new_y = fb_pan_y + lines;
+
+   ASSERT(fb_can_pan());
+
+   if (new_y + fb_height > fb_virt_height) {
+
+      /* The screen reached the bottom of the framebuffer: wrap around */
+      memcpy32((void *)fb_vaddr,
+               (void *)old_vaddr,
+               (fb_pitch * keep) >> 2);
+
+      memcpy32((void *)(fb_vaddr + fb_pitch * keep),
+               (void *)(old_vaddr + fb_pitch * (keep + lines)),
+               (fb_pitch * (fb_height - keep - lines)) >> 2);
+
+      fb_set_pan(0);
+      return;
+   }
+
+   memmove((void *)(old_vaddr + fb_pitch * lines),
+           (void *)old_vaddr,
+           fb_pitch * keep);
+
+   fb_set_pan(new_y);
+}
+
+/*
+ * Move the screen back at the beginning of the framebuffer, keeping its
+ * content, and undo any panning done by user space. Used when the console
+ * pauses or restarts its output: user apps mapping /dev/fb0 expect the visible
+ * area to start at offset 0.
+ */
+void fb_pan_reset(void)
+{
+   if (!fb_can_pan())
+      return;
+
+   if (fb_pan_y)
+      memcpy32((void *)fb_vaddr,
+               (void *)fb_screen_vaddr,
+               (fb_pitch * fb_height) >> 2);
+
+   fb_set_pan(0);
+}
+
+int fb_pan_display(u32 xoffset, u32 yoffset)
+{
+   if (xoffset || yoffset + fb_height > fb_virt_height)
+      return -EINVAL;
+
+   if (fb_can_pan())
+      fb_set_hw_pan(yoffset);
+
+   return 0;
+}
+
 void fb_lines_shift_up(u32 src_y, u32 dst_y, u32 lines_count)
 {
-   memcpy32((void *)(fb_vaddr + fb_pitch * dst_y),
-            (void *)(fb_vaddr + fb_pitch * src_y),
+   memcpy32((void *)(fb_screen_vaddr + fb_pitch * dst_y),
+            (void *)(fb_screen_vaddr + fb_pitch * src_y),
             (fb_pitch * lines_count) >> 2);
 }
 
@@ -218,11 +382,16 @@ int fb_user_mmap(pdir_t *pdir, void *vaddr, size_t mmap_len)
 
 void fb_map_in_kernel_space(void)
 {
+   if (!in_panic())
+      fb_pan_init();
+
    fb_vaddr = (ulong) map_framebuffer(get_kernel_pdir(),
                                       fb_paddr,
                                       0,
                                       fb_size,
                                       false);
+
+   fb_screen_vaddr = fb_vaddr + fb_pitch * fb_pan_y;
 }
 
 /*
@@ -237,12 +406,12 @@ static inline void fb_draw_pixel(u32 x, u32 y, u32 color)
    if (fb_bpp == 32) {
 
       *(volatile u32 *)
-         (fb_vaddr + (fb_pitch * y) + (x << 2)) = color;
+         (fb_screen_vaddr + (fb_pitch * y) + (x << 2)) = color;
 
    } else {
 
       // Assumption: bpp is 24
-      memcpy((void *) (fb_vaddr + (fb_pitch * y) + (x * 3)), &color, 3);
+      memcpy((void *)(fb_screen_vaddr + (fb_pitch * y) + (x * 3)), &color, 3);
    }
 }
 
@@ -250,7 +419,7 @@ void fb_raw_color_lines(u32 iy, u32 h, u32 color)
 {
    if (LIKELY(fb_bpp == 32)) {
 
-      ulong v = fb_vaddr + (fb_pitch * iy);
+      ulong v = fb_screen_vaddr + (fb_pitch * iy);
 
       if (LIKELY(fb_pitch == fb_line_length)) {
 
@@ -283,7 +452,7 @@ void fb_draw_cursor_raw(u32 ix, u32 iy, u32 color)
 
       for (u32 y = iy; y < (iy + font_h); y++) {
 
-         memset32((u32 *)(fb_vaddr + (fb_pitch * y) + ix),
+         memset32((u32 *)(fb_screen_vaddr + (fb_pitch * y) + ix),
                   color,
                   font_w);
       }
@@ -303,7 +472,7 @@ void fb_draw_cursor_raw(u32 ix, u32 iy, u32 color)
 
 void fb_copy_from_screen(u32 ix, u32 iy, u32 w, u32 h, u32 *buf)
 {
-   ulong vaddr = fb_vaddr + (fb_pitch * iy) + (ix * fb_bytes_per_pixel);
+   ulong vaddr = fb_screen_vaddr + fb_pitch * iy + ix * fb_bytes_per_pixel;
 
    if (LIKELY(fb_bpp == 32)) {
 
@@ -326,7 +495,7 @@ void fb_copy_from_screen(u32 ix, u32 iy, u32 w, u32 h, u32 *buf)
 
 void fb_copy_to_screen(u32 ix, u32 iy, u32 w, u32 h, u32 *buf)
 {
-   ulong vaddr = fb_vaddr + (fb_pitch * iy) + (ix * fb_bytes_per_pixel);
+   ulong vaddr = fb_screen_vaddr + fb_pitch * iy + ix * fb_bytes_per_pixel;
 
    if (LIKELY(fb_bpp == 32)) {
 
@@ -448,31 +617,185 @@ void fb_draw_char_failsafe(u32 x, u32 y, u16 e)
 #define FG_COLORS  16     /* #fg colors */
 #define BG_COLORS  16     /* #bg colors */
 
-#define TOT_CHAR_SCANLINES_SIZE (PSZ*SL_COUNT*FG_COLORS*BG_COLORS*SL_SIZE)
+#define COLOR_PAIRS (FG_COLORS * BG_COLORS)
+#define PAIR_SCANLINES_SIZE (PSZ * SL_COUNT * SL_SIZE)   /* 8 KB */
 
-bool fb_pre_render_char_scanlines(void)
+/*
+ * Cache of the pre-rendered 8-pixel scanlines, lazily populated for each
+ * (fg, bg) color pair actually used, indexed by the VGA color byte. When all
+ * the slots allowed by FBCON_GLYPH_CACHE_KB are in use, the least recently
+ * used pair is evicted.
+ *
+ * An entry is pinned while a glyph is being drawn with it: pinned entries are
+ * never evicted, otherwise an IRQ-driven console write could refill the buffer
+ * with another color pair in the middle of the glyph.
+ */
+static u32 *sl_cache[COLOR_PAIRS];
+static u32 sl_last_use[COLOR_PAIRS];
+static ATOMIC(u8) sl_pins[COLOR_PAIRS];
+static u32 *sl_free_list;   /* allocated slots not used by any color pair */
+static u32 sl_clock;
+static u32 sl_slots_used;
+static u32 sl_max_slots;
+
+static void fb_render_pair_scanlines(u32 *buf, u8 color)
 {
-   fb_w8_char_scanlines = kmalloc(TOT_CHAR_SCANLINES_SIZE);
+   const u32 fg = vga_rgb_colors[color & 0xf];
+   const u32 bg = vga_rgb_colors[color >> 4];
 
-   if (!fb_w8_char_scanlines)
-      return false;
+   for (u32 sl = 0; sl < SL_COUNT; sl++)
+      for (u32 pix = 0; pix < SL_SIZE; pix++)
+         buf[sl * SL_SIZE + (SL_SIZE - pix - 1)] = (sl & (1 << pix)) ? fg : bg;
+}
 
-   for (u32 fg = 0; fg < FG_COLORS; fg++) {
-      for (u32 bg = 0; bg < BG_COLORS; bg++) {
-         for (u32 sl = 0; sl < SL_COUNT; sl++) {
-            for (u32 pix = 0; pix < SL_SIZE; pix++) {
-               fb_w8_char_scanlines[
-                  fg * (BG_COLORS * SL_COUNT * SL_SIZE) +
-                  bg * (SL_COUNT * SL_SIZE) +
-                  sl * SL_SIZE +
-                  (SL_SIZE - pix - 1)
-               ] = (sl & (1 << pix)) ? vga_rgb_colors[fg] : vga_rgb_colors[bg];
-            }
-         }
+static u32 *fb_sl_cache_evict_lru(void)
+{
+   u32 *buf;
+   int lru = -1;
+
+   for (int i = 0; i < COLOR_PAIRS; i++) {
+
+      if (!sl_cache[i] || atomic_load_explicit(&sl_pins[i], mo_relaxed))
+         continue;
+
+      if (lru < 0 || sl_clock - sl_last_use[i] > sl_clock - sl_last_use[lru])
+         lru = i;
+   }
+
+   if (lru < 0)
+      return NULL; /* all the entries are in use by interrupted renders */
+
+   buf = sl_cache[lru];
+   sl_cache[lru] = NULL;
+   return buf;
+}
+
+/*
+ * Get a buffer for a new entry: a free slot, a newly allocated one or the
+ * LRU entry. Must be called with interrupts disabled. Returns NULL and sets
+ * `*alloc` when the caller has to allocate the buffer itself, with interrupts
+ * enabled.
+ */
+static u32 *fb_sl_cache_get_buf(bool *alloc)
+{
+   u32 *buf;
+
+   ASSERT(!are_interrupts_enabled());
+
+   if ((buf = sl_free_list)) {
+      sl_free_list = *(u32 **)buf;
+      return buf;
+   }
+
+   if (sl_slots_used < sl_max_slots && !in_panic() && !in_irq()) {
+      sl_slots_used++;     /* reserve the slot */
+      *alloc = true;
+      return NULL;
+   }
+
+   return fb_sl_cache_evict_lru();
+}
+
+static NO_INLINE u32 *fb_sl_cache_load(u8 color)
+{
+   u32 *buf;
+   bool alloc = false;
+   ulong var;
+
+   disable_preemption();
+
+   if (sl_cache[color])
+      goto out; /* another task loaded it in the meanwhile */
+
+   /*
+    * Console writes can nest from IRQ context: the slot accounting, the
+    * eviction and the publishing of the entry run with interrupts disabled.
+    * Rendering the scanlines does not, because `buf` is not visible yet.
+    */
+   disable_interrupts(&var);
+   {
+      buf = fb_sl_cache_get_buf(&alloc);
+   }
+   enable_interrupts(&var);
+
+   if (alloc && !(buf = kmalloc(PAIR_SCANLINES_SIZE))) {
+
+      disable_interrupts(&var);
+      {
+         sl_slots_used--;
+         buf = fb_sl_cache_evict_lru();
+      }
+      enable_interrupts(&var);
+   }
+
+   if (!buf)
+      goto out;
+
+   fb_render_pair_scanlines(buf, color);
+
+   disable_interrupts(&var);
+   {
+      if (!sl_cache[color]) {
+
+         sl_cache[color] = buf;
+
+      } else {
+
+         /* A nested load of the same pair won the race: keep `buf` aside */
+         *(u32 **)buf = sl_free_list;
+         sl_free_list = buf;
       }
    }
+   enable_interrupts(&var);
 
-   return true;
+out:
+   enable_preemption();
+   return sl_cache[color];
+}
+
+/*
+ * Returns the pinned scanlines for the color pair of `e`, or NULL when no
+ * entry can be used: in that case, the caller has to use the failsafe path.
+ * Must be called with the preemption disabled and every successful call must
+ * be paired with a call to fb_put_pair_scanlines().
+ */
+static ALWAYS_INLINE u32 *fb_get_pair_scanlines(u16 e)
+{
+   const u8 color = vgaentry_get_color(e);
+   u32 *buf;
+
+   /* Pin before the lookup, so that no IRQ can evict the entry we get */
+   atomic_fetch_add_explicit(&sl_pins[color], 1, mo_acquire);
+
+   if (UNLIKELY(!(buf = sl_cache[color]))) {
+
+      if (UNLIKELY(!(buf = fb_sl_cache_load(color)))) {
+         atomic_fetch_sub_explicit(&sl_pins[color], 1, mo_relaxed);
+         return NULL;
+      }
+   }
+
+   sl_last_use[color] = ++sl_clock;
+   return buf;
+}
+
+static ALWAYS_INLINE void fb_put_pair_scanlines(u16 e)
+{
+   atomic_fetch_sub_explicit(&sl_pins[vgaentry_get_color(e)], 1, mo_release);
+}
+
+bool fb_init_glyph_cache(void)
+{
+   sl_max_slots = CLAMP(FBCON_GLYPH_CACHE_KB * KB / PAIR_SCANLINES_SIZE,
+                        1u, (u32)COLOR_PAIRS);
+
+   /* Make sure there's at least one slot and warm it up */
+   return fb_sl_cache_load(DEFAULT_COLOR16) != NULL;
+}
+
+u32 fb_get_glyph_cache_slots(void)
+{
+   return sl_max_slots;
 }
 
 void fb_draw_char_optimized(u32 x, u32 y, u16 e)
@@ -497,12 +820,17 @@ void fb_draw_char_optimized(u32 x, u32 y, u16 e)
    ASSUME_WITHOUT_CHECK(font_h == 16 || font_h == 32);
    ASSUME_WITHOUT_CHECK(font_bytes_per_glyph==16 || font_bytes_per_glyph==64);
 
-   void *vaddr = (void *)fb_vaddr + (fb_pitch * y) + (x << 2);
+   void *vaddr = (void *)fb_screen_vaddr + (fb_pitch * y) + (x << 2);
    u8 *d = font_glyph_data + font_bytes_per_glyph * c;
-   const u32 c_off = (u32)(
-      (vgaentry_get_fg(e) << 15) + (vgaentry_get_bg(e) << 11)
-   );
-   u32 *scanlines = &fb_w8_char_scanlines[c_off];
+   u32 *scanlines;
+
+   disable_preemption();
+
+   if (UNLIKELY(!(scanlines = fb_get_pair_scanlines(e)))) {
+      fb_draw_char_failsafe(x, y, e);
+      goto out;
+   }
+
    goto *op;
 
    width1:
@@ -510,7 +838,7 @@ void fb_draw_char_optimized(u32 x, u32 y, u16 e)
       for (u32 r = 0; r < font_h; r++, d++, vaddr += fb_pitch)
          memcpy32(vaddr,      &scanlines[d[0] << 3], SL_SIZE);
 
-      return;
+      goto done;
 
    width2:
 
@@ -519,7 +847,10 @@ void fb_draw_char_optimized(u32 x, u32 y, u16 e)
          memcpy32(vaddr + 32, &scanlines[d[1] << 3], SL_SIZE);
       }
 
-      return;
+   done:
+      fb_put_pair_scanlines(e);
+   out:
+      enable_preemption();
 }
 
 void fb_draw_row_optimized(u32 y, u16 *entries, u32 count, bool fpu)
@@ -533,21 +864,26 @@ void fb_draw_row_optimized(u32 y, u16 *entries, u32 count, bool fpu)
    const void *const op = ops[(font_w == 16) * 2 + fpu];       // ops[0..3]
 
    /* -------------- Regular variables --------------- */
-   const ulong vaddr_base = fb_vaddr + (fb_pitch * y);
+   const ulong vaddr_base = fb_screen_vaddr + (fb_pitch * y);
 
    ASSUME_WITHOUT_CHECK(font_w == 8 || font_w == 16);
    ASSUME_WITHOUT_CHECK(font_h == 16 || font_h == 32);
    ASSUME_WITHOUT_CHECK(font_bytes_per_glyph==16 || font_bytes_per_glyph==64);
 
+   disable_preemption();
+
    for (u32 ei = 0; ei < count; ei++) {
 
       const u16 e = entries[ei];
-      const u32 c_off = (u32) (
-         (vgaentry_get_fg(e) << 15) + (vgaentry_get_bg(e) << 11)
-      );
       void *vaddr = (void *)vaddr_base + (ei << w4_shift);
       const u8 *d = &font_glyph_data[vgaentry_get_char(e) << bpg_shift];
-      u32 *scanlines = &fb_w8_char_scanlines[c_off];
+      u32 *scanlines = fb_get_pair_scanlines(e);
+
+      if (UNLIKELY(!scanlines)) {
+         fb_draw_char_failsafe(ei * font_w, y, e);
+         continue;
+      }
+
       goto *op;
 
       width_1_fpu:
@@ -555,14 +891,14 @@ void fb_draw_row_optimized(u32 y, u16 *entries, u32 count, bool fpu)
          for (u32 r = 0; r < font_h; r++, d++, vaddr += fb_pitch)
             fpu_cpy_single_256_nt(vaddr, &scanlines[d[0] << 3]);
 
-         continue;
+         goto next;
 
       width_1_nofpu:
 
          for (u32 r = 0; r < font_h; r++, d++, vaddr += fb_pitch)
             memcpy32(vaddr, &scanlines[d[0] << 3], SL_SIZE);
 
-         continue;
+         goto next;
 
       width_2_fpu:
 
@@ -571,7 +907,7 @@ void fb_draw_row_optimized(u32 y, u16 *entries, u32 count, bool fpu)
             fpu_cpy_single_256_nt(vaddr + 32, &scanlines[d[1] << 3]);
          }
 
-         continue;
+         goto next;
 
       width_2_nofpu:
 
@@ -580,8 +916,11 @@ void fb_draw_row_optimized(u32 y, u16 *entries, u32 count, bool fpu)
             memcpy32(vaddr + 32, &scanlines[d[1] << 3], SL_SIZE);
          }
 
-         continue;
+      next:
+         fb_put_pair_scanlines(e);
    }
+
+   enable_preemption();
 }
 
 
@@ -596,6 +935,7 @@ void fb_fill_fix_info(void *fix_info)
    fi->smem_start = fb_paddr;
    fi->smem_len = fb_size;
    fi->line_length = fb_pitch;
+   fi->ypanstep = fb_can_pan() ? 1 : 0;
 }
 
 void fb_fill_var_info(void *var_info)
@@ -606,7 +946,8 @@ void fb_fill_var_info(void *var_info)
    vi->xres = fb_width;
    vi->yres = fb_height;
    vi->xres_virtual = fb_width;
-   vi->yres_virtual = fb_height;
+   vi->yres_virtual = fb_virt_height;
+   vi->yoffset = fb_hw_pan_y;
    vi->bits_per_pixel = fb_bpp;
 
    vi->red.offset = fb_red_pos;
@@ -625,9 +966,11 @@ void fb_raw_perf_screen_redraw(u32 color, bool use_fpu)
    VERIFY(fb_bpp == 32);
    VERIFY(fb_pitch == fb_line_length);
 
+   void *vaddr = (void *)fb_screen_vaddr;
+
    if (use_fpu)
-      fpu_memset256((void *)fb_vaddr, color, (fb_pitch * fb_height) >> 5);
+      fpu_memset256(vaddr, color, (fb_pitch * fb_height) >> 5);
    else
-      memset32((void *)fb_vaddr, color, (fb_pitch * fb_height) >> 2);
+      memset32(vaddr, color, (fb_pitch * fb_height) >> 2);
 }
 #endif
@@ -110,6 +110,16 @@ static int fb_ioctl(fs_handle h, ulong request, void *argp)
       return 0;
    }
 
+   if (request == FBIOPAN_DISPLAY) {
+
+      struct fb_var_screeninfo var_info;
+
+      if (copy_from_user(&var_info, argp, sizeof(var_info)))
+         return -EFAULT;
+
+      return fb_pan_display(var_info.xoffset, var_info.yoffset);
+   }
+
    return -EINVAL;
 }
 
@@ -11,6 +11,8 @@
 #include <tilck/mods/fb_console.h>
 #include <tilck/kernel/self_tests.h>
 #include <tilck/kernel/hal.h>
+#include <tilck/kernel/term.h>
+#include <tilck/kernel/timer.h>
 
 #include "fb_int.h"
 
@@ -58,7 +60,52 @@ void selftest_fbperf_fpu(void)
    internal_selftest_fb_perf(true);
 }
 
+/*
+ * Write many lines on the current term and report how many frames the refresh
+ * thread needed to show them, compared to the number of cells written.
+ */
+void selftest_fbperf_term(void)
+{
+   const struct term_interface *ti = get_curr_term_intf();
+   struct term_refresh_stats s0, s1;
+   const int lines = 2000;
+   u64 start, duration, bytes = 0;
+   char buf[80];
+   int n;
+
+   if (ti->get_type() != term_type_video || !ti->get_refresh_stats)
+      panic("Unable to test term's performance: not a video term");
+
+   ti->get_refresh_stats(get_curr_term(), &s0);
+   start = RDTSC();
+
+   for (int i = 0; i < lines; i++) {
+      n = snprintk(buf, sizeof(buf), "fbperf_term: line %05d\n", i);
+      term_write(buf, (size_t)n, DEFAULT_COLOR16);
+      bytes += (u64)n;
+   }
+
+   duration = RDTSC() - start;
+
+   /* Give the refresh thread the time to flush the last frame */
+   kernel_sleep(TIMER_HZ / 10);
+   ti->get_refresh_stats(get_curr_term(), &s1);
+
+   printk("lines written:        %d\n", lines);
+   printk("cycles per line:      %" PRIu64 "\n", duration / (u64)lines);
+   printk("bytes written:        %" PRIu64 "\n", bytes);
+   printk("frames:               %" PRIu64 "\n", s1.frames - s0.frames);
+   printk("rows flushed:         %" PRIu64 "\n", s1.rows - s0.rows);
+   printk("cells drawn:          %" PRIu64 "\n",
+          s1.cells_drawn - s0.cells_drawn);
+   printk("cells skipped:        %" PRIu64 "\n",
+          s1.cells_skipped - s0.cells_skipped);
+   printk("hw scrolls:           %" PRIu64 "\n",
+          s1.hw_scrolls - s0.hw_scrolls);
+}
+
 REGISTER_SELF_TEST(fbperf_nofpu, se_manual, &selftest_fbperf_nofpu)
 REGISTER_SELF_TEST(fbperf_fpu, se_manual, &selftest_fbperf_fpu)
+REGISTER_SELF_TEST(fbperf_term, se_manual, &selftest_fbperf_term)
 
 #endif // #if KERNEL_SELFTESTS
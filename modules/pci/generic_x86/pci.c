@@ -10,6 +10,7 @@
 #include <tilck/kernel/kmalloc.h>
 #include <tilck/kernel/paging.h>
 #include <tilck/kernel/modules.h>
+#include <tilck/kernel/arch/generic_x86/apic.h>
 
 #include <tilck/mods/pci.h>
 #include <tilck/mods/acpi.h>
@@ -37,6 +38,18 @@
 #define PCI_DEV_BASE_INFO                0x00
 #define PCI_CLASS_INFO_OFF               0x08
 #define PCI_HDR_TYPE_OFF                 0x0e
+#define PCI_COMMAND_OFF                  0x04
+#define PCI_STATUS_OFF                   0x06
+#define PCI_CAP_PTR_OFF                  0x34
+
+#define PCI_COMMAND_INTX_DISABLE    (1 << 10)
+#define PCI_STATUS_CAP_LIST         (1 <<  4)
+
+#define PCI_MSI_CTRL_OFF                    2
+#define PCI_MSI_ADDR_OFF                    4
+#define PCI_MSI_CTRL_ENABLE         (1 <<  0)
+#define PCI_MSI_CTRL_MME_MASK       (7 <<  4)
+#define PCI_MSI_CTRL_64BIT          (1 <<  7)
 
 #define PCI_HDR1_SECOND_BUS              0x19
 #define PCI_HDR1_SUBORD_BUS              0x1a
@@ -379,6 +392,91 @@ int pci_device_get_info(struct pci_device_loc loc,
    return 0;
 }
 
+u32
+pci_find_cap(struct pci_device_loc loc, u8 cap_id)
+{
+   u32 status, ptr, hdr;
+
+   if (pci_config_read(loc, PCI_STATUS_OFF, 16, &status))
+      return 0;
+
+   if (!(status & PCI_STATUS_CAP_LIST))
+      return 0;
+
+   if (pci_config_read(loc, PCI_CAP_PTR_OFF, 8, &ptr))
+      return 0;
+
+   /* Limit the number of iterations, in case the list is broken */
+   for (int i = 0; i < 48 && ptr >= 0x40; i++) {
+
+      ptr &= ~3u;
+
+      if (pci_config_read(loc, ptr, 16, &hdr))
+         return 0;
+
+      if ((hdr & 0xff) == cap_id)
+         return ptr;
+
+      ptr = (hdr >> 8) & 0xff;
+   }
+
+   return 0;
+}
+
+int
+pci_enable_msi(struct pci_device *dev)
+{
+   const struct pci_device_loc loc = dev->loc;
+   u32 cap, ctrl, cmd, addr, data;
+   int irq, rc;
+
+   if (!(cap = pci_find_cap(loc, PCI_CAP_ID_MSI)))
+      return -EOPNOTSUPP;
+
+   if ((rc = pci_config_read(loc, cap + PCI_MSI_CTRL_OFF, 16, &ctrl)))
+      return rc;
+
+   if ((irq = apic_alloc_msi_irq(&addr, &data)) < 0)
+      return irq;
+
+   pci_config_write(loc, cap + PCI_MSI_ADDR_OFF, 32, addr);
+
+   if (ctrl & PCI_MSI_CTRL_64BIT) {
+      pci_config_write(loc, cap + PCI_MSI_ADDR_OFF + 4, 32, 0);
+      pci_config_write(loc, cap + PCI_MSI_ADDR_OFF + 8, 16, data);
+   } else {
+      pci_config_write(loc, cap + PCI_MSI_ADDR_OFF + 4, 16, data);
+   }
+
+   /* Single message, enabled */
+   ctrl &= ~PCI_MSI_CTRL_MME_MASK;
+   ctrl |= PCI_MSI_CTRL_ENABLE;
+   pci_config_write(loc, cap + PCI_MSI_CTRL_OFF, 16, ctrl);
+
+   /* Disable the legacy INTx pin */
+   if (!pci_config_read(loc, PCI_COMMAND_OFF, 16, &cmd))
+      pci_config_write(loc, PCI_COMMAND_OFF, 16, cmd | PCI_COMMAND_INTX_DISABLE);
+
+   return irq;
+}
+
+void
+pci_disable_msi(struct pci_device *dev, int irq)
+{
+   const struct pci_device_loc loc = dev->loc;
+   u32 cap, ctrl;
+
+   if (!(cap = pci_find_cap(loc, PCI_CAP_ID_MSI)))
+      return;
+
+   if (!pci_config_read(loc, cap + PCI_MSI_CTRL_OFF, 16, &ctrl)) {
+      ctrl &= ~PCI_MSI_CTRL_ENABLE;
+      pci_config_write(loc, cap + PCI_MSI_CTRL_OFF, 16, ctrl);
+   }
+
+   apic_free_msi_irq(irq);
+}
+
 /*
  * Initialize the support for the Enhanced Configuration Access Mechanism,
  * used by PCI Express.
@@ -31,6 +31,9 @@
 #define IER_SLEEP_MODE_INTR        0b00010000
 #define IER_LOW_PWR_INTR           0b00100000
 
+/* Interrupt Identification Register (IIR) */
+#define IIR_FIFOS_ENABLED          0b11000000
+
 /* Line Status Register (LSR) */
 #define LSR_DATA_READY             0b00000001
 #define LSR_OVERRUN_ERROR          0b00000010
@@ -160,3 +163,34 @@ void serial_write(u16 port, char c)
    serial_wait_for_write(port);
    outb(port, (u8)c);
 }
+
+/* Write a char without waiting: the caller must know there's room for it */
+void serial_write_no_wait(u16 port, char c)
+{
+   outb(port, (u8)c);
+}
+
+/*
+ * The number of chars that can be written without waiting after
+ * serial_write_ready() returned true: the size of the TX FIFO, if any.
+ */
+u32 serial_get_tx_fifo_size(u16 port)
+{
+   if ((inb(port + UART_IIR) & IIR_FIFOS_ENABLED) == IIR_FIFOS_ENABLED)
+      return SERIAL_TX_FIFO_SIZE;
+
+   return 1;
+}
+
+/* Enable/disable the "transmitter holding register empty" interrupt */
+void serial_set_tx_intr(u16 port, bool enabled)
+{
+   u8 ier = inb(port + UART_IER);
+
+   if (enabled)
+      ier |= IER_TR_EMPTY_INTR;
+   else
+      ier &= (u8)~IER_TR_EMPTY_INTR;
+
+   outb(port + UART_IER, ier);
+}
@@ -11,6 +11,10 @@
 #include <tilck/kernel/cmdline.h>
 #include <tilck/kernel/tty.h>
 #include <tilck/kernel/sched.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/ringbuf.h>
+#include <tilck/kernel/interrupts.h>
+#include <tilck/kernel/timer.h>
 
 #include <tilck/mods/serial.h>
 
@@ -23,6 +27,22 @@ struct serial_device {
    struct tty *tty;
    ATOMIC(int) jobs_cnt;
    struct worker_thread *wth;
+
+   /*
+    * TX path: writers append to `tx_rb` and the THR-empty IRQ handler moves
+    * its contents to the UART's TX FIFO, `tx_fifo_size` chars at a time. The
+    * ring buffer and the `tx_*` flags are protected by disabling the
+    * interrupts, while the `tx_mutex` just serializes the writers and allows
+    * them to sleep on `tx_cond` when the ring is full.
+    */
+   bool tx_ready;                /* the TX ring is initialized */
+   bool tx_intr_on;              /* the THR-empty interrupt is enabled */
+   bool tx_waiters;              /* a writer is waiting for room in the ring */
+   u32 tx_fifo_size;
+   struct ringbuf tx_rb;
+   struct kmutex tx_mutex;
+   struct kcond tx_cond;
+   char tx_buf[SERIAL_TX_BUF_SIZE];
 };
 
 struct serial_device legacy_serial_ports[] =
@@ -61,12 +81,78 @@ static void ser_bh_handler(void *ctx)
    dev->jobs_cnt--;
 }
 
+static void ser_tx_bh_handler(void *ctx)
+{
+   struct serial_device *const dev = ctx;
+
+   kmutex_lock(&dev->tx_mutex);
+   {
+      kcond_signal_all(&dev->tx_cond);
+   }
+   kmutex_unlock(&dev->tx_mutex);
+}
+
+/*
+ * Move up to `tx_fifo_size` chars from the TX ring to the UART. It must be
+ * called with the interrupts disabled and only when serial_write_ready() is
+ * true. Returns true if the ring is empty.
+ */
+static bool ser_tx_fill_fifo(struct serial_device *dev)
+{
+   char buf[SERIAL_TX_FIFO_SIZE];
+   size_t n;
+
+   ASSERT(!are_interrupts_enabled());
+   n = ringbuf_read_bytes(&dev->tx_rb, (u8 *)buf, dev->tx_fifo_size);
+
+   for (size_t i = 0; i < n; i++)
+      serial_write_no_wait(dev->ioport, buf[i]);
+
+   return ringbuf_is_empty(&dev->tx_rb);
+}
+
+static void ser_tx_set_intr(struct serial_device *dev, bool enabled)
+{
+   if (dev->tx_intr_on != enabled) {
+      serial_set_tx_intr(dev->ioport, enabled);
+      dev->tx_intr_on = enabled;
+   }
+}
+
+static void ser_tx_irq(struct serial_device *dev)
+{
+   ulong var;
+
+   /* IRQ handlers run with the interrupts enabled: protect the TX ring */
+   disable_interrupts(&var);
+   {
+      if (ser_tx_fill_fifo(dev))
+         ser_tx_set_intr(dev, false);
+
+      if (dev->tx_waiters && !in_panic()) {
+
+         /* kcond_signal_all() cannot be called here: use a bottom half */
+         if (wth_enqueue_on(dev->wth, &ser_tx_bh_handler, dev))
+            dev->tx_waiters = false;
+
+         /* Otherwise, the writer will wake up anyway after its timeout */
+      }
+   }
+   enable_interrupts(&var);
+}
+
 static enum irq_action serial_con_irq_handler(void *ctx)
 {
    struct serial_device *const dev = ctx;
+   enum irq_action rc = IRQ_NOT_HANDLED;
+
+   if (dev->tx_intr_on && serial_write_ready(dev->ioport)) {
+      ser_tx_irq(dev);
+      rc = IRQ_HANDLED;
+   }
 
    if (!serial_read_ready(dev->ioport))
-      return IRQ_NOT_HANDLED; /* Not an IRQ from this "device" [irq sharing] */
+      return rc; /* Not an RX IRQ from this "device" [irq sharing] */
 
    if (dev->jobs_cnt >= 2)
       return IRQ_HANDLED;
@@ -93,6 +179,109 @@ static enum irq_action serial_con_irq_handler(void *ctx)
    return IRQ_HANDLED;
 }
 
+static struct serial_device *ser_get_dev(u16 port)
+{
+   for (int i = 0; i < ARRAY_SIZE(legacy_serial_ports); i++) {
+      if (legacy_serial_ports[i].ioport == port)
+         return &legacy_serial_ports[i];
+   }
+
+   return NULL;
+}
+
+/*
+ * The polled TX path, used before the initialization of the module, during
+ * panic and in all the contexts where we cannot sleep. Flush the TX ring
+ * first, in order to preserve the order of the chars.
+ */
+static void
+ser_tx_write_polled(struct serial_device *dev, u16 port,
+                    const char *buf, size_t len)
+{
+   ulong var;
+   disable_interrupts(&var);
+   {
+      if (dev && dev->tx_ready) {
+
+         while (!ringbuf_is_empty(&dev->tx_rb)) {
+            serial_wait_for_write(port);
+            ser_tx_fill_fifo(dev);
+         }
+
+         ser_tx_set_intr(dev, false);
+      }
+
+      for (size_t i = 0; i < len; i++)
+         serial_write(port, buf[i]);
+   }
+   enable_interrupts(&var);
+}
+
+/*
+ * Enqueue `len` chars in the TX ring of the serial port, sleeping only when
+ * the ring is full.
+ */
+void serial_tx_write(u16 port, const char *buf, size_t len)
+{
+   struct serial_device *dev = ser_get_dev(port);
+   bool full;
+   size_t n;
+   ulong var;
+
+   if (!dev || !dev->tx_ready ||
+       in_panic() || in_irq() || !is_preemption_enabled())
+   {
+      ser_tx_write_polled(dev, port, buf, len);
+      return;
+   }
+
+   kmutex_lock(&dev->tx_mutex);
+
+   while (len > 0) {
+
+      disable_interrupts(&var);
+      {
+         n = ringbuf_write_bytes(&dev->tx_rb, (u8 *)buf, len);
+
+         /* Start the transmission, if it's not running */
+         if (!dev->tx_intr_on && serial_write_ready(port))
+            ser_tx_fill_fifo(dev);
+
+         if (!ringbuf_is_empty(&dev->tx_rb))
+            ser_tx_set_intr(dev, true);
+
+         full = n < len;
+
+         if (full)
+            dev->tx_waiters = true;
+      }
+      enable_interrupts(&var);
+
+      buf += n;
+      len -= n;
+
+      if (!full)
+         break;
+
+      /*
+       * Wait for the IRQ handler to make some room in the ring. Use a timeout
+       * just in case we miss the THR-empty interrupt: in that case, push the
+       * next chars to the UART ourselves.
+       */
+      if (!kcond_wait(&dev->tx_cond, &dev->tx_mutex, TIMER_HZ / 10)) {
+
+         disable_interrupts(&var);
+         {
+            if (serial_write_ready(port))
+               ser_tx_fill_fifo(dev);
+         }
+         enable_interrupts(&var);
+      }
+   }
+
+   kmutex_unlock(&dev->tx_mutex);
+}
+
 void early_init_serial_ports(void)
 {
    init_serial_port(COM1);
@@ -125,6 +314,12 @@ static void init_serial_comm(void)
 
       dev->tty = get_serial_tty((int)i);
       dev->wth = wth;
+
+      ringbuf_init(&dev->tx_rb, SERIAL_TX_BUF_SIZE, 1, dev->tx_buf);
+      kmutex_init(&dev->tx_mutex, 0);
+      kcond_init(&dev->tx_cond);
+      dev->tx_fifo_size = serial_get_tx_fifo_size(dev->ioport);
+      dev->tx_ready = true;
    }
 
    irq_install_handler(X86_PC_COM1_COM3_IRQ, &com1);
@@ -56,14 +56,20 @@ static void
 sterm_action_write(term *_t, const char *buf, size_t len)
 {
    struct sterm *const t = _t;
+   const u16 port = t->serial_port_fwd;
+   size_t start = 0;
 
-   for (u32 i = 0; i < len; i++) {
+   /* Write the text in chunks, translating each '\n' into "\r\n" */
+   for (size_t i = 0; i < len; i++) {
 
-      if (buf[i] == '\n')
-         serial_write(t->serial_port_fwd, '\r');
-
-      serial_write(t->serial_port_fwd, buf[i]);
+      if (buf[i] == '\n') {
+         serial_tx_write(port, buf + start, i - start);
+         serial_tx_write(port, "\r\n", 2);
+         start = i + 1;
+      }
    }
+
+   serial_tx_write(port, buf + start, len - start);
 }
 
 static ALWAYS_INLINE void
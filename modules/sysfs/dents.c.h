@@ -1,20 +1,5 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
-static long sysfs_insert_remove_entry_cmp(const void *a, const void *b)
-{
-   const struct sysfs_entry *e1 = a;
-   const struct sysfs_entry *e2 = b;
-   return strcmp(e1->name, e2->name);
-}
-
-static long sysfs_find_entry_cmp(const void *obj, const void *valptr)
-{
-   const struct sysfs_entry *e = obj;
-   const char *searched_str = valptr;
-   return strcmp(e->name, searched_str);
-}
-
-
 static int
 sysfs_getdents(fs_handle h, get_dents_func_cb cb, void *arg)
 {
@@ -32,6 +17,7 @@ sysfs_getdents(fs_handle h, get_dents_func_cb cb, void *arg)
          .type       = sh->dir.dpos->inode->type,
          .name_len   = sh->dir.dpos->name_len,
          .name       = sh->dir.dpos->name,
+         .next_off   = (offt)sh->dir.dpos->node.cookie + 1,
       };
 
       if ((rc = cb(&dent, arg)))
@@ -46,15 +32,45 @@ sysfs_dir_get_entry_by_name(struct sysfs_inode *idir,
                             const char *name,
                             ssize_t len)
 {
-   char buf[SYSFS_ENTRY_MAX_LEN];
-   memcpy(buf, name, (size_t) len);
-   buf[len] = 0;
-
-   return bintree_find(idir->dir.entries_tree_root,
-                       buf,
-                       sysfs_find_entry_cmp,
-                       struct sysfs_entry,
-                       node);
+   return dir_index_find_obj(&idir->dir.index,
+                             name,
+                             (size_t) len,
+                             struct sysfs_entry,
+                             node);
+}
+
+/*
+ * Return the first entry of `idir` having a cookie >= `cookie`, or the list
+ * head if there's no such entry. Same as ramfs_dir_get_entry_by_cookie().
+ */
+static struct sysfs_entry *
+sysfs_dir_get_entry_by_cookie(struct sysfs_inode *idir, u32 cookie)
+{
+   struct sysfs_entry *e;
+
+   if (cookie > 0) {
+
+      e = dir_index_find_cookie_obj(&idir->dir.index,
+                                    cookie - 1,
+                                    struct sysfs_entry,
+                                    node);
+      if (e)
+         return list_next_obj(e, lnode);
+   }
+
+   e = dir_index_find_cookie_obj(&idir->dir.index,
+                                 cookie,
+                                 struct sysfs_entry,
+                                 node);
+   if (e)
+      return e;
+
+   list_for_each_ro(e, &idir->dir.entries_list, lnode) {
+      if (e->node.cookie >= cookie)
+         break;
+   }
+
+   return e;
 }
 
 static void
@@ -99,7 +115,6 @@ sysfs_dir_add_entry(struct sysfs_inode *idir,
 {
    struct sysfs_entry *e;
    size_t enl = strlen(iname) + 1;
-   bool success;
 
    ASSERT(idir->type == VFS_DIR);
 
@@ -113,7 +128,6 @@ sysfs_dir_add_entry(struct sysfs_inode *idir,
       return -ENOSPC;
 
    list_node_init(&e->lnode);
-   bintree_node_init(&e->node);
 
    e->inode = ie;
    memcpy(e->name, iname, enl);
@@ -125,18 +139,16 @@ sysfs_dir_add_entry(struct sysfs_inode *idir,
 
    e->name_len = (u8) enl;
 
-   success =
-      bintree_insert(&idir->dir.entries_tree_root,
-                     e,
-                     sysfs_insert_remove_entry_cmp,
-                     struct sysfs_entry,
-                     node);
-
-   if (!success) {
+   if (sysfs_dir_get_entry_by_name(idir, e->name, enl - 1)) {
       kfree_obj(e, struct sysfs_entry);
       return -EEXIST;
    }
 
+   if (dir_index_insert(&idir->dir.index, &e->node)) {
+      kfree_obj(e, struct sysfs_entry);
+      return -ENOSPC;
+   }
+
    list_add_tail(&idir->dir.entries_list, &e->lnode);
    idir->dir.num_entries++;
 
@@ -151,12 +163,7 @@ sysfs_dir_remove_entry(struct sysfs_inode *idir, struct sysfs_entry *e)
 {
    ASSERT(idir->type == VFS_DIR);
 
-   bintree_remove(&idir->dir.entries_tree_root,
-                  e,
-                  sysfs_insert_remove_entry_cmp,
-                  struct sysfs_entry,
-                  node);
-
+   dir_index_remove(&idir->dir.index, &e->node);
    list_remove(&e->lnode);
    idir->dir.num_entries--;
    kfree_obj(e, struct sysfs_entry);
@@ -18,31 +18,21 @@ sysfs_dir_ioctl(fs_handle h, ulong request, void *arg)
    return -EINVAL;
 }
 
+/* Dir offsets are entry cookies + 1, as in ramfs: see ramfs_dir_seek() */
 static offt
 sysfs_dir_seek(fs_handle h, offt target_off, int whence)
 {
    struct sysfs_handle *sh = h;
-   struct sysfs_entry *pos;
-   offt off = 0;
 
    if (target_off < 0 || whence != SEEK_SET)
       return -EINVAL;
 
-   list_for_each_ro(pos, &sh->inode->dir.entries_list, lnode) {
-
-      if (off == target_off)
-         break;
-
-      off++;
-   }
-
-   if (off == target_off) {
-      sh->dir.dpos = pos;
-      sh->dir_pos = off;
-      return sh->dir_pos;
-   }
+   if ((u64)target_off > UINT32_MAX)
+      return -EINVAL;
 
-   return -EINVAL;
+   sh->dir.dpos = sysfs_dir_get_entry_by_cookie(sh->inode, (u32)target_off);
+   sh->dir_pos = target_off;
+   return sh->dir_pos;
 }
 
 static const struct file_ops static_ops_dir_sysfs =
@@ -20,6 +20,18 @@ sysfs_destroy_inode(struct sysfs_data *d, struct sysfs_inode *i)
    if (i->type == VFS_SYMLINK)
       kfree2(i->symlink.path, i->symlink.path_len);
 
+   if (i->type == VFS_DIR) {
+
+      /* Only the '.' and '..' entries are expected here, if any */
+      while (!list_is_empty(&i->dir.entries_list)) {
+         sysfs_dir_remove_entry(
+            i, list_first_obj(&i->dir.entries_list, struct sysfs_entry, lnode)
+         );
+      }
+
+      dir_index_destroy(&i->dir.index);
+   }
+
    kfree_obj(i, struct sysfs_inode);
 }
 
@@ -33,25 +45,16 @@ sysfs_create_inode_dir(struct sysfs_data *d,
       return NULL;
 
    i->type = VFS_DIR;
+   dir_index_init_for(&i->dir.index, struct sysfs_entry, node, name);
    list_init(&i->dir.entries_list);
 
    if (!parent)
       parent = i;    /* root case */
 
-   if (sysfs_dir_add_entry(i, ".", i, NULL) < 0) {
-      kfree_obj(i, struct sysfs_inode);
-      return NULL;
-   }
-
-   if (sysfs_dir_add_entry(i, "..", parent, NULL) < 0) {
-
-      struct sysfs_entry *e =
-         list_first_obj(&i->dir.entries_list,
-                        struct sysfs_entry,
-                        lnode);
-
-      sysfs_dir_remove_entry(i, e);
-      kfree_obj(i, struct sysfs_inode);
+   if (sysfs_dir_add_entry(i, ".", i, NULL) < 0 ||
+       sysfs_dir_add_entry(i, "..", parent, NULL) < 0)
+   {
+      sysfs_destroy_inode(d, i);
       return NULL;
    }
 
@@ -0,0 +1,155 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/irq.h>
+#include <tilck/kernel/errno.h>
+
+#include <tilck/mods/sysfs.h>
+#include <tilck/mods/sysfs_utils.h>
+
+#define IRQS_PROP_BUF_SZ      2048
+
+extern u32 unhandled_irq_count[256];
+extern u32 spur_irq_count;
+
+static offt
+irqs_get_buf_sz(struct sysobj *obj, void *data)
+{
+   return IRQS_PROP_BUF_SZ;
+}
+
+static void
+irqs_buf_printf(void *buf, offt buf_sz, offt *written, const char *fmt, ...)
+{
+   va_list args;
+   int len;
+
+   if (*written >= buf_sz)
+      return;
+
+   va_start(args, fmt);
+   len = vsnprintk(buf + *written, (size_t)(buf_sz - *written), fmt, args);
+   va_end(args);
+
+   if (len > 0)
+      *written += len;
+}
+
+static offt
+irqs_stats_load(struct sysobj *obj, void *data, void *buf, offt buf_sz, offt off)
+{
+   struct irq_stats *s;
+   offt written = 0;
+
+   ASSERT(off == 0);
+
+   irqs_buf_printf(buf, buf_sz, &written,
+                   "irq      count  unhandled   avg_cycles   max_cycles\n");
+
+   for (int i = 0; i < ARRAY_SIZE(irq_stats); i++) {
+
+      s = &irq_stats[i];
+
+      if (!s->count)
+         continue;
+
+      irqs_buf_printf(buf, buf_sz, &written,
+                      "%3d %10u %10u %12llu %12u\n",
+                      i, s->count, unhandled_irq_count[i],
+                      s->tot_cycles / s->count, s->max_cycles);
+   }
+
+   irqs_buf_printf(buf, buf_sz, &written, "spurious: %u\n", spur_irq_count);
+   return MIN(written, buf_sz);
+}
+
+static offt
+irqs_hist_load(struct sysobj *obj, void *data, void *buf, offt buf_sz, offt off)
+{
+   offt written = 0;
+
+   ASSERT(off == 0);
+
+   /*
+    * One line per IRQ with at least one sample. The first column is the IRQ
+    * number, the others are the log2 buckets described in irq.h, starting
+    * from the one for cycles < 2^(IRQ_HIST_MIN_SHIFT + 1).
+    */
+   for (int i = 0; i < ARRAY_SIZE(irq_stats) && written < buf_sz; i++) {
+
+      if (!irq_stats[i].count)
+         continue;
+
+      irqs_buf_printf(buf, buf_sz, &written, "%d:", i);
+
+      for (int j = 0; j < IRQ_HIST_BUCKETS; j++)
+         irqs_buf_printf(buf, buf_sz, &written, " %u", irq_stats[i].hist[j]);
+
+      irqs_buf_printf(buf, buf_sz, &written, "\n");
+   }
+
+   return MIN(written, buf_sz);
+}
+
+static offt
+irqs_reset_load(struct sysobj *obj, void *data, void *buf, offt buf_sz, offt off)
+{
+   return 0;
+}
+
+static offt
+irqs_reset_store(struct sysobj *obj, void *data, void *buf, offt buf_sz)
+{
+   irq_reset_stats();
+
+   /* Always consume the whole buffer: see sys_ulong_store() */
+   return buf_sz;
+}
+
+static const struct sysobj_prop_type irqs_ptype_stats = {
+   .get_buf_sz = &irqs_get_buf_sz,
+   .load = &irqs_stats_load,
+};
+
+static const struct sysobj_prop_type irqs_ptype_hist = {
+   .get_buf_sz = &irqs_get_buf_sz,
+   .load = &irqs_hist_load,
+};
+
+static const struct sysobj_prop_type irqs_ptype_reset = {
+   .load = &irqs_reset_load,
+   .store = &irqs_reset_store,
+};
+
+DEF_STATIC_SYSOBJ_PROP(stats, &irqs_ptype_stats);
+DEF_STATIC_SYSOBJ_PROP(hist, &irqs_ptype_hist);
+DEF_STATIC_SYSOBJ_PROP(reset, &irqs_ptype_reset);
+
+void sysfs_create_irqs_obj(void)
+{
+   struct sysobj *irqs;
+
+   irqs = sysfs_create_custom_obj(
+      "irqs",
+      NULL,       /* hooks */
+      &prop_stats, NULL,
+      &prop_hist, NULL,
+      &prop_reset, NULL,
+      NULL
+   );
+
+   if (!irqs)
+      goto fail;
+
+   if (sysfs_register_obj(NULL, &sysfs_root_obj, "irqs", irqs))
+      goto fail;
+
+   /* Success */
+   return;
+
+fail:
+   panic("Unable to create the sysfs irqs obj");
+}
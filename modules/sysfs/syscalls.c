@@ -0,0 +1,287 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/syscall_stats.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/errno.h>
+
+#include <tilck/mods/sysfs.h>
+#include <tilck/mods/sysfs_utils.h>
+
+#define SYS_STATS_LINE_SZ          80
+#define SYS_HIST_LINE_SZ           (16 + SYS_HIST_BUCKETS * 11)
+
+struct sys_dump_ctx {
+
+   char *buf;
+   offt buf_sz;
+   offt written;
+};
+
+static void
+sys_dump_printf(struct sys_dump_ctx *ctx, const char *fmt, ...)
+{
+   va_list args;
+   int len;
+
+   if (ctx->written >= ctx->buf_sz)
+      return;
+
+   va_start(args, fmt);
+   len = vsnprintk(ctx->buf + ctx->written,
+                   (size_t)(ctx->buf_sz - ctx->written), fmt, args);
+   va_end(args);
+
+   if (len > 0)
+      ctx->written += len;
+}
+
+static void
+sys_dump_name(struct sys_dump_ctx *ctx, u32 sn)
+{
+   const char *name = sys_stats_get_name(sn);
+   sys_dump_printf(ctx, "%3u %-20s", sn, name ? name : "?");
+}
+
+static void
+sys_dump_stats_line(struct sys_dump_ctx *ctx, struct syscall_stats *s)
+{
+   sys_dump_printf(ctx, " %10u %8u %12llu %12u\n",
+                   s->calls, s->errors,
+                   s->tot_cycles / s->calls, s->max_cycles);
+}
+
+static void
+sys_dump_hist_line(struct sys_dump_ctx *ctx, struct syscall_stats *s)
+{
+   for (int j = 0; j < SYS_HIST_BUCKETS; j++)
+      sys_dump_printf(ctx, " %u", s->hist[j]);
+
+   sys_dump_printf(ctx, "\n");
+}
+
+static u32
+sys_count_used(void)
+{
+   u32 count = 0;
+
+   for (u32 i = 0; i < MAX_SYSCALLS; i++)
+      if (sys_stats[i].calls)
+         count++;
+
+   return count;
+}
+
+static int
+sys_count_proc_lines_cb(void *obj, void *arg)
+{
+   struct task *ti = obj;
+   struct proc_sys_stats *ps;
+   u32 *count = arg;
+
+   if (!ti->is_main_thread || !(ps = sys_stats_get_proc(ti->pi)))
+      return 0;
+
+   for (int i = 0; i < PROC_SYS_STATS_SLOTS; i++)
+      if (ps->sys_n[i])
+         (*count)++;
+
+   return 0;
+}
+
+static offt
+sys_stats_get_buf_sz(struct sysobj *obj, void *data)
+{
+   return (offt)(sys_count_used() + 1) * SYS_STATS_LINE_SZ;
+}
+
+static offt
+sys_hist_get_buf_sz(struct sysobj *obj, void *data)
+{
+   return (offt)(sys_count_used() + 1) * SYS_HIST_LINE_SZ;
+}
+
+static offt
+sys_procs_get_buf_sz(struct sysobj *obj, void *data)
+{
+   u32 count = 0;
+
+   disable_preemption();
+   {
+      iterate_over_tasks(sys_count_proc_lines_cb, &count);
+   }
+   enable_preemption();
+   return (offt)(count + 1) * (SYS_STATS_LINE_SZ + SYS_HIST_LINE_SZ);
+}
+
+static offt
+sys_stats_load(struct sysobj *obj, void *data, void *buf, offt buf_sz, offt off)
+{
+   struct sys_dump_ctx ctx = { .buf = buf, .buf_sz = buf_sz };
+   ASSERT(off == 0);
+
+   sys_dump_printf(&ctx, "%-24s %10s %8s %12s %12s\n",
+                   "sys name", "calls", "errors",
+                   "avg_cycles", "max_cycles");
+
+   disable_preemption();
+   {
+      for (u32 i = 0; i < MAX_SYSCALLS; i++) {
+
+         if (!sys_stats[i].calls)
+            continue;
+
+         sys_dump_name(&ctx, i);
+         sys_dump_stats_line(&ctx, &sys_stats[i]);
+      }
+   }
+   enable_preemption();
+   return MIN(ctx.written, buf_sz);
+}
+
+static offt
+sys_hist_load(struct sysobj *obj, void *data, void *buf, offt buf_sz, offt off)
+{
+   struct sys_dump_ctx ctx = { .buf = buf, .buf_sz = buf_sz };
+   ASSERT(off == 0);
+
+   /*
+    * One line per syscall called at least once. The first column is the
+    * syscall number, the others are the log2 buckets described in
+    * syscall_stats.h, starting from the one for cycles < 2^(MIN_SHIFT + 1).
+    */
+   disable_preemption();
+   {
+      for (u32 i = 0; i < MAX_SYSCALLS; i++) {
+
+         if (!sys_stats[i].calls)
+            continue;
+
+         sys_dump_printf(&ctx, "%u:", i);
+         sys_dump_hist_line(&ctx, &sys_stats[i]);
+      }
+   }
+   enable_preemption();
+   return MIN(ctx.written, buf_sz);
+}
+
+static int
+sys_dump_proc_cb(void *obj, void *arg)
+{
+   struct task *ti = obj;
+   struct sys_dump_ctx *ctx = arg;
+   struct proc_sys_stats *ps;
+
+   if (!ti->is_main_thread || !(ps = sys_stats_get_proc(ti->pi)))
+      return 0;
+
+   for (int i = 0; i < PROC_SYS_STATS_SLOTS; i++) {
+
+      if (!ps->sys_n[i])
+         continue;
+
+      sys_dump_printf(ctx, "%5d ", ti->pi->pid);
+      sys_dump_name(ctx, ps->sys_n[i] - 1u);
+      sys_dump_stats_line(ctx, &ps->s[i]);
+      sys_dump_printf(ctx, "%6s", "");
+      sys_dump_hist_line(ctx, &ps->s[i]);
+   }
+
+   if (ps->untracked)
+      sys_dump_printf(ctx, "%5d untracked: %u\n", ti->pi->pid, ps->untracked);
+
+   return 0;
+}
+
+static offt
+sys_procs_load(struct sysobj *obj, void *data, void *buf, offt buf_sz, offt off)
+{
+   struct sys_dump_ctx ctx = { .buf = buf, .buf_sz = buf_sz };
+   ASSERT(off == 0);
+
+   /*
+    * Two lines per (process, syscall) pair: the first one has the same columns
+    * as `stats`, prefixed by the pid, the second one has the histogram.
+    */
+   sys_dump_printf(&ctx, "%5s %-24s %10s %8s %12s %12s\n",
+                   "pid", "sys name", "calls", "errors",
+                   "avg_cycles", "max_cycles");
+
+   disable_preemption();
+   {
+      iterate_over_tasks(sys_dump_proc_cb, &ctx);
+   }
+   enable_preemption();
+   return MIN(ctx.written, buf_sz);
+}
+
+static offt
+sys_reset_load(struct sysobj *obj, void *data, void *buf, offt buf_sz, offt off)
+{
+   return 0;
+}
+
+static offt
+sys_reset_store(struct sysobj *obj, void *data, void *buf, offt buf_sz)
+{
+   sys_stats_reset();
+
+   /* Always consume the whole buffer: see sys_ulong_store() */
+   return buf_sz;
+}
+
+static const struct sysobj_prop_type sys_ptype_stats = {
+   .get_buf_sz = &sys_stats_get_buf_sz,
+   .load = &sys_stats_load,
+};
+
+static const struct sysobj_prop_type sys_ptype_hist = {
+   .get_buf_sz = &sys_hist_get_buf_sz,
+   .load = &sys_hist_load,
+};
+
+static const struct sysobj_prop_type sys_ptype_procs = {
+   .get_buf_sz = &sys_procs_get_buf_sz,
+   .load = &sys_procs_load,
+};
+
+static const struct sysobj_prop_type sys_ptype_reset = {
+   .load = &sys_reset_load,
+   .store = &sys_reset_store,
+};
+
+DEF_STATIC_SYSOBJ_PROP(stats, &sys_ptype_stats);
+DEF_STATIC_SYSOBJ_PROP(hist, &sys_ptype_hist);
+DEF_STATIC_SYSOBJ_PROP(procs, &sys_ptype_procs);
+DEF_STATIC_SYSOBJ_PROP(reset, &sys_ptype_reset);
+
+void sysfs_create_syscalls_obj(void)
+{
+   struct sysobj *syscalls;
+
+   syscalls = sysfs_create_custom_obj(
+      "syscalls",
+      NULL,       /* hooks */
+      &prop_stats, NULL,
+      &prop_hist, NULL,
+      &prop_procs, NULL,
+      &prop_reset, NULL,
+      NULL
+   );
+
+   if (!syscalls)
+      goto fail;
+
+   if (sysfs_register_obj(NULL, &sysfs_root_obj, "syscalls", syscalls))
+      goto fail;
+
+   /* Success */
+   return;
+
+fail:
+   panic("Unable to create the sysfs syscalls obj");
+}
@@ -25,6 +25,9 @@
 #include "lock_and_retain.c.h"
 
 void sysfs_create_config_obj(void);
+void sysfs_create_irqs_obj(void);
+void sysfs_create_syscalls_obj(void);
+void sysfs_create_wth_obj(void);
 static struct mnt_fs *sysfs;
 
 static int
@@ -756,6 +759,9 @@ init_sysfs(void)
       panic("Unable to create default objects");
 
    sysfs_create_config_obj();
+   sysfs_create_irqs_obj();
+   sysfs_create_syscalls_obj();
+   sysfs_create_wth_obj();
 }
 
 static struct module sysfs_module = {
@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
 #include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/fs/dir_index.h>
 #include <tilck/mods/sysfs.h>
 #include <tilck/mods/sysfs_utils.h>
 
@@ -9,14 +10,14 @@ struct sysfs_inode;
 #define SYSFS_ENTRY_SIZE                       64
 #define SYSFS_ENTRY_MAX_LEN (                   \
    SYSFS_ENTRY_SIZE                             \
-   - sizeof(struct bintree_node)                \
+   - sizeof(struct dir_index_node)              \
    - sizeof(struct list_node)                   \
    - sizeof(struct ramfs_inode *)               \
    - sizeof(u8)                                 \
 )
 
 struct sysfs_entry {
-   struct bintree_node node;
+   struct dir_index_node node;
    struct list_node lnode;
    struct sysfs_inode *inode;
    u8 name_len;                     /* NOTE: includes the final \0 */
@@ -45,8 +46,8 @@ struct sysfs_inode {
       struct {
 
          offt num_entries;
-         struct ramfs_entry *entries_tree_root;
-         struct list entries_list;
+         struct dir_index index;             /* see dir_index.h */
+         struct list entries_list;           /* ordered by cookie */
          struct sysobj *obj;
 
       } dir;
@@ -0,0 +1,90 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/worker_thread.h>
+#include <tilck/kernel/sched.h>
+
+#include <tilck/mods/sysfs.h>
+#include <tilck/mods/sysfs_utils.h>
+
+#define WTH_PROP_BUF_SZ       4096
+
+static offt
+wth_get_buf_sz(struct sysobj *obj, void *data)
+{
+   return WTH_PROP_BUF_SZ;
+}
+
+static offt
+wth_stats_load(struct sysobj *obj, void *data, void *buf, offt buf_sz, offt off)
+{
+   struct worker_thread *wth;
+   struct wth_stats s;
+   const char *name;
+   offt written = 0;
+   int len;
+
+   ASSERT(off == 0);
+
+   written += snprintk(buf, (size_t)buf_sz,
+                       "%-10s %4s %5s %5s %9s %9s %9s %9s\n",
+                       "name", "prio", "qsize", "depth",
+                       "max_depth", "overflows", "drops", "stolen");
+
+   disable_preemption();
+
+   for (int i = 0; (wth = wth_get_worker(i)) != NULL; i++) {
+
+      wth_get_stats(wth, &s);
+      name = wth_get_name(wth);
+
+      len = snprintk(buf + written, (size_t)(buf_sz - written),
+                     "%-10s %4d %5u %5u %9u %9u %9u %9u\n",
+                     name ? name : "generic",
+                     wth_get_priority(wth),
+                     wth_get_queue_size(wth),
+                     s.depth, s.max_depth, s.overflows, s.drops, s.stolen);
+
+      if (len <= 0)
+         break;
+
+      written += len;
+   }
+
+   enable_preemption();
+   return MIN(written, buf_sz);
+}
+
+static const struct sysobj_prop_type wth_ptype_stats = {
+   .get_buf_sz = &wth_get_buf_sz,
+   .load = &wth_stats_load,
+};
+
+DEF_STATIC_SYSOBJ_PROP(stats, &wth_ptype_stats);
+
+void sysfs_create_wth_obj(void)
+{
+   struct sysobj *wth;
+
+   wth = sysfs_create_custom_obj(
+      "wth",
+      NULL,       /* hooks */
+      &prop_stats, NULL,
+      NULL
+   );
+
+   if (!wth)
+      goto fail;
+
+   if (sysfs_register_obj(NULL, &sysfs_root_obj, "wth", wth))
+      goto fail;
+
+   /* Success */
+   return;
+
+fail:
+   panic("Unable to create the sysfs wth obj");
+}
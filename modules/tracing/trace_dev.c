@@ -0,0 +1,283 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/fs/devfs.h>
+#include <tilck/kernel/fs/vfs.h>
+
+#include <tilck/mods/tracing.h>
+
+/*
+ * /dev/trace: streams the raw trace events to user space, after a header with
+ * the syscall metadata (see struct trace_dev_header). The events are formatted
+ * offline, by scripts/dev/trace_decode. While the device is open, tracing is
+ * enabled: the traced tasks are still selected with the debug panel. The
+ * device cannot be opened while the debug panel's tracer is active, and vice
+ * versa (see tracing_acquire()).
+ */
+
+#define PTYPE_NAME(t)         { &ptype_##t, #t }
+
+static const struct {
+
+   const struct sys_param_type *type;
+   const char *name;
+
+} ptype_names[] = {
+
+   PTYPE_NAME(int),
+   PTYPE_NAME(voidp),
+   PTYPE_NAME(oct),
+   PTYPE_NAME(errno_or_val),
+   PTYPE_NAME(errno_or_ptr),
+   PTYPE_NAME(buffer),
+   PTYPE_NAME(big_buf),
+   PTYPE_NAME(path),
+   PTYPE_NAME(open_flags),
+   PTYPE_NAME(iov_in),
+   PTYPE_NAME(iov_out),
+   PTYPE_NAME(int32_pair),
+   PTYPE_NAME(doff64),
+   PTYPE_NAME(whence),
+   PTYPE_NAME(u64_ptr),
+   PTYPE_NAME(signum),
+};
+
+static struct kmutex trace_dev_lock;
+static char *trace_dev_hdr;
+static u32 trace_dev_hdr_size;
+
+static const char *
+get_ptype_name(const struct sys_param_type *t)
+{
+   for (u32 i = 0; i < ARRAY_SIZE(ptype_names); i++)
+      if (ptype_names[i].type == t)
+         return ptype_names[i].name;
+
+   return "unknown";
+}
+
+static void
+fill_sys_param_rec(u32 sys_n,
+                   const struct syscall_info *si,
+                   int i,
+                   struct trace_dev_param *rec)
+{
+   const struct sys_param_info *p = &si->params[i];
+   size_t off, size;
+
+   snprintk(rec->name, sizeof(rec->name), "%s", p->name);
+   snprintk(rec->type, sizeof(rec->type), "%s", get_ptype_name(p->type));
+
+   rec->kind = (u8)p->kind;
+   rec->helper_idx = -1;
+
+   if (p->helper_param_name)
+      rec->helper_idx = (s8)tracing_get_param_idx(si, p->helper_param_name);
+
+   if (p->real_sz_in_ret)
+      rec->flags |= TRACE_DEV_PF_REAL_SZ_IN_RET;
+
+   if (p->invisible)
+      rec->flags |= TRACE_DEV_PF_INVISIBLE;
+
+   if (tracing_get_slot_info(sys_n, i, &off, &size)) {
+      rec->slot_off = (u16)off;
+      rec->slot_size = (u16)size;
+   }
+}
+
+static void
+fill_sys_rec(u32 sys_n, const char *name, struct trace_dev_sys *rec)
+{
+   const struct syscall_info *si = tracing_get_syscall_info(sys_n);
+
+   rec->sys_n = sys_n;
+   rec->n_params = -1;
+   snprintk(rec->name, sizeof(rec->name), "%s", name + 4 /* skip "sys_" */);
+
+   if (!si)
+      return;
+
+   rec->n_params = si->n_params;
+   rec->exp_block = si->exp_block;
+   snprintk(rec->ret_type, sizeof(rec->ret_type), "%s",
+            get_ptype_name(si->ret_type));
+
+   for (int i = 0; i < si->n_params; i++)
+      fill_sys_param_rec(sys_n, si, i, &rec->params[i]);
+}
+
+static int
+build_trace_dev_header(void)
+{
+   struct trace_dev_header *h;
+   struct trace_dev_sys *recs;
+   u32 sys_count = 0;
+   u32 size;
+
+   for (u32 i = 0; i < MAX_SYSCALLS; i++)
+      if (tracing_get_syscall_name(i))
+         sys_count++;
+
+   size = sizeof(*h) + sys_count * sizeof(struct trace_dev_sys);
+
+   if (!(trace_dev_hdr = kzmalloc(size)))
+      return -ENOMEM;
+
+   h = (void *)trace_dev_hdr;
+   recs = (void *)(trace_dev_hdr + sizeof(*h));
+
+   *h = (struct trace_dev_header) {
+      .version = TRACE_DEV_VERSION,
+      .header_size = size,
+      .event_size = sizeof(struct trace_event),
+      .ulong_size = sizeof(ulong),
+      .sys_count = sys_count,
+      .sys_rec_size = sizeof(struct trace_dev_sys),
+   };
+
+   memcpy(h->magic, TRACE_DEV_MAGIC, sizeof(h->magic));
+
+   for (u32 i = 0; i < MAX_SYSCALLS; i++) {
+
+      const char *name = tracing_get_syscall_name(i);
+
+      if (name)
+         fill_sys_rec(i, name, recs++);
+   }
+
+   trace_dev_hdr_size = size;
+   return 0;
+}
+
+static ssize_t
+trace_dev_read_header(char *user_buf, size_t size, offt *pos)
+{
+   const size_t len = MIN(size, (size_t)(trace_dev_hdr_size - *pos));
+
+   if (copy_to_user(user_buf, trace_dev_hdr + *pos, len))
+      return -EFAULT;
+
+   *pos += (offt)len;
+   return (ssize_t)len;
+}
+
+static ssize_t
+trace_dev_read(fs_handle h, char *user_buf, size_t size, offt *pos)
+{
+   struct fs_handle_base *hb = h;
+   struct trace_event e;
+   size_t tot = 0;
+
+   if (*pos < (offt)trace_dev_hdr_size)
+      return trace_dev_read_header(user_buf, size, pos);
+
+   if (size < sizeof(e))
+      return -EINVAL;
+
+   /* Wait for the first event, unless the handle is non-blocking */
+   while (!read_trace_event_noblock(&e)) {
+
+      if (hb->fl_flags & O_NONBLOCK)
+         return -EAGAIN;
+
+      if (pending_signals())
+         return -EINTR;
+
+      if (read_trace_event(&e, TIMER_HZ / 10))
+         break;
+   }
+
+   do {
+
+      if (copy_to_user(user_buf + tot, &e, sizeof(e)))
+         return -EFAULT;
+
+      tot += sizeof(e);
+
+   } while (tot + sizeof(e) <= size && read_trace_event_noblock(&e));
+
+   *pos += (offt)tot;
+   return (ssize_t)tot;
+}
+
+static int
+trace_dev_create_extra(int minor, void *extra)
+{
+   int rc = 0;
+
+   kmutex_lock(&trace_dev_lock);
+   {
+      if (!trace_dev_hdr)
+         rc = build_trace_dev_header();
+
+      if (!rc)
+         rc = tracing_acquire(&trace_dev_lock);
+   }
+   kmutex_unlock(&trace_dev_lock);
+   return rc;
+}
+
+/*
+ * Each handle holds a tracing reference, owned by the device: the ones
+ * created by dup() or fork() cannot fail because we already own tracing.
+ */
+static int
+trace_dev_on_dup_extra(int minor, void *extra)
+{
+   return tracing_acquire(&trace_dev_lock);
+}
+
+static void
+trace_dev_destroy_extra(int minor, void *extra)
+{
+   tracing_release(&trace_dev_lock);
+}
+
+static int
+create_trace_device(int minor,
+                    enum vfs_entry_type *type,
+                    struct devfs_file_info *nfo)
+{
+   static const struct file_ops static_ops_trace = {
+      .read = trace_dev_read,
+   };
+
+   *type = VFS_CHAR_DEV;
+   nfo->fops = &static_ops_trace;
+   nfo->spec_flags = VFS_SPFL_NO_USER_COPY;
+   nfo->create_extra = trace_dev_create_extra;
+   nfo->on_dup_extra = trace_dev_on_dup_extra;
+   nfo->destroy_extra = trace_dev_destroy_extra;
+   return 0;
+}
+
+void
+init_trace_dev(void)
+{
+   struct driver_info *di = kzalloc_obj(struct driver_info);
+   int rc;
+
+   if (!di)
+      panic("Unable to allocate the driver_info for /dev/trace");
+
+   kmutex_init(&trace_dev_lock, 0);
+
+   di->name = "trace";
+   di->create_dev_file = create_trace_device;
+
+   if ((rc = register_driver(di, -1)) < 0)
+      panic("Unable to register the trace driver (error: %d)", rc);
+
+   if ((rc = create_dev_file("trace", (u16)rc, 0 /* minor */, NULL)) < 0)
+      panic("Unable to create /dev/trace (error: %d)", rc);
+}
@@ -7,16 +7,19 @@
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/kmalloc.h>
 #include <tilck/kernel/sync.h>
-#include <tilck/kernel/ringbuf.h>
+#include <tilck/kernel/safe_ringbuf.h>
+#include <tilck/kernel/timer.h>
 #include <tilck/kernel/datetime.h>
 #include <tilck/kernel/elf_utils.h>
 #include <tilck/kernel/bintree.h>
 #include <tilck/kernel/syscalls.h>
 #include <tilck/kernel/debug_utils.h>
+#include <tilck/kernel/errno.h>
 
 #include <tilck/mods/tracing.h>
 
-#define TRACE_BUF_SIZE                       (128 * KB)
+#define TRACE_PER_BUF_SIZE         (TRACE_BUF_SIZE / TRACE_NR_BUFS)
+#define TRACE_READ_POLL_TICKS       MAX(TIMER_HZ / 100, 1)
 
 struct symbol_node {
 
@@ -27,9 +30,35 @@ struct symbol_node {
    const char *name;
 };
 
-static struct kmutex tracing_lock;
-static struct kcond tracing_cond;
-static struct ringbuf tracing_rb;
+/*
+ * Trace event buffers. The producers never take a lock: each traced task gets
+ * its own buffer (as long as there are free ones) and writes to it with
+ * preemption disabled, so that a reader (always a task) can never interrupt
+ * an on-going write. Producers can still nest (e.g. trace_printk() called by
+ * an IRQ handler), as supported by the safe_ringbuf. The buffer 0 is shared
+ * by the tasks that didn't get a buffer of their own.
+ *
+ * The readers, serialized by `tracing_read_lock`, keep the first event of each
+ * buffer in `head` and return the one with the lowest sys_time.
+ *
+ * All the buffers have the same size: TRACE_BUF_SIZE / TRACE_NR_BUFS (see
+ * config_kernel.h).
+ */
+struct trace_buf {
+
+   struct safe_ringbuf rb;
+   ATOMIC(int) tid;              /* owner task, 0 if none */
+   ATOMIC(u32) dropped;          /* events lost because the buffer was full */
+
+   bool has_head;
+   struct trace_event head;
+};
+
+/* The ring buffers have at most 64K elems */
+STATIC_ASSERT(TRACE_PER_BUF_SIZE / sizeof(struct trace_event) <= 0xffff);
+
+static struct kmutex tracing_read_lock;
+static struct trace_buf trace_bufs[TRACE_NR_BUFS];
 static void *tracing_buf;
 
 static u32 syms_count;
@@ -46,6 +75,8 @@ static int traced_syscalls_count;
 bool *traced_syscalls;
 bool __force_exp_block;
 bool __tracing_on;
+static const void *tracing_owner;
+static int tracing_refs;
 bool __tracing_dump_big_bufs;
 int __tracing_printk_lvl = 10;
 
@@ -232,15 +263,53 @@ trace_syscall_exit_save_params(const struct syscall_info *si,
    }
 }
 
+static struct trace_buf *
+get_trace_buf(int tid)
+{
+   int exp;
+
+   ASSERT(!is_preemption_enabled());
+
+   for (int i = 1; i < TRACE_NR_BUFS; i++)
+      if (atomic_load_explicit(&trace_bufs[i].tid, mo_relaxed) == tid)
+         return &trace_bufs[i];
+
+   /*
+    * Claim a free buffer with a CAS: preemption is disabled, but a nested IRQ
+    * handler might trace an event and claim a buffer for another task at the
+    * same time. Without the CAS, both could get the same buffer.
+    */
+   for (int i = 1; i < TRACE_NR_BUFS; i++) {
+
+      exp = 0;
+
+      if (atomic_cas_strong(&trace_bufs[i].tid, &exp, tid,
+                            mo_relaxed, mo_relaxed))
+      {
+         return &trace_bufs[i];
+      }
+
+      if (exp == tid)
+         return &trace_bufs[i];   /* just claimed by a nested producer */
+   }
+
+   return &trace_bufs[0];
+}
+
 static void
 enqueue_trace_event(struct trace_event *e)
 {
-   kmutex_lock(&tracing_lock);
+   struct trace_buf *tb;
+   bool was_empty;
+
+   disable_preemption();
    {
-      ringbuf_write_elem(&tracing_rb, e);
-      kcond_signal_one(&tracing_cond);
+      tb = get_trace_buf(e->tid);
+
+      if (!safe_ringbuf_write_elem(&tb->rb, e, &was_empty))
+         atomic_fetch_add_explicit(&tb->dropped, 1, mo_relaxed);
    }
-   kmutex_unlock(&tracing_lock);
+   enable_preemption();
 }
 
 void
@@ -376,29 +445,103 @@ trace_task_killed_int(int signum)
    enqueue_trace_event(&e);
 }
 
+/*
+ * Give back to the pool the buffers of the tasks that died or are not traced
+ * anymore, once they have been drained.
+ */
+static void
+release_idle_trace_bufs(void)
+{
+   struct task *ti;
+   ulong var;
+
+   disable_preemption();
+   {
+      for (int i = 1; i < TRACE_NR_BUFS; i++) {
+
+         struct trace_buf *tb = &trace_bufs[i];
+         int tid = atomic_load_explicit(&tb->tid, mo_relaxed);
+
+         if (!tid || tb->has_head || !safe_ringbuf_is_empty(&tb->rb))
+            continue;
+
+         ti = get_task(tid);
+
+         if (!ti || !ti->traced) {
+
+            /*
+             * Producers in IRQ context can still write events for `tid`:
+             * release the buffer only if it's still empty.
+             */
+            disable_interrupts(&var);
+            {
+               if (safe_ringbuf_is_empty(&tb->rb))
+                  atomic_store_explicit(&tb->tid, 0, mo_relaxed);
+            }
+            enable_interrupts(&var);
+         }
+      }
+   }
+   enable_preemption();
+}
+
+static bool
+read_trace_event_int(struct trace_event *e)
+{
+   struct trace_buf *best = NULL;
+
+   for (int i = 0; i < TRACE_NR_BUFS; i++) {
+
+      struct trace_buf *tb = &trace_bufs[i];
+
+      if (!tb->has_head)
+         tb->has_head = safe_ringbuf_read_elem(&tb->rb, &tb->head);
+
+      if (!tb->has_head)
+         continue;
+
+      if (!best || tb->head.sys_time < best->head.sys_time)
+         best = tb;
+   }
+
+   if (!best)
+      return false;
+
+   memcpy(e, &best->head, sizeof(*e));
+   best->has_head = false;
+   return true;
+}
+
 bool read_trace_event_noblock(struct trace_event *e)
 {
    bool ret;
-   kmutex_lock(&tracing_lock);
+   kmutex_lock(&tracing_read_lock);
    {
-      ret = ringbuf_read_elem(&tracing_rb, e);
+      if (!(ret = read_trace_event_int(e)))
+         release_idle_trace_bufs();
    }
-   kmutex_unlock(&tracing_lock);
+   kmutex_unlock(&tracing_read_lock);
    return ret;
 }
 
 bool read_trace_event(struct trace_event *e, u32 timeout_ticks)
 {
-   bool ret;
-   kmutex_lock(&tracing_lock);
-   {
-      if (ringbuf_is_empty(&tracing_rb))
-         kcond_wait(&tracing_cond, &tracing_lock, timeout_ticks);
+   u32 waited = 0;
 
-      ret = ringbuf_read_elem(&tracing_rb, e);
+   /*
+    * The producers don't signal anything: just poll the buffers, in order
+    * to keep the cost of tracing an event as low as possible.
+    */
+   while (!read_trace_event_noblock(e)) {
+
+      if (waited >= timeout_ticks)
+         return false;
+
+      kernel_sleep(TRACE_READ_POLL_TICKS);
+      waited += TRACE_READ_POLL_TICKS;
    }
-   kmutex_unlock(&tracing_lock);
-   return ret;
+
+   return true;
 }
 
 const struct syscall_info *
@@ -484,6 +627,20 @@ tracing_get_slot(struct trace_event *e,
    return true;
 }
 
+bool
+tracing_get_slot_info(u32 sys, int p_idx, size_t *off, size_t *size)
+{
+   const s8 slot = (*params_slots)[sys][p_idx];
+   const s8 fmt = syscalls_fmts[sys];
+
+   if (slot == NO_SLOT)
+      return false;
+
+   *off = fmt_offsets[fmt][slot];
+   *size = fmt_sizes[fmt][slot];
+   return true;
+}
+
 static bool
 is_slot_free(u32 sys, int slot)
 {
@@ -763,15 +920,70 @@ set_traced_syscalls(const char *s)
 int
 tracing_get_in_buffer_events_count(void)
 {
-   int rc;
-   kmutex_lock(&tracing_lock);
+   int rc = 0;
+   kmutex_lock(&tracing_read_lock);
+   {
+      for (int i = 0; i < TRACE_NR_BUFS; i++) {
+         rc += (int)safe_ringbuf_get_elems(&trace_bufs[i].rb);
+         rc += trace_bufs[i].has_head;
+      }
+   }
+   kmutex_unlock(&tracing_read_lock);
+   return rc;
+}
+
+u32
+tracing_get_dropped_events_count(void)
+{
+   u32 tot = 0;
+
+   for (int i = 0; i < TRACE_NR_BUFS; i++)
+      tot += atomic_load_explicit(&trace_bufs[i].dropped, mo_relaxed);
+
+   return tot;
+}
+
+/*
+ * Tracing is enabled as long as its consumer holds at least one reference.
+ * Reading an event consumes it, therefore two consumers (e.g. the debug panel
+ * and a reader of /dev/trace) would just steal each other's events: allow
+ * only one consumer at a time. The same consumer can take many references.
+ */
+int
+tracing_acquire(const void *owner)
+{
+   int rc = 0;
+
+   disable_preemption();
    {
-      rc = (int)ringbuf_get_elems(&tracing_rb); // integer narrowing
+      if (tracing_refs && tracing_owner != owner) {
+         rc = -EBUSY;
+      } else {
+         tracing_owner = owner;
+         tracing_refs++;
+         tracing_set_enabled(true);
+      }
    }
-   kmutex_unlock(&tracing_lock);
+   enable_preemption();
    return rc;
 }
 
+void
+tracing_release(const void *owner)
+{
+   disable_preemption();
+   {
+      ASSERT(tracing_refs > 0);
+      ASSERT(tracing_owner == owner);
+
+      if (--tracing_refs == 0) {
+         tracing_owner = NULL;
+         tracing_set_enabled(false);
+      }
+   }
+   enable_preemption();
+}
+
 static void
 tracing_init_oom_panic(const char *buf_name)
 {
@@ -802,13 +1014,14 @@ init_tracing(void)
    if (!(traced_syscalls_str = kmalloc(TRACED_SYSCALLS_STR_LEN)))
       tracing_init_oom_panic("traced_syscalls_str");
 
-   ringbuf_init(&tracing_rb,
-                TRACE_BUF_SIZE / sizeof(struct trace_event),
-                sizeof(struct trace_event),
-                tracing_buf);
+   for (int i = 0; i < TRACE_NR_BUFS; i++) {
+      safe_ringbuf_init(&trace_bufs[i].rb,
+                        (u16)(TRACE_PER_BUF_SIZE / sizeof(struct trace_event)),
+                        (u16)sizeof(struct trace_event),
+                        (char *)tracing_buf + i * TRACE_PER_BUF_SIZE);
+   }
 
-   kmutex_init(&tracing_lock, 0);
-   kcond_init(&tracing_cond);
+   kmutex_init(&tracing_read_lock, 0);
 
    foreach_symbol(elf_symbol_cb, NULL);
 
@@ -816,6 +1029,7 @@ init_tracing(void)
    tracing_allocate_slots_for_params();
 
    set_traced_syscalls("*");
+   init_trace_dev();
 }
 
 static struct module dp_module = {
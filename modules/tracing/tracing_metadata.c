@@ -139,6 +139,56 @@ static const struct syscall_info __tracing_metadata[] =
       }
    },
 
+   {
+      .sys_n = SYS_openat,
+      .n_params = 4,
+      .exp_block = false,
+      .ret_type = &ptype_errno_or_val,
+      .params = {
+         SIMPLE_PARAM("dirfd", &ptype_int, sys_param_in),
+         SIMPLE_PARAM("path", &ptype_path, sys_param_in),
+         SIMPLE_PARAM("flags", &ptype_open_flags, sys_param_in),
+         SIMPLE_PARAM("mode", &ptype_oct, sys_param_in),
+      }
+   },
+
+   {
+      .sys_n = SYS_mkdirat,
+      .n_params = 3,
+      .exp_block = false,
+      .ret_type = &ptype_errno_or_val,
+      .params = {
+         SIMPLE_PARAM("dirfd", &ptype_int, sys_param_in),
+         SIMPLE_PARAM("path", &ptype_path, sys_param_in),
+         SIMPLE_PARAM("mode", &ptype_oct, sys_param_in),
+      }
+   },
+
+   {
+      .sys_n = SYS_unlinkat,
+      .n_params = 3,
+      .exp_block = false,
+      .ret_type = &ptype_errno_or_val,
+      .params = {
+         SIMPLE_PARAM("dirfd", &ptype_int, sys_param_in),
+         SIMPLE_PARAM("path", &ptype_path, sys_param_in),
+         SIMPLE_PARAM("flags", &ptype_int, sys_param_in),
+      }
+   },
+
+   {
+      .sys_n = FSTATAT_SYSCALL_N,
+      .n_params = 4,
+      .exp_block = false,
+      .ret_type = &ptype_errno_or_val,
+      .params = {
+         SIMPLE_PARAM("dirfd", &ptype_int, sys_param_in),
+         SIMPLE_PARAM("path", &ptype_path, sys_param_in),
+         SIMPLE_PARAM("statbuf", &ptype_voidp, sys_param_out),
+         SIMPLE_PARAM("flags", &ptype_int, sys_param_in),
+      },
+   },
+
    {
       .sys_n = STAT_SYSCALL_N,
       .n_params = 2,
@@ -19,6 +19,7 @@ CI = env_bool('CI')
 DUMP_COV = env_bool('DUMP_COV')
 REPORT_COV = env_bool('REPORT_COV')
 VERBOSE = env_bool('VERBOSE')
+IOAPIC = env_bool('TILCK_IOAPIC')
 IN_ANY_CI = Const(IN_TRAVIS.val or IN_CIRCLECI.val or IN_AZURE.val or CI.val)
 
 ReloadAsConstModule(__name__)
@@ -13,6 +13,7 @@ CMD_ENTRY(selftest,     TT_LONG,  false)
 CMD_ENTRY(runall,       TT_LONG,  false)
 CMD_ENTRY(loop,         TT_MED,   false)
 CMD_ENTRY(fpu_loop,     TT_LONG,  false)
+CMD_ENTRY(tty_perf,     TT_MED,   false)
 
 CMD_ENTRY(fork0,        TT_MED,    true)
 CMD_ENTRY(fork1,        TT_SHORT,  true)
@@ -52,6 +53,10 @@ CMD_ENTRY(fs6,          TT_SHORT,  true)
 CMD_ENTRY(fs7,          TT_SHORT,  true)
 CMD_ENTRY(fs_perf1,     TT_SHORT,  true)
 CMD_ENTRY(fs_perf2,     TT_SHORT,  true)
+CMD_ENTRY(fs_perf3,     TT_MED,    true)
+CMD_ENTRY(fs_perf4,     TT_SHORT,  true)
+CMD_ENTRY(aio1,         TT_SHORT,  true)
+CMD_ENTRY(aio_perf,     TT_MED,    true)
 CMD_ENTRY(fmmap1,       TT_SHORT,  true)
 CMD_ENTRY(fmmap2,       TT_SHORT,  true)
 CMD_ENTRY(fmmap3,       TT_SHORT,  true)
@@ -64,6 +69,9 @@ CMD_ENTRY(pipe2,        TT_SHORT,  true)
 CMD_ENTRY(pipe3,        TT_SHORT,  true)
 CMD_ENTRY(pipe4,        TT_SHORT,  true)
 CMD_ENTRY(pipe5,        TT_SHORT,  true)
+CMD_ENTRY(pipe6,        TT_SHORT,  true)
+CMD_ENTRY(pipe_perf,    TT_MED,    true)
+CMD_ENTRY(pipe_perf2,   TT_LONG,   true)
 CMD_ENTRY(pollerr,      TT_SHORT,  true)
 CMD_ENTRY(pollhup,      TT_SHORT,  true)
 CMD_ENTRY(poll1,        TT_SHORT,  true)
@@ -0,0 +1,211 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include <linux/aio_abi.h>
+
+#include "devshell.h"
+#include "sysenter.h"
+
+#define AIO_NR_REQS          64
+#define AIO_BUF_SIZE       1024
+
+static const char aio_test_file[] = "/tmp/aio_test";
+
+static int io_setup(unsigned nr_events, aio_context_t *ctxp)
+{
+   return syscall(SYS_io_setup, nr_events, ctxp);
+}
+
+static int io_destroy(aio_context_t ctx)
+{
+   return syscall(SYS_io_destroy, ctx);
+}
+
+static int io_submit(aio_context_t ctx, long nr, struct iocb **iocbpp)
+{
+   return syscall(SYS_io_submit, ctx, nr, iocbpp);
+}
+
+static int
+io_getevents(aio_context_t ctx, long min_nr, long nr, struct io_event *ev)
+{
+   return syscall(SYS_io_getevents, ctx, min_nr, nr, ev, NULL);
+}
+
+static struct iocb aio_iocbs[AIO_NR_REQS];
+static struct iocb *aio_iocbps[AIO_NR_REQS];
+static struct io_event aio_events[AIO_NR_REQS];
+static char aio_bufs[AIO_NR_REQS][AIO_BUF_SIZE];
+
+static void
+aio_prep_iocbs(int fd, int opcode)
+{
+   for (int i = 0; i < AIO_NR_REQS; i++) {
+
+      memset(&aio_iocbs[i], 0, sizeof(aio_iocbs[i]));
+      aio_iocbs[i].aio_data = (u64)i;
+      aio_iocbs[i].aio_lio_opcode = opcode;
+      aio_iocbs[i].aio_fildes = fd;
+      aio_iocbs[i].aio_buf = (u64)(ulong)aio_bufs[i];
+      aio_iocbs[i].aio_nbytes = AIO_BUF_SIZE;
+      aio_iocbs[i].aio_offset = (s64)i * AIO_BUF_SIZE;
+      aio_iocbps[i] = &aio_iocbs[i];
+   }
+}
+
+static void
+aio_submit_and_wait(aio_context_t ctx, long exp_res)
+{
+   int rc, cnt = 0;
+
+   rc = io_submit(ctx, AIO_NR_REQS, aio_iocbps);
+   DEVSHELL_CMD_ASSERT(rc == AIO_NR_REQS);
+
+   while (cnt < AIO_NR_REQS) {
+
+      rc = io_getevents(ctx, 1, AIO_NR_REQS - cnt, aio_events + cnt);
+      DEVSHELL_CMD_ASSERT(rc > 0);
+      cnt += rc;
+   }
+
+   for (int i = 0; i < AIO_NR_REQS; i++) {
+      DEVSHELL_CMD_ASSERT(aio_events[i].res == exp_res);
+      DEVSHELL_CMD_ASSERT(aio_events[i].obj == (u64)(ulong)aio_iocbps[i]);
+      DEVSHELL_CMD_ASSERT(aio_events[i].data == (u64)i);
+   }
+}
+
+/* Write a file with AIO and read it back, both with AIO and with read() */
+int cmd_aio1(int argc, char **argv)
+{
+   aio_context_t ctx = 0;
+   aio_context_t ctxs[1024];
+   char buf[AIO_BUF_SIZE];
+   int fd, rc, n;
+
+   rc = io_setup(AIO_NR_REQS, &ctx);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(ctx != 0);
+
+   fd = open(aio_test_file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   for (int i = 0; i < AIO_NR_REQS; i++)
+      memset(aio_bufs[i], 'A' + i % 26, AIO_BUF_SIZE);
+
+   aio_prep_iocbs(fd, IOCB_CMD_PWRITE);
+   aio_submit_and_wait(ctx, AIO_BUF_SIZE);
+
+   for (int i = 0; i < AIO_NR_REQS; i++) {
+      rc = read(fd, buf, sizeof(buf));
+      DEVSHELL_CMD_ASSERT(rc == AIO_BUF_SIZE);
+      DEVSHELL_CMD_ASSERT(!memcmp(buf, aio_bufs[i], AIO_BUF_SIZE));
+   }
+
+   memset(aio_bufs, 0, sizeof(aio_bufs));
+   aio_prep_iocbs(fd, IOCB_CMD_PREAD);
+   aio_submit_and_wait(ctx, AIO_BUF_SIZE);
+
+   for (int i = 0; i < AIO_NR_REQS; i++) {
+      memset(buf, 'A' + i % 26, AIO_BUF_SIZE);
+      DEVSHELL_CMD_ASSERT(!memcmp(buf, aio_bufs[i], AIO_BUF_SIZE));
+   }
+
+   /* AIO is supported only on regular files */
+   aio_prep_iocbs(0, IOCB_CMD_PWRITE);
+   rc = io_submit(ctx, 1, aio_iocbps);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   rc = io_destroy(ctx);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = io_destroy(ctx);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EINVAL);
+
+   close(fd);
+   rc = unlink(aio_test_file);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* The number of contexts per process is limited */
+   for (n = 0; n < ARRAY_SIZE(ctxs); n++) {
+
+      ctxs[n] = 0;
+
+      if (io_setup(1, &ctxs[n]) < 0)
+         break;
+   }
+
+   DEVSHELL_CMD_ASSERT(n > 0 && n < ARRAY_SIZE(ctxs));
+   DEVSHELL_CMD_ASSERT(errno == EAGAIN);
+
+   for (int i = 0; i < n; i++)
+      DEVSHELL_CMD_ASSERT(io_destroy(ctxs[i]) == 0);
+
+   return 0;
+}
+
+/*
+ * Compare the cost of writing AIO_NR_REQS blocks with sequential write() calls
+ * with the cost of writing them with a single io_submit() call, followed by
+ * io_getevents() calls.
+ */
+int cmd_aio_perf(int argc, char **argv)
+{
+   const int iters = 100;
+   aio_context_t ctx = 0;
+   u64 start, seq_elapsed = 0, aio_elapsed = 0;
+   int fd, rc;
+
+   rc = io_setup(AIO_NR_REQS, &ctx);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   fd = open(aio_test_file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   for (int i = 0; i < AIO_NR_REQS; i++)
+      memset(aio_bufs[i], 'a' + i % 26, AIO_BUF_SIZE);
+
+   aio_prep_iocbs(fd, IOCB_CMD_PWRITE);
+
+   for (int it = 0; it < iters; it++) {
+
+      rc = (int)lseek(fd, 0, SEEK_SET);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+
+      start = RDTSC();
+
+      for (int i = 0; i < AIO_NR_REQS; i++) {
+         rc = write(fd, aio_bufs[i], AIO_BUF_SIZE);
+         DEVSHELL_CMD_ASSERT(rc == AIO_BUF_SIZE);
+      }
+
+      seq_elapsed += RDTSC() - start;
+
+      start = RDTSC();
+      aio_submit_and_wait(ctx, AIO_BUF_SIZE);
+      aio_elapsed += RDTSC() - start;
+   }
+
+   printf("Blocks per batch: %d, block size: %d\n",
+          AIO_NR_REQS, AIO_BUF_SIZE);
+   printf("Avg. cost per block (write):     %6" PRIu64 " cycles\n",
+          seq_elapsed / (u64)(iters * AIO_NR_REQS));
+   printf("Avg. cost per block (io_submit): %6" PRIu64 " cycles\n",
+          aio_elapsed / (u64)(iters * AIO_NR_REQS));
+
+   rc = io_destroy(ctx);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   close(fd);
+   rc = unlink(aio_test_file);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
@@ -398,7 +398,7 @@ int cmd_fmmap5(int argc, char **argv)
 
    /*
     * This memory write will trigger a page-fault and the kernel should allocate
-    * on-the-fly the page (ramfs_block) for us and, ultimately, resume the
+    * on-the-fly the page for us and, ultimately, resume the
     * write.
     */
    strcpy(vaddr + page_size, test_str2);
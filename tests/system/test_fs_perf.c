@@ -14,6 +14,7 @@
 #include <sys/syscall.h>
 #include <sys/mman.h>
 #include <sys/time.h>
+#include <dirent.h>
 
 #include "devshell.h"
 #include "sysenter.h"
@@ -109,3 +110,245 @@ int cmd_fs_perf2(int argc, char **argv)
    DEVSHELL_CMD_ASSERT(rc == 0);
    return 0;
 }
+
+#define FS_PERF3_DIRS           10   /* number of dirs at each level */
+#define FS_PERF3_FILES         100   /* number of files in each leaf dir */
+
+static const char fs_perf3_root[] = "/tmp/fs_perf3";
+
+static void fs_perf3_create_tree(void)
+{
+   char path[256];
+   int rc, fd;
+
+   rc = mkdir(fs_perf3_root, 0755);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   for (int i = 0; i < FS_PERF3_DIRS; i++) {
+
+      sprintf(path, "%s/d%d", fs_perf3_root, i);
+      rc = mkdir(path, 0755);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+
+      for (int j = 0; j < FS_PERF3_DIRS; j++) {
+
+         sprintf(path, "%s/d%d/d%d", fs_perf3_root, i, j);
+         rc = mkdir(path, 0755);
+         DEVSHELL_CMD_ASSERT(rc == 0);
+
+         for (int k = 0; k < FS_PERF3_FILES; k++) {
+            sprintf(path, "%s/d%d/d%d/file_%03d", fs_perf3_root, i, j, k);
+            fd = creat(path, 0644);
+            DEVSHELL_CMD_ASSERT(fd > 0);
+            close(fd);
+         }
+      }
+   }
+}
+
+/* Classic tree walk: stat() each entry using its full path */
+static int fs_perf3_walk_abs(const char *path)
+{
+   char child[256];
+   struct dirent *de;
+   struct stat st;
+   int count = 0;
+   DIR *d;
+   int rc;
+
+   d = opendir(path);
+   DEVSHELL_CMD_ASSERT(d != NULL);
+
+   while ((de = readdir(d))) {
+
+      if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+         continue;
+
+      sprintf(child, "%s/%s", path, de->d_name);
+      rc = lstat(child, &st);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+      count++;
+
+      if (S_ISDIR(st.st_mode))
+         count += fs_perf3_walk_abs(child);
+   }
+
+   closedir(d);
+   return count;
+}
+
+/* Tree walk using the *at() syscalls: stat each entry relative to its dir */
+static int fs_perf3_walk_at(int dirfd)
+{
+   struct dirent *de;
+   struct stat st;
+   int count = 0;
+   int rc, fd;
+   DIR *d;
+
+   d = fdopendir(dirfd);
+   DEVSHELL_CMD_ASSERT(d != NULL);
+
+   while ((de = readdir(d))) {
+
+      if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+         continue;
+
+      rc = fstatat(dirfd, de->d_name, &st, AT_SYMLINK_NOFOLLOW);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+      count++;
+
+      if (S_ISDIR(st.st_mode)) {
+         fd = openat(dirfd, de->d_name, O_RDONLY | O_DIRECTORY);
+         DEVSHELL_CMD_ASSERT(fd > 0);
+         count += fs_perf3_walk_at(fd); /* closes fd */
+      }
+   }
+
+   closedir(d); /* closes dirfd as well */
+   return count;
+}
+
+static void fs_perf3_remove_tree(void)
+{
+   char name[32];
+   int rc, fd1, fd2, fd3;
+
+   fd1 = open(fs_perf3_root, O_RDONLY | O_DIRECTORY);
+   DEVSHELL_CMD_ASSERT(fd1 > 0);
+
+   for (int i = 0; i < FS_PERF3_DIRS; i++) {
+
+      sprintf(name, "d%d", i);
+      fd2 = openat(fd1, name, O_RDONLY | O_DIRECTORY);
+      DEVSHELL_CMD_ASSERT(fd2 > 0);
+
+      for (int j = 0; j < FS_PERF3_DIRS; j++) {
+
+         sprintf(name, "d%d", j);
+         fd3 = openat(fd2, name, O_RDONLY | O_DIRECTORY);
+         DEVSHELL_CMD_ASSERT(fd3 > 0);
+
+         for (int k = 0; k < FS_PERF3_FILES; k++) {
+            sprintf(name, "file_%03d", k);
+            rc = unlinkat(fd3, name, 0);
+            DEVSHELL_CMD_ASSERT(rc == 0);
+         }
+
+         close(fd3);
+         sprintf(name, "d%d", j);
+         rc = unlinkat(fd2, name, AT_REMOVEDIR);
+         DEVSHELL_CMD_ASSERT(rc == 0);
+      }
+
+      close(fd2);
+      sprintf(name, "d%d", i);
+      rc = unlinkat(fd1, name, AT_REMOVEDIR);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   close(fd1);
+   rc = rmdir(fs_perf3_root);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+}
+
+int cmd_fs_perf3(int argc, char **argv)
+{
+   const int exp_count =
+      FS_PERF3_DIRS * (1 + FS_PERF3_DIRS * (1 + FS_PERF3_FILES));
+   u64 start, elapsed;
+   int count, fd;
+
+   printf("Creating %d files under %s...\n", exp_count, fs_perf3_root);
+   fs_perf3_create_tree();
+
+   start = RDTSC();
+   count = fs_perf3_walk_abs(fs_perf3_root);
+   elapsed = RDTSC() - start;
+   DEVSHELL_CMD_ASSERT(count == exp_count);
+
+   printf("Avg. cost per entry (abs paths): %6" PRIu64 " cycles\n",
+          elapsed / (u64)count);
+
+   fd = open(fs_perf3_root, O_RDONLY | O_DIRECTORY);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   start = RDTSC();
+   count = fs_perf3_walk_at(fd);
+   elapsed = RDTSC() - start;
+   DEVSHELL_CMD_ASSERT(count == exp_count);
+
+   printf("Avg. cost per entry (*at):       %6" PRIu64 " cycles\n",
+          elapsed / (u64)count);
+
+   fs_perf3_remove_tree();
+   return 0;
+}
+
+#define FS_PERF4_PROCS           4
+#define FS_PERF4_FILES         250   /* files created by each process */
+
+static void fs_perf4_child(int n)
+{
+   char dir[64];
+   sprintf(dir, "/tmp/fs_perf4_%d", n);
+
+   for (int i = 0; i < FS_PERF4_FILES; i++)
+      create_test_file(dir, i);
+
+   for (int i = 0; i < FS_PERF4_FILES; i++)
+      remove_test_file_expecting_success(dir, i);
+
+   exit(0);
+}
+
+/*
+ * Like fs_perf1, but with multiple processes creating and removing files at
+ * the same time, each one in its own directory.
+ */
+int cmd_fs_perf4(int argc, char **argv)
+{
+   const int tot = FS_PERF4_PROCS * FS_PERF4_FILES;
+   int pids[FS_PERF4_PROCS];
+   u64 start, elapsed;
+   int rc, wstatus;
+   char dir[64];
+
+   for (int i = 0; i < FS_PERF4_PROCS; i++) {
+      sprintf(dir, "/tmp/fs_perf4_%d", i);
+      rc = mkdir(dir, 0755);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   start = RDTSC();
+
+   for (int i = 0; i < FS_PERF4_PROCS; i++) {
+
+      pids[i] = fork();
+      DEVSHELL_CMD_ASSERT(pids[i] >= 0);
+
+      if (!pids[i])
+         fs_perf4_child(i);
+   }
+
+   for (int i = 0; i < FS_PERF4_PROCS; i++) {
+      rc = waitpid(pids[i], &wstatus, 0);
+      DEVSHELL_CMD_ASSERT(rc == pids[i]);
+      DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+   }
+
+   elapsed = RDTSC() - start;
+
+   printf("Processes: %d, files per process: %d\n",
+          FS_PERF4_PROCS, FS_PERF4_FILES);
+   printf("Avg. creat() + unlink() cost: %4" PRIu64 " cycles\n",
+          elapsed / (u64)tot);
+
+   for (int i = 0; i < FS_PERF4_PROCS; i++) {
+      sprintf(dir, "/tmp/fs_perf4_%d", i);
+      rc = rmdir(dir);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+
+   return 0;
+}
@@ -176,6 +176,60 @@ int cmd_fpu_loop(int argc, char **argv)
    return 0;
 }
 
+/*
+ * Measure the throughput of the tty output path, like `cat bigfile > /dev/tty`
+ * does: mostly plain text lines, with a colored one every 16 lines.
+ */
+int cmd_tty_perf(int argc, char **argv)
+{
+   const char *path = argc > 0 ? argv[0] : "/dev/tty";
+   const int tot_mb = argc > 1 ? atoi(argv[1]) : 4;
+   static char buf[4096];
+   struct timespec ts0, ts1;
+   u64 tot = 0, elapsed_us, bps;
+   int fd, rc, pos = 0;
+
+   DEVSHELL_CMD_ASSERT(tot_mb > 0);
+
+   for (int ln = 0; pos + 80 <= (int)sizeof(buf); ln++) {
+
+      if (ln % 16 == 15)
+         pos += sprintf(buf + pos, "\033[32mline %4d\033[m ", ln);
+      else
+         pos += sprintf(buf + pos, "line %4d ", ln);
+
+      for (; pos % 80 != 79; pos++)
+         buf[pos] = (char)('a' + pos % 26);
+
+      buf[pos++] = '\n';
+   }
+
+   fd = open(path, O_WRONLY);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   clock_gettime(CLOCK_MONOTONIC, &ts0);
+
+   while (tot < (u64)tot_mb * MB) {
+      rc = write(fd, buf, pos);
+      DEVSHELL_CMD_ASSERT(rc == pos);
+      tot += (u64)rc;
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &ts1);
+   close(fd);
+
+   elapsed_us = (u64)((s64)(ts1.tv_sec - ts0.tv_sec) * 1000000 +
+                      (ts1.tv_nsec - ts0.tv_nsec) / 1000);
+   bps = tot * 1000000 / MAX(elapsed_us, (u64)1);
+
+   printf("\033[m\n");
+   printf("Wrote %" PRIu64 " KB to %s in %" PRIu64 " ms\n",
+          tot / KB, path, elapsed_us / 1000);
+   printf("Throughput: %" PRIu64 ".%02" PRIu64 " MB/s\n",
+          bps / MB, bps % MB * 100 / MB);
+   return 0;
+}
+
 /*
  * Test the scenario where a user copy-on-write happens in the kernel because
  * of a syscall.
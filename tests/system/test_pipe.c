@@ -1,5 +1,7 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
+#define _GNU_SOURCE /* for F_SETPIPE_SZ and F_GETPIPE_SZ */
+
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
@@ -469,3 +471,198 @@ int cmd_pipe5(int argc, char **argv)
 
    return 0;
 }
+
+/* Test F_GETPIPE_SZ and F_SETPIPE_SZ */
+int cmd_pipe6(int argc, char **argv)
+{
+   static char buf[8192];
+   int fds[2];
+   int rc;
+
+   rc = pipe2(fds, O_NONBLOCK);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = fcntl(fds[0], F_GETPIPE_SZ);
+   DEVSHELL_CMD_ASSERT(rc == 4096);
+
+   /* The size is rounded up to a power-of-2 number of pages */
+   rc = fcntl(fds[1], F_SETPIPE_SZ, 5000);
+   DEVSHELL_CMD_ASSERT(rc == 8192);
+
+   rc = fcntl(fds[0], F_GETPIPE_SZ);
+   DEVSHELL_CMD_ASSERT(rc == 8192);
+
+   for (int i = 0; i < (int)sizeof(buf); i++)
+      buf[i] = (char)i;
+
+   rc = write(fds[1], buf, sizeof(buf));
+   DEVSHELL_CMD_ASSERT(rc == sizeof(buf));
+
+   rc = write(fds[1], buf, 1);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EAGAIN);
+
+   /* Cannot shrink the pipe below the amount of data in it */
+   rc = fcntl(fds[1], F_SETPIPE_SZ, 4096);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EBUSY);
+
+   rc = read(fds[0], buf, 100);
+   DEVSHELL_CMD_ASSERT(rc == 100);
+
+   /* Now the data must be moved in the new (smaller) ring */
+   rc = fcntl(fds[1], F_SETPIPE_SZ, 0);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EBUSY);
+
+   rc = read(fds[0], buf, 4000);
+   DEVSHELL_CMD_ASSERT(rc == 4000);
+
+   rc = fcntl(fds[1], F_SETPIPE_SZ, 4096);
+   DEVSHELL_CMD_ASSERT(rc == 4096);
+
+   rc = read(fds[0], buf, sizeof(buf));
+   DEVSHELL_CMD_ASSERT(rc == 8192 - 4100);
+
+   for (int i = 0; i < rc; i++)
+      DEVSHELL_CMD_ASSERT(buf[i] == (char)(4100 + i));
+
+   rc = fcntl(fds[0], F_SETPIPE_SZ, 16 * 1024 * 1024);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EPERM);
+
+   close(fds[0]);
+   close(fds[1]);
+
+   rc = open("/tmp/pipe6_file", O_CREAT | O_RDWR, 0644);
+   DEVSHELL_CMD_ASSERT(rc > 0);
+   fds[0] = rc;
+
+   rc = fcntl(fds[0], F_GETPIPE_SZ);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EBADF);
+
+   close(fds[0]);
+   rc = unlink("/tmp/pipe6_file");
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
+
+static void pipe_perf_child(int rfd, int wfd, int iters)
+{
+   char c;
+
+   for (int i = 0; i < iters; i++) {
+
+      if (read(rfd, &c, 1) != 1)
+         exit(1);
+
+      if (write(wfd, &c, 1) != 1)
+         exit(1);
+   }
+
+   exit(0);
+}
+
+/* Measure the round-trip cost of a one-byte ping-pong between two processes */
+int cmd_pipe_perf(int argc, char **argv)
+{
+   const int iters = 10000;
+   int p2c[2], c2p[2];
+   int rc, wstatus;
+   ull_t start, duration;
+   pid_t childpid;
+   char c = 'x';
+
+   rc = pipe(p2c);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = pipe(c2p);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   childpid = fork();
+   DEVSHELL_CMD_ASSERT(childpid >= 0);
+
+   if (!childpid) {
+      close(p2c[1]);
+      close(c2p[0]);
+      pipe_perf_child(p2c[0], c2p[1], iters);
+   }
+
+   close(p2c[0]);
+   close(c2p[1]);
+
+   start = RDTSC();
+
+   for (int i = 0; i < iters; i++) {
+      DEVSHELL_CMD_ASSERT(write(p2c[1], &c, 1) == 1);
+      DEVSHELL_CMD_ASSERT(read(c2p[0], &c, 1) == 1);
+   }
+
+   duration = RDTSC() - start;
+   printf("pipe ping-pong round trip: %llu cycles\n", duration / iters);
+
+   close(p2c[1]);
+   close(c2p[0]);
+
+   rc = waitpid(childpid, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(rc == childpid);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+   return 0;
+}
+
+#define PIPE_PERF2_TOT        (256 * 1024 * 1024)
+#define PIPE_PERF2_CHUNK      (64 * 1024)
+
+static void pipe_perf2_run(int pipe_size)
+{
+   static char buf[PIPE_PERF2_CHUNK];
+   ull_t start, duration;
+   int fds[2];
+   int rc, wstatus;
+   pid_t childpid;
+   long long tot;
+
+   rc = pipe(fds);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = fcntl(fds[1], F_SETPIPE_SZ, pipe_size);
+   DEVSHELL_CMD_ASSERT(rc == pipe_size);
+
+   start = RDTSC();
+   childpid = fork();
+   DEVSHELL_CMD_ASSERT(childpid >= 0);
+
+   if (!childpid) {
+
+      /* Like `dd of=/dev/null`: just count the bytes */
+      close(fds[1]);
+      tot = 0;
+
+      while ((rc = read(fds[0], buf, sizeof(buf))) > 0)
+         tot += rc;
+
+      exit(tot == PIPE_PERF2_TOT ? 0 : 1);
+   }
+
+   close(fds[0]);
+
+   for (tot = 0; tot < PIPE_PERF2_TOT; tot += rc) {
+      rc = write(fds[1], buf, sizeof(buf));
+      DEVSHELL_CMD_ASSERT(rc > 0);
+   }
+
+   close(fds[1]);
+
+   rc = waitpid(childpid, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(rc == childpid);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+
+   duration = RDTSC() - start;
+   printf("pipe size: %7d, avg. cost per KB: %6llu cycles\n",
+          pipe_size, duration / (PIPE_PERF2_TOT / 1024));
+}
+
+/* Measure the throughput of a 256 MB `dd` through a pipe, for several sizes */
+int cmd_pipe_perf2(int argc, char **argv)
+{
+   pipe_perf2_run(4 * 1024);
+   pipe_perf2_run(64 * 1024);
+   pipe_perf2_run(1024 * 1024);
+   return 0;
+}
@@ -0,0 +1,130 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <cstdio>
+#include <random>
+#include <map>
+#include <string>
+#include <gtest/gtest.h>
+
+#include "kernel_init_funcs.h"
+
+extern "C" {
+   #include <tilck/kernel/fs/dir_index.h>
+}
+
+using namespace std;
+
+struct test_entry {
+   struct dir_index_node node;
+   char name[32];
+};
+
+class dir_index_test : public ::testing::Test {
+
+protected:
+   struct dir_index idx;
+
+   void SetUp() override {
+      init_kmalloc_for_tests();
+      dir_index_init_for(&idx, struct test_entry, node, name);
+   }
+
+   void TearDown() override {
+      dir_index_destroy(&idx);
+   }
+
+   test_entry *find(const string &name) {
+      return dir_index_find_obj(&idx,
+                                name.c_str(),
+                                name.size(),
+                                struct test_entry,
+                                node);
+   }
+};
+
+TEST_F(dir_index_test, insert_find_remove)
+{
+   test_entry a, b;
+
+   strcpy(a.name, "file_a");
+   strcpy(b.name, "file_b");
+
+   ASSERT_EQ(dir_index_insert(&idx, &a.node), 0);
+   ASSERT_EQ(dir_index_insert(&idx, &b.node), 0);
+
+   ASSERT_EQ(find("file_a"), &a);
+   ASSERT_EQ(find("file_b"), &b);
+   ASSERT_EQ(find("file_"), nullptr);
+   ASSERT_EQ(find("file_ab"), nullptr);
+
+   /* Lookups by a prefix of a longer string (path components) */
+   ASSERT_EQ(dir_index_find(&idx, "file_a/x", 6), &a.node);
+
+   ASSERT_EQ(a.node.cookie, 0u);
+   ASSERT_EQ(b.node.cookie, 1u);
+   ASSERT_EQ(dir_index_find_cookie(&idx, 1), &b.node);
+
+   dir_index_remove(&idx, &a.node);
+   ASSERT_EQ(find("file_a"), nullptr);
+   ASSERT_EQ(dir_index_find_cookie(&idx, 0), nullptr);
+   ASSERT_EQ(find("file_b"), &b);
+
+   /* Cookies are never reused */
+   ASSERT_EQ(dir_index_insert(&idx, &a.node), 0);
+   ASSERT_EQ(a.node.cookie, 2u);
+
+   dir_index_remove(&idx, &a.node);
+   dir_index_remove(&idx, &b.node);
+}
+
+TEST_F(dir_index_test, random_ops)
+{
+   const int max_entries = 2000;
+   const int iters = 50000;
+
+   random_device rdev;
+   const auto seed = rdev();
+   default_random_engine engine(seed);
+   uniform_int_distribution<int> dist(0, max_entries - 1);
+   vector<test_entry> entries(max_entries);
+   map<u32, test_entry *> by_cookie;
+   vector<bool> present(max_entries);
+
+   cout << "[ INFO     ] random seed: " << seed << endl;
+
+   for (int i = 0; i < max_entries; i++)
+      sprintf(entries[i].name, "entry_%d", i);
+
+   for (int it = 0; it < iters; it++) {
+
+      const int i = dist(engine);
+      test_entry *e = &entries[i];
+
+      if (present[i]) {
+         ASSERT_EQ(find(e->name), e);
+         dir_index_remove(&idx, &e->node);
+         by_cookie.erase(e->node.cookie);
+      } else {
+         ASSERT_EQ(find(e->name), nullptr);
+         ASSERT_EQ(dir_index_insert(&idx, &e->node), 0);
+         by_cookie[e->node.cookie] = e;
+      }
+
+      present[i] = !present[i];
+   }
+
+   ASSERT_EQ(idx.count, by_cookie.size());
+
+   for (auto &p : by_cookie)
+      ASSERT_EQ(dir_index_find_cookie(&idx, p.first), &p.second->node);
+
+   for (int i = 0; i < max_entries; i++) {
+
+      ASSERT_EQ(find(entries[i].name), present[i] ? &entries[i] : nullptr);
+
+      if (present[i])
+         dir_index_remove(&idx, &entries[i].node);
+   }
+
+   ASSERT_EQ(idx.count, 0u);
+}
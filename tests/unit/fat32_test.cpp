@@ -4,6 +4,10 @@
 #include <iostream>
 #include <memory>
 #include <map>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <fcntl.h>
 #include <gtest/gtest.h>
 
 #include "kernel_init_funcs.h"
@@ -12,12 +16,17 @@ extern "C" {
    #include <tilck/kernel/fs/fat32.h>
    #include <tilck/kernel/fs/vfs.h>
    #include <tilck/common/utils.h>
+   #include <tilck/common/arch/generic_x86/x86_utils.h>
    #include <tilck/kernel/test/fat32.h>
    #include <3rd_party/crc32.h>
 }
 
 using namespace std;
 
+extern "C" {
+   u32 fat_cindex_lookup(struct fat_cindex *ci, u32 n, u32 *contig);
+}
+
 void test_dump_buf(char *buf, const char *buf_name, int off, int count)
 {
    printf("%s", buf_name);
@@ -149,3 +158,139 @@ TEST(fat32, read_whole_file)
    uint32_t actual_file_crc = crc32(0, buf, fsize);
    ASSERT_EQ(fat_crc, actual_file_crc);
 }
+
+struct fat32_dents_ctx {
+   struct fs_handle_base *h;
+   vector<string> names;
+   int batch_left;
+};
+
+/*
+ * Emulate vfs_getdents64() with a user buffer fitting only a few entries:
+ * vfs_getdents64() itself cannot be used here, as it requires a user buffer.
+ */
+static int fat32_dents_cb(struct vfs_dent64 *vde, void *arg)
+{
+   auto *ctx = (struct fat32_dents_ctx *)arg;
+
+   if (!ctx->batch_left)
+      return 1; /* buffer full */
+
+   ctx->names.push_back(vde->name);
+   ctx->h->dir_pos = vde->next_off;
+   ctx->batch_left--;
+   return 0;
+}
+
+static vector<string> fat32_read_dir(fs_handle h, int batch_size)
+{
+   struct fat32_dents_ctx ctx;
+   struct fs_handle_base *hb = (struct fs_handle_base *)h;
+   size_t prev_count;
+   int rc;
+
+   ctx.h = hb;
+
+   do {
+
+      prev_count = ctx.names.size();
+      ctx.batch_left = batch_size;
+      rc = hb->fs->fsops->getdents(h, &fat32_dents_cb, &ctx);
+
+   } while (rc >= 0 && ctx.names.size() > prev_count);
+
+   return ctx.names;
+}
+
+TEST(fat32, getdents_big_dir)
+{
+   const int n = 5000;
+   vector<string> names;
+   struct mnt_fs *fs;
+   size_t fatpart_size;
+   fs_handle h;
+   u64 start, cycles;
+
+   init_kmalloc_for_tests();
+
+   const char *buf = load_once_file(PROJ_BUILD_DIR "/test_fatpart",
+                                    &fatpart_size);
+
+   fs = fat_mount_ramdisk((void *) buf, fatpart_size, 0);
+   ASSERT_TRUE(fs != NULL);
+   ASSERT_EQ(mp_init(fs), 0);
+   ASSERT_EQ(vfs_open("/bigdir", &h, O_RDONLY, 0), 0);
+
+   /* Read the dir a few entries per call, like a small user buffer would */
+   start = RDTSC();
+   names = fat32_read_dir(h, 8);
+   cycles = RDTSC() - start;
+
+   printf("[ INFO     ] getdents: %llu cycles/entry\n",
+          (unsigned long long)(cycles / names.size()));
+
+   ASSERT_EQ(names.size(), (size_t)n + 2);
+   ASSERT_EQ(names[0], ".");
+   ASSERT_EQ(names[1], "..");
+
+   {
+      /* The order of the entries depends on how they were copied */
+      vector<string> expected, sorted_names(names.begin() + 2, names.end());
+
+      for (int i = 0; i < n; i++)
+         expected.push_back("file_with_a_long_name_" + to_string(i));
+
+      sort(expected.begin(), expected.end());
+      sort(sorted_names.begin(), sorted_names.end());
+      ASSERT_EQ(sorted_names, expected);
+   }
+
+   /* seek() both forward and backwards and resume from there */
+   for (offt off : { 4000, 2500, 2501, 5001, 7 }) {
+
+      ASSERT_EQ(vfs_seek(h, off, SEEK_SET), off);
+
+      vector<string> tail = fat32_read_dir(h, 5);
+      ASSERT_EQ(tail.size(), (size_t)(n + 2 - off));
+      ASSERT_EQ(tail[0], names[off]);
+      ASSERT_EQ(tail.back(), names.back());
+   }
+
+   /* Seeking at the end is fine, but not past it */
+   ASSERT_EQ(vfs_seek(h, n + 2, SEEK_SET), n + 2);
+   ASSERT_EQ(fat32_read_dir(h, 5).size(), 0u);
+   ASSERT_EQ(vfs_seek(h, n + 3, SEEK_SET), -EINVAL);
+
+   vfs_close(h);
+   fat_umount_ramdisk(fs);
+}
+
+TEST(fat32, cindex_lookup)
+{
+   struct fat_run runs[] = {
+      { .off = 0, .clu = 100 },     /* clusters 100..102 */
+      { .off = 3, .clu = 50 },      /* cluster 50 */
+      { .off = 4, .clu = 200 },     /* clusters 200..209 */
+   };
+
+   struct fat_cindex ci = {};
+   u32 contig;
+
+   ci.runs = runs;
+   ci.runs_count = ARRAY_SIZE(runs);
+   ci.clusters_count = 14;
+
+   ASSERT_EQ(fat_cindex_lookup(&ci, 0, &contig), 100u);
+   ASSERT_EQ(contig, 3u);
+   ASSERT_EQ(fat_cindex_lookup(&ci, 2, &contig), 102u);
+   ASSERT_EQ(contig, 1u);
+   ASSERT_EQ(fat_cindex_lookup(&ci, 3, &contig), 50u);
+   ASSERT_EQ(contig, 1u);
+   ASSERT_EQ(fat_cindex_lookup(&ci, 4, &contig), 200u);
+   ASSERT_EQ(contig, 10u);
+   ASSERT_EQ(fat_cindex_lookup(&ci, 13, &contig), 209u);
+   ASSERT_EQ(contig, 1u);
+
+   fat_cindex_lookup(&ci, 14, &contig);
+   ASSERT_EQ(contig, 0u);
+}
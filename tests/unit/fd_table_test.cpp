@@ -0,0 +1,109 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "kernel_init_funcs.h"
+
+extern "C" {
+   #include <tilck/kernel/process.h>
+   #include <tilck/kernel/errno.h>
+}
+
+using namespace std;
+
+class fd_table_test : public ::testing::Test {
+
+protected:
+   struct process pi;
+   vector<fs_handle_base> handles;
+
+   void SetUp() override {
+      init_kmalloc_for_tests();
+      pi = {};
+      handles.resize(256);
+      fd_table_init(&pi);
+      kmutex_init(&pi.fslock, KMUTEX_FL_RECURSIVE);
+      kmutex_lock(&pi.fslock);
+   }
+
+   void TearDown() override {
+      kmutex_unlock(&pi.fslock);
+      kmutex_destroy(&pi.fslock);
+      fd_table_destroy(&pi);
+   }
+
+   int alloc_fd(int ge = 0) {
+
+      int fd = fd_table_get_free_fd(&pi, ge);
+
+      if (fd >= 0)
+         fd_table_set(&pi, fd, &handles[fd]);
+
+      return fd;
+   }
+
+   vector<int> used_fds() {
+
+      vector<int> res;
+      int fd;
+
+      for_each_used_fd(&pi, fd)
+         res.push_back(fd);
+
+      return res;
+   }
+};
+
+TEST_F(fd_table_test, grow_and_reuse)
+{
+   for (int i = 0; i < 200; i++)
+      ASSERT_EQ(alloc_fd(), i);
+
+   ASSERT_GE(pi.handles_cap, 200u);
+
+   for (int i = 0; i < 200; i++)
+      ASSERT_EQ(pi.handles[i], &handles[i]);
+
+   fd_table_set(&pi, 3, NULL);
+   fd_table_set(&pi, 100, NULL);
+   fd_table_set(&pi, 150, NULL);
+
+   ASSERT_EQ(alloc_fd(4), 100);
+   ASSERT_EQ(alloc_fd(), 3);
+   ASSERT_EQ(alloc_fd(), 150);
+   ASSERT_EQ(alloc_fd(), 200);
+}
+
+TEST_F(fd_table_test, iterate_used_fds)
+{
+   const vector<int> fds = {0, 5, 31, 32, 33, 64, 130, 255};
+
+   ASSERT_EQ(fd_table_ensure(&pi, 255), 0);
+
+   for (int fd : fds)
+      fd_table_set(&pi, fd, &handles[fd]);
+
+   ASSERT_EQ(used_fds(), fds);
+
+   for (int fd : fds)
+      fd_table_set(&pi, fd, NULL);
+
+   ASSERT_EQ(used_fds(), vector<int>());
+}
+
+TEST_F(fd_table_test, nofile_limit)
+{
+   pi.nofile_cur = 40;
+
+   for (int i = 0; i < 40; i++)
+      ASSERT_EQ(alloc_fd(), i);
+
+   ASSERT_EQ(pi.handles_cap, 40u);
+   ASSERT_EQ(alloc_fd(), -EMFILE);
+   ASSERT_EQ(fd_table_ensure(&pi, 40), -EBADF);
+   ASSERT_EQ(fd_table_ensure(&pi, -1), -EBADF);
+
+   fd_table_set(&pi, 7, NULL);
+   ASSERT_EQ(alloc_fd(), 7);
+}
@@ -23,9 +23,10 @@ TEST(fork_dup_all_handles, trigger_inside_path)
    vfs_mock mock;
    process pi = {};
    fs_handle_base handles[3] = {}, dup_handles[2] = {};
-   pi.handles[0] = &handles[0];
-   pi.handles[1] = &handles[1];
-   pi.handles[2] = &handles[2];
+   fd_table_init(&pi);
+   fd_table_set(&pi, 0, &handles[0]);
+   fd_table_set(&pi, 1, &handles[1]);
+   fd_table_set(&pi, 2, &handles[2]);
 
    EXPECT_CALL(mock, vfs_dup(&handles[0], _))
       .WillOnce(
@@ -34,6 +34,7 @@ void irq_install() { }
 void hw_timer_setup() { }
 void irq_install_handler() { }
 void irq_uninstall_handler() { }
+void irq_reset_stats() { }
 void setup_sysenter_interface() { }
 void save_current_task_state() { }
 void switch_to_task() { }
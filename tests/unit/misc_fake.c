@@ -9,6 +9,7 @@
 #include <tilck/kernel/datetime.h>
 #include <tilck/kernel/sync.h>
 #include <tilck/kernel/sched.h>
+#include <tilck/kernel/irq.h>
 
 #include <tilck_gen_headers/config_kmalloc.h>
 
@@ -18,6 +19,7 @@
 
 u32 spur_irq_count;
 u32 unhandled_irq_count[256];
+struct irq_stats irq_stats[16];
 
 bool suppress_printk;
 volatile bool __in_panic;
@@ -100,7 +102,7 @@ void *__wrap_general_kmalloc(size_t *size, u32 flags)
    if (mock_kmalloc)
       return malloc(*size);
 
-   return __real_general_kmalloc(size, 0);
+   return __real_general_kmalloc(size, flags);
 }
 
 void __wrap_general_kfree(void *ptr, size_t *size, u32 flags)
@@ -108,7 +110,7 @@ void __wrap_general_kfree(void *ptr, size_t *size, u32 flags)
    if (mock_kmalloc)
       return free(ptr);
 
-   return __real_general_kfree(ptr, size, 0);
+   return __real_general_kfree(ptr, size, flags);
 }
 
 void *__wrap_kmalloc_get_first_heap(size_t *size)
@@ -0,0 +1,116 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "kernel_init_funcs.h"
+
+extern "C" {
+   #include <tilck/kernel/fs/vfs.h>
+   #include <tilck/kernel/fs/kernelfs.h>
+   #include <tilck/kernel/pipe.h>
+   #include <tilck/kernel/errno.h>
+}
+
+using namespace std;
+
+static const int kb = (int)KB;
+
+class pipe_test : public ::testing::Test {
+
+protected:
+   struct pipe *p;
+   struct kfs_handle *rh, *wh;
+
+   void SetUp() override {
+
+      static bool kernelfs_initialized;
+
+      init_kmalloc_for_tests();
+
+      if (!kernelfs_initialized) {
+         init_kernelfs();
+         kernelfs_initialized = true;
+      }
+
+      p = create_pipe();
+      ASSERT_TRUE(p != NULL);
+
+      rh = (struct kfs_handle *)pipe_create_read_handle(p);
+      wh = (struct kfs_handle *)pipe_create_write_handle(p);
+      ASSERT_TRUE(rh != NULL);
+      ASSERT_TRUE(wh != NULL);
+
+      rh->fl_flags |= O_NONBLOCK;
+      wh->fl_flags |= O_NONBLOCK;
+   }
+
+   void TearDown() override {
+      kfs_destroy_handle(rh);
+      kfs_destroy_handle(wh);
+      destroy_pipe(p);
+   }
+
+   ssize_t pwrite(const vector<char> &buf) {
+      offt pos = 0;
+      return wh->fops->write(wh, (char *)buf.data(), buf.size(), &pos);
+   }
+
+   ssize_t pread(vector<char> &buf) {
+      offt pos = 0;
+      return rh->fops->read(rh, buf.data(), buf.size(), &pos);
+   }
+};
+
+static vector<char> make_data(int len, int start)
+{
+   vector<char> v((size_t)len);
+
+   for (int i = 0; i < len; i++)
+      v[(size_t)i] = (char)(start + i);
+
+   return v;
+}
+
+TEST_F(pipe_test, wrap_around)
+{
+   vector<char> out(3000);
+
+   ASSERT_EQ(pipe_get_size(rh), PIPE_BUF_SIZE);
+
+   for (int i = 0; i < 10; i++) {
+      ASSERT_EQ(pwrite(make_data(3000, i)), 3000);
+      ASSERT_EQ(pread(out), 3000);
+      ASSERT_EQ(out, make_data(3000, i));
+   }
+
+   ASSERT_EQ(pread(out), -EAGAIN);
+}
+
+TEST_F(pipe_test, resize)
+{
+   vector<char> out(16 * KB);
+
+   ASSERT_EQ(pipe_set_size(wh, 5000), 8 * kb);
+   ASSERT_EQ(pipe_get_size(rh), 8 * kb);
+
+   /* Make the data wrap around the end of the ring */
+   ASSERT_EQ(pwrite(make_data(6 * kb, 0)), 6 * kb);
+   out.resize(5 * KB);
+   ASSERT_EQ(pread(out), 5 * kb);
+   ASSERT_EQ(pwrite(make_data(16 * kb, 6 * kb)), 7 * kb);
+
+   /* 8 KB in the pipe */
+   ASSERT_EQ(pipe_set_size(wh, 4 * kb), -EBUSY);
+   ASSERT_EQ(pipe_set_size(wh, 64 * kb), 64 * kb);
+   ASSERT_EQ(pwrite(make_data(kb, 13 * kb)), kb);
+
+   out.resize(16 * KB);
+   ASSERT_EQ(pread(out), 9 * kb);
+   out.resize(9 * KB);
+   ASSERT_EQ(out, make_data(9 * kb, 5 * kb));
+
+   ASSERT_EQ(pipe_set_size(wh, 0), 4 * kb);
+   ASSERT_EQ(pipe_set_size(wh, PIPE_MAX_SIZE + 1), -EPERM);
+   ASSERT_EQ(pipe_set_size(wh, -1), -EINVAL);
+}
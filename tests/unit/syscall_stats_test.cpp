@@ -0,0 +1,99 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <gtest/gtest.h>
+
+#include "kernel_init_funcs.h"
+
+extern "C" {
+   #include <tilck/kernel/syscall_stats.h>
+   #include <tilck/kernel/process.h>
+   #include <tilck/kernel/sched.h>
+   #include <tilck/kernel/errno.h>
+}
+
+class syscall_stats_test : public ::testing::Test {
+
+protected:
+
+   void SetUp() override {
+      init_kmalloc_for_tests();
+      sys_stats_reset();
+   }
+
+   void TearDown() override {
+      sys_stats_free_proc(get_curr_proc());
+   }
+
+   void account(u32 sn, long ret, u64 cycles) {
+      disable_preemption();
+      sys_stats_account(sn, (ulong)ret, cycles);
+      enable_preemption();
+   }
+
+   struct syscall_stats *proc_stats(u32 sn) {
+
+      struct proc_sys_stats *ps;
+      struct syscall_stats *res = NULL;
+
+      disable_preemption();
+      {
+         ps = sys_stats_get_proc(get_curr_proc());
+
+         for (int i = 0; ps && i < PROC_SYS_STATS_SLOTS; i++)
+            if (ps->sys_n[i] == sn + 1)
+               res = &ps->s[i];
+      }
+      enable_preemption();
+      return res;
+   }
+};
+
+TEST_F(syscall_stats_test, counters_and_hist)
+{
+   account(3, 10, 100);
+   account(3, -EBADF, 1000);
+   account(3, 0, 1ull << 40);
+
+   /* Addresses returned by mmap() are not errors, even if "negative" */
+   account(3, (long)0xb0000000, 1 << SYS_HIST_MIN_SHIFT);
+
+   struct syscall_stats *s = &sys_stats[3];
+   ASSERT_EQ(s->calls, 4u);
+   ASSERT_EQ(s->errors, 1u);
+   ASSERT_EQ(s->max_cycles, 0xffffffffu);
+   ASSERT_EQ(s->tot_cycles, 100 + 1000 + (1ull << 40) + 256);
+
+   ASSERT_EQ(s->hist[0], 2u);          /* 100 and 256 */
+   ASSERT_EQ(s->hist[1], 1u);          /* 1000, in [2^9, 2^10) */
+   ASSERT_EQ(s->hist[SYS_HIST_BUCKETS - 1], 1u);
+
+   struct syscall_stats *ps = proc_stats(3);
+   ASSERT_TRUE(ps != NULL);
+   ASSERT_EQ(ps->calls, 4u);
+   ASSERT_EQ(ps->errors, 1u);
+   ASSERT_TRUE(proc_stats(4) == NULL);
+}
+
+TEST_F(syscall_stats_test, proc_slots_and_reset)
+{
+   /* Fill all the slots: the last syscall has no free slot left */
+   for (u32 i = 0; i <= PROC_SYS_STATS_SLOTS; i++)
+      account(i, 0, 10);
+
+   for (u32 i = 0; i < PROC_SYS_STATS_SLOTS; i++)
+      ASSERT_TRUE(proc_stats(i) != NULL);
+
+   ASSERT_TRUE(proc_stats(PROC_SYS_STATS_SLOTS) == NULL);
+   ASSERT_EQ(get_curr_proc()->sys_stats->untracked, 1u);
+   ASSERT_EQ(sys_stats[PROC_SYS_STATS_SLOTS].calls, 1u);
+
+   sys_stats_reset();
+   ASSERT_EQ(sys_stats[0].calls, 0u);
+   ASSERT_TRUE(proc_stats(0) == NULL);
+
+   /* The per-process table is zeroed lazily, on the next syscall */
+   account(5, 0, 10);
+   ASSERT_TRUE(proc_stats(0) == NULL);
+   ASSERT_EQ(proc_stats(5)->calls, 1u);
+   ASSERT_EQ(get_curr_proc()->sys_stats->untracked, 0u);
+}
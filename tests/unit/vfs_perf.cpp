@@ -2,6 +2,10 @@
 
 #include "vfs_test.h"
 
+extern "C" {
+   #include <tilck/common/arch/generic_x86/x86_utils.h>
+}
+
 using namespace std;
 
 class ramfs_perf : public vfs_test_base {
@@ -45,3 +49,151 @@ TEST_F(ramfs_perf, creat)
    for (int i = 0; i < 100; i++)
       create_test_file(i);
 }
+
+TEST_F(ramfs_perf, resolve_deep_path)
+{
+   static const char dir[] = "/usr/local/share/some/deep/dir";
+   struct vfs_dcache_stats before, after;
+   struct k_stat64 st;
+   char path[256];
+   fs_handle h;
+   u64 start, duration;
+   const int iters = 100 * 1000;
+
+   for (const char *p = strchr(dir + 1, '/'); p; p = strchr(p + 1, '/')) {
+      snprintf(path, sizeof(path), "%.*s", (int)(p - dir), dir);
+      ASSERT_EQ(vfs_mkdir(path, 0755), 0);
+   }
+
+   ASSERT_EQ(vfs_mkdir(dir, 0755), 0);
+   snprintf(path, sizeof(path), "%s/file", dir);
+   ASSERT_EQ(vfs_open(path, &h, O_CREAT, 0644), 0);
+   vfs_close(h);
+
+   vfs_dcache_get_stats(&before);
+   start = RDTSC();
+
+   for (int i = 0; i < iters; i++) {
+      ASSERT_EQ(vfs_stat64(path, &st, true), 0);
+      ASSERT_EQ(vfs_stat64("/usr/local/share/missing", &st, true), -ENOENT);
+   }
+
+   duration = RDTSC() - start;
+   vfs_dcache_get_stats(&after);
+
+   printf("[ INFO     ] avg cycles per resolve: %llu\n",
+          (unsigned long long)(duration / (2 * iters)));
+
+   /* All the lookups, but the first ones, must have hit the cache */
+   ASSERT_GE(after.hits - before.hits, (u32)(10 * (iters - 1)));
+   ASSERT_GE(after.neg_hits - before.neg_hits, (u32)(iters - 1));
+}
+
+TEST_F(ramfs_perf, seq_read_write_64mb)
+{
+   const size_t file_size = 64 * MB;
+   const size_t chunk = 64 * KB;
+   vector<char> wbuf(chunk), rbuf(chunk);
+   struct k_stat64 st;
+   u64 start, duration;
+   fs_handle h;
+   ssize_t rc;
+
+   for (size_t i = 0; i < chunk; i++)
+      wbuf[i] = (char)(i * 7 + 3);
+
+   ASSERT_EQ(vfs_open("/bigfile", &h, O_CREAT | O_RDWR, 0644), 0);
+
+   start = RDTSC();
+
+   for (size_t off = 0; off < file_size; off += chunk) {
+      wbuf[0] = (char)(off / chunk);
+      rc = vfs_write(h, &wbuf[0], chunk);
+      ASSERT_EQ(rc, (ssize_t)chunk);
+   }
+
+   duration = RDTSC() - start;
+   printf("[ INFO     ] avg cycles per KB written: %llu\n",
+          (unsigned long long)(duration / (file_size / KB)));
+
+   ASSERT_EQ(vfs_fstat64(h, &st), 0);
+   ASSERT_EQ((size_t)st.st_size, file_size);
+   ASSERT_EQ((size_t)st.st_blocks, file_size / 512);
+   ASSERT_EQ(vfs_seek(h, 0, SEEK_SET), 0);
+
+   duration = 0;
+
+   for (size_t off = 0; off < file_size; off += chunk) {
+
+      start = RDTSC();
+      rc = vfs_read(h, &rbuf[0], chunk);
+      duration += RDTSC() - start;
+      ASSERT_EQ(rc, (ssize_t)chunk);
+
+      wbuf[0] = (char)(off / chunk);
+      ASSERT_EQ(memcmp(&rbuf[0], &wbuf[0], chunk), 0);
+   }
+
+   printf("[ INFO     ] avg cycles per KB read: %llu\n",
+          (unsigned long long)(duration / (file_size / KB)));
+
+   vfs_close(h);
+   ASSERT_EQ(vfs_unlink("/bigfile"), 0);
+}
+
+class fat_perf : public vfs_test_base {
+
+protected:
+   struct mnt_fs *fat_fs;
+   size_t fatpart_size;
+
+   void SetUp() override {
+
+      vfs_test_base::SetUp();
+
+      const char *buf = load_once_file(TEST_FATPART_FILE, &fatpart_size);
+      fat_fs = fat_mount_ramdisk((void *) buf, fatpart_size, 0);
+      ASSERT_TRUE(fat_fs != NULL);
+
+      mp_init(fat_fs);
+   }
+
+   void TearDown() override {
+
+      fat_umount_ramdisk(fat_fs);
+      vfs_test_base::TearDown();
+   }
+};
+
+/*
+ * Measure the cost of the lookups in the fs itself, as the VFS dentry cache
+ * would hide it: that's what the first lookup of each path component costs
+ * (e.g. during execve() of a program deep in the boot FAT ramdisk).
+ */
+TEST_F(fat_perf, lookup_in_big_dir)
+{
+   const int n = 5000;
+   const struct fs_ops *fsops = fat_fs->fsops;
+   struct fs_path root, dir, fp;
+   u64 start, duration;
+   char name[64];
+
+   fsops->get_entry(fat_fs, NULL, NULL, 0, &root);
+   fsops->get_entry(fat_fs, root.inode, "bigdir", 6, &dir);
+   ASSERT_TRUE(dir.inode != NULL);
+
+   start = RDTSC();
+
+   for (int i = 0; i < n; i++) {
+      int len = sprintf(name, "file_with_a_long_name_%d", i);
+      fsops->get_entry(fat_fs, dir.inode, name, len, &fp);
+      ASSERT_TRUE(fp.inode != NULL);
+   }
+
+   fsops->get_entry(fat_fs, dir.inode, "missing", 7, &fp);
+   ASSERT_TRUE(fp.inode == NULL);
+
+   duration = RDTSC() - start;
+   printf("[ INFO     ] avg cycles per lookup: %llu\n",
+          (unsigned long long)(duration / n));
+}
@@ -6,6 +6,8 @@
 
 #include <iostream>
 #include <random>
+#include <vector>
+#include <string>
 
 #include "vfs_test.h"
 
@@ -166,24 +168,77 @@ TEST_F(vfs_fat32, fseek)
    close(fd);
 }
 
-TEST_F(vfs_fat32, pread_not_supported)
+TEST_F(vfs_fat32, pread)
 {
+   random_device rdev;
+   const auto seed = rdev();
+   default_random_engine engine(seed);
    const char *fatpart_file_path = "/bigfile";
+   const char *real_file_path = PROJ_BUILD_DIR "/test_sysroot/bigfile";
+   char buf1[8192], buf2[8192];
    fs_handle h = NULL;
-   char buf[32];
+   ssize_t rc1, rc2;
    int rc;
 
+   cout << "[ INFO     ] random seed: " << seed << endl;
+
+   int fd = open(real_file_path, O_RDONLY);
+   ASSERT_GE(fd, 0);
+
+   const off_t file_size = lseek(fd, 0, SEEK_END);
+   uniform_int_distribution<off_t> off_dist(0, file_size + 100);
+   uniform_int_distribution<size_t> len_dist(0, sizeof(buf1));
+
    rc = vfs_open(fatpart_file_path, &h, 0, O_RDONLY);
-   ASSERT_TRUE(rc == 0);
+   ASSERT_EQ(rc, 0);
    ASSERT_TRUE(h != NULL);
 
-   rc = vfs_pread(h, buf, sizeof(buf), 0 /* offset */);
-   EXPECT_EQ(rc, -EPERM);
+   for (int i = 0; i < 1000; i++) {
+
+      const off_t off = off_dist(engine);
+      const size_t len = len_dist(engine);
 
-   rc = vfs_pread(h, buf, sizeof(buf), 10 /* offset */);
-   EXPECT_EQ(rc, -EPERM);
+      rc1 = pread(fd, buf1, len, off);
+      rc2 = vfs_pread(h, buf2, len, (offt)off);
+
+      ASSERT_EQ(rc2, rc1) << "off: " << off << ", len: " << len;
+      ASSERT_EQ(memcmp(buf1, buf2, (size_t)rc1), 0);
+   }
+
+   /* pread() does not change the file position */
+   ASSERT_EQ(vfs_seek(h, 0, SEEK_CUR), 0);
 
    vfs_close(h);
+   close(fd);
+}
+
+TEST_F(vfs_fat32, lookup_case_sensitivity)
+{
+   struct k_stat64 st;
+
+   /* Long names are case sensitive */
+   ASSERT_EQ(vfs_stat64("/testdir/Aaa", &st, true), 0);
+   ASSERT_EQ(vfs_stat64("/testdir/aaa", &st, true), -ENOENT);
+   ASSERT_EQ(vfs_stat64("/testdir/AAA", &st, true), -ENOENT);
+
+   ASSERT_EQ(vfs_stat64("/testdir/This_is_a_file_with_a_veeeery_long_name.txt",
+                        &st, true), 0);
+   ASSERT_EQ(vfs_stat64("/testdir/this_is_a_file_with_a_veeeery_long_name.txt",
+                        &st, true), -ENOENT);
+
+   /* Short names are not */
+   ASSERT_EQ(vfs_stat64("/testdir/BBB", &st, true), 0);
+   ASSERT_EQ(vfs_stat64("/testdir/bbb", &st, true), 0);
+   ASSERT_EQ(vfs_stat64("/testdir/file.abc", &st, true), 0);
+   ASSERT_EQ(vfs_stat64("/testdir/FILE.ABC", &st, true), 0);
+   ASSERT_EQ(vfs_stat64("/testdir/12345678.xyz", &st, true), 0);
+   ASSERT_EQ(vfs_stat64("/testdir/12345678.xy", &st, true), -ENOENT);
+
+   /* Directories and the dot entries */
+   ASSERT_EQ(vfs_stat64("/testdir/dir1/f1", &st, true), 0);
+   ASSERT_EQ(vfs_stat64("/testdir/dir1/./f2", &st, true), 0);
+   ASSERT_EQ(vfs_stat64("/testdir/dir1/../dir2/f3", &st, true), 0);
+   ASSERT_EQ(vfs_stat64("/testdir/dir1/f3", &st, true), -ENOENT);
 }
 
 class vfs_ramfs : public vfs_test_base {
@@ -425,6 +480,222 @@ TEST_F(vfs_ramfs, seek)
    ASSERT_NO_FATAL_FAILURE({ test_pread_pwrite_seek(true); });
 }
 
+TEST_F(vfs_ramfs, dcache_invalidation)
+{
+   struct k_stat64 st;
+   fs_handle h;
+
+   /* Cache a negative entry, then create the file */
+   ASSERT_EQ(vfs_stat64("/a", &st, true), -ENOENT);
+   ASSERT_EQ(vfs_stat64("/a", &st, true), -ENOENT);
+   ASSERT_EQ(vfs_open("/a", &h, O_CREAT | O_RDWR, 0644), 0);
+   vfs_close(h);
+   ASSERT_EQ(vfs_stat64("/a", &st, true), 0);
+
+   /* Cache a positive entry, then unlink the file */
+   ASSERT_EQ(vfs_unlink("/a"), 0);
+   ASSERT_EQ(vfs_stat64("/a", &st, true), -ENOENT);
+
+   /* Entries inside a removed dir must not survive a new dir with same name */
+   ASSERT_EQ(vfs_mkdir("/d", 0755), 0);
+   ASSERT_EQ(vfs_mkdir("/d/e", 0755), 0);
+   ASSERT_EQ(vfs_stat64("/d/e", &st, true), 0);
+   ASSERT_EQ(vfs_rmdir("/d/e"), 0);
+   ASSERT_EQ(vfs_rmdir("/d"), 0);
+   ASSERT_EQ(vfs_stat64("/d/e", &st, true), -ENOENT);
+   ASSERT_EQ(vfs_mkdir("/d", 0755), 0);
+   ASSERT_EQ(vfs_stat64("/d/e", &st, true), -ENOENT);
+
+   /* Rename: both the old and the new names change */
+   ASSERT_EQ(vfs_open("/d/f", &h, O_CREAT | O_RDWR, 0644), 0);
+   vfs_close(h);
+   ASSERT_EQ(vfs_stat64("/d/f", &st, true), 0);
+   ASSERT_EQ(vfs_stat64("/d/g", &st, true), -ENOENT);
+   ASSERT_EQ(vfs_rename("/d/f", "/d/g"), 0);
+   ASSERT_EQ(vfs_stat64("/d/f", &st, true), -ENOENT);
+   ASSERT_EQ(vfs_stat64("/d/g", &st, true), 0);
+
+   /* Link and symlink create new entries */
+   ASSERT_EQ(vfs_stat64("/d/h", &st, true), -ENOENT);
+   ASSERT_EQ(vfs_stat64("/d/s", &st, false), -ENOENT);
+   ASSERT_EQ(vfs_link("/d/g", "/d/h"), 0);
+   ASSERT_EQ(vfs_symlink("/d/g", "/d/s"), 0);
+   ASSERT_EQ(vfs_stat64("/d/h", &st, true), 0);
+   ASSERT_EQ(vfs_stat64("/d/s", &st, false), 0);
+
+   /* With AT_SYMLINK_FOLLOW, link the symlink's target instead */
+   ASSERT_EQ(vfs_linkat(AT_FDCWD, "/d/s", AT_FDCWD, "/d/t", true), 0);
+   ASSERT_EQ(vfs_stat64("/d/t", &st, false), 0);
+   ASSERT_TRUE(S_ISREG(st.st_mode));
+
+   /* ramfs does not support hard links to symlinks */
+   ASSERT_EQ(vfs_linkat(AT_FDCWD, "/d/s", AT_FDCWD, "/d/u", false), -EPERM);
+}
+
+TEST_F(vfs_ramfs, rename_dirs_and_unlinked_files)
+{
+   struct k_stat64 st, st2;
+   char buf[8] = {0};
+   fs_handle h;
+
+   ASSERT_EQ(vfs_mkdir("/a", 0755), 0);
+   ASSERT_EQ(vfs_mkdir("/b", 0755), 0);
+   ASSERT_EQ(vfs_mkdir("/a/x", 0755), 0);
+
+   /* Moving a dir elsewhere updates its '..' entry */
+   ASSERT_EQ(vfs_rename("/a/x", "/b/x"), 0);
+   ASSERT_EQ(vfs_stat64("/b/x/..", &st, true), 0);
+   ASSERT_EQ(vfs_stat64("/b", &st2, true), 0);
+   ASSERT_EQ(st.st_ino, st2.st_ino);
+
+   /* A dir cannot be moved inside itself */
+   ASSERT_EQ(vfs_rename("/b", "/b/x/y"), -EINVAL);
+   ASSERT_EQ(vfs_rename("/b", "/b/y"), -EINVAL);
+
+   /* Type checks and RENAME_NOREPLACE */
+   ASSERT_EQ(vfs_open("/b/f", &h, O_CREAT | O_RDWR, 0644), 0);
+   ASSERT_EQ(vfs_write(h, (void *)"hello", 5), 5);
+   ASSERT_EQ(vfs_rename("/b/f", "/b/x"), -EISDIR);
+   ASSERT_EQ(vfs_rename("/b/x", "/b/f"), -ENOTDIR);
+   ASSERT_EQ(vfs_renameat(AT_FDCWD, "/b/x", AT_FDCWD, "/a", RENAME_NOREPLACE),
+             -EEXIST);
+
+   /* An unlinked file is still usable, as long as a handle is open */
+   ASSERT_EQ(vfs_unlink("/b/f"), 0);
+   ASSERT_EQ(vfs_stat64("/b/f", &st, true), -ENOENT);
+   ASSERT_EQ(vfs_pread(h, buf, 5, 0), 5);
+   ASSERT_STREQ(buf, "hello");
+   vfs_close(h);
+
+   ASSERT_EQ(vfs_rmdir("/b/x"), 0);
+   ASSERT_EQ(vfs_rmdir("/b"), 0);
+   ASSERT_EQ(vfs_rmdir("/a"), 0);
+}
+
+TEST_F(vfs_ramfs, sparse_files_and_truncate)
+{
+   const offt off = 3 * PAGE_SIZE + 100;
+   char buf[PAGE_SIZE];
+   struct k_stat64 st;
+   fs_handle h;
+
+   ASSERT_EQ(vfs_open("/sparse", &h, O_CREAT | O_RDWR, 0644), 0);
+
+   /* Write in the middle of a page, past a few holes */
+   ASSERT_EQ(vfs_pwrite(h, (void *)"hello", 5, off), 5);
+   ASSERT_EQ(vfs_fstat64(h, &st), 0);
+   ASSERT_EQ(st.st_size, off + 5);
+   ASSERT_EQ(st.st_blocks, PAGE_SIZE / 512);
+
+   /* Both the holes and the rest of the page are read as zeros */
+   ASSERT_EQ(vfs_pread(h, buf, sizeof(buf), 0), (ssize_t)sizeof(buf));
+   ASSERT_EQ(buf[0], 0);
+   ASSERT_EQ(memcmp(buf, buf + 1, sizeof(buf) - 1), 0);
+   ASSERT_EQ(vfs_pread(h, buf, 10, off - 5), 10);
+   ASSERT_EQ(memcmp(buf, "\0\0\0\0\0hello", 10), 0);
+
+   /* Truncating in the middle of a page and extending again gives zeros */
+   ASSERT_EQ(vfs_ftruncate(h, off + 2), 0);
+   ASSERT_EQ(vfs_ftruncate(h, off + 5), 0);
+   ASSERT_EQ(vfs_pread(h, buf, 5, off), 5);
+   ASSERT_EQ(memcmp(buf, "he\0\0\0", 5), 0);
+
+   ASSERT_EQ(vfs_ftruncate(h, 0), 0);
+   ASSERT_EQ(vfs_fstat64(h, &st), 0);
+   ASSERT_EQ(st.st_blocks, 0);
+
+   vfs_close(h);
+   ASSERT_EQ(vfs_unlink("/sparse"), 0);
+}
+
+struct dent_info {
+   string name;
+   offt next_off;
+};
+
+static int collect_dents_cb(struct vfs_dent64 *vde, void *arg)
+{
+   auto *v = (vector<dent_info> *)arg;
+   v->push_back(dent_info{ vde->name, vde->next_off });
+   return 0;
+}
+
+/*
+ * Read the whole dir from its current position, calling directly the fs-op
+ * getdents(), as vfs_getdents64() requires an user buffer.
+ */
+static vector<dent_info> read_dir(fs_handle h)
+{
+   struct fs_handle_base *hb = (struct fs_handle_base *)h;
+   vector<dent_info> v;
+
+   if (hb->fs->fsops->getdents(h, &collect_dents_cb, &v))
+      v.clear();
+
+   return v;
+}
+
+TEST_F(vfs_ramfs, getdents_stable_offsets)
+{
+   const int n = 1000;
+   vector<dent_info> dents;
+   char path[64];
+   fs_handle h, dh;
+   offt pos = 0;
+
+   ASSERT_EQ(vfs_mkdir("/d", 0755), 0);
+
+   for (int i = 0; i < n; i++) {
+      sprintf(path, "/d/f%d", i);
+      ASSERT_EQ(vfs_open(path, &h, O_CREAT | O_RDWR, 0644), 0);
+      vfs_close(h);
+   }
+
+   ASSERT_EQ(vfs_open("/d", &dh, O_RDONLY, 0), 0);
+   dents = read_dir(dh);
+   ASSERT_EQ(dents.size(), (size_t)n + 2);
+   ASSERT_EQ(dents[0].name, ".");
+   ASSERT_EQ(dents[1].name, "..");
+
+   /* Remember the offset after "f499", then remove the entries around it */
+   ASSERT_EQ(dents[2 + 499].name, "f499");
+   pos = dents[2 + 499].next_off;
+
+   ASSERT_EQ(vfs_unlink("/d/f499"), 0);
+   ASSERT_EQ(vfs_unlink("/d/f500"), 0);
+   ASSERT_EQ(vfs_unlink("/d/f10"), 0);
+
+   /* The offset is still valid: we resume from "f501" */
+   ASSERT_EQ(vfs_seek(dh, pos, SEEK_SET), pos);
+   dents = read_dir(dh);
+   ASSERT_EQ(dents.size(), (size_t)(n - 501));
+   ASSERT_EQ(dents[0].name, "f501");
+   ASSERT_EQ(dents.back().name, "f999");
+
+   /* Seeking at the offset of a removed entry works as well */
+   ASSERT_EQ(vfs_seek(dh, pos - 1, SEEK_SET), pos - 1);
+   dents = read_dir(dh);
+   ASSERT_EQ(dents[0].name, "f501");
+
+   /* Rewind */
+   ASSERT_EQ(vfs_seek(dh, 0, SEEK_SET), 0);
+   dents = read_dir(dh);
+   ASSERT_EQ(dents.size(), (size_t)n - 1);
+   ASSERT_EQ(dents[0].name, ".");
+   vfs_close(dh);
+
+   for (int i = 0; i < n; i++) {
+
+      if (i == 10 || i == 499 || i == 500)
+         continue;
+
+      sprintf(path, "/d/f%d", i);
+      ASSERT_EQ(vfs_unlink(path), 0);
+   }
+
+   ASSERT_EQ(vfs_rmdir("/d"), 0);
+}
+
 class compute_abs_path_test :
    public TestWithParam<
       tuple<const char *, const char *, const char *>
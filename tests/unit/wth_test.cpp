@@ -19,6 +19,7 @@ extern "C" {
 
    #include <tilck/kernel/kmalloc.h>
    #include <tilck/kernel/worker_thread.h>
+   #include <tilck/kernel/sched.h>
    #include "kernel/wth_int.h" // private header
 }
 
@@ -72,7 +73,8 @@ TEST_F(worker_thread_test, essential)
 TEST_F(worker_thread_test, base)
 {
    struct worker_thread *wth = wth_find_worker(WTH_PRIO_HIGHEST);
-   const int max_jobs = wth_get_queue_size(wth);
+   const int max_jobs = wth_get_queue_size(wth) + WTH_OVERFLOW_POOL_SIZE;
+   struct wth_stats stats;
    bool res;
 
    for (int i = 0; i < max_jobs; i++) {
@@ -85,6 +87,12 @@ TEST_F(worker_thread_test, base)
    // There is no more space left, expecting the ADD failed.
    ASSERT_FALSE(res);
 
+   wth_get_stats(wth, &stats);
+   ASSERT_EQ(stats.depth, (u32)max_jobs);
+   ASSERT_EQ(stats.max_depth, (u32)max_jobs);
+   ASSERT_EQ(stats.overflows, (u32)WTH_OVERFLOW_POOL_SIZE);
+   ASSERT_EQ(stats.drops, 1u);
+
    for (int i = 0; i < max_jobs; i++) {
       ASSERT_NO_FATAL_FAILURE({ res = wth_process_single_job(wth); });
       ASSERT_TRUE(res);
@@ -147,10 +155,56 @@ TEST_F(worker_thread_test, advanced)
    ASSERT_FALSE(res);
 }
 
+static vector<ulong> overflow_test_seq;
+
+static void overflow_test_func(void *arg)
+{
+   overflow_test_seq.push_back((ulong)arg);
+}
+
+TEST_F(worker_thread_test, overflow_fifo_order)
+{
+   struct worker_thread *wth = wth_find_worker(WTH_PRIO_HIGHEST);
+   const int ring_size = wth_get_queue_size(wth);
+   ulong next = 0;
+   bool res;
+
+   overflow_test_seq.clear();
+
+   // Fill the ring buffer and put a few jobs in the overflow list
+   for (int i = 0; i < ring_size + 4; i++) {
+      res = wth_enqueue_on(wth, &overflow_test_func, TO_PTR(next++));
+      ASSERT_TRUE(res);
+   }
+
+   // Free some space in the ring buffer
+   for (int i = 0; i < 2; i++) {
+      ASSERT_TRUE(wth_process_single_job(wth));
+   }
+
+   // The new jobs must go after the ones in the overflow list anyway
+   for (int i = 0; i < 2; i++) {
+      res = wth_enqueue_on(wth, &overflow_test_func, TO_PTR(next++));
+      ASSERT_TRUE(res);
+   }
+
+   while (wth_process_single_job(wth)) { }
+
+   ASSERT_EQ(overflow_test_seq.size(), next);
+
+   for (ulong i = 0; i < next; i++)
+      ASSERT_EQ(overflow_test_seq[i], i);
+
+   // Once the overflow list is empty, the ring buffer is used again
+   ASSERT_TRUE(wth_enqueue_on(wth, &overflow_test_func, TO_PTR(next)));
+   ASSERT_EQ(wth->ovf_head, nullptr);
+   ASSERT_TRUE(wth_process_single_job(wth));
+}
+
 TEST_F(worker_thread_test, chaos)
 {
    struct worker_thread *wth = wth_find_worker(WTH_PRIO_HIGHEST);
-   const int max_jobs = wth_get_queue_size(wth);
+   const int max_jobs = wth_get_queue_size(wth) + WTH_OVERFLOW_POOL_SIZE;
 
    random_device rdev;
    default_random_engine e(rdev());
@@ -173,7 +227,18 @@ TEST_F(worker_thread_test, chaos)
          }
 
          res = wth_enqueue_on(wth, &simple_func1, TO_PTR(1234));
-         ASSERT_TRUE(res);
+
+         if (!res) {
+
+            /*
+             * While the overflow list is in use, new jobs go only there, in
+             * order to preserve the FIFO order. Therefore, we can fail before
+             * reaching `max_jobs`, but only when the overflow pool is empty.
+             */
+            ASSERT_EQ(wth->ovf_count, (u32)WTH_OVERFLOW_POOL_SIZE);
+            break;
+         }
+
          slots_used++;
       }
 
@@ -193,3 +258,99 @@ TEST_F(worker_thread_test, chaos)
       }
    }
 }
+
+static u32 steal_test_count;
+
+static void steal_test_func(void *arg)
+{
+   struct worker_thread *victim = (struct worker_thread *)arg;
+
+   // A stolen job must be accounted as running while it runs
+   if (victim) {
+      ASSERT_EQ(victim->stolen_running, 1u);
+   }
+
+   steal_test_count++;
+}
+
+static struct worker_thread *
+create_test_worker(const char *name, int prio)
+{
+   struct worker_thread *wth;
+
+   disable_preemption();
+   wth = wth_create_thread(name, prio, 16);
+   enable_preemption();
+   return wth;
+}
+
+TEST_F(worker_thread_test, steal_same_pool)
+{
+   struct worker_thread *a = create_test_worker("pool", 5);
+   struct worker_thread *b = create_test_worker("pool", 5);
+   struct worker_thread *other = create_test_worker("other", 5);
+   struct wth_stats stats;
+
+   ASSERT_TRUE(a && b && other);
+   steal_test_count = 0;
+
+   for (int i = 0; i < 2; i++)
+      ASSERT_TRUE(wth_enqueue_on(a, &steal_test_func, a));
+
+   ASSERT_TRUE(wth_enqueue_on(a, &steal_test_func, NULL));
+
+   // Workers of other pools cannot steal from `a`: it's not unordered
+   ASSERT_FALSE(wth_steal_job(other));
+   ASSERT_FALSE(wth_steal_job(wth_find_worker(WTH_PRIO_HIGHEST)));
+
+   // `b` is in the same pool, while `a` is busy
+   ASSERT_TRUE(wth_steal_job(b));
+   ASSERT_TRUE(wth_steal_job(b));
+   ASSERT_EQ(steal_test_count, 2u);
+
+   wth_get_stats(a, &stats);
+   ASSERT_EQ(stats.stolen, 2u);
+   ASSERT_EQ(stats.depth, 1u);
+   ASSERT_EQ(a->stolen_running, 0u);
+
+   // Nothing can be stolen from a worker waiting for jobs
+   a->waiting_for_jobs = true;
+   ASSERT_FALSE(wth_steal_job(b));
+   a->waiting_for_jobs = false;
+
+   ASSERT_TRUE(wth_process_single_job(a));
+   ASSERT_FALSE(wth_steal_job(b));
+   ASSERT_EQ(steal_test_count, 3u);
+
+   for (int i = 0; i < 3; i++)
+      destroy_last_worker_thread();
+}
+
+TEST_F(worker_thread_test, steal_unordered)
+{
+   struct worker_thread *prio0 = wth_find_worker(WTH_PRIO_HIGHEST);
+   struct worker_thread *low = create_test_worker("low", 10);
+   struct worker_thread *v = create_test_worker("unord", 5);
+   struct wth_stats stats;
+
+   ASSERT_TRUE(low && v);
+   wth_set_unordered(v);
+   steal_test_count = 0;
+
+   ASSERT_TRUE(wth_enqueue_on(v, &steal_test_func, NULL));
+   ASSERT_TRUE(wth_enqueue_on(v, &steal_test_func, NULL));
+
+   // Jobs never run with a priority lower than the one of their worker
+   ASSERT_FALSE(wth_steal_job(low));
+
+   ASSERT_TRUE(wth_steal_job(prio0));
+   ASSERT_EQ(steal_test_count, 1u);
+
+   wth_get_stats(v, &stats);
+   ASSERT_EQ(stats.stolen, 1u);
+
+   ASSERT_TRUE(wth_process_single_job(v));
+
+   for (int i = 0; i < 2; i++)
+      destroy_last_worker_thread();
+}
@@ -38,6 +38,45 @@ static int ps_tool(int argc, char **argv)
    return rc;
 }
 
+static int prof_tool(int argc, char **argv)
+{
+   static char report[64 * 1024];
+   int cmd, rc;
+
+   if (argc != 1) {
+      printf("Usage: prof start | stop | reset | flat | cg\n");
+      return 1;
+   }
+
+   if (!strcmp(argv[0], "start"))
+      cmd = TILCK_PROF_START;
+   else if (!strcmp(argv[0], "stop"))
+      cmd = TILCK_PROF_STOP;
+   else if (!strcmp(argv[0], "reset"))
+      cmd = TILCK_PROF_RESET;
+   else if (!strcmp(argv[0], "flat"))
+      cmd = TILCK_PROF_REPORT_FLAT;
+   else if (!strcmp(argv[0], "cg"))
+      cmd = TILCK_PROF_REPORT_CALLGRAPH;
+   else {
+      printf("ERROR: unknown option '%s'\n", argv[0]);
+      return 1;
+   }
+
+   rc = syscall(TILCK_CMD_SYSCALL,
+                TILCK_CMD_PROFILER, cmd, report, sizeof(report));
+
+   if (rc < 0) {
+      perror("prof");
+      return rc;
+   }
+
+   if (cmd == TILCK_PROF_REPORT_FLAT || cmd == TILCK_PROF_REPORT_CALLGRAPH)
+      fputs(report, stdout);
+
+   return 0;
+}
+
 static int debug_panel(int argc, char **argv)
 {
    if (argc > 0) {
@@ -87,6 +126,10 @@ int main(int argc, char **argv)
 
       rc = ps_tool(argc-1, argv+1);
 
+   } else if (!strcmp(prog_name, "prof")) {
+
+      rc = prof_tool(argc-1, argv+1);
+
    } else {
 
       printf("Unknown '%s' tool\n", prog_name);
@@ -26,7 +26,9 @@ static struct fb_var_screeninfo fbi;
 static struct fb_fix_screeninfo fb_fixinfo;
 
 static char *buffer;
+static char *draw_buf;     /* page of `buffer` where we're drawing */
 static size_t fb_size;
+static size_t fb_map_size;
 static size_t fb_pitch;
 static size_t fb_pitch_div4;
 static int fbfd = -1, ttyfd = -1;
@@ -46,19 +48,19 @@ static inline uint32_t make_color(uint8_t red, uint8_t green, uint8_t blue)
 
 static inline void set_pixel(uint32_t x, uint32_t y, uint32_t color)
 {
-   ((volatile uint32_t *)buffer)[x + y * fb_pitch_div4] = color;
+   ((volatile uint32_t *)draw_buf)[x + y * fb_pitch_div4] = color;
 }
 
 static void clear_screen(uint32_t color)
 {
-   memset32(buffer, color, fb_size >> 2);
+   memset32(draw_buf, color, fb_size >> 2);
 }
 
 static void
 fill_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t color)
 {
    for (uint32_t cy = y; cy < y + h; cy++)
-      memset32(buffer + cy * fb_pitch + (x << 2), color, w);
+      memset32(draw_buf + cy * fb_pitch + (x << 2), color, w);
 }
 
 static bool check_fb_assumptions(void)
@@ -94,6 +96,22 @@ static bool fb_acquire(void)
       return false;
    }
 
+   ttyfd = open(TTY_DEVICE, O_RDWR);
+
+   if (ttyfd < 0) {
+      fprintf(stderr, "Unable to open '%s'\n", TTY_DEVICE);
+      return false;
+   }
+
+   /*
+    * Switch to graphics mode before reading the screen info: the console
+    * might have panned the display while it was active.
+    */
+   if (ioctl(ttyfd, KDSETMODE, KD_GRAPHICS) != 0) {
+      fprintf(stderr, "WARNING: unable set tty into "
+              "graphics mode on '%s'\n", TTY_DEVICE);
+   }
+
    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &fb_fixinfo) != 0) {
       fprintf(stderr, "ioctl(FBIOGET_FSCREENINFO) failed\n");
       return false;
@@ -106,37 +124,27 @@ static bool fb_acquire(void)
 
    fb_pitch = fb_fixinfo.line_length;
    fb_size = fb_pitch * fbi.yres;
+   fb_map_size = fb_pitch * fbi.yres_virtual;
    fb_pitch_div4 = fb_pitch >> 2;
 
    if (!check_fb_assumptions())
       return false;
 
-   ttyfd = open(TTY_DEVICE, O_RDWR);
-
-   if (ttyfd < 0) {
-      fprintf(stderr, "Unable to open '%s'\n", TTY_DEVICE);
-      return false;
-   }
-
-   if (ioctl(ttyfd, KDSETMODE, KD_GRAPHICS) != 0) {
-      fprintf(stderr, "WARNING: unable set tty into "
-              "graphics mode on '%s'\n", TTY_DEVICE);
-   }
-
-   buffer = mmap(0, fb_size, PROT_READ | PROT_WRITE, MAP_SHARED, fbfd, 0);
+   buffer = mmap(0, fb_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fbfd, 0);
 
    if (buffer == MAP_FAILED) {
       fprintf(stderr, "Unable to mmap framebuffer '%s'\n", FB_DEVICE);
       return false;
    }
 
+   draw_buf = buffer;
    return true;
 }
 
 static void fb_release(void)
 {
    if (buffer)
-      munmap(buffer, fb_size);
+      munmap(buffer, fb_map_size);
 
    if (ttyfd != -1) {
       ioctl(ttyfd, KDSETMODE, KD_TEXT);
@@ -155,6 +163,52 @@ static void draw_something(void)
    fill_rect(50 + 200, 50, 100, 100, make_color(0, 0, 255));
 }
 
+static bool fb_pan(uint32_t yoffset)
+{
+   fbi.xoffset = 0;
+   fbi.yoffset = yoffset;
+
+   if (ioctl(fbfd, FBIOPAN_DISPLAY, &fbi) != 0) {
+      fprintf(stderr, "ioctl(FBIOPAN_DISPLAY) failed\n");
+      return false;
+   }
+
+   return true;
+}
+
+/*
+ * Move a square on the screen drawing each frame in the page not currently
+ * shown and then panning the display to it (double buffering).
+ */
+static void double_buffer_demo(void)
+{
+   const uint32_t frames = 300;
+   uint32_t back = fbi.yres;
+
+   if (fbi.yres_virtual < 2 * fbi.yres) {
+      fprintf(stderr, "No room for double buffering: yres_virtual: %u\n",
+              fbi.yres_virtual);
+      return;
+   }
+
+   for (uint32_t f = 0; f < frames; f++) {
+
+      draw_buf = buffer + back * fb_pitch;
+      clear_screen(make_color(0, 0, 0));
+      fill_rect(f * (fbi.xres - 100) / frames, 50, 100, 100,
+                make_color(255, 255, 0));
+
+      if (!fb_pan(back))
+         break;
+
+      back = back ? 0 : fbi.yres;
+      usleep(16 * 1000);
+   }
+
+   draw_buf = buffer;
+   fb_pan(0);
+}
+
 static void dump_fb_fix_info(void)
 {
    fbfd = open(FB_DEVICE, O_RDWR);
@@ -200,6 +254,7 @@ static void dump_fb_var_info(void)
    printf("yres:           %u\n", fbi.yres);
    printf("xres_virtual:   %u\n", fbi.xres_virtual);
    printf("yres_virtual:   %u\n", fbi.yres_virtual);
+   printf("yoffset:        %u\n", fbi.yoffset);
    printf("height (mm):    %u\n", fbi.height);
    printf("width (mm):     %u\n", fbi.width);
    printf("pixclock (ps):  %u\n", fbi.pixclock);
@@ -222,16 +277,23 @@ static void dump_fb_var_info(void)
 
 int main(int argc, char **argv)
 {
+   bool db = false;
+
    if (argc > 1) {
 
-      if (!strcmp(argv[1], "-fi"))
-         dump_fb_fix_info();
-      else if (!strcmp(argv[1], "-vi"))
-         dump_fb_var_info();
-      else
-         printf("Unknown option '%s'\n", argv[1]);
+      if (!strcmp(argv[1], "-db")) {
+         db = true;
+      } else {
 
-      return 0;
+         if (!strcmp(argv[1], "-fi"))
+            dump_fb_fix_info();
+         else if (!strcmp(argv[1], "-vi"))
+            dump_fb_var_info();
+         else
+            printf("Unknown option '%s'\n", argv[1]);
+
+         return 0;
+      }
    }
 
    if (!fb_acquire()) {
@@ -239,7 +301,11 @@ int main(int argc, char **argv)
       return 1;
    }
 
-   draw_something();
+   if (db)
+      double_buffer_demo();
+   else
+      draw_something();
+
    getchar();
 
    fb_release();